@@ -85,6 +85,8 @@ class ToolHelperFileOutputGenerator(OutputGenerator):
         self.structNames = []                             # List of Vulkan struct typenames
         self.structTypes = dict()                         # Map of Vulkan struct typename to required VkStructureType
         self.structMembers = []                           # List of StructMemberData records for all Vulkan structs
+        self.structAliases = dict()                       # Map of Vulkan struct alias typename to the typename it aliases
+        self.unionNames = []                              # List of Vulkan union typenames
         self.object_types = []                            # List of all handle types
         self.debug_report_object_types = []               # Handy copy of debug_report_object_type enum data
         self.core_object_types = []                       # Handy copy of core_object_type enum data
@@ -104,6 +106,31 @@ class ToolHelperFileOutputGenerator(OutputGenerator):
             'VkPipelineViewportStateCreateInfo' :
                 ', const bool is_dynamic_viewports, const bool is_dynamic_scissors',
         }
+        # Struct members that point to data the struct_info tables leave as it is, so the pointer value is captured and
+        # replayed. The generator warns about any other member it can't describe.
+        self.undescribed_struct_members = {
+            # Window system objects belong to the application and are recreated by the replayer
+            'VkXlibSurfaceCreateInfoKHR' : ['dpy'],
+            'VkXcbSurfaceCreateInfoKHR' : ['connection'],
+            'VkWaylandSurfaceCreateInfoKHR' : ['display', 'surface'],
+            'VkAndroidSurfaceCreateInfoKHR' : ['window'],
+            'VkMacOSSurfaceCreateInfoMVK' : ['pView'],
+            'VkIOSSurfaceCreateInfoMVK' : ['pView'],
+            'VkMetalSurfaceCreateInfoEXT' : ['pLayer'],
+            'VkViSurfaceCreateInfoNN' : ['window'],
+            'VkDirectFBSurfaceCreateInfoEXT' : ['dfb', 'surface'],
+            'VkImportAndroidHardwareBufferInfoANDROID' : ['buffer'],
+            # Host memory and user data of the application, whose size isn't known
+            'VkImportMemoryHostPointerInfoEXT' : ['pHostPointer'],
+            'VkDebugReportCallbackCreateInfoEXT' : ['pUserData'],
+            'VkDebugUtilsMessengerCreateInfoEXT' : ['pUserData'],
+            'VkInitializePerformanceApiInfoINTEL' : ['pUserData'],
+            'VkAllocationCallbacks' : ['pUserData'],
+            # Arrays of pointers, which are copied by the packets of the calls that take these structs
+            'VkInstanceCreateInfo' : ['ppEnabledLayerNames', 'ppEnabledExtensionNames'],
+            'VkDeviceCreateInfo' : ['ppEnabledLayerNames', 'ppEnabledExtensionNames'],
+            'VkAccelerationStructureBuildGeometryInfoKHR' : ['ppGeometries'],
+        }
     #
     # Called once at the beginning of each run
     def beginFile(self, genOpts):
@@ -213,6 +240,8 @@ class ToolHelperFileOutputGenerator(OutputGenerator):
             self.object_types.append(name)
         elif (category == 'struct' or category == 'union'):
             self.structNames.append(name)
+            if category == 'union':
+                self.unionNames.append(name)
             self.genStruct(typeinfo, name, alias)
     #
     # Check if the parameter passed in is a pointer
@@ -290,6 +319,8 @@ class ToolHelperFileOutputGenerator(OutputGenerator):
     # Generate local ready-access data describing Vulkan structures and unions from the XML metadata
     def genStruct(self, typeinfo, typeName, alias):
         OutputGenerator.genStruct(self, typeinfo, typeName, alias)
+        if alias:
+            self.structAliases[typeName] = alias
         members = typeinfo.elem.findall('.//member')
         # Iterate over members once to get length parameters for arrays
         lens = set()
@@ -331,6 +362,7 @@ class ToolHelperFileOutputGenerator(OutputGenerator):
     # struct_size_header: build function prototypes for header file
     def GenerateStructSizeHeader(self):
         outstring = ''
+        outstring += 'const struct_info* get_struct_info(VkStructureType sType);\n'
         outstring += 'size_t get_struct_chain_size(const void* struct_ptr);\n'
         outstring += 'size_t get_struct_size(const void* struct_ptr);\n'
         for item in self.structMembers:
@@ -356,10 +388,199 @@ class ToolHelperFileOutputGenerator(OutputGenerator):
         struct_size_helper_header += '#include <stdlib.h>\n'
         struct_size_helper_header += '#include <vulkan/vulkan.h>\n'
         struct_size_helper_header += '\n'
+        struct_size_helper_header += self.GenerateStructInfoHeader()
         struct_size_helper_header += '// Function Prototypes\n'
         struct_size_helper_header += self.GenerateStructSizeHeader()
         return struct_size_helper_header
     #
+    # struct_info types, which describe the data a struct points to for copying structs into trace packets
+    def GenerateStructInfoHeader(self):
+        outstring  = '// Kinds of the struct members that a struct_member_info describes\n'
+        outstring += 'typedef enum struct_member_kind {\n'
+        outstring += '    STRUCT_MEMBER_ARRAY = 0,   // pointer to an array, with its element count in another member\n'
+        outstring += '    STRUCT_MEMBER_SINGLE = 1,  // pointer to a single element\n'
+        outstring += '    STRUCT_MEMBER_STRING = 2,  // pointer to a null-terminated string\n'
+        outstring += '    STRUCT_MEMBER_INLINE = 3,  // struct embedded in its parent, which points to data itself\n'
+        outstring += '} struct_member_kind;\n'
+        outstring += '\n'
+        outstring += 'struct struct_info;\n'
+        outstring += '\n'
+        outstring += '// Describes a member of a struct that points to data which has to be copied along with the struct\n'
+        outstring += 'typedef struct struct_member_info {\n'
+        outstring += '    uint16_t kind;                          // struct_member_kind\n'
+        outstring += '    uint16_t offset;                        // offset of the member in its struct\n'
+        outstring += '    uint16_t count_offset;                  // offset of the element count of STRUCT_MEMBER_ARRAY members\n'
+        outstring += '    uint8_t count_size;                     // size of the element count\n'
+        outstring += '    uint8_t count_divisor;                  // the element count is the count member divided by count_divisor\n'
+        outstring += '    uint32_t element_size;                  // size of the elements pointed to\n'
+        outstring += '    const struct struct_info* pElementInfo;  // describes the elements if they point to data too, or else NULL\n'
+        outstring += '} struct_member_info;\n'
+        outstring += '\n'
+        outstring += '// Describes a member of a struct that holds or points to handles, for tools that look for handles in structs\n'
+        outstring += 'typedef struct struct_handle_info {\n'
+        outstring += '    uint16_t kind;          // STRUCT_MEMBER_INLINE for handles in the struct, or else STRUCT_MEMBER_SINGLE or _ARRAY\n'
+        outstring += '    uint16_t offset;        // offset of the member in its struct\n'
+        outstring += '    uint16_t count_offset;  // offset of the element count of STRUCT_MEMBER_ARRAY members\n'
+        outstring += '    uint8_t count_size;     // size of the element count\n'
+        outstring += '    uint8_t handle_size;    // size of a handle, which is a pointer for dispatchable handles\n'
+        outstring += '    uint32_t inline_count;  // number of handles of STRUCT_MEMBER_INLINE members, which may be fixed size arrays\n'
+        outstring += '    const char* type_name;  // name of the handle type\n'
+        outstring += '} struct_handle_info;\n'
+        outstring += '\n'
+        outstring += '// Describes a struct and the members of it that point to data or hold handles\n'
+        outstring += 'typedef struct struct_info {\n'
+        outstring += '    uint32_t size;\n'
+        outstring += '    uint16_t has_pnext;\n'
+        outstring += '    uint16_t member_count;\n'
+        outstring += '    const struct_member_info* pMembers;\n'
+        outstring += '    uint32_t handle_count;\n'
+        outstring += '    const struct_handle_info* pHandles;\n'
+        outstring += '} struct_info;\n'
+        outstring += '\n'
+        return outstring
+    #
+    # Build the struct_info of every struct with an sType, and of the structs they point to, and get_struct_info()
+    def GenerateStructInfoSource(self):
+        struct_items = dict((item.name, item) for item in self.structMembers)
+        handle_types = set(self.object_types)
+        struct_info_names = dict()
+        visiting = set()
+        outstring = '\n\n#define MEMBER_SIZE(_type, _member) sizeof(((_type*)0)->_member)\n'
+        # Returns the name of the struct_info of a struct member type, or None if elements of the type point to nothing
+        def ElementInfo(type_name, ifdef_protect):
+            type_name = self.structAliases.get(type_name, type_name)
+            if type_name not in struct_items or type_name in self.unionNames:
+                return None
+            element = struct_items[type_name]
+            if element.ifdef_protect is not None and element.ifdef_protect != ifdef_protect:
+                return None
+            return StructInfo(element)
+        # Returns True if a type comes from a platform header, such as a window system type
+        def IsPlatformType(type_name):
+            type_elem = self.registry.tree.find("types/type/[@name='%s']" % type_name)
+            return type_elem is not None and type_elem.get('requires') not in (None, 'vk_platform')
+        # Warns about a struct member that isn't in undescribed_struct_members and can't be described
+        def WarnUndescribed(item, member, reason):
+            self.logMsg('warn', 'struct_info of %s leaves %s as it is: %s' % (item.name, member.name, reason))
+        # Emits the struct_info of a struct before the struct_infos that point to it, and returns its name
+        def StructInfo(item):
+            nonlocal outstring
+            if item.name in struct_info_names:
+                return struct_info_names[item.name]
+            if item.name in visiting:
+                return None
+            visiting.add(item.name)
+            member_names = [member.name for member in item.members]
+            has_pnext = False
+            members = []
+            handles = []
+            undescribed_members = self.undescribed_struct_members.get(item.name, [])
+            for member in item.members:
+                element_info = None
+                if member.name == 'pNext':
+                    has_pnext = True
+                    continue
+                if member.name in undescribed_members:
+                    continue
+                if not member.ispointer:
+                    if member.type in handle_types:
+                        handles.append(('STRUCT_MEMBER_INLINE', member, None))
+                        continue
+                    if not member.isstaticarray:
+                        element_info = ElementInfo(member.type, item.ifdef_protect)
+                    if element_info is not None:
+                        members.append(('STRUCT_MEMBER_INLINE', member, None, 1, 'sizeof(%s)' % member.type, element_info))
+                    continue
+                if member.cdecl.count('*') > 1:
+                    WarnUndescribed(item, member, 'arrays of pointers are not supported')
+                    continue
+                if IsPlatformType(member.type):
+                    WarnUndescribed(item, member, 'the size of %s is not known' % member.type)
+                    continue
+                if member.type == 'char':
+                    if member.len is None:
+                        members.append(('STRUCT_MEMBER_STRING', member, None, 1, '1', None))
+                    else:
+                        WarnUndescribed(item, member, 'arrays of strings are not supported')
+                    continue
+                if member.type == 'void':
+                    if member.len is None:
+                        WarnUndescribed(item, member, 'the size of the data is not known')
+                        continue
+                    element_size = '1'
+                else:
+                    element_size = 'sizeof(%s)' % member.type
+                    element_info = ElementInfo(member.type, item.ifdef_protect)
+                if member.len is None:
+                    members.append(('STRUCT_MEMBER_SINGLE', member, None, 1, element_size, element_info))
+                    if member.type in handle_types:
+                        handles.append(('STRUCT_MEMBER_SINGLE', member, None))
+                    continue
+                if (member.len[0].isdigit() or member.len[0].isupper()) and element_info is None:
+                    # Length that is a number or a constant, such as 2*VK_UUID_SIZE, is copied as a single element
+                    members.append(('STRUCT_MEMBER_SINGLE', member, None, 1, '(%s) * %s' % (member.len, element_size), None))
+                    continue
+                # Element counts are other members of the struct, possibly divided by a constant
+                match = re.match(r'^(\w+)(?:/(\d+))?(?: \+ 1)?$', member.len)
+                if not match or match.group(1) not in member_names:
+                    WarnUndescribed(item, member, 'len "%s" is not a member of the struct' % member.len)
+                    continue
+                divisor = int(match.group(2)) if match.group(2) else 1
+                members.append(('STRUCT_MEMBER_ARRAY', member, match.group(1), divisor, element_size, element_info))
+                if member.type in handle_types and divisor == 1:
+                    handles.append(('STRUCT_MEMBER_ARRAY', member, match.group(1)))
+            visiting.remove(item.name)
+            if not members and not handles and not has_pnext and item.name not in self.structTypes:
+                struct_info_names[item.name] = None
+                return None
+            info_name = 'vk_info_%s' % item.name.lower()
+            members_name = 'vk_members_%s' % item.name.lower()
+            handles_name = 'vk_handles_%s' % item.name.lower()
+            if item.ifdef_protect is not None:
+                outstring += '#ifdef %s\n' % item.ifdef_protect
+            if members:
+                outstring += 'static const struct_member_info %s[] = {\n' % members_name
+                for kind, member, count, divisor, element_size, element_info in members:
+                    count_offset = 'offsetof(%s, %s)' % (item.name, count) if count else '0'
+                    count_size = 'MEMBER_SIZE(%s, %s)' % (item.name, count) if count else '0'
+                    outstring += '    {%s, offsetof(%s, %s), %s, %s, %d, %s, %s},\n' % (
+                        kind, item.name, member.name, count_offset, count_size, divisor, element_size,
+                        '&%s' % element_info if element_info else 'NULL')
+                outstring += '};\n'
+            if handles:
+                outstring += 'static const struct_handle_info %s[] = {\n' % handles_name
+                for kind, member, count in handles:
+                    count_offset = 'offsetof(%s, %s)' % (item.name, count) if count else '0'
+                    count_size = 'MEMBER_SIZE(%s, %s)' % (item.name, count) if count else '0'
+                    inline_count = 'MEMBER_SIZE(%s, %s) / sizeof(%s)' % (item.name, member.name, member.type) if kind == 'STRUCT_MEMBER_INLINE' else '0'
+                    outstring += '    {%s, offsetof(%s, %s), %s, %s, sizeof(%s), %s, "%s"},\n' % (
+                        kind, item.name, member.name, count_offset, count_size, member.type, inline_count, member.type)
+                outstring += '};\n'
+            outstring += 'static const struct_info %s = {sizeof(%s), %d, %d, %s, %d, %s};\n' % (
+                info_name, item.name, has_pnext, len(members), members_name if members else 'NULL', len(handles),
+                handles_name if handles else 'NULL')
+            if item.ifdef_protect is not None:
+                outstring += '#endif // %s\n' % item.ifdef_protect
+            struct_info_names[item.name] = info_name
+            return info_name
+        lookup  = '\nconst struct_info* get_struct_info(VkStructureType sType) {\n'
+        lookup += '    switch (sType) {\n'
+        for item in self.structMembers:
+            if item.name not in self.structTypes:
+                continue
+            info_name = StructInfo(item)
+            if item.ifdef_protect is not None:
+                lookup += '#ifdef %s\n' % item.ifdef_protect
+            lookup += '    case %s:\n' % self.structTypes[item.name].value
+            lookup += '        return &%s;\n' % info_name
+            if item.ifdef_protect is not None:
+                lookup += '#endif // %s\n' % item.ifdef_protect
+        lookup += '    default:\n'
+        lookup += '        return NULL;\n'
+        lookup += '    }\n'
+        lookup += '}\n'
+        return outstring + lookup
+    #
     # Helper function for declaring a counter variable only once
     def DeclareCounter(self, string_var, declare_flag):
         if declare_flag == False:
@@ -482,12 +703,14 @@ class ToolHelperFileOutputGenerator(OutputGenerator):
     def GenerateStructSizeHelperSource(self):
         struct_size_helper_source = '\n'
         struct_size_helper_source += '#include "vk_struct_size_helper.h"\n'
+        struct_size_helper_source += '#include <stddef.h>\n'
         struct_size_helper_source += '#include <string.h>\n'
         struct_size_helper_source += '#include <assert.h>\n'
         struct_size_helper_source += '\n'
         struct_size_helper_source += '#define ROUNDUP_TO_4(_len) ((((_len) + 3) >> 2) << 2)\n\n'
         struct_size_helper_source += '// Function Definitions\n'
         struct_size_helper_source += self.GenerateStructSizeSource()
+        struct_size_helper_source += self.GenerateStructInfoSource()
         return struct_size_helper_source
 
     #
@@ -515,6 +515,7 @@ class VkTraceFileOutputGenerator(OutputGenerator):
         replay_objmapper_header += '    }\n'
 
         remapped_objects = ['VkImage', 'VkBuffer', 'VkDeviceMemory']
+        bulk_remap_objects = ['VkSampler', 'VkImageView', 'VkBufferView', 'VkBuffer']
         for item in self.object_types:
             map_name = item[2:].lower() + 's'
             mangled_name = 'm_' + map_name
@@ -533,6 +534,7 @@ class VkTraceFileOutputGenerator(OutputGenerator):
 
             replay_objmapper_header += '    %s remap_%s(const %s& value) {\n' % (item, map_name, item)
             replay_objmapper_header += '        if (value == 0) { return 0; }\n'
+            replay_objmapper_header += '        remapTimer timer(m_pRemapStats);\n'
             if item in remapped_objects:
                 replay_objmapper_header += '        std::unordered_map<%s, %s>::const_iterator q = %s.find(value);\n' % (item, obj_name, mangled_name)
                 if item == 'VkDeviceMemory':
@@ -545,6 +547,32 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                 replay_objmapper_header += '        if (q == %s.end()) { vktrace_LogError("Failed to remap %s."); return VK_NULL_HANDLE; }\n' % (mangled_name, item)
                 replay_objmapper_header += '        return q->second;\n'
             replay_objmapper_header += '    }\n\n'
+            if item in bulk_remap_objects:
+                # Remaps the handles of an array of descriptor infos in place, looking up runs of the same handle once
+                replay_objmapper_header += '    bool remap_%s(%s* pValues, uint32_t count, size_t stride) {\n' % (map_name, item)
+                replay_objmapper_header += '        remapTimer timer(m_pRemapStats);\n'
+                replay_objmapper_header += '        bool result = true;\n'
+                replay_objmapper_header += '        %s traceValue = VK_NULL_HANDLE;\n' % item
+                replay_objmapper_header += '        %s replayValue = VK_NULL_HANDLE;\n' % item
+                replay_objmapper_header += '        for (uint32_t i = 0; i < count; i++) {\n'
+                replay_objmapper_header += '            %s* pValue = reinterpret_cast<%s*>(reinterpret_cast<char*>(pValues) + i * stride);\n' % (item, item)
+                replay_objmapper_header += '            if (*pValue == VK_NULL_HANDLE) continue;\n'
+                replay_objmapper_header += '            if (*pValue != traceValue) {\n'
+                replay_objmapper_header += '                traceValue = *pValue;\n'
+                replay_objmapper_header += '                std::unordered_map<%s, %s>::const_iterator q = %s.find(traceValue);\n' % (item, obj_name, mangled_name)
+                if item in remapped_objects:
+                    replay_objmapper_header += '                replayValue = (q != %s.end()) ? q->second.replay%s : VK_NULL_HANDLE;\n' % (mangled_name, item[2:])
+                else:
+                    replay_objmapper_header += '                replayValue = (q != %s.end()) ? q->second : VK_NULL_HANDLE;\n' % mangled_name
+                replay_objmapper_header += '                if (replayValue == VK_NULL_HANDLE) {\n'
+                replay_objmapper_header += '                    vktrace_LogError("Failed to remap %s.");\n' % item
+                replay_objmapper_header += '                    result = false;\n'
+                replay_objmapper_header += '                }\n'
+                replay_objmapper_header += '            }\n'
+                replay_objmapper_header += '            *pValue = replayValue;\n'
+                replay_objmapper_header += '        }\n'
+                replay_objmapper_header += '        return result;\n'
+                replay_objmapper_header += '    }\n\n'
         for item in additional_remap_fifo:
             replay_objmapper_header += '    std::list<%s> m_%s;\n' % (additional_remap_fifo[item], item)
             replay_objmapper_header += '    void add_to_%s_map(%s traceVal, %s replayVal) {\n' % (item, additional_remap_fifo[item], additional_remap_fifo[item])
@@ -718,9 +746,45 @@ class VkTraceFileOutputGenerator(OutputGenerator):
         replay_gen_source += '        return false;\n'
         replay_gen_source += '    }\n'
         replay_gen_source += '}\n\n'
+        # Packets that deferred waits can be moved past
+        replay_gen_source += 'bool vkReplay::isWaitRelaxable(vktrace_trace_packet_header *packet) const {\n'
+        replay_gen_source += '    switch (packet->packet_id) {\n'
+        replay_gen_source += '        case VKTRACE_TPI_VK_vkApiVersion:\n'
+        replay_gen_source += '        case VKTRACE_TPI_VK_vkWaitForFences:\n'
+        replay_gen_source += '        case VKTRACE_TPI_VK_vkQueueWaitIdle:\n'
+        replay_gen_source += '        case VKTRACE_TPI_VK_vkDeviceWaitIdle:\n'
+        replay_gen_source += '        // these make the deferred waits themselves when they need them\n'
+        replay_gen_source += '        case VKTRACE_TPI_VK_vkQueueSubmit:\n'
+        replay_gen_source += '        case VKTRACE_TPI_VK_vkResetFences:\n'
+        replay_gen_source += '        case VKTRACE_TPI_VK_vkBeginCommandBuffer:\n'
+        replay_gen_source += '        case VKTRACE_TPI_VK_vkEndCommandBuffer:\n'
+        replay_gen_source += '        case VKTRACE_TPI_VK_vkAcquireNextImageKHR:\n'
+        replay_gen_source += '        case VKTRACE_TPI_VK_vkQueuePresentKHR:\n'
+        replay_gen_source += '        // recording into a command buffer that isn\'t pending, and new objects, don\'t touch the work in flight\n'
+        for api in self.cmdMembers:
+            if not isSupportedCmd(api, cmd_extension_dict):
+                continue
+            if api.name.startswith('vkCmd') or api.name.startswith('vkCreate') or api.name.startswith('vkAllocate'):
+                replay_gen_source += '        case VKTRACE_TPI_VK_%s:\n' % api.name
+        replay_gen_source += '            return true;\n'
+        replay_gen_source += '        default:\n'
+        replay_gen_source += '            return false;\n'
+        replay_gen_source += '    }\n'
+        replay_gen_source += '}\n\n'
         replay_gen_source += 'vktrace_replay::VKTRACE_REPLAY_RESULT vkReplay::replay(vktrace_trace_packet_header *packet) { \n'
         replay_gen_source += '    vktrace_replay::VKTRACE_REPLAY_RESULT returnValue = vktrace_replay::VKTRACE_REPLAY_SUCCESS;\n'
         replay_gen_source += '    VkResult replayResult = VK_SUCCESS;\n'
+        replay_gen_source += '    // Deferred waits are made before the next packet that could depend on them\n'
+        replay_gen_source += '    if (m_waitRelaxer.isPending() && !isWaitRelaxable(packet)) {\n'
+        replay_gen_source += '        resolveRelaxedWaits();\n'
+        replay_gen_source += '    }\n'
+        replay_gen_source += '    // Submits and descriptor updates that are held back are made before the next packet of another command\n'
+        replay_gen_source += '    if (m_descriptorBatcher.isPending() && packet->packet_id != VKTRACE_TPI_VK_vkUpdateDescriptorSets) {\n'
+        replay_gen_source += '        m_descriptorBatcher.flush(m_vkDeviceFuncs.UpdateDescriptorSets);\n'
+        replay_gen_source += '    }\n'
+        replay_gen_source += '    if (m_submitCoalescer.isPending() && packet->packet_id != VKTRACE_TPI_VK_vkQueueSubmit) {\n'
+        replay_gen_source += '        flushCoalescedQueueSubmits();\n'
+        replay_gen_source += '    }\n'
         replay_gen_source += '    switch (packet->packet_id) {\n'
         replay_gen_source += '        case VKTRACE_TPI_VK_vkApiVersion:\n'
         replay_gen_source += '            // Ignore api version packets\n'
@@ -818,6 +882,10 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                     replay_gen_source += '                    return vktrace_replay::VKTRACE_REPLAY_ERROR;\n'
                     replay_gen_source += '                }\n'
                     replay_gen_source += '            }\n'
+                    replay_gen_source += '            // a fence can only be reset once the work that signals it has completed\n'
+                    replay_gen_source += '            if (m_waitRelaxer.isResetBlocked(pPacket->fenceCount, fences)) {\n'
+                    replay_gen_source += '                resolveRelaxedWaits();\n'
+                    replay_gen_source += '            }\n'
                 elif cmdname in do_while_dict:
                     replay_gen_source += '            do {\n'
                 last_name = ''
@@ -879,6 +947,28 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                     replay_gen_source += '            VkPhysicalDeviceMemoryProperties memProperties = *(pPacket->pMemoryProperties);\n'
                 elif cmdname == 'GetImageMemoryRequirements':
                     replay_gen_source += '            VkMemoryRequirements memReqs = *(pPacket->pMemoryRequirements);\n'
+                elif cmdname == 'DestroyDevice':
+                    replay_gen_source += '            m_subAllocator.destroyDevice(remappeddevice);\n'
+                elif cmdname == 'QueueWaitIdle':
+                    replay_gen_source += '            if (m_waitRelaxer.deferQueueWaitIdle(remappedqueue)) {\n'
+                    replay_gen_source += '                break;\n'
+                    replay_gen_source += '            }\n'
+                elif cmdname == 'DeviceWaitIdle':
+                    replay_gen_source += '            if (m_waitRelaxer.deferDeviceWaitIdle(remappeddevice)) {\n'
+                    replay_gen_source += '                break;\n'
+                    replay_gen_source += '            }\n'
+                elif cmdname == 'CmdBindPipeline':
+                    replay_gen_source += '            if (m_stateFilter.skipBindPipeline(remappedcommandBuffer, pPacket->pipelineBindPoint, remappedpipeline)) {\n'
+                    replay_gen_source += '                break;\n'
+                    replay_gen_source += '            }\n'
+                elif cmdname == 'CmdSetViewport':
+                    replay_gen_source += '            if (m_stateFilter.skipSetViewport(remappedcommandBuffer, pPacket->firstViewport, pPacket->viewportCount, pPacket->pViewports)) {\n'
+                    replay_gen_source += '                break;\n'
+                    replay_gen_source += '            }\n'
+                elif cmdname == 'CmdSetScissor':
+                    replay_gen_source += '            if (m_stateFilter.skipSetScissor(remappedcommandBuffer, pPacket->firstScissor, pPacket->scissorCount, pPacket->pScissors)) {\n'
+                    replay_gen_source += '                break;\n'
+                    replay_gen_source += '            }\n'
                 elif cmdname == 'DebugReportMessageEXT':
                     replay_gen_source += '            if (!g_fpDbgMsgCallback || !m_vkFuncs.DebugReportMessageEXT) {\n'
                     replay_gen_source += '                // just eat this call as we don\'t have local call back function defined\n'
@@ -951,7 +1041,9 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                 if 'Destroy' in cmdname:
                     clean_type = params[-2].type.strip('*').replace('const ', '')
                     replay_gen_source += '            m_objMapper.rm_from_%ss_map(pPacket->%s);\n' % (clean_type.lower()[2:], params[-2].name)
-                if 'DestroyDevice' in cmdname:
+                if cmdname in ['DestroyImageView', 'DestroyBufferView', 'DestroySampler']:
+                    replay_gen_source += '            m_descriptorBatcher.forgetHandle((uint64_t)remapped%s);\n' % params[-2].name
+                elif 'DestroyDevice' in cmdname:
                     replay_gen_source += '            m_pCBDump = NULL;\n'
                     replay_gen_source += '            m_pDSDump = NULL;\n'
                     #TODO138 : disabling snapshot
@@ -968,8 +1060,15 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                 elif 'MergePipelineCaches' in cmdname:
                     replay_gen_source += '            delete[] remappedpSrcCaches;\n'
                 elif 'FreeCommandBuffers' in cmdname:
+                    replay_gen_source += '            for (uint32_t i = 0; i < pPacket->commandBufferCount; i++) {\n'
+                    replay_gen_source += '                m_stateFilter.forgetCommandBuffer(remappedpCommandBuffers[i]);\n'
+                    replay_gen_source += '                m_waitRelaxer.forgetCommandBuffer(remappedpCommandBuffers[i]);\n'
+                    replay_gen_source += '            }\n'
                     replay_gen_source += '            delete[] remappedpCommandBuffers;\n'
                 elif 'CmdExecuteCommands' in cmdname:
+                    replay_gen_source += '            // the state bound by the secondary command buffers is unknown\n'
+                    replay_gen_source += '            m_stateFilter.forgetCommandBuffer(remappedcommandBuffer);\n'
+                    replay_gen_source += '            m_waitRelaxer.addExecutedCommandBuffers(remappedcommandBuffer, pPacket->commandBufferCount, remappedpCommandBuffers);\n'
                     replay_gen_source += '            delete[] remappedpCommandBuffers;\n'
                 elif 'AllocateDescriptorSets' in cmdname:
                     replay_gen_source += '            if (replayResult == VK_SUCCESS) {\n'
@@ -1165,6 +1264,7 @@ class VkTraceFileOutputGenerator(OutputGenerator):
         trace_pkt_id_hdr += '#include "vktrace_interconnect.h"\n'
         trace_pkt_id_hdr += '#include <inttypes.h>\n'
         trace_pkt_id_hdr += '#include "vk_enum_string_helper.h"\n'
+        trace_pkt_id_hdr += '#include "vk_struct_size_helper.h"\n'
         trace_pkt_id_hdr += '#ifndef _WIN32\n'
         trace_pkt_id_hdr += '#pragma GCC diagnostic ignored "-Wwrite-strings"\n'
         trace_pkt_id_hdr += '#endif\n'
@@ -1183,9 +1283,17 @@ class VkTraceFileOutputGenerator(OutputGenerator):
         trace_pkt_id_hdr += '#define SEND_ENTRYPOINT_PARAMS(entrypoint, ...) ;\n'
         trace_pkt_id_hdr += '#define CREATE_TRACE_PACKET(entrypoint, buffer_bytes_needed) \\\n'
         trace_pkt_id_hdr += '    pHeader = vktrace_create_trace_packet(VKTRACE_TID_VULKAN, VKTRACE_TPI_VK_##entrypoint, sizeof(packet_##entrypoint), buffer_bytes_needed);\n\n'
+        trace_pkt_id_hdr += '// Creates the packet in the packet arena, so that the size of its buffers is only computed if the arena can\'t be used\n'
+        trace_pkt_id_hdr += '#define CREATE_ARENA_TRACE_PACKET(entrypoint, buffer_bytes_needed) \\\n'
+        trace_pkt_id_hdr += '    pHeader = g_trimEnabled ? NULL : vktrace_create_arena_trace_packet(VKTRACE_TID_VULKAN, VKTRACE_TPI_VK_##entrypoint, sizeof(packet_##entrypoint)); \\\n'
+        trace_pkt_id_hdr += '    if (pHeader == NULL) { \\\n'
+        trace_pkt_id_hdr += '        CREATE_TRACE_PACKET(entrypoint, buffer_bytes_needed) \\\n'
+        trace_pkt_id_hdr += '    }\n\n'
+        trace_pkt_id_hdr += '// Packets that aren\'t batched are written after the pending command batch\n'
         trace_pkt_id_hdr += '#define FINISH_TRACE_PACKET() \\\n'
         trace_pkt_id_hdr += '    vktrace_finalize_trace_packet(pHeader); \\\n'
-        trace_pkt_id_hdr += '    vktrace_write_trace_packet(pHeader, vktrace_trace_get_trace_file()); \\\n'
+        trace_pkt_id_hdr += '    vktrace_cmdbatch_flush(); \\\n'
+        trace_pkt_id_hdr += '    vktrace_stats_write_trace_packet(pHeader, vktrace_trace_get_trace_file()); \\\n'
         trace_pkt_id_hdr += '    vktrace_delete_trace_packet(&pHeader);\n'
         trace_pkt_id_hdr += '\n'
         trace_pkt_id_hdr += '// Include trace packet identifier definitions\n'
@@ -1204,6 +1312,9 @@ class VkTraceFileOutputGenerator(OutputGenerator):
             trace_pkt_id_hdr += '        case VKTRACE_TPI_VK_%s: {\n' % api.name
             trace_pkt_id_hdr += '            return "%s";\n' % api.name
             trace_pkt_id_hdr += '        };\n'
+        trace_pkt_id_hdr += '        case VKTRACE_TPI_VK_CommandBatch: {\n'
+        trace_pkt_id_hdr += '            return "CommandBatch";\n'
+        trace_pkt_id_hdr += '        }\n'
         trace_pkt_id_hdr += '        default:\n'
         trace_pkt_id_hdr += '            return NULL;\n'
         trace_pkt_id_hdr += '    }\n'
@@ -1212,7 +1323,7 @@ class VkTraceFileOutputGenerator(OutputGenerator):
         #
         # Construct packet id stringify helper function
         trace_pkt_id_hdr += 'static const char *vktrace_stringify_vk_packet_id(const VKTRACE_TRACE_PACKET_ID_VK id, const vktrace_trace_packet_header* pHeader) {\n'
-        trace_pkt_id_hdr += '    static char str[1024];\n'
+        trace_pkt_id_hdr += '    static VKTRACE_THREAD_LOCAL char str[1024];\n'
         trace_pkt_id_hdr += '    switch(id) {\n'
         trace_pkt_id_hdr += '        case VKTRACE_TPI_VK_vkApiVersion: {\n'
         trace_pkt_id_hdr += '            packet_vkApiVersion* pPacket = (packet_vkApiVersion*)(pHeader->pBody);\n'
@@ -1251,6 +1362,11 @@ class VkTraceFileOutputGenerator(OutputGenerator):
             trace_pkt_id_hdr += '            snprintf(str, 1024, "%s"%s);\n' % (func_str, print_vals)
             trace_pkt_id_hdr += '            return str;\n'
             trace_pkt_id_hdr += '        }\n'
+        trace_pkt_id_hdr += '    case VKTRACE_TPI_VK_CommandBatch: {\n'
+        trace_pkt_id_hdr += '            vktrace_trace_packet_command_batch* pPacket = (vktrace_trace_packet_command_batch*)(pHeader->pBody);\n'
+        trace_pkt_id_hdr += '            snprintf(str, 1024, "CommandBatch(call_count = %u)", pPacket->call_count);\n'
+        trace_pkt_id_hdr += '            return str;\n'
+        trace_pkt_id_hdr += '        }\n'
         trace_pkt_id_hdr += '        default:\n'
         trace_pkt_id_hdr += '            return NULL;\n'
         trace_pkt_id_hdr += '    }\n'
@@ -1258,8 +1374,87 @@ class VkTraceFileOutputGenerator(OutputGenerator):
         trace_pkt_id_hdr += '\n'
         # Include interpret_trace_packet_vk function
         trace_pkt_id_hdr += self.GenerateInterpFunc()
+        trace_pkt_id_hdr += self.GeneratePacketParamInfoFunc()
         return trace_pkt_id_hdr
     #
+    # Creates vktrace_vk_packet_param_infos(), which describes the parameters of each packet that hold or point to handles, or
+    # point to structs with an sType, so that tools can find the handles of a packet
+    def GeneratePacketParamInfoFunc(self):
+        struct_member_dict = dict((item.name, item.members) for item in self.structMembers)
+        def HasSType(type_name):
+            members = struct_member_dict.get(type_name)
+            return members is not None and len(members) > 0 and members[0].name == 'sType'
+        info_func  = '\n'
+        info_func += '// Describes a parameter of a packet that holds or points to handles, or points to structs with an sType\n'
+        info_func += 'typedef struct vktrace_vk_packet_param_info {\n'
+        info_func += '    uint16_t kind;                 // STRUCT_MEMBER_INLINE for handles passed by value, or else STRUCT_MEMBER_SINGLE or _ARRAY\n'
+        info_func += '    uint16_t offset;               // offset of the parameter in the packet\n'
+        info_func += '    uint16_t count_offset;         // offset of the parameter that holds the uint32_t count of STRUCT_MEMBER_ARRAY elements\n'
+        info_func += '    uint16_t count_indirect;       // the count parameter points to the count, which is count_member_offset into what it points to\n'
+        info_func += '    uint32_t count_member_offset;\n'
+        info_func += '    uint32_t element_size;\n'
+        info_func += '    const char* handle_type;       // type of the handles, or NULL for structs with an sType, described by get_struct_info()\n'
+        info_func += '} vktrace_vk_packet_param_info;\n'
+        info_func += '\n'
+        info_func += 'static const vktrace_vk_packet_param_info* vktrace_vk_packet_param_infos(const VKTRACE_TRACE_PACKET_ID_VK id, uint32_t* pCount) {\n'
+        info_func += '    switch (id) {\n'
+        cmd_member_dict = dict(self.cmdMembers)
+        cmd_extension_dict = dict(self.cmd_extension_names)
+        for api in self.cmdMembers:
+            extension = cmd_extension_dict[api.name]
+            if 'VK_VERSION_' not in extension and extension not in approved_ext:
+                continue
+            if api.name[2:] in api_exclusions:
+                continue
+            params = cmd_member_dict[api.name]
+            param_dict = dict((p.name, p) for p in params if p.name != '')
+            packet = 'packet_%s' % api.name
+            entries = []
+            for p in params:
+                if p.name == '':
+                    continue
+                is_handle = p.handle is not None
+                if not p.ispointer:
+                    if is_handle:
+                        entries.append(('STRUCT_MEMBER_INLINE', p, '0', '0', '0', '"%s"' % p.type))
+                    continue
+                if p.cdecl.count('*') > 1 or not (is_handle or HasSType(p.type)):
+                    continue
+                handle_type = '"%s"' % p.type if is_handle else 'NULL'
+                if p.len is None:
+                    entries.append(('STRUCT_MEMBER_SINGLE', p, '0', '0', '0', handle_type))
+                    continue
+                # Element counts are other parameters, the values they point to, or members of the structs they point to
+                match = re.match(r'^(\w+)(?:->(\w+))?$', p.len)
+                count_param = param_dict.get(match.group(1)) if match else None
+                if count_param is None:
+                    continue
+                count_offset = 'offsetof(%s, %s)' % (packet, count_param.name)
+                if match.group(2) is not None:
+                    count_member = next((m for m in struct_member_dict.get(count_param.type, []) if m.name == match.group(2)), None)
+                    if count_member is None or count_member.type != 'uint32_t' or not count_param.ispointer:
+                        continue
+                    entries.append(('STRUCT_MEMBER_ARRAY', p, count_offset, '1', 'offsetof(%s, %s)' % (count_param.type, count_member.name), handle_type))
+                elif count_param.type == 'uint32_t':
+                    entries.append(('STRUCT_MEMBER_ARRAY', p, count_offset, '1' if count_param.ispointer else '0', '0', handle_type))
+            if not entries:
+                continue
+            info_func += '        case VKTRACE_TPI_VK_%s: {\n' % api.name
+            info_func += '            static const vktrace_vk_packet_param_info params[] = {\n'
+            for kind, p, count_offset, count_indirect, count_member_offset, handle_type in entries:
+                info_func += '                {%s, offsetof(%s, %s), %s, %s, %s, sizeof(%s), %s},\n' % (
+                    kind, packet, p.name, count_offset, count_indirect, count_member_offset, p.type, handle_type)
+            info_func += '            };\n'
+            info_func += '            *pCount = sizeof(params) / sizeof(params[0]);\n'
+            info_func += '            return params;\n'
+            info_func += '        }\n'
+        info_func += '        default:\n'
+        info_func += '            *pCount = 0;\n'
+        info_func += '            return NULL;\n'
+        info_func += '    }\n'
+        info_func += '}\n'
+        return info_func
+    #
     # Creates the shared interpret_trace_packet function
     def GenerateInterpFunc(self):
         interp_func_body = ''
@@ -2641,6 +2836,8 @@ class VkTraceFileOutputGenerator(OutputGenerator):
         trace_vk_src += '#include "vktrace_common.h"\n'
         trace_vk_src += '#include "vktrace_lib_helpers.h"\n'
         trace_vk_src += '#include "vktrace_lib_trim.h"\n'
+        trace_vk_src += '#include "vktrace_lib_stats.h"\n'
+        trace_vk_src += '#include "vktrace_lib_cmdbatch.h"\n'
         trace_vk_src += '#include "vktrace_vk_vk.h"\n'
         trace_vk_src += '#include "vktrace_interconnect.h"\n'
         trace_vk_src += '#include "vktrace_filelike.h"\n'
@@ -2684,6 +2881,8 @@ class VkTraceFileOutputGenerator(OutputGenerator):
         trace_vk_src += '    vktrace_trace_set_trace_file(vktrace_FileLike_create_msg(gMessageStream));\n'
         trace_vk_src += '    vktrace_tracelog_set_tracer_id(VKTRACE_TID_VULKAN);\n'
         trace_vk_src += '    trim::initialize();\n'
+        trace_vk_src += '    vktrace_stats_initialize();\n'
+        trace_vk_src += '    vktrace_cmdbatch_initialize();\n'
         trace_vk_src += '    vktrace_initialize_trace_packet_utils();\n'
         trace_vk_src += '    vktrace_create_critical_section(&g_memInfoLock);\n'
         trace_vk_src += '#ifdef WIN32\n'
@@ -2870,12 +3069,14 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                     trace_vk_src += '    for (uint32_t i=0; i<surfaceFormatCount; i++) {\n'
                     trace_vk_src += '        byteCount += get_struct_chain_size(&pSurfaceFormats[i]);\n'
                     trace_vk_src += '    }\n'
-                    trace_vk_src += '    CREATE_TRACE_PACKET(vkGetPhysicalDeviceSurfaceFormats2KHR, get_struct_chain_size((void*)pSurfaceInfo) + sizeof(uint32_t) + byteCount);\n'
+                    trace_vk_src += '    CREATE_ARENA_TRACE_PACKET(vkGetPhysicalDeviceSurfaceFormats2KHR, get_struct_chain_size((void*)pSurfaceInfo) + sizeof(uint32_t) + byteCount);\n'
                 else:
+                    # The packet grows as buffers are added to it, so the structures are only walked for their size when
+                    # the packet arena can't be used
                     if (0 == len(packet_size)):
-                        trace_vk_src += '    CREATE_TRACE_PACKET(%s, 0);\n' % (proto.name)
+                        trace_vk_src += '    CREATE_ARENA_TRACE_PACKET(%s, 0);\n' % (proto.name)
                     else:
-                        trace_vk_src += '    CREATE_TRACE_PACKET(%s, %s);\n' % (proto.name, ' + '.join(packet_size))
+                        trace_vk_src += '    CREATE_ARENA_TRACE_PACKET(%s, %s);\n' % (proto.name, ' + '.join(packet_size))
                 if proto.name == 'vkCreateImage':
                     trace_vk_src += '    VkImageCreateInfo replayCreateInfo = *pCreateInfo;\n'
                     trace_vk_src += '    VkImageCreateInfo trimCreateInfo = *pCreateInfo;\n'
@@ -2930,55 +3131,55 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                     trace_vk_src += '    vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->pSurfaceFormatCount), sizeof(uint32_t), pSurfaceFormatCount);\n'
                     trace_vk_src += '    vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->pSurfaceFormats), surfaceFormatCount*sizeof(VkSurfaceFormat2KHR), pSurfaceFormats);\n'
                     trace_vk_src += '    for (uint32_t i = 0; i < surfaceFormatCount; i++) {\n'
-                    trace_vk_src += '        vktrace_add_pnext_structs_to_trace_packet(pHeader, (void *)(&pPacket->pSurfaceFormats[i]), (void *)(&pSurfaceFormats[i]));\n'
+                    trace_vk_src += '        vktrace_stats_add_pnext_structs_to_trace_packet(pHeader, (void *)(&pPacket->pSurfaceFormats[i]), (void *)(&pSurfaceFormats[i]));\n'
                     trace_vk_src += '    }\n'
                 else:
                     for pp_dict in ptr_packet_update_list: # buff_ptr_indices:
                         trace_vk_src += '    %s;\n' % (pp_dict['add_txt'])
                         if '(pPacket->pCreateInfo)' in pp_dict['add_txt']:
-                            trace_vk_src += '    vktrace_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pCreateInfo, (void *)pCreateInfo);\n'
+                            trace_vk_src += '    vktrace_stats_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pCreateInfo, (void *)pCreateInfo);\n'
                         if '(pPacket->pBeginInfo)' in pp_dict['add_txt']:
-                            trace_vk_src += '    vktrace_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pBeginInfo, (void *)pBeginInfo);\n'
+                            trace_vk_src += '    vktrace_stats_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pBeginInfo, (void *)pBeginInfo);\n'
                         if '(pPacket->pAllocateInfo)' in pp_dict['add_txt']:
-                            trace_vk_src += '    vktrace_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pAllocateInfo, (void *)pAllocateInfo);\n'
+                            trace_vk_src += '    vktrace_stats_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pAllocateInfo, (void *)pAllocateInfo);\n'
                         if '(pPacket->pReserveSpaceInfo)' in pp_dict['add_txt']:
-                            trace_vk_src += '    vktrace_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pReserveSpaceInfo, (void *)pReserveSpaceInfo);\n'
+                            trace_vk_src += '    vktrace_stats_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pReserveSpaceInfo, (void *)pReserveSpaceInfo);\n'
                         if '(pPacket->pLimits)' in pp_dict['add_txt']:
-                            trace_vk_src += '    vktrace_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pLimits, (void *)pLimits);\n'
+                            trace_vk_src += '    vktrace_stats_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pLimits, (void *)pLimits);\n'
                         if ('(pPacket->pFeatures)' in pp_dict['add_txt'] and ('KHR' in pp_dict['add_txt'] or ('NVX' in pp_dict['add_txt']))):
-                            trace_vk_src += '    vktrace_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pFeatures, (void *)pFeatures);\n'
+                            trace_vk_src += '    vktrace_stats_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pFeatures, (void *)pFeatures);\n'
                         if ('(pPacket->pSurfaceInfo)' in pp_dict['add_txt'] and ('2KHR' in pp_dict['add_txt'])):
-                            trace_vk_src += '    vktrace_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pSurfaceInfo, (void *)pSurfaceInfo);\n'
+                            trace_vk_src += '    vktrace_stats_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pSurfaceInfo, (void *)pSurfaceInfo);\n'
                         if ('(pPacket->pInfo)' in pp_dict['add_txt'] and ('2KHR' in pp_dict['add_txt'])):
-                            trace_vk_src += '    vktrace_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pInfo, (void *)pInfo);\n'
+                            trace_vk_src += '    vktrace_stats_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pInfo, (void *)pInfo);\n'
                         elif ('(pPacket->pInfo)' in pp_dict['add_txt'] and ('RequirementsInfo2' in pp_dict['add_txt'])):
-                            trace_vk_src += '    vktrace_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pInfo, (void *)pInfo);\n'
+                            trace_vk_src += '    vktrace_stats_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pInfo, (void *)pInfo);\n'
                         if ('(pPacket->pMemoryRequirements)' in pp_dict['add_txt'] and ('2' in pp_dict['add_txt'])):
-                            trace_vk_src += '    vktrace_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pMemoryRequirements, (void *)pMemoryRequirements);\n'
+                            trace_vk_src += '    vktrace_stats_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pMemoryRequirements, (void *)pMemoryRequirements);\n'
                         if ('(pPacket->pSparseMemoryRequirements)' in pp_dict['add_txt'] and ('2' in pp_dict['add_txt'])):
                             trace_vk_src += '    for (uint32_t i=0; i< *pPacket->pSparseMemoryRequirementCount; i++)\n'
-                            trace_vk_src += '        vktrace_add_pnext_structs_to_trace_packet(pHeader, (void *)(&pPacket->pSparseMemoryRequirements[i]), (void *)(&pSparseMemoryRequirements[i]));\n'
+                            trace_vk_src += '        vktrace_stats_add_pnext_structs_to_trace_packet(pHeader, (void *)(&pPacket->pSparseMemoryRequirements[i]), (void *)(&pSparseMemoryRequirements[i]));\n'
                         if ('(pPacket->pFeatures)' in pp_dict['add_txt'] and ('2' in pp_dict['add_txt'])):
-                            trace_vk_src += '    vktrace_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pFeatures, (void *)pFeatures);\n'
+                            trace_vk_src += '    vktrace_stats_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pFeatures, (void *)pFeatures);\n'
                         if ('(pPacket->pProperties)' in pp_dict['add_txt'] and ('2' in pp_dict['add_txt'])):
-                            trace_vk_src += '    vktrace_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pProperties, (void *)pProperties);\n'
+                            trace_vk_src += '    vktrace_stats_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pProperties, (void *)pProperties);\n'
                         if ('(pPacket->pFormatProperties)' in pp_dict['add_txt'] and ('2' in pp_dict['add_txt'])):
-                            trace_vk_src += '    vktrace_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pFormatProperties, (void *)pFormatProperties);\n'
+                            trace_vk_src += '    vktrace_stats_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pFormatProperties, (void *)pFormatProperties);\n'
                         if ('(pPacket->pImageFormatInfo)' in pp_dict['add_txt'] and ('2' in pp_dict['add_txt'])):
-                            trace_vk_src += '    vktrace_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pImageFormatInfo, (void *)pImageFormatInfo);\n'
+                            trace_vk_src += '    vktrace_stats_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pImageFormatInfo, (void *)pImageFormatInfo);\n'
                         if ('(pPacket->pImageFormatProperties)' in pp_dict['add_txt'] and ('2' in pp_dict['add_txt'])):
-                            trace_vk_src += '    vktrace_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pImageFormatProperties, (void *)pImageFormatProperties);\n'
+                            trace_vk_src += '    vktrace_stats_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pImageFormatProperties, (void *)pImageFormatProperties);\n'
                         if ('(pPacket->pQueueFamilyProperties)' in pp_dict['add_txt'] and ('2' in pp_dict['add_txt'])):
                             trace_vk_src += '    for (uint32_t i=0; i< *pPacket->pQueueFamilyPropertyCount; i++)\n'
-                            trace_vk_src += '        vktrace_add_pnext_structs_to_trace_packet(pHeader, (void *)(&pPacket->pQueueFamilyProperties[i]), (void *)(&pQueueFamilyProperties[i]));\n'
+                            trace_vk_src += '        vktrace_stats_add_pnext_structs_to_trace_packet(pHeader, (void *)(&pPacket->pQueueFamilyProperties[i]), (void *)(&pQueueFamilyProperties[i]));\n'
                         if ('(pPacket->pMemoryProperties)' in pp_dict['add_txt'] and ('2' in pp_dict['add_txt'])):
-                            trace_vk_src += '    vktrace_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pMemoryProperties, (void *)pMemoryProperties);\n'
+                            trace_vk_src += '    vktrace_stats_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pMemoryProperties, (void *)pMemoryProperties);\n'
                         if ('(pPacket->pQueueInfo)' in pp_dict['add_txt'] and ('2' in pp_dict['add_txt'])):
-                            trace_vk_src += '    vktrace_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pQueueInfo, (void *)pQueueInfo);\n'
+                            trace_vk_src += '    vktrace_stats_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pQueueInfo, (void *)pQueueInfo);\n'
                         if (proto.name == 'vkGetPhysicalDeviceSparseImageFormatProperties2' and '(pPacket->pFormatInfo)' in pp_dict['add_txt']):
-                            trace_vk_src += '    vktrace_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pFormatInfo, (void *)pFormatInfo);\n'
+                            trace_vk_src += '    vktrace_stats_add_pnext_structs_to_trace_packet(pHeader, (void *)pPacket->pFormatInfo, (void *)pFormatInfo);\n'
                             trace_vk_src += '    for (uint32_t i=0; i< *pPacket->pPropertyCount; i++)\n'
-                            trace_vk_src += '        vktrace_add_pnext_structs_to_trace_packet(pHeader, (void *)(&pPacket->pProperties[i]), (void *)(&pProperties[i]));\n'
+                            trace_vk_src += '        vktrace_stats_add_pnext_structs_to_trace_packet(pHeader, (void *)(&pPacket->pProperties[i]), (void *)(&pProperties[i]));\n'
 
                 if 'void' not in resulttype or '*' in resulttype:
                     trace_vk_src += '    pPacket->result = result;\n'
@@ -2986,8 +3187,13 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                     if ('DeviceCreateInfo' not in proto.members[pp_dict['index']].type):
                         trace_vk_src += '    %s;\n' % (pp_dict['finalize_txt'])
                 trace_vk_src += '    if (!g_trimEnabled) {\n'
-                # All buffers should be finalized by now, and the trace packet can be finished (which sends it over the socket)
-                trace_vk_src += '        FINISH_TRACE_PACKET();\n'
+                # All buffers should be finalized by now, and the trace packet can be finished (which sends it over the socket).
+                # Packets of vkCmd* calls go to the pending command batch, which is written ahead of the next packet that isn't
+                # batched.
+                if proto.name.startswith('vkCmd') and proto.members[0].type == 'VkCommandBuffer':
+                    trace_vk_src += '        vktrace_cmdbatch_finish_packet(&pHeader);\n'
+                else:
+                    trace_vk_src += '        FINISH_TRACE_PACKET();\n'
 
                 # Else half of g_trimEnabled conditional
                 # Since packet wasn't sent to trace file, it either needs to be associated with an object, or deleted.
@@ -3020,8 +3226,10 @@ class VkTraceFileOutputGenerator(OutputGenerator):
 
                 # Clean up instance or device data if needed
                 if proto.name == "vkDestroyInstance":
+                    trace_vk_src += '    g_instanceDataCache.erase(key);\n'
                     trace_vk_src += '    g_instanceDataMap.erase(key);\n'
                 elif proto.name == "vkDestroyDevice":
+                    trace_vk_src += '    g_deviceDataCache.erase(key);\n'
                     trace_vk_src += '    g_deviceDataMap.erase(key);\n'
 
                 # Return result if needed
@@ -0,0 +1,713 @@
+/*
+ * Copyright (C) 2019 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Microbenchmarks for the primitives the trace layer runs on every captured call. None of them need a GPU or a Vulkan
+// driver; each benchmark runs single threaded and then on several threads at once, and the results can be written as
+// JSON to track regressions between builds.
+
+#include <inttypes.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+extern "C" {
+#include "vktrace_common.h"
+#include "vktrace_filelike.h"
+#include "vktrace_interconnect.h"
+#include "vktrace_settings.h"
+#include "vktrace_trace_packet_utils.h"
+}
+#include "vktrace_pageguard_memorycopy.h"
+#include "vktrace_lib_dispatchcache.h"
+#include "vktrace_lib_pagestatusarray.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+// settings
+//----------------------------------------------------------------------------------------------------------------------
+typedef struct vktrace_benchmark_settings {
+    char* filter;
+    char* output_json;
+    unsigned int threads;
+    unsigned int min_time_ms;
+    unsigned int port;
+} vktrace_benchmark_settings;
+
+vktrace_benchmark_settings g_settings;
+vktrace_benchmark_settings g_default_settings;
+
+vktrace_SettingInfo g_settings_info[] = {
+    {"f",
+     "Filter",
+     VKTRACE_SETTING_STRING,
+     {&g_settings.filter},
+     {&g_default_settings.filter},
+     TRUE,
+     "Only run the benchmarks whose name contains <string>."},
+    {"o",
+     "OutputJson",
+     VKTRACE_SETTING_STRING,
+     {&g_settings.output_json},
+     {&g_default_settings.output_json},
+     TRUE,
+     "Write the results as JSON to <string>."},
+    {"t",
+     "Threads",
+     VKTRACE_SETTING_UINT,
+     {&g_settings.threads},
+     {&g_default_settings.threads},
+     TRUE,
+     "Number of threads for the multithreaded runs, default is the number of hardware threads up to 8."},
+    {"mt",
+     "MinTime",
+     VKTRACE_SETTING_UINT,
+     {&g_settings.min_time_ms},
+     {&g_default_settings.min_time_ms},
+     TRUE,
+     "Minimum time in milliseconds that each measurement runs, default is 200."},
+    {"pt",
+     "Port",
+     VKTRACE_SETTING_UINT,
+     {&g_settings.port},
+     {&g_default_settings.port},
+     TRUE,
+     "Local TCP port used by the socket benchmark, default is one above the vktrace port range."},
+};
+
+vktrace_SettingGroup g_settingGroup = {"vktrace_benchmark", sizeof(g_settings_info) / sizeof(g_settings_info[0]),
+                                       &g_settings_info[0]};
+
+//----------------------------------------------------------------------------------------------------------------------
+// benchmarks
+//----------------------------------------------------------------------------------------------------------------------
+
+// A benchmark runs the same operation on every thread; run() returns the number of bytes it processed so that the
+// results can be reported as bandwidth as well as operations per second.
+class Benchmark {
+   public:
+    explicit Benchmark(const char* pName) : m_pName(pName) {}
+    virtual ~Benchmark() {}
+
+    const char* name() const { return m_pName; }
+    virtual bool setup(uint32_t threadCount) { return true; }
+    virtual uint64_t run(uint32_t threadIndex, uint64_t iterations) = 0;
+    virtual void teardown() {}
+
+   private:
+    const char* m_pName;
+};
+
+// Keeps the optimizer from removing work whose result is otherwise unused.
+std::atomic<uint64_t> g_sink(0);
+
+//----------------------------------------------------------------------------------------------------------------------
+// Builds the packet of a typical vkCreateBuffer call: the create info plus its queue family index array. The packet is
+// either sized up front, or created in the packet arena and grown as the buffers are added.
+class PacketBuildBenchmark : public Benchmark {
+   public:
+    PacketBuildBenchmark(const char* pName, bool useArena) : Benchmark(pName), m_useArena(useArena) {}
+
+    uint64_t run(uint32_t threadIndex, uint64_t iterations) override {
+        VkBufferCreateInfo createInfo = {};
+        createInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        createInfo.size = 65536;
+        createInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        createInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        uint32_t queueFamilies[4] = {0, 1, 2, 3};
+        createInfo.queueFamilyIndexCount = 4;
+        createInfo.pQueueFamilyIndices = queueFamilies;
+
+        uint64_t bytes = 0;
+        for (uint64_t i = 0; i < iterations; i++) {
+            vktrace_trace_packet_header* pHeader =
+                m_useArena ? vktrace_create_arena_trace_packet(VKTRACE_TID_VULKAN, VKTRACE_TPI_VK_vkCreateBuffer, 64) : NULL;
+            if (pHeader == NULL) {
+                pHeader = vktrace_create_trace_packet(VKTRACE_TID_VULKAN, VKTRACE_TPI_VK_vkCreateBuffer, 64,
+                                                      sizeof(VkBufferCreateInfo) + sizeof(queueFamilies));
+            }
+            VkBufferCreateInfo** ppCreateInfo = (VkBufferCreateInfo**)pHeader->pBody;
+            vktrace_add_buffer_to_trace_packet(pHeader, (void**)ppCreateInfo, sizeof(VkBufferCreateInfo), &createInfo);
+            vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(*ppCreateInfo)->pQueueFamilyIndices, sizeof(queueFamilies),
+                                               queueFamilies);
+            vktrace_finalize_buffer_address(pHeader, (void**)&(*ppCreateInfo)->pQueueFamilyIndices);
+            vktrace_finalize_buffer_address(pHeader, (void**)ppCreateInfo);
+            vktrace_set_packet_entrypoint_end_time(pHeader);
+            vktrace_finalize_trace_packet(pHeader);
+            bytes += pHeader->size;
+            vktrace_delete_trace_packet(&pHeader);
+        }
+        return bytes;
+    }
+
+   private:
+    bool m_useArena;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+// Serializes the pNext chains of a device group vkQueueSubmit and of a vkCreateImage with format list and external memory.
+class PnextChainBenchmark : public Benchmark {
+   public:
+    PnextChainBenchmark() : Benchmark("pnext_chains") {}
+
+    uint64_t run(uint32_t threadIndex, uint64_t iterations) override {
+        uint32_t deviceIndices[8] = {0, 1, 0, 1, 0, 1, 0, 1};
+        VkDeviceGroupSubmitInfo deviceGroupSubmit = {};
+        deviceGroupSubmit.sType = VK_STRUCTURE_TYPE_DEVICE_GROUP_SUBMIT_INFO;
+        deviceGroupSubmit.waitSemaphoreCount = 2;
+        deviceGroupSubmit.pWaitSemaphoreDeviceIndices = deviceIndices;
+        deviceGroupSubmit.commandBufferCount = 8;
+        deviceGroupSubmit.pCommandBufferDeviceMasks = deviceIndices;
+        deviceGroupSubmit.signalSemaphoreCount = 2;
+        deviceGroupSubmit.pSignalSemaphoreDeviceIndices = deviceIndices;
+        VkProtectedSubmitInfo protectedSubmit = {};
+        protectedSubmit.sType = VK_STRUCTURE_TYPE_PROTECTED_SUBMIT_INFO;
+        protectedSubmit.pNext = &deviceGroupSubmit;
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.pNext = &protectedSubmit;
+
+        VkFormat viewFormats[3] = {VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R8G8B8A8_SRGB, VK_FORMAT_B8G8R8A8_UNORM};
+        VkImageFormatListCreateInfoKHR formatList = {};
+        formatList.sType = VK_STRUCTURE_TYPE_IMAGE_FORMAT_LIST_CREATE_INFO_KHR;
+        formatList.viewFormatCount = 3;
+        formatList.pViewFormats = viewFormats;
+        VkExternalMemoryImageCreateInfo externalMemory = {};
+        externalMemory.sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO;
+        externalMemory.pNext = &formatList;
+        VkImageCreateInfo imageInfo = {};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.pNext = &externalMemory;
+
+        uint64_t bytes = 0;
+        for (uint64_t i = 0; i < iterations; i++) {
+            vktrace_trace_packet_header* pHeader =
+                vktrace_create_trace_packet(VKTRACE_TID_VULKAN, VKTRACE_TPI_VK_vkQueueSubmit, 64, 1024);
+            VkSubmitInfo* pSubmitInfo = (VkSubmitInfo*)vktrace_trace_packet_get_new_buffer_address(pHeader, sizeof(VkSubmitInfo));
+            *pSubmitInfo = submitInfo;
+            vktrace_add_pnext_structs_to_trace_packet(pHeader, pSubmitInfo, &submitInfo);
+            VkImageCreateInfo* pImageInfo =
+                (VkImageCreateInfo*)vktrace_trace_packet_get_new_buffer_address(pHeader, sizeof(VkImageCreateInfo));
+            *pImageInfo = imageInfo;
+            vktrace_add_pnext_structs_to_trace_packet(pHeader, pImageInfo, &imageInfo);
+            bytes += pHeader->next_buffers_offset;
+            vktrace_delete_trace_packet(&pHeader);
+        }
+        return bytes;
+    }
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+// Looks up the dispatch data of the first parameter of a call the way mdd() does, for objects of four devices, either in
+// the map of dispatch keys alone or through the dispatch data cache in front of it.
+class DispatchLookupBenchmark : public Benchmark {
+   public:
+    DispatchLookupBenchmark(const char* pName, bool useCache) : Benchmark(pName), m_useCache(useCache) {}
+
+    bool setup(uint32_t threadCount) override {
+        for (uint32_t i = 0; i < kDeviceCount; i++) {
+            // A dispatchable object starts with the pointer to its loader dispatch table, which is its dispatch key.
+            m_dispatchTables[i] = new uint64_t[64];
+            m_objects[i] = &m_dispatchTables[i];
+            m_data[i].key = m_dispatchTables[i];
+            m_data[i].index = i;
+            m_dataMap[m_data[i].key] = &m_data[i];
+        }
+        return true;
+    }
+
+    uint64_t run(uint32_t threadIndex, uint64_t iterations) override {
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < iterations; i++) {
+            void* key = *(void**)m_objects[i % kDeviceCount];
+            DeviceData* pData = m_useCache ? m_cache.find(key) : NULL;
+            if (pData == NULL) {
+                pData = m_dataMap.find(key)->second;
+                if (m_useCache) {
+                    m_cache.insert(pData);
+                }
+            }
+            sum += pData->index;
+        }
+        g_sink += sum;
+        return 0;
+    }
+
+    void teardown() override {
+        m_dataMap.clear();
+        for (uint32_t i = 0; i < kDeviceCount; i++) {
+            m_cache.erase(m_data[i].key);
+            delete[] m_dispatchTables[i];
+        }
+    }
+
+   private:
+    static const uint32_t kDeviceCount = 4;
+
+    struct DeviceData {
+        void* key;
+        uint64_t index;
+    };
+
+    bool m_useCache;
+    uint64_t* m_dispatchTables[kDeviceCount];
+    void* m_objects[kDeviceCount];
+    DeviceData m_data[kDeviceCount];
+    std::unordered_map<void*, DeviceData*> m_dataMap;
+    DispatchDataCache<DeviceData> m_cache;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+// Page status scans over a 64MB mapping with every eighth page changed, as done on each flush and queue submit.
+const uint64_t kMappedSize = 64 * 1024 * 1024;
+const uint64_t kPageSize = 4096;
+const uint64_t kPageCount = kMappedSize / kPageSize;
+const uint64_t kChangedPageStride = 8;
+
+class PageStatusScanBenchmark : public Benchmark {
+   public:
+    PageStatusScanBenchmark() : Benchmark("page_status_scan") {}
+
+    bool setup(uint32_t threadCount) override {
+        for (uint32_t i = 0; i < threadCount; i++) {
+            m_pageStatusArrays.push_back(new PageStatusArray(kPageCount));
+        }
+        return true;
+    }
+
+    uint64_t run(uint32_t threadIndex, uint64_t iterations) override {
+        PageStatusArray* pPageStatus = m_pageStatusArrays[threadIndex];
+        uint64_t changedPages = 0;
+        for (uint64_t i = 0; i < iterations; i++) {
+            for (uint64_t page = 0; page < kPageCount; page += kChangedPageStride) {
+                pPageStatus->setBlockChangedArray(page, true);
+            }
+            pPageStatus->backupChangedArray();
+            for (uint64_t page = 0; page < kPageCount; page++) {
+                if (pPageStatus->getBlockChangedArraySnapshot(page)) {
+                    changedPages++;
+                    pPageStatus->setBlockChangedArraySnapshot(page, false);
+                }
+            }
+        }
+        g_sink += changedPages;
+        return iterations * kMappedSize;
+    }
+
+    void teardown() override {
+        for (PageStatusArray* pPageStatus : m_pageStatusArrays) {
+            delete pPageStatus;
+        }
+        m_pageStatusArrays.clear();
+    }
+
+   private:
+    std::vector<PageStatusArray*> m_pageStatusArrays;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+// Builds the changed block package that PageGuardMappedMemory::getChangedBlockInfo() produces for a flush: an array of
+// PageGuardChangedBlockInfo followed by the changed pages. PageGuardMappedMemory can't be created without the layer's
+// dispatch state, so this walks a PageStatusArray and copies the pages the same way.
+class ChangedBlockPackageBenchmark : public Benchmark {
+   public:
+    ChangedBlockPackageBenchmark() : Benchmark("changed_block_package") {}
+
+    bool setup(uint32_t threadCount) override {
+        const uint64_t changedCount = kPageCount / kChangedPageStride;
+        for (uint32_t i = 0; i < threadCount; i++) {
+            ThreadData data;
+            data.pPageStatus = new PageStatusArray(kPageCount);
+            data.pMappedMemory = (PBYTE)vktrace_malloc(kMappedSize);
+            data.pPackage =
+                (PBYTE)vktrace_malloc((changedCount + 1) * sizeof(PageGuardChangedBlockInfo) + changedCount * kPageSize);
+            if (data.pMappedMemory == NULL || data.pPackage == NULL) {
+                return false;
+            }
+            memset(data.pMappedMemory, (int)i, kMappedSize);
+            m_threadData.push_back(data);
+        }
+        return true;
+    }
+
+    uint64_t run(uint32_t threadIndex, uint64_t iterations) override {
+        ThreadData& data = m_threadData[threadIndex];
+        uint64_t bytes = 0;
+        for (uint64_t i = 0; i < iterations; i++) {
+            for (uint64_t page = 0; page < kPageCount; page += kChangedPageStride) {
+                data.pPageStatus->setBlockChangedArray(page, true);
+            }
+            data.pPageStatus->backupChangedArray();
+
+            uint64_t blockCount = 0;
+            for (uint64_t page = 0; page < kPageCount; page++) {
+                blockCount += data.pPageStatus->getBlockChangedArraySnapshot(page) ? 1 : 0;
+            }
+
+            PageGuardChangedBlockInfo* pInfos = (PageGuardChangedBlockInfo*)data.pPackage;
+            PBYTE pBlockData = data.pPackage + (blockCount + 1) * sizeof(PageGuardChangedBlockInfo);
+            uint64_t blockIndex = 0;
+            uint64_t dataSize = 0;
+            for (uint64_t page = 0; page < kPageCount; page++) {
+                if (data.pPageStatus->getBlockChangedArraySnapshot(page)) {
+                    blockIndex++;
+                    pInfos[blockIndex].offset = (uint32_t)(page * kPageSize);
+                    pInfos[blockIndex].length = (uint32_t)kPageSize;
+                    vktrace_pageguard_memcpy(pBlockData + dataSize, data.pMappedMemory + page * kPageSize, kPageSize);
+                    dataSize += kPageSize;
+                    data.pPageStatus->setBlockChangedArraySnapshot(page, false);
+                }
+            }
+            pInfos[0].offset = (uint32_t)blockCount;
+            pInfos[0].length = (uint32_t)dataSize;
+            bytes += dataSize;
+        }
+        return bytes;
+    }
+
+    void teardown() override {
+        for (ThreadData& data : m_threadData) {
+            delete data.pPageStatus;
+            vktrace_free(data.pMappedMemory);
+            vktrace_free(data.pPackage);
+        }
+        m_threadData.clear();
+    }
+
+   private:
+    struct ThreadData {
+        PageStatusArray* pPageStatus;
+        PBYTE pMappedMemory;
+        PBYTE pPackage;
+    };
+    std::vector<ThreadData> m_threadData;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+// vktrace_pageguard_memcpy at the sizes of a small uniform update, a changed page run and a large upload.
+class MemcpyBenchmark : public Benchmark {
+   public:
+    MemcpyBenchmark(const char* pName, uint64_t size) : Benchmark(pName), m_size(size) {}
+
+    bool setup(uint32_t threadCount) override {
+        for (uint32_t i = 0; i < threadCount; i++) {
+            void* pSource = vktrace_malloc(m_size);
+            void* pDestination = vktrace_malloc(m_size);
+            if (pSource == NULL || pDestination == NULL) {
+                return false;
+            }
+            memset(pSource, (int)i, m_size);
+            m_buffers.push_back(std::make_pair(pSource, pDestination));
+        }
+        return true;
+    }
+
+    uint64_t run(uint32_t threadIndex, uint64_t iterations) override {
+        for (uint64_t i = 0; i < iterations; i++) {
+            vktrace_pageguard_memcpy(m_buffers[threadIndex].second, m_buffers[threadIndex].first, m_size);
+        }
+        return iterations * m_size;
+    }
+
+    void teardown() override {
+        for (auto& buffers : m_buffers) {
+            vktrace_free(buffers.first);
+            vktrace_free(buffers.second);
+        }
+        m_buffers.clear();
+    }
+
+   private:
+    uint64_t m_size;
+    std::vector<std::pair<void*, void*> > m_buffers;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+// Writes 1KB packets with vktrace_write_trace_packet through a FileLike, either to a temporary file or to a local socket
+// that a reader thread drains the way vktrace does.
+const uint64_t kWritePacketBodySize = 1024;
+
+class PacketWriteBenchmark : public Benchmark {
+   public:
+    PacketWriteBenchmark(const char* pName, bool bSocket)
+        : Benchmark(pName), m_bSocket(bSocket), m_pFile(NULL), m_pFileLike(NULL), m_pClientStream(NULL) {}
+
+    bool setup(uint32_t threadCount) override {
+        if (!m_bSocket) {
+            m_pFile = tmpfile();
+            if (m_pFile == NULL) {
+                return false;
+            }
+            m_pFileLike = vktrace_FileLike_create_file(m_pFile);
+            return true;
+        }
+
+        // the host side blocks until the client connects, so it is created on the reader thread
+        std::atomic<bool> bHostFailed(false);
+        m_readerThread = std::thread([this, &bHostFailed]() {
+            MessageStream* pHostStream = vktrace_MessageStream_create(TRUE, "", g_settings.port);
+            if (pHostStream == NULL) {
+                bHostFailed = true;
+                return;
+            }
+            FileLike* pReader = vktrace_FileLike_create_msg(pHostStream);
+            vktrace_trace_packet_header* pHeader;
+            while ((pHeader = vktrace_read_trace_packet(pReader)) != NULL) {
+                bool bDone = (pHeader->packet_id == VKTRACE_TPI_MARKER_TERMINATE_PROCESS);
+                vktrace_delete_trace_packet_no_lock(&pHeader);
+                if (bDone) {
+                    break;
+                }
+            }
+            VKTRACE_DELETE(pReader);
+            vktrace_MessageStream_destroy(&pHostStream);
+        });
+
+        m_pClientStream = vktrace_MessageStream_create(FALSE, "localhost", g_settings.port);
+        if (m_pClientStream == NULL || bHostFailed) {
+            vktrace_LogError("Unable to connect the benchmark socket on port %u.", g_settings.port);
+            return false;
+        }
+        m_pFileLike = vktrace_FileLike_create_msg(m_pClientStream);
+        return true;
+    }
+
+    uint64_t run(uint32_t threadIndex, uint64_t iterations) override {
+        uint64_t bytes = 0;
+        for (uint64_t i = 0; i < iterations; i++) {
+            vktrace_trace_packet_header* pHeader =
+                vktrace_create_trace_packet(VKTRACE_TID_VULKAN, VKTRACE_TPI_VK_vkCmdPushConstants, kWritePacketBodySize, 0);
+            vktrace_finalize_trace_packet(pHeader);
+            vktrace_write_trace_packet(pHeader, m_pFileLike);
+            bytes += pHeader->size;
+            vktrace_delete_trace_packet(&pHeader);
+        }
+        if (m_pFile != NULL) {
+            fflush(m_pFile);
+            rewind(m_pFile);
+        }
+        return bytes;
+    }
+
+    void teardown() override {
+        if (m_pClientStream != NULL) {
+            vktrace_trace_packet_header* pHeader =
+                vktrace_create_trace_packet(VKTRACE_TID_VULKAN, VKTRACE_TPI_MARKER_TERMINATE_PROCESS, 0, 0);
+            vktrace_finalize_trace_packet(pHeader);
+            vktrace_write_trace_packet(pHeader, m_pFileLike);
+            vktrace_delete_trace_packet(&pHeader);
+        }
+        if (m_readerThread.joinable()) {
+            m_readerThread.join();
+        }
+        VKTRACE_DELETE(m_pFileLike);
+        m_pFileLike = NULL;
+        if (m_pClientStream != NULL) {
+            vktrace_MessageStream_destroy(&m_pClientStream);
+        }
+        if (m_pFile != NULL) {
+            fclose(m_pFile);
+            m_pFile = NULL;
+        }
+    }
+
+   private:
+    bool m_bSocket;
+    FILE* m_pFile;
+    FileLike* m_pFileLike;
+    MessageStream* m_pClientStream;
+    std::thread m_readerThread;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+// measurement
+//----------------------------------------------------------------------------------------------------------------------
+struct BenchmarkResult {
+    std::string name;
+    uint32_t threads;
+    uint64_t iterations;
+    double nsPerOp;
+    double opsPerSec;
+    double mbPerSec;
+};
+
+// Runs the benchmark on all threads at once and returns the wall time in nanoseconds.
+uint64_t run_on_threads(Benchmark* pBenchmark, uint32_t threadCount, uint64_t iterations, uint64_t* pBytes) {
+    std::atomic<uint32_t> readyThreads(0);
+    std::atomic<bool> bStart(false);
+    std::vector<uint64_t> bytes(threadCount, 0);
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < threadCount; t++) {
+        threads.push_back(std::thread([&, t]() {
+            readyThreads++;
+            while (!bStart) {
+                std::this_thread::yield();
+            }
+            bytes[t] = pBenchmark->run(t, iterations);
+        }));
+    }
+
+    while (readyThreads < threadCount) {
+        std::this_thread::yield();
+    }
+    uint64_t startTime = vktrace_get_time();
+    bStart = true;
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    uint64_t elapsed = vktrace_get_time() - startTime;
+
+    *pBytes = 0;
+    for (uint64_t threadBytes : bytes) {
+        *pBytes += threadBytes;
+    }
+    return std::max(elapsed, (uint64_t)1);
+}
+
+bool measure(Benchmark* pBenchmark, uint32_t threadCount, BenchmarkResult* pResult) {
+    if (!pBenchmark->setup(threadCount)) {
+        vktrace_LogError("Setup of %s failed.", pBenchmark->name());
+        pBenchmark->teardown();
+        return false;
+    }
+
+    // double the iterations until one measurement takes long enough to be meaningful
+    const uint64_t minTime = (uint64_t)g_settings.min_time_ms * 1000000;
+    uint64_t bytes = 0;
+    uint64_t iterations = 1;
+    uint64_t elapsed = run_on_threads(pBenchmark, threadCount, iterations, &bytes);
+    while (elapsed < minTime) {
+        uint64_t scale = std::min((uint64_t)100, std::max((uint64_t)2, (minTime * 3 / 2) / elapsed));
+        iterations *= scale;
+        elapsed = run_on_threads(pBenchmark, threadCount, iterations, &bytes);
+    }
+    pBenchmark->teardown();
+
+    uint64_t operations = iterations * threadCount;
+    pResult->name = pBenchmark->name();
+    pResult->threads = threadCount;
+    pResult->iterations = operations;
+    pResult->nsPerOp = (double)elapsed / operations;
+    pResult->opsPerSec = operations * 1e9 / elapsed;
+    pResult->mbPerSec = bytes * 1e9 / elapsed / (1024.0 * 1024.0);
+    return true;
+}
+
+bool write_json(const char* pFilename, const std::vector<BenchmarkResult>& results) {
+    FILE* pFile = fopen(pFilename, "w");
+    if (pFile == NULL) {
+        vktrace_LogError("Unable to open %s for writing.", pFilename);
+        return false;
+    }
+
+    fprintf(pFile, "{\n");
+    fprintf(pFile, "    \"context\": {\"hardware_threads\": %u, \"pointer_size\": %u, \"min_time_ms\": %u},\n",
+            std::thread::hardware_concurrency(), (uint32_t)sizeof(void*), g_settings.min_time_ms);
+    fprintf(pFile, "    \"benchmarks\": [");
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchmarkResult& result = results[i];
+        fprintf(pFile,
+                "%s\n        {\"name\": \"%s\", \"threads\": %u, \"iterations\": %" PRIu64
+                ", \"ns_per_op\": %.2f, \"ops_per_sec\": %.1f, \"mb_per_sec\": %.2f}",
+                (i > 0) ? "," : "", result.name.c_str(), result.threads, result.iterations, result.nsPerOp, result.opsPerSec,
+                result.mbPerSec);
+    }
+    fprintf(pFile, "\n    ]\n}\n");
+    fclose(pFile);
+    return true;
+}
+
+void loggingCallback(VktraceLogLevel level, const char* pMessage) {
+    if (level == VKTRACE_LOG_NONE) return;
+    printf("vktrace_benchmark: %s\n", pMessage);
+    fflush(stdout);
+}
+
+// ------------------------------------------------------------------------------------------------
+int main(int argc, char* argv[]) {
+    vktrace_LogSetCallback(loggingCallback);
+    vktrace_LogSetLevel(VKTRACE_LOG_ERROR);
+
+    memset(&g_settings, 0, sizeof(vktrace_benchmark_settings));
+    memset(&g_default_settings, 0, sizeof(vktrace_benchmark_settings));
+    g_default_settings.threads = std::max(2u, std::min(8u, std::thread::hardware_concurrency()));
+    g_default_settings.min_time_ms = 200;
+    g_default_settings.port = VKTRACE_BASE_PORT + VKTRACE_MAX_TRACER_ID_ARRAY_SIZE;
+
+    if (vktrace_SettingGroup_init(&g_settingGroup, NULL, argc, argv, NULL) != 0) {
+        vktrace_SettingGroup_print(&g_settingGroup);
+        return -1;
+    }
+    if (g_settings.threads == 0 || g_settings.min_time_ms == 0) {
+        vktrace_LogError("Threads and MinTime must be greater than 0.");
+        vktrace_SettingGroup_print(&g_settingGroup);
+        vktrace_SettingGroup_delete(&g_settingGroup);
+        return -1;
+    }
+
+    vktrace_initialize_trace_packet_utils();
+
+    std::vector<Benchmark*> benchmarks;
+    benchmarks.push_back(new PacketBuildBenchmark("packet_create_add_finalize", false));
+    benchmarks.push_back(new PacketBuildBenchmark("packet_arena_create_add_finalize", true));
+    benchmarks.push_back(new PnextChainBenchmark());
+    benchmarks.push_back(new DispatchLookupBenchmark("dispatch_lookup_map", false));
+    benchmarks.push_back(new DispatchLookupBenchmark("dispatch_lookup_cache", true));
+    benchmarks.push_back(new PageStatusScanBenchmark());
+    benchmarks.push_back(new ChangedBlockPackageBenchmark());
+    benchmarks.push_back(new MemcpyBenchmark("pageguard_memcpy_256b", 256));
+    benchmarks.push_back(new MemcpyBenchmark("pageguard_memcpy_64kb", 64 * 1024));
+    benchmarks.push_back(new MemcpyBenchmark("pageguard_memcpy_16mb", 16 * 1024 * 1024));
+    benchmarks.push_back(new PacketWriteBenchmark("packet_write_file", false));
+    benchmarks.push_back(new PacketWriteBenchmark("packet_write_socket", true));
+
+    std::vector<uint32_t> threadCounts(1, 1);
+    if (g_settings.threads > 1) {
+        threadCounts.push_back(g_settings.threads);
+    }
+
+    int exitval = 0;
+    std::vector<BenchmarkResult> results;
+    printf("%-28s %8s %14s %14s %12s\n", "benchmark", "threads", "ns/op", "ops/s", "MB/s");
+    for (Benchmark* pBenchmark : benchmarks) {
+        if (g_settings.filter != NULL && strstr(pBenchmark->name(), g_settings.filter) == NULL) {
+            continue;
+        }
+        for (uint32_t threadCount : threadCounts) {
+            BenchmarkResult result;
+            if (!measure(pBenchmark, threadCount, &result)) {
+                exitval = 1;
+                continue;
+            }
+            printf("%-28s %8u %14.2f %14.1f %12.2f\n", result.name.c_str(), result.threads, result.nsPerOp, result.opsPerSec,
+                   result.mbPerSec);
+            fflush(stdout);
+            results.push_back(result);
+        }
+    }
+
+    if (g_settings.output_json != NULL && strlen(g_settings.output_json) > 0 && !write_json(g_settings.output_json, results)) {
+        exitval = 1;
+    }
+
+    for (Benchmark* pBenchmark : benchmarks) {
+        delete pBenchmark;
+    }
+    vktrace_deinitialize_trace_packet_utils();
+    vktrace_SettingGroup_delete(&g_settingGroup);
+    return exitval;
+}
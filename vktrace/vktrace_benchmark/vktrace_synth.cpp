@@ -0,0 +1,756 @@
+/*
+ * Copyright (C) 2019 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Writes synthetic trace files with a fixed shape, so that the replay side can be measured on workloads that stress one
+// thing at a time: many draws, many descriptor updates, large uploads through mapped memory, or command buffers
+// recorded on many threads. The packets are built with the same trim::generate helpers the layer uses, no Vulkan driver
+// is called. The handles in the trace are made up, so the traces are meant to be replayed against the mock ICD.
+
+#include <inttypes.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "vktrace_common.h"
+#include "vktrace_filelike.h"
+#include "vktrace_settings.h"
+#include "vktrace_trace_packet_utils.h"
+}
+#include "vktrace_pageguard_memorycopy.h"
+#include "vktrace_lib_helpers.h"
+#include "vktrace_lib_trim_generate.h"
+#include "vktrace_vk_vk_packets.h"
+#include "vktrace_vk_packet_id.h"
+
+// The trim::generate helpers only use these when makeCall is true, which it never is here.
+layer_device_data* mdd(void* object) { return NULL; }
+layer_instance_data* mid(void* object) { return NULL; }
+
+//----------------------------------------------------------------------------------------------------------------------
+// settings
+//----------------------------------------------------------------------------------------------------------------------
+typedef struct vktrace_synth_settings {
+    char* output_trace;
+    char* shape;
+    unsigned int frames;
+    unsigned int work_per_frame;
+    unsigned int upload_kb;
+    unsigned int threads;
+} vktrace_synth_settings;
+
+vktrace_synth_settings g_settings;
+vktrace_synth_settings g_default_settings;
+
+vktrace_SettingInfo g_settings_info[] = {
+    {"o",
+     "OutputTrace",
+     VKTRACE_SETTING_STRING,
+     {&g_settings.output_trace},
+     {&g_default_settings.output_trace},
+     TRUE,
+     "Name of the generated trace file."},
+    {"s",
+     "Shape",
+     VKTRACE_SETTING_STRING,
+     {&g_settings.shape},
+     {&g_default_settings.shape},
+     TRUE,
+     "Shape of the trace: draw, descriptor, upload or threads, default is draw."},
+    {"f",
+     "Frames",
+     VKTRACE_SETTING_UINT,
+     {&g_settings.frames},
+     {&g_default_settings.frames},
+     TRUE,
+     "Number of frames, each one is recorded, submitted and waited for, default is 100."},
+    {"n",
+     "WorkPerFrame",
+     VKTRACE_SETTING_UINT,
+     {&g_settings.work_per_frame},
+     {&g_default_settings.work_per_frame},
+     TRUE,
+     "Draws (draw, threads) or descriptor writes (descriptor) per frame, default is 1000."},
+    {"us",
+     "UploadKB",
+     VKTRACE_SETTING_UINT,
+     {&g_settings.upload_kb},
+     {&g_default_settings.upload_kb},
+     TRUE,
+     "Kilobytes flushed from mapped memory per frame in the upload shape, default is 4096."},
+    {"t",
+     "Threads",
+     VKTRACE_SETTING_UINT,
+     {&g_settings.threads},
+     {&g_default_settings.threads},
+     TRUE,
+     "Number of recording threads in the threads shape, default is 4."},
+};
+
+vktrace_SettingGroup g_settingGroup = {"vktrace_synth", sizeof(g_settings_info) / sizeof(g_settings_info[0]),
+                                       &g_settings_info[0]};
+
+//----------------------------------------------------------------------------------------------------------------------
+// packet output
+//----------------------------------------------------------------------------------------------------------------------
+enum SynthShape { SYNTH_SHAPE_DRAW, SYNTH_SHAPE_DESCRIPTOR, SYNTH_SHAPE_UPLOAD, SYNTH_SHAPE_THREADS };
+
+const VkDeviceSize kPageSize = 4096;
+const uint32_t kPushConstantSize = 16;
+
+FileLike* g_pTraceFile = NULL;
+std::atomic<uint64_t> g_nextHandle(0x10000);
+
+// Handles only have to be unique and non-null for the replayer to map them.
+template <typename T>
+T make_handle() {
+    return (T)(uintptr_t)g_nextHandle.fetch_add(0x10);
+}
+
+// The packet keeps the trace packet lock from creation to deletion, which also serializes the writes of the recording
+// threads in the threads shape.
+void write_packet(vktrace_trace_packet_header* pHeader) {
+    vktrace_write_trace_packet(pHeader, g_pTraceFile);
+    vktrace_delete_trace_packet(&pHeader);
+}
+
+bool write_trace_file_header() {
+    // a single made up GPU; vkreplay falls back to the first physical device when the ids don't match
+    size_t header_size = sizeof(vktrace_trace_file_header) + sizeof(struct_gpuinfo);
+    vktrace_trace_file_header* pHeader = (vktrace_trace_file_header*)vktrace_malloc(header_size);
+    if (pHeader == NULL) {
+        return false;
+    }
+    memset(pHeader, 0, header_size);
+    pHeader->trace_file_version = VKTRACE_TRACE_FILE_VERSION;
+    pHeader->magic = VKTRACE_FILE_MAGIC;
+    vktrace_gen_uuid(pHeader->uuid);
+    pHeader->first_packet_offset = header_size;
+    pHeader->tracer_count = 1;
+    pHeader->tracer_id_array[0].id = VKTRACE_TID_VULKAN;
+    pHeader->tracer_id_array[0].is_64_bit = (sizeof(intptr_t) == 8) ? 1 : 0;
+    pHeader->trace_start_time = vktrace_get_time();
+    pHeader->endianess = get_endianess();
+    pHeader->ptrsize = sizeof(void*);
+    pHeader->arch = get_arch();
+    pHeader->os = get_os();
+    pHeader->n_gpuinfo = 1;
+
+    BOOL bWritten = vktrace_FileLike_WriteRaw(g_pTraceFile, pHeader, header_size);
+    vktrace_free(pHeader);
+    return bWritten == TRUE;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+// packets the trim::generate helpers don't cover; they're built the same way the layer builds them
+//----------------------------------------------------------------------------------------------------------------------
+namespace synth {
+
+vktrace_trace_packet_header* vkApiVersion() {
+    vktrace_trace_packet_header* pHeader =
+        vktrace_create_trace_packet(VKTRACE_TID_VULKAN, VKTRACE_TPI_VK_vkApiVersion, sizeof(packet_vkApiVersion), 0);
+    packet_vkApiVersion* pPacket = interpret_body_as_vkApiVersion(pHeader);
+    pPacket->version = VK_MAKE_VERSION(1, 2, VK_HEADER_VERSION);
+    vktrace_finalize_trace_packet(pHeader);
+    return pHeader;
+}
+
+vktrace_trace_packet_header* vkCreateInstance(VkInstanceCreateInfo* pCreateInfo, VkInstance* pInstance) {
+    vktrace_trace_packet_header* pHeader;
+    CREATE_TRACE_PACKET(vkCreateInstance, sizeof(VkInstance) + get_struct_chain_size((void*)pCreateInfo) +
+                                              sizeof(VkAllocationCallbacks));
+    packet_vkCreateInstance* pPacket = interpret_body_as_vkCreateInstance(pHeader);
+    add_VkInstanceCreateInfo_to_packet(pHeader, (VkInstanceCreateInfo**)&(pPacket->pCreateInfo), pCreateInfo);
+    vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->pAllocator), sizeof(VkAllocationCallbacks), NULL);
+    vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->pInstance), sizeof(VkInstance), pInstance);
+    pPacket->result = VK_SUCCESS;
+    vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->pAllocator));
+    vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->pInstance));
+    vktrace_finalize_trace_packet(pHeader);
+    return pHeader;
+}
+
+vktrace_trace_packet_header* vkEnumeratePhysicalDevices(VkInstance instance, uint32_t* pPhysicalDeviceCount,
+                                                        VkPhysicalDevice* pPhysicalDevices) {
+    vktrace_trace_packet_header* pHeader;
+    size_t devicesSize = (pPhysicalDevices == NULL) ? 0 : *pPhysicalDeviceCount * sizeof(VkPhysicalDevice);
+    CREATE_TRACE_PACKET(vkEnumeratePhysicalDevices, sizeof(uint32_t) + devicesSize);
+    packet_vkEnumeratePhysicalDevices* pPacket = interpret_body_as_vkEnumeratePhysicalDevices(pHeader);
+    pPacket->instance = instance;
+    vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->pPhysicalDeviceCount), sizeof(uint32_t),
+                                       pPhysicalDeviceCount);
+    vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->pPhysicalDevices), devicesSize, pPhysicalDevices);
+    pPacket->result = VK_SUCCESS;
+    vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->pPhysicalDeviceCount));
+    vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->pPhysicalDevices));
+    vktrace_finalize_trace_packet(pHeader);
+    return pHeader;
+}
+
+vktrace_trace_packet_header* vkCreateDevice(VkPhysicalDevice physicalDevice, const VkDeviceCreateInfo* pCreateInfo,
+                                            VkDevice* pDevice) {
+    vktrace_trace_packet_header* pHeader;
+    size_t pnextSize = get_struct_chain_size((void*)pCreateInfo);
+    for (uint32_t i = 0; i < pCreateInfo->queueCreateInfoCount; i++) {
+        pnextSize += get_struct_chain_size((void*)&pCreateInfo->pQueueCreateInfos[i]);
+    }
+    CREATE_TRACE_PACKET(vkCreateDevice, pnextSize + sizeof(VkAllocationCallbacks) + sizeof(VkDevice));
+    packet_vkCreateDevice* pPacket = interpret_body_as_vkCreateDevice(pHeader);
+    pPacket->physicalDevice = physicalDevice;
+    add_VkDeviceCreateInfo_to_packet(pHeader, (VkDeviceCreateInfo**)&(pPacket->pCreateInfo), pCreateInfo);
+    vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->pAllocator), sizeof(VkAllocationCallbacks), NULL);
+    vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->pDevice), sizeof(VkDevice), pDevice);
+    pPacket->result = VK_SUCCESS;
+    vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->pAllocator));
+    vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->pDevice));
+    vktrace_finalize_trace_packet(pHeader);
+    return pHeader;
+}
+
+vktrace_trace_packet_header* vkGetDeviceQueue(VkDevice device, uint32_t queueFamilyIndex, uint32_t queueIndex, VkQueue* pQueue) {
+    vktrace_trace_packet_header* pHeader;
+    CREATE_TRACE_PACKET(vkGetDeviceQueue, sizeof(VkQueue));
+    packet_vkGetDeviceQueue* pPacket = interpret_body_as_vkGetDeviceQueue(pHeader);
+    pPacket->device = device;
+    pPacket->queueFamilyIndex = queueFamilyIndex;
+    pPacket->queueIndex = queueIndex;
+    vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->pQueue), sizeof(VkQueue), pQueue);
+    vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->pQueue));
+    vktrace_finalize_trace_packet(pHeader);
+    return pHeader;
+}
+
+vktrace_trace_packet_header* vkCreateDescriptorSetLayout(VkDevice device, const VkDescriptorSetLayoutCreateInfo* pCreateInfo,
+                                                         VkDescriptorSetLayout* pSetLayout) {
+    vktrace_trace_packet_header* pHeader;
+    CREATE_TRACE_PACKET(vkCreateDescriptorSetLayout,
+                        get_struct_chain_size((void*)pCreateInfo) + sizeof(VkAllocationCallbacks) + sizeof(VkDescriptorSetLayout));
+    packet_vkCreateDescriptorSetLayout* pPacket = interpret_body_as_vkCreateDescriptorSetLayout(pHeader);
+    pPacket->device = device;
+    vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->pCreateInfo), sizeof(VkDescriptorSetLayoutCreateInfo),
+                                       pCreateInfo);
+    add_create_ds_layout_to_trace_packet(pHeader, &pPacket->pCreateInfo, pCreateInfo);
+    vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->pAllocator), sizeof(VkAllocationCallbacks), NULL);
+    vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->pSetLayout), sizeof(VkDescriptorSetLayout), pSetLayout);
+    pPacket->result = VK_SUCCESS;
+    vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->pAllocator));
+    vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->pSetLayout));
+    vktrace_finalize_trace_packet(pHeader);
+    return pHeader;
+}
+
+vktrace_trace_packet_header* vkCreatePipelineLayout(VkDevice device, const VkPipelineLayoutCreateInfo* pCreateInfo,
+                                                    VkPipelineLayout* pPipelineLayout) {
+    vktrace_trace_packet_header* pHeader;
+    CREATE_TRACE_PACKET(vkCreatePipelineLayout,
+                        get_struct_chain_size((void*)pCreateInfo) + sizeof(VkAllocationCallbacks) + sizeof(VkPipelineLayout));
+    packet_vkCreatePipelineLayout* pPacket = interpret_body_as_vkCreatePipelineLayout(pHeader);
+    pPacket->device = device;
+    vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->pCreateInfo), sizeof(VkPipelineLayoutCreateInfo), pCreateInfo);
+    vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->pCreateInfo->pSetLayouts),
+                                       pCreateInfo->setLayoutCount * sizeof(VkDescriptorSetLayout), pCreateInfo->pSetLayouts);
+    vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->pCreateInfo->pPushConstantRanges),
+                                       pCreateInfo->pushConstantRangeCount * sizeof(VkPushConstantRange),
+                                       pCreateInfo->pPushConstantRanges);
+    vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->pCreateInfo->pSetLayouts));
+    vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->pCreateInfo->pPushConstantRanges));
+    vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->pAllocator), sizeof(VkAllocationCallbacks), NULL);
+    vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->pPipelineLayout), sizeof(VkPipelineLayout), pPipelineLayout);
+    pPacket->result = VK_SUCCESS;
+    vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->pCreateInfo));
+    vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->pAllocator));
+    vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->pPipelineLayout));
+    vktrace_finalize_trace_packet(pHeader);
+    return pHeader;
+}
+
+vktrace_trace_packet_header* vkCreateDescriptorPool(VkDevice device, const VkDescriptorPoolCreateInfo* pCreateInfo,
+                                                    VkDescriptorPool* pDescriptorPool) {
+    vktrace_trace_packet_header* pHeader;
+    CREATE_TRACE_PACKET(vkCreateDescriptorPool,
+                        get_struct_chain_size((void*)pCreateInfo) + sizeof(VkAllocationCallbacks) + sizeof(VkDescriptorPool));
+    packet_vkCreateDescriptorPool* pPacket = interpret_body_as_vkCreateDescriptorPool(pHeader);
+    pPacket->device = device;
+    vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->pCreateInfo), sizeof(VkDescriptorPoolCreateInfo), pCreateInfo);
+    vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->pCreateInfo->pPoolSizes),
+                                       pCreateInfo->poolSizeCount * sizeof(VkDescriptorPoolSize), pCreateInfo->pPoolSizes);
+    vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->pCreateInfo->pPoolSizes));
+    vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->pAllocator), sizeof(VkAllocationCallbacks), NULL);
+    vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->pDescriptorPool), sizeof(VkDescriptorPool), pDescriptorPool);
+    pPacket->result = VK_SUCCESS;
+    vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->pCreateInfo));
+    vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->pAllocator));
+    vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->pDescriptorPool));
+    vktrace_finalize_trace_packet(pHeader);
+    return pHeader;
+}
+
+vktrace_trace_packet_header* vkCmdBindDescriptorSets(VkCommandBuffer commandBuffer, VkPipelineLayout layout,
+                                                     uint32_t descriptorSetCount, const VkDescriptorSet* pDescriptorSets) {
+    vktrace_trace_packet_header* pHeader;
+    CREATE_TRACE_PACKET(vkCmdBindDescriptorSets, descriptorSetCount * sizeof(VkDescriptorSet));
+    packet_vkCmdBindDescriptorSets* pPacket = interpret_body_as_vkCmdBindDescriptorSets(pHeader);
+    pPacket->commandBuffer = commandBuffer;
+    pPacket->pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    pPacket->layout = layout;
+    pPacket->firstSet = 0;
+    pPacket->descriptorSetCount = descriptorSetCount;
+    pPacket->dynamicOffsetCount = 0;
+    vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->pDescriptorSets), descriptorSetCount * sizeof(VkDescriptorSet),
+                                       pDescriptorSets);
+    vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->pDynamicOffsets), 0, NULL);
+    vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->pDescriptorSets));
+    vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->pDynamicOffsets));
+    vktrace_finalize_trace_packet(pHeader);
+    return pHeader;
+}
+
+vktrace_trace_packet_header* vkCmdBindVertexBuffers(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset) {
+    vktrace_trace_packet_header* pHeader;
+    CREATE_TRACE_PACKET(vkCmdBindVertexBuffers, sizeof(VkBuffer) + sizeof(VkDeviceSize));
+    packet_vkCmdBindVertexBuffers* pPacket = interpret_body_as_vkCmdBindVertexBuffers(pHeader);
+    pPacket->commandBuffer = commandBuffer;
+    pPacket->firstBinding = 0;
+    pPacket->bindingCount = 1;
+    vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->pBuffers), sizeof(VkBuffer), &buffer);
+    vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->pOffsets), sizeof(VkDeviceSize), &offset);
+    vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->pBuffers));
+    vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->pOffsets));
+    vktrace_finalize_trace_packet(pHeader);
+    return pHeader;
+}
+
+vktrace_trace_packet_header* vkCmdPushConstants(VkCommandBuffer commandBuffer, VkPipelineLayout layout, uint32_t size,
+                                                const void* pValues) {
+    vktrace_trace_packet_header* pHeader;
+    CREATE_TRACE_PACKET(vkCmdPushConstants, size);
+    packet_vkCmdPushConstants* pPacket = interpret_body_as_vkCmdPushConstants(pHeader);
+    pPacket->commandBuffer = commandBuffer;
+    pPacket->layout = layout;
+    pPacket->stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pPacket->offset = 0;
+    pPacket->size = size;
+    vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->pValues), size, pValues);
+    vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->pValues));
+    vktrace_finalize_trace_packet(pHeader);
+    return pHeader;
+}
+
+vktrace_trace_packet_header* vkCmdDraw(VkCommandBuffer commandBuffer, uint32_t vertexCount, uint32_t firstVertex) {
+    vktrace_trace_packet_header* pHeader;
+    CREATE_TRACE_PACKET(vkCmdDraw, 0);
+    packet_vkCmdDraw* pPacket = interpret_body_as_vkCmdDraw(pHeader);
+    pPacket->commandBuffer = commandBuffer;
+    pPacket->vertexCount = vertexCount;
+    pPacket->instanceCount = 1;
+    pPacket->firstVertex = firstVertex;
+    pPacket->firstInstance = 0;
+    vktrace_finalize_trace_packet(pHeader);
+    return pHeader;
+}
+
+// pPackage is a changed block package in the format PageGuardMappedMemory::vkFlushMappedMemoryRangePageGuardHandle writes.
+vktrace_trace_packet_header* vkFlushMappedMemoryRanges(VkDevice device, const VkMappedMemoryRange* pMemoryRange,
+                                                       const void* pPackage, size_t packageSize) {
+    vktrace_trace_packet_header* pHeader;
+    CREATE_TRACE_PACKET(vkFlushMappedMemoryRanges, sizeof(VkMappedMemoryRange) + sizeof(void*) + ROUNDUP_TO_4(packageSize));
+    packet_vkFlushMappedMemoryRanges* pPacket = interpret_body_as_vkFlushMappedMemoryRanges(pHeader);
+    pPacket->device = device;
+    pPacket->memoryRangeCount = 1;
+    vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->pMemoryRanges), sizeof(VkMappedMemoryRange), pMemoryRange);
+    vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->pMemoryRanges));
+    // reserve the ppData array first, then fill in the package
+    void* pTmpData = NULL;
+    vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->ppData), sizeof(void*), &pTmpData);
+    vktrace_add_buffer_to_trace_packet(pHeader, (void**)&(pPacket->ppData[0]), packageSize, pPackage);
+    vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->ppData[0]));
+    vktrace_finalize_buffer_address(pHeader, (void**)&(pPacket->ppData));
+    pPacket->result = VK_SUCCESS;
+    vktrace_finalize_trace_packet(pHeader);
+    return pHeader;
+}
+
+}  // namespace synth
+
+//----------------------------------------------------------------------------------------------------------------------
+// trace shapes
+//----------------------------------------------------------------------------------------------------------------------
+
+// Everything a shape records into; created once at the start of the trace and destroyed at the end.
+struct SynthDevice {
+    VkInstance instance;
+    VkPhysicalDevice physicalDevice;
+    VkDevice device;
+    VkQueue queue;
+    VkFence fence;
+    VkCommandPool commandPool;
+    VkCommandBuffer commandBuffer;
+    VkDescriptorSetLayout setLayout;
+    VkPipelineLayout pipelineLayout;
+    VkDescriptorPool descriptorPool;
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    VkDeviceSize memorySize;
+    std::vector<VkDescriptorSet> descriptorSets;
+};
+
+void create_command_buffer(VkDevice device, VkCommandPool* pCommandPool, VkCommandBuffer* pCommandBuffer) {
+    VkCommandPoolCreateInfo poolCreateInfo = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+    poolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolCreateInfo.queueFamilyIndex = 0;
+    *pCommandPool = make_handle<VkCommandPool>();
+    write_packet(trim::generate::vkCreateCommandPool(false, device, &poolCreateInfo, NULL, pCommandPool));
+
+    VkCommandBufferAllocateInfo allocateInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+    allocateInfo.commandPool = *pCommandPool;
+    allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocateInfo.commandBufferCount = 1;
+    *pCommandBuffer = make_handle<VkCommandBuffer>();
+    write_packet(trim::generate::vkAllocateCommandBuffers(false, device, &allocateInfo, pCommandBuffer));
+}
+
+void destroy_command_buffer(VkDevice device, VkCommandPool commandPool, VkCommandBuffer commandBuffer) {
+    write_packet(trim::generate::vkFreeCommandBuffers(false, device, commandPool, 1, &commandBuffer));
+    write_packet(trim::generate::vkDestroyCommandPool(false, device, commandPool, NULL));
+}
+
+void create_device(SynthDevice* pSynth, SynthShape shape) {
+    VkApplicationInfo appInfo = {VK_STRUCTURE_TYPE_APPLICATION_INFO};
+    appInfo.pApplicationName = "vktrace_synth";
+    appInfo.apiVersion = VK_API_VERSION_1_0;
+    VkInstanceCreateInfo instanceCreateInfo = {VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO};
+    instanceCreateInfo.pApplicationInfo = &appInfo;
+    pSynth->instance = make_handle<VkInstance>();
+    write_packet(synth::vkCreateInstance(&instanceCreateInfo, &pSynth->instance));
+
+    uint32_t physicalDeviceCount = 1;
+    pSynth->physicalDevice = make_handle<VkPhysicalDevice>();
+    write_packet(synth::vkEnumeratePhysicalDevices(pSynth->instance, &physicalDeviceCount, NULL));
+    write_packet(synth::vkEnumeratePhysicalDevices(pSynth->instance, &physicalDeviceCount, &pSynth->physicalDevice));
+
+    float queuePriority = 1.0f;
+    VkDeviceQueueCreateInfo queueCreateInfo = {VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO};
+    queueCreateInfo.queueFamilyIndex = 0;
+    queueCreateInfo.queueCount = 1;
+    queueCreateInfo.pQueuePriorities = &queuePriority;
+    VkDeviceCreateInfo deviceCreateInfo = {VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO};
+    deviceCreateInfo.queueCreateInfoCount = 1;
+    deviceCreateInfo.pQueueCreateInfos = &queueCreateInfo;
+    pSynth->device = make_handle<VkDevice>();
+    write_packet(synth::vkCreateDevice(pSynth->physicalDevice, &deviceCreateInfo, &pSynth->device));
+
+    pSynth->queue = make_handle<VkQueue>();
+    write_packet(synth::vkGetDeviceQueue(pSynth->device, 0, 0, &pSynth->queue));
+
+    VkFenceCreateInfo fenceCreateInfo = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+    pSynth->fence = make_handle<VkFence>();
+    write_packet(trim::generate::vkCreateFence(false, pSynth->device, &fenceCreateInfo, NULL, &pSynth->fence));
+
+    create_command_buffer(pSynth->device, &pSynth->commandPool, &pSynth->commandBuffer);
+
+    VkDescriptorSetLayoutBinding binding = {};
+    binding.binding = 0;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    binding.descriptorCount = 1;
+    binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    VkDescriptorSetLayoutCreateInfo setLayoutCreateInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    setLayoutCreateInfo.bindingCount = 1;
+    setLayoutCreateInfo.pBindings = &binding;
+    pSynth->setLayout = make_handle<VkDescriptorSetLayout>();
+    write_packet(synth::vkCreateDescriptorSetLayout(pSynth->device, &setLayoutCreateInfo, &pSynth->setLayout));
+
+    VkPushConstantRange pushConstantRange = {VK_SHADER_STAGE_VERTEX_BIT, 0, kPushConstantSize};
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    pipelineLayoutCreateInfo.setLayoutCount = 1;
+    pipelineLayoutCreateInfo.pSetLayouts = &pSynth->setLayout;
+    pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+    pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+    pSynth->pipelineLayout = make_handle<VkPipelineLayout>();
+    write_packet(synth::vkCreatePipelineLayout(pSynth->device, &pipelineLayoutCreateInfo, &pSynth->pipelineLayout));
+
+    // one buffer serves as vertex buffer, uniform buffer and upload target; the upload shape needs room for twice the
+    // uploaded data because only every other page is flushed
+    pSynth->memorySize = (shape == SYNTH_SHAPE_UPLOAD) ? 2 * (VkDeviceSize)g_settings.upload_kb * 1024 : 64 * kPageSize;
+    pSynth->memorySize = (pSynth->memorySize + 2 * kPageSize - 1) / (2 * kPageSize) * (2 * kPageSize);
+    VkBufferCreateInfo bufferCreateInfo = {VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+    bufferCreateInfo.size = pSynth->memorySize;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    pSynth->buffer = make_handle<VkBuffer>();
+    write_packet(trim::generate::vkCreateBuffer(false, pSynth->device, &bufferCreateInfo, NULL, &pSynth->buffer));
+
+    VkMemoryRequirements memoryRequirements = {pSynth->memorySize, kPageSize, 1};
+    write_packet(trim::generate::vkGetBufferMemoryRequirements(false, pSynth->device, pSynth->buffer, &memoryRequirements));
+
+    // memory type 0 is host visible and coherent on the mock ICD
+    VkMemoryAllocateInfo memoryAllocateInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+    memoryAllocateInfo.allocationSize = pSynth->memorySize;
+    memoryAllocateInfo.memoryTypeIndex = 0;
+    pSynth->memory = make_handle<VkDeviceMemory>();
+    write_packet(trim::generate::vkAllocateMemory(false, pSynth->device, &memoryAllocateInfo, NULL, &pSynth->memory));
+    write_packet(trim::generate::vkBindBufferMemory(false, pSynth->device, pSynth->buffer, pSynth->memory, 0));
+
+    uint32_t setCount = (shape == SYNTH_SHAPE_DESCRIPTOR) ? std::max(1u, g_settings.work_per_frame) : 1;
+    VkDescriptorPoolSize poolSize = {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, setCount};
+    VkDescriptorPoolCreateInfo poolCreateInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    poolCreateInfo.maxSets = setCount;
+    poolCreateInfo.poolSizeCount = 1;
+    poolCreateInfo.pPoolSizes = &poolSize;
+    pSynth->descriptorPool = make_handle<VkDescriptorPool>();
+    write_packet(synth::vkCreateDescriptorPool(pSynth->device, &poolCreateInfo, &pSynth->descriptorPool));
+
+    std::vector<VkDescriptorSetLayout> setLayouts(setCount, pSynth->setLayout);
+    VkDescriptorSetAllocateInfo setAllocateInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    setAllocateInfo.descriptorPool = pSynth->descriptorPool;
+    setAllocateInfo.descriptorSetCount = setCount;
+    setAllocateInfo.pSetLayouts = setLayouts.data();
+    pSynth->descriptorSets.resize(setCount);
+    for (VkDescriptorSet& descriptorSet : pSynth->descriptorSets) {
+        descriptorSet = make_handle<VkDescriptorSet>();
+    }
+    write_packet(trim::generate::vkAllocateDescriptorSets(false, pSynth->device, &setAllocateInfo, pSynth->descriptorSets.data()));
+}
+
+void destroy_device(SynthDevice* pSynth) {
+    write_packet(trim::generate::vkDestroyDescriptorPool(false, pSynth->device, pSynth->descriptorPool, NULL));
+    write_packet(trim::generate::vkDestroyBuffer(false, pSynth->device, pSynth->buffer, NULL));
+    write_packet(trim::generate::vkFreeMemory(false, pSynth->device, pSynth->memory, NULL));
+    write_packet(trim::generate::vkDestroyPipelineLayout(false, pSynth->device, pSynth->pipelineLayout, NULL));
+    write_packet(trim::generate::vkDestroyDescriptorSetLayout(false, pSynth->device, pSynth->setLayout, NULL));
+    destroy_command_buffer(pSynth->device, pSynth->commandPool, pSynth->commandBuffer);
+    write_packet(trim::generate::vkDestroyFence(false, pSynth->device, pSynth->fence, NULL));
+    write_packet(trim::generate::vkDestroyDevice(false, pSynth->device, NULL));
+    write_packet(trim::generate::vkDestroyInstance(false, pSynth->instance, NULL));
+}
+
+void begin_command_buffer(VkCommandBuffer commandBuffer) {
+    VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    write_packet(trim::generate::vkBeginCommandBuffer(false, commandBuffer, &beginInfo));
+}
+
+void record_draws(const SynthDevice& synth, VkCommandBuffer commandBuffer, uint32_t drawCount, uint32_t seed) {
+    write_packet(synth::vkCmdBindVertexBuffers(commandBuffer, synth.buffer, 0));
+    write_packet(synth::vkCmdBindDescriptorSets(commandBuffer, synth.pipelineLayout, 1, &synth.descriptorSets[0]));
+    uint32_t pushConstants[kPushConstantSize / sizeof(uint32_t)] = {};
+    for (uint32_t i = 0; i < drawCount; i++) {
+        pushConstants[0] = seed + i;
+        write_packet(synth::vkCmdPushConstants(commandBuffer, synth.pipelineLayout, kPushConstantSize, pushConstants));
+        write_packet(synth::vkCmdDraw(commandBuffer, 3, (i * 3) % 1024));
+    }
+}
+
+void record_descriptor_updates(const SynthDevice& synth, VkCommandBuffer commandBuffer, uint32_t frame) {
+    uint32_t setCount = (uint32_t)synth.descriptorSets.size();
+    std::vector<VkDescriptorBufferInfo> bufferInfos(setCount);
+    std::vector<VkWriteDescriptorSet> writes(setCount);
+    for (uint32_t i = 0; i < setCount; i++) {
+        bufferInfos[i].buffer = synth.buffer;
+        bufferInfos[i].offset = ((frame + i) % (synth.memorySize / 256)) * 256;
+        bufferInfos[i].range = 256;
+        writes[i] = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        writes[i].dstSet = synth.descriptorSets[i];
+        writes[i].dstBinding = 0;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        writes[i].pBufferInfo = &bufferInfos[i];
+    }
+    write_packet(trim::generate::vkUpdateDescriptorSets(false, synth.device, setCount, writes.data(), 0, NULL));
+
+    // bind every set once so the updates are used
+    write_packet(synth::vkCmdBindVertexBuffers(commandBuffer, synth.buffer, 0));
+    for (uint32_t i = 0; i < setCount; i++) {
+        write_packet(synth::vkCmdBindDescriptorSets(commandBuffer, synth.pipelineLayout, 1, &synth.descriptorSets[i]));
+        write_packet(synth::vkCmdDraw(commandBuffer, 3, 0));
+    }
+}
+
+// Flushes every other page of the mapped memory, so the package holds one changed block per page like a scattered
+// update captured with page guard would.
+void record_upload(const SynthDevice& synth, std::vector<uint8_t>* pPackage, uint32_t frame) {
+    uint32_t blockCount = (uint32_t)(synth.memorySize / (2 * kPageSize));
+    size_t infoSize = (blockCount + 1) * sizeof(PageGuardChangedBlockInfo);
+    pPackage->resize(infoSize + blockCount * kPageSize);
+
+    PageGuardChangedBlockInfo* pInfos = (PageGuardChangedBlockInfo*)pPackage->data();
+    memset(pInfos, 0, infoSize);
+    pInfos[0].offset = blockCount;
+    pInfos[0].length = (uint32_t)(blockCount * kPageSize);
+    for (uint32_t i = 0; i < blockCount; i++) {
+        pInfos[i + 1].offset = (uint32_t)(2 * i * kPageSize);
+        pInfos[i + 1].length = (uint32_t)kPageSize;
+    }
+    memset(pPackage->data() + infoSize, (int)(frame & 0xff), blockCount * kPageSize);
+
+    VkMappedMemoryRange range = {VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE};
+    range.memory = synth.memory;
+    range.offset = 0;
+    range.size = synth.memorySize;
+    write_packet(synth::vkFlushMappedMemoryRanges(synth.device, &range, pPackage->data(), pPackage->size()));
+}
+
+void submit_and_wait(const SynthDevice& synth, const std::vector<VkCommandBuffer>& commandBuffers) {
+    VkSubmitInfo submitInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submitInfo.commandBufferCount = (uint32_t)commandBuffers.size();
+    submitInfo.pCommandBuffers = commandBuffers.data();
+    write_packet(trim::generate::vkQueueSubmit(false, synth.queue, 1, &submitInfo, synth.fence));
+    write_packet(trim::generate::vkWaitForFences(false, synth.device, 1, &synth.fence, VK_TRUE, UINT64_MAX));
+    write_packet(trim::generate::vkResetFences(false, synth.device, 1, &synth.fence));
+}
+
+void write_frames(SynthDevice* pSynth, SynthShape shape) {
+    uint32_t threadCount = (shape == SYNTH_SHAPE_THREADS) ? g_settings.threads : 0;
+    std::vector<VkCommandPool> threadPools(threadCount);
+    std::vector<VkCommandBuffer> threadCommandBuffers(threadCount);
+    for (uint32_t i = 0; i < threadCount; i++) {
+        create_command_buffer(pSynth->device, &threadPools[i], &threadCommandBuffers[i]);
+    }
+
+    // the upload shape keeps the memory mapped for the whole trace, like an application streaming data would
+    std::vector<uint8_t> mappedData;
+    std::vector<uint8_t> package;
+    if (shape == SYNTH_SHAPE_UPLOAD) {
+        mappedData.resize((size_t)pSynth->memorySize);
+        void* pMappedData = mappedData.data();
+        write_packet(trim::generate::vkMapMemory(false, pSynth->device, pSynth->memory, 0, pSynth->memorySize, 0, &pMappedData));
+    }
+
+    for (uint32_t frame = 0; frame < g_settings.frames; frame++) {
+        std::vector<VkCommandBuffer> submitted;
+        if (shape == SYNTH_SHAPE_THREADS) {
+            // each thread records its share of the draws into its own command buffer, with packets interleaved in the
+            // trace the same way they are when an application records in parallel
+            std::vector<std::thread> threads;
+            for (uint32_t i = 0; i < threadCount; i++) {
+                threads.push_back(std::thread([pSynth, &threadCommandBuffers, i, frame, threadCount]() {
+                    begin_command_buffer(threadCommandBuffers[i]);
+                    record_draws(*pSynth, threadCommandBuffers[i], g_settings.work_per_frame / threadCount, frame * 1000 + i);
+                    write_packet(trim::generate::vkEndCommandBuffer(false, threadCommandBuffers[i]));
+                }));
+            }
+            for (std::thread& thread : threads) {
+                thread.join();
+            }
+            submitted = threadCommandBuffers;
+        } else {
+            begin_command_buffer(pSynth->commandBuffer);
+            if (shape == SYNTH_SHAPE_DRAW) {
+                record_draws(*pSynth, pSynth->commandBuffer, g_settings.work_per_frame, frame);
+            } else if (shape == SYNTH_SHAPE_DESCRIPTOR) {
+                record_descriptor_updates(*pSynth, pSynth->commandBuffer, frame);
+            } else {
+                record_upload(*pSynth, &package, frame);
+                record_draws(*pSynth, pSynth->commandBuffer, 1, frame);
+            }
+            write_packet(trim::generate::vkEndCommandBuffer(false, pSynth->commandBuffer));
+            submitted.push_back(pSynth->commandBuffer);
+        }
+        submit_and_wait(*pSynth, submitted);
+    }
+
+    if (shape == SYNTH_SHAPE_UPLOAD) {
+        write_packet(trim::generate::vkUnmapMemory(false, pSynth->memorySize, mappedData.data(), pSynth->device, pSynth->memory));
+    }
+    for (uint32_t i = 0; i < threadCount; i++) {
+        destroy_command_buffer(pSynth->device, threadPools[i], threadCommandBuffers[i]);
+    }
+}
+
+bool parse_shape(const char* pShape, SynthShape* pOut) {
+    const char* const kShapeNames[] = {"draw", "descriptor", "upload", "threads"};
+    for (uint32_t i = 0; i < sizeof(kShapeNames) / sizeof(kShapeNames[0]); i++) {
+        if (strcmp(pShape, kShapeNames[i]) == 0) {
+            *pOut = (SynthShape)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void loggingCallback(VktraceLogLevel level, const char* pMessage) {
+    if (level == VKTRACE_LOG_NONE) return;
+    printf("vktrace_synth: %s\n", pMessage);
+    fflush(stdout);
+}
+
+// ------------------------------------------------------------------------------------------------
+int main(int argc, char* argv[]) {
+    vktrace_LogSetCallback(loggingCallback);
+    vktrace_LogSetLevel(VKTRACE_LOG_ERROR);
+
+    memset(&g_settings, 0, sizeof(vktrace_synth_settings));
+    memset(&g_default_settings, 0, sizeof(vktrace_synth_settings));
+    g_default_settings.shape = vktrace_allocate_and_copy("draw");
+    g_default_settings.frames = 100;
+    g_default_settings.work_per_frame = 1000;
+    g_default_settings.upload_kb = 4096;
+    g_default_settings.threads = 4;
+
+    if (vktrace_SettingGroup_init(&g_settingGroup, NULL, argc, argv, NULL) != 0) {
+        vktrace_SettingGroup_print(&g_settingGroup);
+        return -1;
+    }
+
+    SynthShape shape;
+    if (g_settings.output_trace == NULL || strlen(g_settings.output_trace) == 0) {
+        vktrace_LogError("No output trace file specified.");
+        vktrace_SettingGroup_print(&g_settingGroup);
+        vktrace_SettingGroup_delete(&g_settingGroup);
+        return -1;
+    }
+    if (!parse_shape(g_settings.shape, &shape)) {
+        vktrace_LogError("Unknown trace shape %s.", g_settings.shape);
+        vktrace_SettingGroup_print(&g_settingGroup);
+        vktrace_SettingGroup_delete(&g_settingGroup);
+        return -1;
+    }
+    if (g_settings.threads == 0 || g_settings.upload_kb == 0) {
+        vktrace_LogError("Threads and UploadKB must be greater than 0.");
+        vktrace_SettingGroup_print(&g_settingGroup);
+        vktrace_SettingGroup_delete(&g_settingGroup);
+        return -1;
+    }
+
+    FILE* pFile = fopen(g_settings.output_trace, "wb");
+    if (pFile == NULL) {
+        vktrace_LogError("Unable to open %s for writing.", g_settings.output_trace);
+        vktrace_SettingGroup_delete(&g_settingGroup);
+        return -1;
+    }
+    g_pTraceFile = vktrace_FileLike_create_file(pFile);
+    vktrace_initialize_trace_packet_utils();
+
+    int exitval = 0;
+    if (!write_trace_file_header()) {
+        vktrace_LogError("Unable to write the trace file header.");
+        exitval = 1;
+    } else {
+        SynthDevice synth;
+        write_packet(synth::vkApiVersion());
+        create_device(&synth, shape);
+        write_frames(&synth, shape);
+        destroy_device(&synth);
+        vktrace_LogAlways("Wrote %u frames of the %s shape to %s.", g_settings.frames, g_settings.shape, g_settings.output_trace);
+    }
+
+    vktrace_deinitialize_trace_packet_utils();
+    vktrace_free(g_pTraceFile);
+    fclose(pFile);
+    vktrace_SettingGroup_delete(&g_settingGroup);
+    return exitval;
+}
@@ -411,6 +411,10 @@ typedef enum _VKTRACE_TRACE_PACKET_ID_VK {
     VKTRACE_TPI_VK_vkCmdPreprocessGeneratedCommandsNV = 333,
     VKTRACE_TPI_VK_vkCmdExecuteGeneratedCommandsNV = 334,
     VKTRACE_TPI_VK_vkCmdBindPipelineShaderGroupNV = 335,
+
+    // Ids from 0xF000 up are reserved for packets that aren't Vulkan calls, so that new entrypoints can keep taking the
+    // next id above.
+    VKTRACE_TPI_VK_CommandBatch = 0xF000,  // consecutive vkCmd* calls, see vktrace_trace_packet_command_batch
 } VKTRACE_TRACE_PACKET_ID_VK;
 
 #define VKTRACE_BIG_ENDIAN 1
@@ -489,6 +493,27 @@ typedef struct {
     char* label;
 } vktrace_trace_packet_marker_checkpoint;
 
+// Body of a VKTRACE_TPI_VK_CommandBatch packet, written by the trace layer in place of the packets of consecutive vkCmd* calls.
+// The vktrace process expands it back into those packets before writing the trace file. It is followed by a
+// vktrace_trace_packet_command_batch_call for each call, each followed by the body of the packet of the call. The header of
+// the packet of a call is rebuilt from the deltas in its record.
+typedef struct {
+    ALIGN8 uint64_t packet_index;  // global_packet_index of the first call
+    ALIGN8 uint64_t begin_time;    // entrypoint_begin_time of the first call
+    uint32_t call_count;
+    uint32_t reserved;
+} vktrace_trace_packet_command_batch;
+
+typedef struct {
+    uint32_t size;  // of the record and the packet body that follows it, a multiple of 8
+    uint16_t packet_id;
+    uint16_t reserved;
+    uint32_t thread_id;
+    uint32_t packet_index_delta;  // from the previous call, or from packet_index of the batch for the first call
+    uint32_t begin_time_delta;    // from the end of the previous call, or from begin_time of the batch for the first call
+    uint32_t call_time;           // entrypoint_end_time - entrypoint_begin_time
+} vktrace_trace_packet_command_batch_call;
+
 typedef vktrace_trace_packet_marker_checkpoint vktrace_trace_packet_marker_api_boundary;
 typedef vktrace_trace_packet_marker_checkpoint vktrace_trace_packet_marker_api_group_begin;
 typedef vktrace_trace_packet_marker_checkpoint vktrace_trace_packet_marker_api_group_end;
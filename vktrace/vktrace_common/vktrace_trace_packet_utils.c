@@ -34,9 +34,15 @@
 #if defined(PLATFORM_LINUX) || defined(PLATFORM_OSX)
 #include <fcntl.h>
 #include <time.h>
+#include <sys/mman.h>
 #include <sys/utsname.h>
 #endif
 
+#if defined(PLATFORM_LINUX) && defined(__x86_64__)
+#include <ctype.h>
+#include <x86intrin.h>
+#endif
+
 #if defined(PLATFORM_OSX)
 #include <mach/clock.h>
 #include <mach/mach.h>
@@ -45,31 +51,22 @@
 #include "vk_struct_size_helper.c"
 #include "vktrace_pageguard_memorycopy.h"
 
-static VKTRACE_CRITICAL_SECTION s_packet_index_lock;
 static VKTRACE_CRITICAL_SECTION s_trace_lock;
 
-void vktrace_initialize_trace_packet_utils() {
-    vktrace_create_critical_section(&s_packet_index_lock);
-    vktrace_create_critical_section(&s_trace_lock);
-}
+void vktrace_initialize_trace_packet_utils() { vktrace_create_critical_section(&s_trace_lock); }
 
-void vktrace_deinitialize_trace_packet_utils() {
-    vktrace_delete_critical_section(&s_packet_index_lock);
-    vktrace_delete_critical_section(&s_trace_lock);
-}
+void vktrace_deinitialize_trace_packet_utils() { vktrace_delete_critical_section(&s_trace_lock); }
 
 uint64_t vktrace_get_unique_packet_index() {
     // Keep the s_packet_index scope to within this method, to ensure this method is always used to get a unique packet index.
-    static uint64_t s_packet_index = 0;
+    static volatile uint64_t s_packet_index = 0;
 
-    vktrace_enter_critical_section(&s_packet_index_lock);
-    // Store the value then increment within the critical section to avoid race conditions.
-    uint64_t index = s_packet_index;
-    s_packet_index += 1;
-    vktrace_leave_critical_section(&s_packet_index_lock);
-
-    // Return the stored value rather than the actual variable (again to avoid race conditions).
-    return index;
+    // The index is taken with a single atomic increment, which returns the value before the increment.
+#if defined(WIN32)
+    return (uint64_t)InterlockedIncrement64((volatile LONG64*)&s_packet_index) - 1;
+#else
+    return __atomic_fetch_add(&s_packet_index, 1, __ATOMIC_RELAXED);
+#endif
 }
 
 void vktrace_gen_uuid(uint32_t* pUuid) {
@@ -83,11 +80,167 @@ void vktrace_gen_uuid(uint32_t* pUuid) {
 }
 
 #if defined(PLATFORM_LINUX)
-uint64_t vktrace_get_time() {
+// CLOCK_MONOTONIC_RAW isn't slewed by NTP, so it runs at the same rate as the TSC timestamps calibrated against it, and
+// is read through the vDSO without a system call.
+static uint64_t vktrace_get_raw_time() {
     struct timespec time;
-    clock_gettime(CLOCK_MONOTONIC, &time);
+    clock_gettime(CLOCK_MONOTONIC_RAW, &time);
     return ((uint64_t)time.tv_sec * 1000000000) + time.tv_nsec;
 }
+
+#if defined(__x86_64__)
+//  TSC timestamps
+//
+//     When the VKTRACE_TSC_TIMESTAMPS env var is set to 1, timestamps are read from the TSC, which costs a fraction of
+//     a clock_gettime() call, and converted to nanoseconds on the CLOCK_MONOTONIC_RAW timeline. The TSC is only used if
+//     it is invariant, that is it runs at a constant rate in every power state, and if the kernel keeps it as its
+//     clocksource, which it only does while the TSCs of all cores are synchronized; otherwise timestamps fall back to
+//     CLOCK_MONOTONIC_RAW.
+//
+//     The scale is calibrated without stalling the application: the first timestamp records a TSC and clock pair, the
+//     timestamps that follow are read from the clock, and the first one taken after the calibration time has passed
+//     records the second pair and switches to the TSC.
+#define VKTRACE_TSC_TIMESTAMPS_ENV "VKTRACE_TSC_TIMESTAMPS"
+#define VKTRACE_TSC_CALIBRATION_TIME 20000000
+
+typedef enum {
+    VKTRACE_TSC_UNINITIALIZED = 0,
+    VKTRACE_TSC_CALIBRATING,
+    VKTRACE_TSC_FINISHING_CALIBRATION,
+    VKTRACE_TSC_ENABLED,
+    VKTRACE_TSC_DISABLED,
+} VKTRACE_TSC_STATE;
+
+static pthread_once_t s_tsc_once = PTHREAD_ONCE_INIT;
+static int s_tsc_state = VKTRACE_TSC_UNINITIALIZED;
+// TSC and clock read when the calibration started
+static uint64_t s_tsc_calibration_tsc = 0;
+static uint64_t s_tsc_calibration_time = 0;
+// A TSC value tsc is converted to base_time + ((tsc - base) * mult) >> 32 nanoseconds.
+static uint64_t s_tsc_base = 0;
+static uint64_t s_tsc_base_time = 0;
+static uint64_t s_tsc_mult = 0;
+
+// Returns whether the line of /proc/cpuinfo that lists the flags of the first core has the given flag.
+static BOOL vktrace_cpuinfo_has_flag(const char* pFlags, const char* pFlag) {
+    size_t length = strlen(pFlag);
+    const char* pFound = pFlags;
+    while ((pFound = strstr(pFound, pFlag)) != NULL) {
+        if ((pFound == pFlags || isspace((unsigned char)pFound[-1])) &&
+            (pFound[length] == '\0' || isspace((unsigned char)pFound[length]))) {
+            return TRUE;
+        }
+        pFound += length;
+    }
+    return FALSE;
+}
+
+// The kernel reports an invariant TSC as the constant_tsc and nonstop_tsc flags. It checks at boot that the TSCs of all
+// cores are synchronized, and only keeps the TSC as its clocksource if they are and stay so.
+static BOOL vktrace_tsc_is_reliable() {
+    char clocksource[16] = {0};
+    FILE* pFile = fopen("/sys/devices/system/clocksource/clocksource0/current_clocksource", "r");
+    if (pFile == NULL) {
+        return FALSE;
+    }
+    BOOL kernelTsc = fgets(clocksource, sizeof(clocksource), pFile) != NULL && strcmp(clocksource, "tsc\n") == 0;
+    fclose(pFile);
+    if (!kernelTsc) {
+        return FALSE;
+    }
+
+    pFile = fopen("/proc/cpuinfo", "r");
+    if (pFile == NULL) {
+        return FALSE;
+    }
+    BOOL invariant = FALSE;
+    char line[4096];
+    while (fgets(line, sizeof(line), pFile) != NULL) {
+        if (strncmp(line, "flags", 5) == 0) {
+            invariant = vktrace_cpuinfo_has_flag(line, "constant_tsc") && vktrace_cpuinfo_has_flag(line, "nonstop_tsc");
+            break;
+        }
+    }
+    fclose(pFile);
+    return invariant;
+}
+
+// Reads the TSC on both sides of the clock, so that the pair is apart by half of the clock read at most. The quickest of a
+// few reads is kept, as the first clock read of a process is slowed down by cold caches.
+static void vktrace_read_tsc_and_time(uint64_t* pTsc, uint64_t* pTime) {
+    uint64_t shortest = UINT64_MAX;
+    int i;
+    for (i = 0; i < 8; i++) {
+        uint64_t before = __rdtsc();
+        uint64_t time = vktrace_get_raw_time();
+        uint64_t after = __rdtsc();
+        if (after - before < shortest) {
+            shortest = after - before;
+            *pTsc = before + (after - before) / 2;
+            *pTime = time;
+        }
+    }
+}
+
+static void vktrace_tsc_initialize() {
+    int state = VKTRACE_TSC_DISABLED;
+    const char* env_tsc = vktrace_get_global_var(VKTRACE_TSC_TIMESTAMPS_ENV);
+    if (env_tsc != NULL && strcmp(env_tsc, "1") == 0) {
+        if (!vktrace_tsc_is_reliable()) {
+            vktrace_LogWarning("The TSC is not invariant or not synchronized across cores, TSC timestamps are disabled.");
+        } else {
+            vktrace_read_tsc_and_time(&s_tsc_calibration_tsc, &s_tsc_calibration_time);
+            state = VKTRACE_TSC_CALIBRATING;
+        }
+    }
+    __atomic_store_n(&s_tsc_state, state, __ATOMIC_RELEASE);
+}
+
+// Computes the scale from the TSC and clock pair read now and the one read when the calibration started. Only the thread
+// that moves the state out of calibrating does it; the others keep reading the clock until the TSC is enabled.
+static void vktrace_tsc_finish_calibration() {
+    int expected = VKTRACE_TSC_CALIBRATING;
+    if (!__atomic_compare_exchange_n(&s_tsc_state, &expected, VKTRACE_TSC_FINISHING_CALIBRATION, FALSE, __ATOMIC_ACQUIRE,
+                                     __ATOMIC_RELAXED)) {
+        return;
+    }
+
+    uint64_t tsc, time;
+    vktrace_read_tsc_and_time(&tsc, &time);
+    int state = VKTRACE_TSC_DISABLED;
+    if (tsc > s_tsc_calibration_tsc && time > s_tsc_calibration_time) {
+        s_tsc_mult =
+            (uint64_t)((((unsigned __int128)(time - s_tsc_calibration_time)) << 32) / (tsc - s_tsc_calibration_tsc));
+        s_tsc_base = tsc;
+        s_tsc_base_time = time;
+        state = VKTRACE_TSC_ENABLED;
+    }
+    __atomic_store_n(&s_tsc_state, state, __ATOMIC_RELEASE);
+}
+#endif
+
+uint64_t vktrace_get_time() {
+#if defined(__x86_64__)
+    int state = __atomic_load_n(&s_tsc_state, __ATOMIC_ACQUIRE);
+    if (state == VKTRACE_TSC_UNINITIALIZED) {
+        pthread_once(&s_tsc_once, vktrace_tsc_initialize);
+        state = __atomic_load_n(&s_tsc_state, __ATOMIC_ACQUIRE);
+    }
+    if (state == VKTRACE_TSC_ENABLED) {
+        // A core may read a TSC slightly behind the calibration, so the difference is signed.
+        __int128 ticks = (int64_t)(__rdtsc() - s_tsc_base);
+        return s_tsc_base_time + (uint64_t)((ticks * (__int128)s_tsc_mult) >> 32);
+    }
+    if (state == VKTRACE_TSC_CALIBRATING) {
+        uint64_t time = vktrace_get_raw_time();
+        if (time - s_tsc_calibration_time < VKTRACE_TSC_CALIBRATION_TIME) {
+            return time;
+        }
+        vktrace_tsc_finish_calibration();
+    }
+#endif
+    return vktrace_get_raw_time();
+}
 #elif defined(PLATFORM_OSX)
 uint64_t vktrace_get_time() {
     clock_serv_t cclock;
@@ -185,18 +338,140 @@ uint64_t get_os() {
 }
 
 //=============================================================================
-// Methods for creating, populating, and writing trace packets
+// Packet arena
+//
+// Packets created by vktrace_create_arena_trace_packet live in a single arena that reserves address space for the largest
+// packet up front and commits it as the packet grows, so that the packet never moves and the pointers to its buffers stay
+// valid while buffers are added. The arena holds one packet at a time, which the trace lock serializes.
+//
+// A packet that outgrows the arena doesn't move either: the buffers that don't fit are spilled into heap allocations of
+// their own, at the offsets they would have had in the packet. vktrace_finalize_buffer_address turns pointers into spilled
+// buffers into those offsets, and vktrace_write_trace_packet copies the packet and its spilled buffers into a single heap
+// packet to write it, so a spilled packet is written the same as any other.
 
-vktrace_trace_packet_header* vktrace_create_trace_packet(uint8_t tracer_id, uint16_t packet_id, uint64_t packet_size,
-                                                         uint64_t additional_buffers_size) {
-    vktrace_enter_critical_section(&s_trace_lock);
-    // Always allocate at least enough space for the packet header
-    uint64_t total_packet_size =
-        ROUNDUP_TO_8(sizeof(vktrace_trace_packet_header) + ROUNDUP_TO_8(packet_size) + additional_buffers_size);
-    void* pMemory = vktrace_malloc((size_t)total_packet_size);
-    memset(pMemory, 0, (size_t)total_packet_size);
+#define VKTRACE_PACKET_ARENA_RESERVE_SIZE (sizeof(void*) == 8 ? (uint64_t)1024 * 1024 * 1024 : (uint64_t)64 * 1024 * 1024)
+#define VKTRACE_PACKET_ARENA_COMMIT_SIZE ((uint64_t)1024 * 1024)
+#define VKTRACE_PACKET_ARENA_KEEP_SIZE ((uint64_t)4 * 1024 * 1024)
 
-    vktrace_trace_packet_header* pHeader = (vktrace_trace_packet_header*)pMemory;
+typedef struct {
+    char* pBuffer;
+    uint64_t offset;  // from the start of the packet
+    uint64_t size;
+} vktrace_packet_arena_spill;
+
+typedef struct {
+    char* pBase;
+    uint64_t committed;
+    BOOL inUse;
+    BOOL failed;
+
+    // buffers of the current packet that didn't fit in the arena, in order of their offsets
+    vktrace_packet_arena_spill* pSpills;
+    uint32_t spillCount;
+    uint32_t spillCapacity;
+} vktrace_packet_arena;
+
+static vktrace_packet_arena s_packet_arena;
+
+// Commits the first size bytes of the arena, reserving it on first use.
+static BOOL vktrace_packet_arena_commit(uint64_t size) {
+    if (size > VKTRACE_PACKET_ARENA_RESERVE_SIZE || s_packet_arena.failed) {
+        return FALSE;
+    }
+    if (s_packet_arena.pBase == NULL) {
+#if defined(WIN32)
+        s_packet_arena.pBase = (char*)VirtualAlloc(NULL, (size_t)VKTRACE_PACKET_ARENA_RESERVE_SIZE, MEM_RESERVE, PAGE_READWRITE);
+#else
+        void* pBase = mmap(NULL, (size_t)VKTRACE_PACKET_ARENA_RESERVE_SIZE, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        s_packet_arena.pBase = (pBase != MAP_FAILED) ? (char*)pBase : NULL;
+#endif
+        if (s_packet_arena.pBase == NULL) {
+            vktrace_LogWarning("Failed to reserve the packet arena, packet sizes will be computed ahead of time.");
+            s_packet_arena.failed = TRUE;
+            return FALSE;
+        }
+    }
+    if (size > s_packet_arena.committed) {
+        uint64_t committed =
+            (size + VKTRACE_PACKET_ARENA_COMMIT_SIZE - 1) / VKTRACE_PACKET_ARENA_COMMIT_SIZE * VKTRACE_PACKET_ARENA_COMMIT_SIZE;
+        if (committed > VKTRACE_PACKET_ARENA_RESERVE_SIZE) {
+            committed = VKTRACE_PACKET_ARENA_RESERVE_SIZE;
+        }
+#if defined(WIN32)
+        if (VirtualAlloc(s_packet_arena.pBase + s_packet_arena.committed, (size_t)(committed - s_packet_arena.committed),
+                         MEM_COMMIT, PAGE_READWRITE) == NULL) {
+            return FALSE;
+        }
+#endif
+        s_packet_arena.committed = committed;
+    }
+    return TRUE;
+}
+
+// Allocates a buffer of byteCount bytes for the packet in the arena outside of the arena, at the end of the packet.
+static void* vktrace_packet_arena_spill_buffer(vktrace_trace_packet_header* pHeader, uint64_t byteCount) {
+    if (s_packet_arena.spillCount == s_packet_arena.spillCapacity) {
+        uint32_t capacity = (s_packet_arena.spillCapacity == 0) ? 16 : 2 * s_packet_arena.spillCapacity;
+        vktrace_packet_arena_spill* pSpills = (vktrace_packet_arena_spill*)vktrace_realloc(
+            s_packet_arena.pSpills, (size_t)capacity * sizeof(vktrace_packet_arena_spill));
+        if (pSpills == NULL) {
+            return NULL;
+        }
+        s_packet_arena.pSpills = pSpills;
+        s_packet_arena.spillCapacity = capacity;
+    }
+
+    char* pBuffer = (char*)vktrace_malloc((size_t)byteCount);
+    if (pBuffer == NULL) {
+        return NULL;
+    }
+    memset(pBuffer, 0, (size_t)byteCount);
+
+    vktrace_packet_arena_spill* pSpill = &s_packet_arena.pSpills[s_packet_arena.spillCount++];
+    pSpill->pBuffer = pBuffer;
+    pSpill->offset = pHeader->next_buffers_offset;
+    pSpill->size = byteCount;
+    pHeader->next_buffers_offset += byteCount;
+    pHeader->size = ROUNDUP_TO_8(pHeader->next_buffers_offset);
+    return pBuffer;
+}
+
+// Returns the spilled buffer of the packet in the arena that holds ptr, or NULL if ptr isn't in a spilled buffer.
+static const vktrace_packet_arena_spill* vktrace_packet_arena_find_spill(const void* ptr) {
+    for (uint32_t i = 0; i < s_packet_arena.spillCount; i++) {
+        const vktrace_packet_arena_spill* pSpill = &s_packet_arena.pSpills[i];
+        if ((const char*)ptr >= pSpill->pBuffer && (const char*)ptr < pSpill->pBuffer + pSpill->size) {
+            return pSpill;
+        }
+    }
+    return NULL;
+}
+
+// Ends the use of the arena by its packet, and gives the memory committed for a large packet back to the system.
+static void vktrace_packet_arena_release() {
+    s_packet_arena.inUse = FALSE;
+    for (uint32_t i = 0; i < s_packet_arena.spillCount; i++) {
+        vktrace_free(s_packet_arena.pSpills[i].pBuffer);
+    }
+    s_packet_arena.spillCount = 0;
+    if (s_packet_arena.committed > VKTRACE_PACKET_ARENA_KEEP_SIZE) {
+#if defined(WIN32)
+        VirtualFree(s_packet_arena.pBase + VKTRACE_PACKET_ARENA_KEEP_SIZE,
+                    (size_t)(s_packet_arena.committed - VKTRACE_PACKET_ARENA_KEEP_SIZE), MEM_DECOMMIT);
+#else
+        madvise(s_packet_arena.pBase + VKTRACE_PACKET_ARENA_KEEP_SIZE,
+                (size_t)(s_packet_arena.committed - VKTRACE_PACKET_ARENA_KEEP_SIZE), MADV_DONTNEED);
+#endif
+        s_packet_arena.committed = VKTRACE_PACKET_ARENA_KEEP_SIZE;
+    }
+}
+
+//=============================================================================
+// Methods for creating, populating, and writing trace packets
+
+static void vktrace_init_trace_packet_header(vktrace_trace_packet_header* pHeader, uint8_t tracer_id, uint16_t packet_id,
+                                             uint64_t packet_size, uint64_t total_packet_size) {
     pHeader->size = total_packet_size;
     pHeader->global_packet_index = vktrace_get_unique_packet_index();
     pHeader->tracer_id = tracer_id;
@@ -214,11 +489,43 @@ vktrace_trace_packet_header* vktrace_create_trace_packet(uint8_t tracer_id, uint
                                                                // Assuming the content of the buffer has expected alignment of the
                                                                // tracing platform.
     if (total_packet_size > sizeof(vktrace_trace_packet_header)) {
-        pHeader->pBody = (uintptr_t)(((char*)pMemory) + sizeof(vktrace_trace_packet_header));
+        pHeader->pBody = (uintptr_t)(((char*)pHeader) + sizeof(vktrace_trace_packet_header));
     }
+}
+
+vktrace_trace_packet_header* vktrace_create_trace_packet(uint8_t tracer_id, uint16_t packet_id, uint64_t packet_size,
+                                                         uint64_t additional_buffers_size) {
+    vktrace_enter_critical_section(&s_trace_lock);
+    // Always allocate at least enough space for the packet header
+    uint64_t total_packet_size =
+        ROUNDUP_TO_8(sizeof(vktrace_trace_packet_header) + ROUNDUP_TO_8(packet_size) + additional_buffers_size);
+    void* pMemory = vktrace_malloc((size_t)total_packet_size);
+    memset(pMemory, 0, (size_t)total_packet_size);
+
+    vktrace_trace_packet_header* pHeader = (vktrace_trace_packet_header*)pMemory;
+    vktrace_init_trace_packet_header(pHeader, tracer_id, packet_id, packet_size, total_packet_size);
+    return pHeader;
+}
+
+vktrace_trace_packet_header* vktrace_create_arena_trace_packet(uint8_t tracer_id, uint16_t packet_id, uint64_t packet_size) {
+    vktrace_enter_critical_section(&s_trace_lock);
+    uint64_t total_packet_size = sizeof(vktrace_trace_packet_header) + ROUNDUP_TO_8(packet_size);
+    if (s_packet_arena.inUse || !vktrace_packet_arena_commit(total_packet_size)) {
+        vktrace_leave_critical_section(&s_trace_lock);
+        return NULL;
+    }
+    s_packet_arena.inUse = TRUE;
+    memset(s_packet_arena.pBase, 0, (size_t)total_packet_size);
+
+    vktrace_trace_packet_header* pHeader = (vktrace_trace_packet_header*)s_packet_arena.pBase;
+    vktrace_init_trace_packet_header(pHeader, tracer_id, packet_id, packet_size, total_packet_size);
     return pHeader;
 }
 
+BOOL vktrace_trace_packet_has_spilled_buffers(const vktrace_trace_packet_header* pHeader) {
+    return (const char*)pHeader == s_packet_arena.pBase && s_packet_arena.spillCount > 0;
+}
+
 // Delete packet after vktrace_create_trace_packet being called.
 void vktrace_delete_trace_packet(vktrace_trace_packet_header** ppHeader) {
     vktrace_delete_trace_packet_no_lock(ppHeader);
@@ -230,6 +537,20 @@ void* vktrace_trace_packet_get_new_buffer_address(vktrace_trace_packet_header* p
     void* pBufferStart;
     assert(byteCount > 0);
     assert((byteCount & 0x3) == 0);  // All buffer sizes should be multiple of 4 so structs in packet are kept aligned
+    if ((char*)pHeader == s_packet_arena.pBase) {
+        // packets in the arena grow to hold their buffers, and spill the buffers that don't fit along with all that follow
+        if (s_packet_arena.spillCount > 0) {
+            return vktrace_packet_arena_spill_buffer(pHeader, byteCount);
+        }
+        if (pHeader->size < pHeader->next_buffers_offset + byteCount) {
+            uint64_t size = ROUNDUP_TO_8(pHeader->next_buffers_offset + byteCount);
+            if (!vktrace_packet_arena_commit(size)) {
+                return vktrace_packet_arena_spill_buffer(pHeader, byteCount);
+            }
+            memset((char*)pHeader + pHeader->size, 0, (size_t)(size - pHeader->size));
+            pHeader->size = size;
+        }
+    }
     assert(pHeader->size >= pHeader->next_buffers_offset + byteCount);
     if (pHeader->size < pHeader->next_buffers_offset + byteCount || byteCount == 0) {
         // not enough memory left in packet to hold buffer
@@ -271,134 +592,100 @@ void vktrace_finalize_buffer_address(vktrace_trace_packet_header* pHeader, void*
     if (*ptr_address != NULL) {
         // turn ptr into an offset from the packet body
         uint64_t offset = (uint64_t)*ptr_address - (uint64_t)(pHeader->pBody);
+        if (vktrace_trace_packet_has_spilled_buffers(pHeader)) {
+            const vktrace_packet_arena_spill* pSpill = vktrace_packet_arena_find_spill(*ptr_address);
+            if (pSpill != NULL) {
+                offset = pSpill->offset - sizeof(vktrace_trace_packet_header) + ((char*)*ptr_address - pSpill->pBuffer);
+            }
+        }
         *ptr_address = (void*)offset;
     }
 }
 
-#define AddPointerWithCountToTracebuffer(_sName, _sType, _sPtr, _sCount)                 \
-    do {                                                                                 \
-        void* pSrc = (void*)(((_sName*)pInNext)->_sPtr);                                 \
-        void** pDst = (void**)&(((_sName*)*ppOutNext)->_sPtr);                           \
-        uint32_t count = ((_sName*)*ppOutNext)->_sCount;                                 \
-        vktrace_add_buffer_to_trace_packet(pHeader, pDst, sizeof(_sType) * count, pSrc); \
-        vktrace_finalize_buffer_address(pHeader, pDst);                                  \
-    } while (0)
+// Returns the number of elements that the member described by pMember of the struct at struct_ptr points to.
+static uint64_t vktrace_get_struct_member_count(const void* struct_ptr, const struct_member_info* pMember) {
+    const char* pCount = (const char*)struct_ptr + pMember->count_offset;
+    uint64_t count;
+    switch (pMember->kind) {
+        case STRUCT_MEMBER_ARRAY:
+            switch (pMember->count_size) {
+                case sizeof(uint64_t):
+                    count = *(const uint64_t*)pCount;
+                    break;
+                case sizeof(uint16_t):
+                    count = *(const uint16_t*)pCount;
+                    break;
+                case sizeof(uint8_t):
+                    count = *(const uint8_t*)pCount;
+                    break;
+                default:
+                    count = *(const uint32_t*)pCount;
+                    break;
+            }
+            return (count + pMember->count_divisor - 1) / pMember->count_divisor;
+        case STRUCT_MEMBER_STRING: {
+            const char* pString = *(const char* const*)((const char*)struct_ptr + pMember->offset);
+            return (pString != NULL) ? strlen(pString) + 1 : 0;
+        }
+        default:
+            return 1;
+    }
+}
+
+static void vktrace_add_struct_members_to_trace_packet(vktrace_trace_packet_header* pHeader, void* pOut, const void* pIn,
+                                                       const struct_info* pInfo);
+
+// Adds the data pointed to by a struct that is an element of another struct, including its pNext chain.
+static void vktrace_add_struct_element_to_trace_packet(vktrace_trace_packet_header* pHeader, void* pOut, const void* pIn,
+                                                       const struct_info* pInfo) {
+    if (pInfo->has_pnext) {
+        vktrace_add_pnext_structs_to_trace_packet(pHeader, pOut, pIn);
+    }
+    vktrace_add_struct_members_to_trace_packet(pHeader, pOut, pIn, pInfo);
+}
+
+// Adds the data pointed to by the members of the struct pIn, already copied to pOut, that pInfo describes.
+static void vktrace_add_struct_members_to_trace_packet(vktrace_trace_packet_header* pHeader, void* pOut, const void* pIn,
+                                                       const struct_info* pInfo) {
+    uint32_t i;
+    uint64_t j, count;
+    for (i = 0; i < pInfo->member_count; i++) {
+        const struct_member_info* pMember = &pInfo->pMembers[i];
+        void* pMemberOut = (char*)pOut + pMember->offset;
+        const void* pMemberIn = (const char*)pIn + pMember->offset;
+        if (pMember->kind == STRUCT_MEMBER_INLINE) {
+            vktrace_add_struct_element_to_trace_packet(pHeader, pMemberOut, pMemberIn, pMember->pElementInfo);
+            continue;
+        }
+
+        void** ppElementsOut = (void**)pMemberOut;
+        const char* pElementsIn = *(const char* const*)pMemberIn;
+        count = vktrace_get_struct_member_count(pIn, pMember);
+        vktrace_add_buffer_to_trace_packet(pHeader, ppElementsOut, count * pMember->element_size, pElementsIn);
+        if (*ppElementsOut != NULL && pMember->pElementInfo != NULL) {
+            for (j = 0; j < count; j++) {
+                vktrace_add_struct_element_to_trace_packet(pHeader, (char*)*ppElementsOut + j * pMember->element_size,
+                                                           pElementsIn + j * pMember->element_size, pMember->pElementInfo);
+            }
+        }
+        vktrace_finalize_buffer_address(pHeader, ppElementsOut);
+    }
+}
 
 void vktrace_add_pnext_structs_to_trace_packet(vktrace_trace_packet_header* pHeader, void* pOut, const void* pIn) {
     void** ppOutNext;
     const void* pInNext;
+    const struct_info* pInfo;
     if (!pIn) return;
     // Add the pNext chain to trace packet.
     while (((VkApplicationInfo*)pIn)->pNext) {
         ppOutNext = (void**)&(((VkApplicationInfo*)pOut)->pNext);
         pInNext = (void*)((VkApplicationInfo*)pIn)->pNext;
-        size_t size = get_struct_size(pInNext);
-        if (size > 0) {
-            vktrace_add_buffer_to_trace_packet(pHeader, ppOutNext, size, pInNext);
-            // TODO: Might be able codegen this switch statement
-            switch (((VkApplicationInfo*)*ppOutNext)->sType) {
-                case VK_STRUCTURE_TYPE_DEVICE_GROUP_DEVICE_CREATE_INFO:
-                    AddPointerWithCountToTracebuffer(VkDeviceGroupDeviceCreateInfo, VkPhysicalDevice, pPhysicalDevices,
-                                                     physicalDeviceCount);
-                    break;
-                case VK_STRUCTURE_TYPE_DEVICE_GROUP_RENDER_PASS_BEGIN_INFO:
-                    AddPointerWithCountToTracebuffer(VkDeviceGroupRenderPassBeginInfo, VkRect2D, pDeviceRenderAreas,
-                                                     deviceRenderAreaCount);
-                    break;
-                case VK_STRUCTURE_TYPE_DEVICE_GROUP_SUBMIT_INFO:
-                    AddPointerWithCountToTracebuffer(VkDeviceGroupSubmitInfo, uint32_t, pWaitSemaphoreDeviceIndices,
-                                                     waitSemaphoreCount);
-                    AddPointerWithCountToTracebuffer(VkDeviceGroupSubmitInfo, uint32_t, pCommandBufferDeviceMasks,
-                                                     commandBufferCount);
-                    AddPointerWithCountToTracebuffer(VkDeviceGroupSubmitInfo, uint32_t, pSignalSemaphoreDeviceIndices,
-                                                     signalSemaphoreCount);
-                    break;
-                case VK_STRUCTURE_TYPE_BIND_BUFFER_MEMORY_DEVICE_GROUP_INFO:
-                    AddPointerWithCountToTracebuffer(VkBindBufferMemoryDeviceGroupInfo, uint32_t, pDeviceIndices, deviceIndexCount);
-                    break;
-                case VK_STRUCTURE_TYPE_BIND_IMAGE_MEMORY_DEVICE_GROUP_INFO:
-                    AddPointerWithCountToTracebuffer(VkBindImageMemoryDeviceGroupInfo, uint32_t, pDeviceIndices, deviceIndexCount);
-                    AddPointerWithCountToTracebuffer(VkBindImageMemoryDeviceGroupInfo, VkRect2D, pSplitInstanceBindRegions,
-                                                     splitInstanceBindRegionCount);
-                    break;
-                case VK_STRUCTURE_TYPE_VALIDATION_FLAGS_EXT:
-                    AddPointerWithCountToTracebuffer(VkValidationFlagsEXT, VkValidationCheckEXT, pDisabledValidationChecks,
-                                                     disabledValidationCheckCount);
-                    break;
-                case VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO_EXT:
-                    AddPointerWithCountToTracebuffer(VkDescriptorSetVariableDescriptorCountAllocateInfoEXT, uint32_t,
-                                                     pDescriptorCounts, descriptorSetCount);
-                    break;
-                case VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_W_SCALING_STATE_CREATE_INFO_NV:
-                    AddPointerWithCountToTracebuffer(VkPipelineViewportWScalingStateCreateInfoNV, VkViewportWScalingNV,
-                                                     pViewportWScalings, viewportCount);
-                    break;
-                case VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_SWIZZLE_STATE_CREATE_INFO_NV:
-                    AddPointerWithCountToTracebuffer(VkPipelineViewportSwizzleStateCreateInfoNV, VkViewportSwizzleNV,
-                                                     pViewportSwizzles, viewportCount);
-                    break;
-                case VK_STRUCTURE_TYPE_PIPELINE_DISCARD_RECTANGLE_STATE_CREATE_INFO_EXT:
-                    AddPointerWithCountToTracebuffer(VkPipelineDiscardRectangleStateCreateInfoEXT, VkRect2D, pDiscardRectangles,
-                                                     discardRectangleCount);
-                    break;
-                case VK_STRUCTURE_TYPE_SAMPLE_LOCATIONS_INFO_EXT:
-                    AddPointerWithCountToTracebuffer(VkSampleLocationsInfoEXT, VkSampleLocationEXT, pSampleLocations,
-                                                     sampleLocationsCount);
-                    break;
-                case VK_STRUCTURE_TYPE_RENDER_PASS_SAMPLE_LOCATIONS_BEGIN_INFO_EXT:
-                    AddPointerWithCountToTracebuffer(VkRenderPassSampleLocationsBeginInfoEXT, VkAttachmentSampleLocationsEXT,
-                                                     pAttachmentInitialSampleLocations, attachmentInitialSampleLocationsCount);
-                    AddPointerWithCountToTracebuffer(VkRenderPassSampleLocationsBeginInfoEXT, VkSubpassSampleLocationsEXT,
-                                                     pPostSubpassSampleLocations, postSubpassSampleLocationsCount);
-                    break;
-                case VK_STRUCTURE_TYPE_PIPELINE_COVERAGE_MODULATION_STATE_CREATE_INFO_NV:
-                    AddPointerWithCountToTracebuffer(VkPipelineCoverageModulationStateCreateInfoNV, VkCoverageModulationModeNV,
-                                                     pCoverageModulationTable, coverageModulationTableCount);
-                    break;
-                case VK_STRUCTURE_TYPE_IMAGE_FORMAT_LIST_CREATE_INFO_KHR:
-                    AddPointerWithCountToTracebuffer(VkImageFormatListCreateInfoKHR, VkFormat, pViewFormats, viewFormatCount);
-                    break;
-                case VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO:
-                    AddPointerWithCountToTracebuffer(VkRenderPassMultiviewCreateInfo, uint32_t, pViewMasks, subpassCount);
-                    AddPointerWithCountToTracebuffer(VkRenderPassMultiviewCreateInfo, int32_t, pViewOffsets, dependencyCount);
-                    AddPointerWithCountToTracebuffer(VkRenderPassMultiviewCreateInfo, uint32_t, pCorrelationMasks,
-                                                     correlationMaskCount);
-                    break;
-#if defined(WIN32)
-                case VK_STRUCTURE_TYPE_WIN32_KEYED_MUTEX_ACQUIRE_RELEASE_INFO_KHR:
-                    AddPointerWithCountToTracebuffer(VkWin32KeyedMutexAcquireReleaseInfoKHR, VkDeviceMemory, pAcquireSyncs,
-                                                     acquireCount);
-                    AddPointerWithCountToTracebuffer(VkWin32KeyedMutexAcquireReleaseInfoKHR, uint64_t, pAcquireKeys, acquireCount);
-                    AddPointerWithCountToTracebuffer(VkWin32KeyedMutexAcquireReleaseInfoKHR, uint32_t, pAcquireTimeouts,
-                                                     acquireCount);
-                    AddPointerWithCountToTracebuffer(VkWin32KeyedMutexAcquireReleaseInfoKHR, VkDeviceMemory, pReleaseSyncs,
-                                                     releaseCount);
-                    AddPointerWithCountToTracebuffer(VkWin32KeyedMutexAcquireReleaseInfoKHR, uint64_t, pReleaseKeys, releaseCount);
-                    break;
-                case VK_STRUCTURE_TYPE_WIN32_KEYED_MUTEX_ACQUIRE_RELEASE_INFO_NV:
-                    AddPointerWithCountToTracebuffer(VkWin32KeyedMutexAcquireReleaseInfoNV, VkDeviceMemory, pAcquireSyncs,
-                                                     acquireCount);
-                    AddPointerWithCountToTracebuffer(VkWin32KeyedMutexAcquireReleaseInfoNV, uint64_t, pAcquireKeys, acquireCount);
-                    AddPointerWithCountToTracebuffer(VkWin32KeyedMutexAcquireReleaseInfoNV, uint32_t, pAcquireTimeoutMilliseconds,
-                                                     acquireCount);
-                    AddPointerWithCountToTracebuffer(VkWin32KeyedMutexAcquireReleaseInfoNV, VkDeviceMemory, pReleaseSyncs,
-                                                     releaseCount);
-                    AddPointerWithCountToTracebuffer(VkWin32KeyedMutexAcquireReleaseInfoNV, uint64_t, pReleaseKeys, releaseCount);
-                    break;
-#endif
-                case VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE:
-                    AddPointerWithCountToTracebuffer(VkPresentTimesInfoGOOGLE, VkPresentTimeGOOGLE, pTimes, swapchainCount);
-                    break;
-                case VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT:
-                    AddPointerWithCountToTracebuffer(VkDescriptorSetLayoutBindingFlagsCreateInfoEXT, VkDescriptorBindingFlagsEXT,
-                                                     pBindingFlags, bindingCount);
-
-                default:
-                    // The cases in this switch statement are only those pnext struct types that have
-                    // pointers inside them that need to be added. The pnext list may contain
-                    // struct types that don't have pointers in them, which we skip and remove.
-                    break;
-            }
+        // The struct_info generated from the registry for the struct type describes the data it points to.
+        pInfo = get_struct_info(((VkApplicationInfo*)pInNext)->sType);
+        if (pInfo != NULL) {
+            vktrace_add_buffer_to_trace_packet(pHeader, ppOutNext, pInfo->size, pInNext);
+            vktrace_add_struct_members_to_trace_packet(pHeader, *ppOutNext, pInNext, pInfo);
             pOut = *ppOutNext;
             pIn = pInNext;
             vktrace_finalize_buffer_address(pHeader, ppOutNext);
@@ -415,14 +702,34 @@ void vktrace_set_packet_entrypoint_end_time(vktrace_trace_packet_header* pHeader
 }
 
 void vktrace_finalize_trace_packet(vktrace_trace_packet_header* pHeader) {
+    // Packets that didn't set their entrypoint end time end with one timestamp for both.
+    pHeader->vktrace_end_time = vktrace_get_time();
     if (pHeader->entrypoint_end_time == 0) {
-        vktrace_set_packet_entrypoint_end_time(pHeader);
+        pHeader->entrypoint_end_time = pHeader->vktrace_end_time;
     }
-    pHeader->vktrace_end_time = vktrace_get_time();
 }
 
 void vktrace_write_trace_packet(const vktrace_trace_packet_header* pHeader, FileLike* pFile) {
-    BOOL res = vktrace_FileLike_WriteRaw(pFile, pHeader, (size_t)pHeader->size);
+    BOOL res;
+    if (vktrace_trace_packet_has_spilled_buffers(pHeader)) {
+        // put the packet back together with its spilled buffers
+        char* pPacket = (char*)vktrace_malloc((size_t)pHeader->size);
+        if (pPacket == NULL) {
+            vktrace_LogError("Failed to allocate a trace packet of %ju bytes.", (intmax_t)pHeader->size);
+            exit(1);
+        }
+        uint64_t arenaSize = s_packet_arena.pSpills[0].offset;
+        memcpy(pPacket, pHeader, (size_t)arenaSize);
+        memset(pPacket + arenaSize, 0, (size_t)(pHeader->size - arenaSize));
+        for (uint32_t i = 0; i < s_packet_arena.spillCount; i++) {
+            const vktrace_packet_arena_spill* pSpill = &s_packet_arena.pSpills[i];
+            memcpy(pPacket + pSpill->offset, pSpill->pBuffer, (size_t)pSpill->size);
+        }
+        res = vktrace_FileLike_WriteRaw(pFile, pPacket, (size_t)pHeader->size);
+        vktrace_free(pPacket);
+    } else {
+        res = vktrace_FileLike_WriteRaw(pFile, pHeader, (size_t)pHeader->size);
+    }
     if (!res && pHeader->packet_id != VKTRACE_TPI_MARKER_TERMINATE_PROCESS) {
         // We don't retry on failure because vktrace_FileLike_WriteRaw already retried and gave up.
         vktrace_LogWarning("Failed to write trace packet.");
@@ -469,6 +776,11 @@ void vktrace_delete_trace_packet_no_lock(vktrace_trace_packet_header** ppHeader)
     if (ppHeader == NULL) return;
     if (*ppHeader == NULL) return;
 
+    if ((char*)*ppHeader == s_packet_arena.pBase) {
+        vktrace_packet_arena_release();
+        *ppHeader = NULL;
+        return;
+    }
     VKTRACE_DELETE(*ppHeader);
     *ppHeader = NULL;
 }
@@ -686,116 +998,53 @@ VkDeviceGroupDeviceCreateInfo* interpret_VkDeviceGroupDeviceCreateInfo(vktrace_t
     }
     return pCreateInfo;
 }
-#define InterpretPointerInPNext(_sName, _sPtrType, _sPtr)                                                        \
-    do {                                                                                                         \
-        _sName* struct_ptr_cur = (_sName*)(((VkApplicationInfo*)struct_ptr)->pNext);                             \
-        struct_ptr_cur->_sPtr =                                                                                  \
-            (_sPtrType*)vktrace_trace_packet_interpret_buffer_pointer(pHeader, (intptr_t)struct_ptr_cur->_sPtr); \
-    } while (0)
+static void vkreplay_interpret_struct_members(vktrace_trace_packet_header* pHeader, void* struct_ptr, const struct_info* pInfo);
 
-void vkreplay_interpret_pnext_pointers(vktrace_trace_packet_header* pHeader, void* struct_ptr) {
+// Converts the pointers of a struct that is an element of another struct, including its pNext chain.
+static void vkreplay_interpret_struct_element(vktrace_trace_packet_header* pHeader, void* struct_ptr, const struct_info* pInfo) {
+    if (pInfo->has_pnext) {
+        vkreplay_interpret_pnext_pointers(pHeader, struct_ptr);
+    }
+    vkreplay_interpret_struct_members(pHeader, struct_ptr, pInfo);
+}
+
+// Converts the members of the struct at struct_ptr that pInfo describes from byte offsets into pointers.
+static void vkreplay_interpret_struct_members(vktrace_trace_packet_header* pHeader, void* struct_ptr, const struct_info* pInfo) {
     uint32_t i;
+    uint64_t j, count;
+    for (i = 0; i < pInfo->member_count; i++) {
+        const struct_member_info* pMember = &pInfo->pMembers[i];
+        void* pMemberPtr = (char*)struct_ptr + pMember->offset;
+        if (pMember->kind == STRUCT_MEMBER_INLINE) {
+            vkreplay_interpret_struct_element(pHeader, pMemberPtr, pMember->pElementInfo);
+            continue;
+        }
+
+        void** ppElements = (void**)pMemberPtr;
+        *ppElements = vktrace_trace_packet_interpret_buffer_pointer(pHeader, (intptr_t)*ppElements);
+        if (*ppElements != NULL && pMember->pElementInfo != NULL) {
+            count = vktrace_get_struct_member_count(struct_ptr, pMember);
+            for (j = 0; j < count; j++) {
+                vkreplay_interpret_struct_element(pHeader, (char*)*ppElements + j * pMember->element_size, pMember->pElementInfo);
+            }
+        }
+    }
+}
+
+void vkreplay_interpret_pnext_pointers(vktrace_trace_packet_header* pHeader, void* struct_ptr) {
+    const struct_info* pInfo;
     if (!struct_ptr) return;
 
     while (((VkApplicationInfo*)struct_ptr)->pNext) {
         // Convert the pNext pointer
         VkApplicationInfo* pNext = (VkApplicationInfo*)((VkApplicationInfo*)struct_ptr)->pNext;
         ((VkApplicationInfo*)struct_ptr)->pNext = (void*)vktrace_trace_packet_interpret_buffer_pointer(pHeader, (intptr_t)pNext);
+        struct_ptr = (void*)((VkApplicationInfo*)struct_ptr)->pNext;
 
         // Convert pointers in pNext structures
-        switch (((VkApplicationInfo*)(((VkApplicationInfo*)struct_ptr)->pNext))->sType) {
-            case VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO: {
-                VkDescriptorSetLayoutCreateInfo* struct_ptr_cur =
-                    (VkDescriptorSetLayoutCreateInfo*)(((VkApplicationInfo*)struct_ptr)->pNext);
-                struct_ptr_cur->pBindings = (VkDescriptorSetLayoutBinding*)vktrace_trace_packet_interpret_buffer_pointer(
-                    pHeader, (intptr_t)struct_ptr_cur->pBindings);
-                for (i = 0; i < struct_ptr_cur->bindingCount; i++) {
-                    VkSampler** ppSamplers = (VkSampler**)&(struct_ptr_cur->pBindings[i].pImmutableSamplers);
-                    *ppSamplers = (VkSampler*)vktrace_trace_packet_interpret_buffer_pointer(
-                        pHeader, (intptr_t)struct_ptr_cur->pBindings[i].pImmutableSamplers);
-                }
-            } break;
-            case VK_STRUCTURE_TYPE_DEVICE_GROUP_DEVICE_CREATE_INFO:
-                InterpretPointerInPNext(VkDeviceGroupDeviceCreateInfo, VkPhysicalDevice, pPhysicalDevices);
-                break;
-            case VK_STRUCTURE_TYPE_DEVICE_GROUP_RENDER_PASS_BEGIN_INFO:
-                InterpretPointerInPNext(VkDeviceGroupRenderPassBeginInfo, VkRect2D, pDeviceRenderAreas);
-                break;
-            case VK_STRUCTURE_TYPE_DEVICE_GROUP_SUBMIT_INFO:
-                InterpretPointerInPNext(VkDeviceGroupSubmitInfo, uint32_t, pWaitSemaphoreDeviceIndices);
-                InterpretPointerInPNext(VkDeviceGroupSubmitInfo, uint32_t, pCommandBufferDeviceMasks);
-                InterpretPointerInPNext(VkDeviceGroupSubmitInfo, uint32_t, pSignalSemaphoreDeviceIndices);
-                break;
-            case VK_STRUCTURE_TYPE_BIND_BUFFER_MEMORY_DEVICE_GROUP_INFO:
-                InterpretPointerInPNext(VkBindBufferMemoryDeviceGroupInfo, uint32_t, pDeviceIndices);
-                break;
-            case VK_STRUCTURE_TYPE_BIND_IMAGE_MEMORY_DEVICE_GROUP_INFO:
-                InterpretPointerInPNext(VkBindImageMemoryDeviceGroupInfo, uint32_t, pDeviceIndices);
-                InterpretPointerInPNext(VkBindImageMemoryDeviceGroupInfo, VkRect2D, pSplitInstanceBindRegions);
-                break;
-            case VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO_EXT:
-                InterpretPointerInPNext(VkDescriptorSetVariableDescriptorCountAllocateInfoEXT, uint32_t, pDescriptorCounts);
-                break;
-            case VK_STRUCTURE_TYPE_VALIDATION_FLAGS_EXT:
-                InterpretPointerInPNext(VkValidationFlagsEXT, VkValidationCheckEXT, pDisabledValidationChecks);
-                break;
-            case VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_W_SCALING_STATE_CREATE_INFO_NV:
-                InterpretPointerInPNext(VkPipelineViewportWScalingStateCreateInfoNV, VkViewportWScalingNV, pViewportWScalings);
-                break;
-            case VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_SWIZZLE_STATE_CREATE_INFO_NV:
-                InterpretPointerInPNext(VkPipelineViewportSwizzleStateCreateInfoNV, VkViewportSwizzleNV, pViewportSwizzles);
-                break;
-            case VK_STRUCTURE_TYPE_PIPELINE_DISCARD_RECTANGLE_STATE_CREATE_INFO_EXT:
-                InterpretPointerInPNext(VkPipelineDiscardRectangleStateCreateInfoEXT, VkRect2D, pDiscardRectangles);
-                break;
-            case VK_STRUCTURE_TYPE_SAMPLE_LOCATIONS_INFO_EXT:
-                InterpretPointerInPNext(VkSampleLocationsInfoEXT, VkSampleLocationEXT, pSampleLocations);
-                break;
-            case VK_STRUCTURE_TYPE_RENDER_PASS_SAMPLE_LOCATIONS_BEGIN_INFO_EXT:
-                InterpretPointerInPNext(VkRenderPassSampleLocationsBeginInfoEXT, VkAttachmentSampleLocationsEXT,
-                                        pAttachmentInitialSampleLocations);
-                InterpretPointerInPNext(VkRenderPassSampleLocationsBeginInfoEXT, VkSubpassSampleLocationsEXT,
-                                        pPostSubpassSampleLocations);
-                break;
-            case VK_STRUCTURE_TYPE_PIPELINE_COVERAGE_MODULATION_STATE_CREATE_INFO_NV:
-                InterpretPointerInPNext(VkPipelineCoverageModulationStateCreateInfoNV, float, pCoverageModulationTable);
-                break;
-            case VK_STRUCTURE_TYPE_IMAGE_FORMAT_LIST_CREATE_INFO_KHR:
-                InterpretPointerInPNext(VkImageFormatListCreateInfoKHR, VkFormat, pViewFormats);
-                break;
-            case VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO:
-                InterpretPointerInPNext(VkRenderPassMultiviewCreateInfo, uint32_t, pViewMasks);
-                InterpretPointerInPNext(VkRenderPassMultiviewCreateInfo, int32_t, pViewOffsets);
-                InterpretPointerInPNext(VkRenderPassMultiviewCreateInfo, uint32_t, pCorrelationMasks);
-                break;
-#if defined(WIN32)
-            case VK_STRUCTURE_TYPE_WIN32_KEYED_MUTEX_ACQUIRE_RELEASE_INFO_KHR:
-                InterpretPointerInPNext(VkWin32KeyedMutexAcquireReleaseInfoKHR, VkDeviceMemory, pAcquireSyncs);
-                InterpretPointerInPNext(VkWin32KeyedMutexAcquireReleaseInfoKHR, uint64_t, pAcquireKeys);
-                InterpretPointerInPNext(VkWin32KeyedMutexAcquireReleaseInfoKHR, uint32_t, pAcquireTimeouts);
-                InterpretPointerInPNext(VkWin32KeyedMutexAcquireReleaseInfoKHR, VkDeviceMemory, pReleaseSyncs);
-                InterpretPointerInPNext(VkWin32KeyedMutexAcquireReleaseInfoKHR, uint64_t, pReleaseKeys);
-                break;
-            case VK_STRUCTURE_TYPE_WIN32_KEYED_MUTEX_ACQUIRE_RELEASE_INFO_NV:
-                InterpretPointerInPNext(VkWin32KeyedMutexAcquireReleaseInfoNV, VkDeviceMemory, pAcquireSyncs);
-                InterpretPointerInPNext(VkWin32KeyedMutexAcquireReleaseInfoNV, uint64_t, pAcquireKeys);
-                InterpretPointerInPNext(VkWin32KeyedMutexAcquireReleaseInfoNV, uint32_t, pAcquireTimeoutMilliseconds);
-                InterpretPointerInPNext(VkWin32KeyedMutexAcquireReleaseInfoNV, VkDeviceMemory, pReleaseSyncs);
-                InterpretPointerInPNext(VkWin32KeyedMutexAcquireReleaseInfoNV, uint64_t, pReleaseKeys);
-                break;
-#endif
-            case VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE:
-                InterpretPointerInPNext(VkPresentTimesInfoGOOGLE, VkPresentTimeGOOGLE, pTimes);
-                break;
-            case VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT:
-                InterpretPointerInPNext(VkDescriptorSetLayoutBindingFlagsCreateInfoEXT, VkDescriptorBindingFlagsEXT, pBindingFlags);
-                break;
-            default:
-                // The cases in this switch statement are only those pnext struct types that have
-                // pointers inside them that need to be interpreted. The pnext list may contain
-                // struct types that don't have pointers in them, which we simply skip over.
-                break;
-        }
-        struct_ptr = (VkApplicationInfo*)((VkApplicationInfo*)struct_ptr)->pNext;
+        pInfo = get_struct_info(((VkApplicationInfo*)struct_ptr)->sType);
+        if (pInfo != NULL) {
+            vkreplay_interpret_struct_members(pHeader, struct_ptr, pInfo);
+        }
     }
 }
@@ -77,6 +77,14 @@ static FILE* vktrace_open_trace_file(vktrace_process_info* pProcInfo) {
 vktrace_trace_packet_header* vktrace_create_trace_packet(uint8_t tracer_id, uint16_t packet_id, uint64_t packet_size,
                                                          uint64_t additional_buffers_size);
 
+// creates a trace packet in the packet arena, where it grows as buffers are added to it, so the size of its buffers doesn't
+// need to be known up front. Returns NULL if the arena is in use by another packet or can't be reserved.
+vktrace_trace_packet_header* vktrace_create_arena_trace_packet(uint8_t tracer_id, uint16_t packet_id, uint64_t packet_size);
+
+// returns TRUE if the packet outgrew the packet arena, and keeps some of its buffers outside of it. Only
+// vktrace_write_trace_packet reads such a packet as a whole.
+BOOL vktrace_trace_packet_has_spilled_buffers(const vktrace_trace_packet_header* pHeader);
+
 // deletes a trace packet and sets pointer to NULL, this function should be used on a packet created to write to trace file
 void vktrace_delete_trace_packet(vktrace_trace_packet_header** ppHeader);
 
@@ -102,7 +110,8 @@ void vktrace_set_packet_entrypoint_end_time(vktrace_trace_packet_header* pHeader
 void vktrace_finalize_trace_packet(vktrace_trace_packet_header* pHeader);
 
 // Write the trace packet to the filelike thing.
-// This has no knowledge of the details of the packet other than its size.
+// This has no knowledge of the details of the packet other than its size, and where the buffers spilled out of the packet
+// arena go.
 void vktrace_write_trace_packet(const vktrace_trace_packet_header* pHeader, FileLike* pFile);
 
 //=============================================================================
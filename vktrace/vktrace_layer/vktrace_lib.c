@@ -25,6 +25,7 @@
 #include "vktrace_vk_vk.h"
 #include "vktrace_lib_trim.h"
 #include "vktrace_lib_helpers.h"
+#include "vktrace_lib_cmdbatch.h"
 
 #if defined(__cplusplus)
 extern "C" {
@@ -89,6 +90,7 @@ void loggingCallback(VktraceLogLevel level, const char *pMessage) {
         vktrace_set_packet_entrypoint_end_time(pHeader);
         vktrace_finalize_trace_packet(pHeader);
 
+        vktrace_cmdbatch_flush();
         vktrace_write_trace_packet(pHeader, vktrace_trace_get_trace_file());
         vktrace_delete_trace_packet(&pHeader);
     }
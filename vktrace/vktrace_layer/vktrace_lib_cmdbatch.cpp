@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2019 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <mutex>
+#include <vector>
+
+#include "vktrace_lib_cmdbatch.h"
+#include "vktrace_lib_stats.h"
+#include "vktrace_lib_trim.h"
+#include "vktrace_tracelog.h"
+
+bool g_vktraceCmdBatchEnabled = false;
+std::atomic<bool> g_vktraceCmdBatchPending(false);
+
+namespace {
+
+// Batches are written once their calls take 4 MB, so that a long run of commands doesn't hold on to a lot of memory.
+const size_t kMaxBatchBytes = 4 * 1024 * 1024;
+
+// The calls of a batch are kept after room for the header and body of its packet, so the batch is written from where its
+// calls were appended.
+const size_t kBatchCallsOffset = sizeof(vktrace_trace_packet_header) + sizeof(vktrace_trace_packet_command_batch);
+
+struct CommandBatch {
+    vktrace_trace_packet_command_batch info;
+    uint64_t lastPacketIndex;
+    uint64_t lastEndTime;
+    std::vector<uint8_t> packet;
+};
+
+// The trace lock is only taken when VKTRACE_ENABLE_TRACE_LOCK is set, so the mutex alone keeps the pending batch
+// consistent between threads. It is never held while another packet is written, other than the batch itself.
+std::mutex g_batchMutex;
+CommandBatch g_batch;
+
+// Called with g_batchMutex held. The batch is no longer pending once its write starts, so that a message logged while it
+// is written doesn't try to write it again.
+void write_batch(CommandBatch& batch) {
+    g_vktraceCmdBatchPending.store(false, std::memory_order_release);
+
+    // only the header is created as a packet, it takes the packet index of the batch and the trace lock for the write
+    vktrace_trace_packet_header* pHeader = vktrace_create_trace_packet(VKTRACE_TID_VULKAN, VKTRACE_TPI_VK_CommandBatch, 0, 0);
+    vktrace_trace_packet_header* pBatchHeader = (vktrace_trace_packet_header*)batch.packet.data();
+    memcpy(pBatchHeader, pHeader, sizeof(vktrace_trace_packet_header));
+    pBatchHeader->size = batch.packet.size();
+    pBatchHeader->next_buffers_offset = pBatchHeader->size;
+    pBatchHeader->pBody = (uintptr_t)(pBatchHeader + 1);
+    memcpy((void*)pBatchHeader->pBody, &batch.info, sizeof(batch.info));
+    vktrace_finalize_trace_packet(pBatchHeader);
+
+    // the calls of the batch were already counted as they were added, so only the write is recorded
+    uint64_t startTime = vktrace_get_time();
+    vktrace_write_trace_packet(pBatchHeader, vktrace_trace_get_trace_file());
+    if (g_vktraceStatsEnabled) {
+        vktrace_stats_record(VKTRACE_TPI_VK_CommandBatch, VKTRACE_STATS_STAGE_WRITE, vktrace_get_time() - startTime);
+    }
+    vktrace_delete_trace_packet(&pHeader);
+
+    batch.packet.clear();
+    batch.info.call_count = 0;
+}
+
+// Returns false if the header of pHeader can't be rebuilt from deltas to the last call of batch.
+bool fits_batch(const CommandBatch& batch, const vktrace_trace_packet_header* pHeader, uint64_t bodySize) {
+    if (batch.info.call_count == 0) {
+        return true;
+    }
+    return pHeader->global_packet_index > batch.lastPacketIndex &&
+           pHeader->global_packet_index - batch.lastPacketIndex <= UINT32_MAX &&
+           pHeader->entrypoint_begin_time >= batch.lastEndTime &&
+           pHeader->entrypoint_begin_time - batch.lastEndTime <= UINT32_MAX &&
+           batch.packet.size() - kBatchCallsOffset + sizeof(vktrace_trace_packet_command_batch_call) + bodySize <= kMaxBatchBytes;
+}
+
+}  // namespace
+
+void vktrace_cmdbatch_initialize() {
+    const char* env_batch = vktrace_get_global_var(VKTRACE_BATCH_COMMANDS_ENV);
+    g_vktraceCmdBatchEnabled = (env_batch != NULL && strcmp(env_batch, "1") == 0);
+    if (g_vktraceCmdBatchEnabled && g_trimEnabled) {
+        vktrace_LogWarning("Command batching is not supported with trim, commands will not be batched.");
+        g_vktraceCmdBatchEnabled = false;
+    }
+}
+
+void vktrace_cmdbatch_finish_packet(vktrace_trace_packet_header** ppHeader) {
+    vktrace_trace_packet_header* pHeader = *ppHeader;
+    vktrace_finalize_trace_packet(pHeader);
+
+    uint64_t bodySize = pHeader->size - sizeof(vktrace_trace_packet_header);
+    uint64_t callTime = pHeader->entrypoint_end_time - pHeader->entrypoint_begin_time;
+    if (!g_vktraceCmdBatchEnabled || sizeof(vktrace_trace_packet_command_batch_call) + bodySize > kMaxBatchBytes ||
+        callTime > UINT32_MAX || vktrace_trace_packet_has_spilled_buffers(pHeader)) {
+        // calls that don't fit a batch are written on their own, after the calls batched ahead of them
+        vktrace_cmdbatch_flush();
+        vktrace_stats_write_trace_packet(pHeader, vktrace_trace_get_trace_file());
+        vktrace_delete_trace_packet(ppHeader);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(g_batchMutex);
+        CommandBatch& batch = g_batch;
+        if (!fits_batch(batch, pHeader, bodySize)) {
+            write_batch(batch);
+        }
+
+        vktrace_trace_packet_command_batch_call call;
+        call.size = (uint32_t)(sizeof(call) + bodySize);
+        call.packet_id = pHeader->packet_id;
+        call.reserved = 0;
+        call.thread_id = pHeader->thread_id;
+        if (batch.info.call_count == 0) {
+            batch.info.packet_index = pHeader->global_packet_index;
+            batch.info.begin_time = pHeader->entrypoint_begin_time;
+            batch.info.reserved = 0;
+            batch.packet.resize(kBatchCallsOffset);
+            call.packet_index_delta = 0;
+            call.begin_time_delta = 0;
+        } else {
+            call.packet_index_delta = (uint32_t)(pHeader->global_packet_index - batch.lastPacketIndex);
+            call.begin_time_delta = (uint32_t)(pHeader->entrypoint_begin_time - batch.lastEndTime);
+        }
+        call.call_time = (uint32_t)callTime;
+
+        const uint8_t* pCall = (const uint8_t*)&call;
+        const uint8_t* pBody = (const uint8_t*)pHeader->pBody;
+        batch.packet.insert(batch.packet.end(), pCall, pCall + sizeof(call));
+        batch.packet.insert(batch.packet.end(), pBody, pBody + bodySize);
+        batch.info.call_count++;
+        batch.lastPacketIndex = pHeader->global_packet_index;
+        batch.lastEndTime = pHeader->entrypoint_end_time;
+        g_vktraceCmdBatchPending.store(true, std::memory_order_release);
+    }
+
+    if (g_vktraceStatsEnabled) {
+        vktrace_stats_record_packet(pHeader);
+    }
+    vktrace_delete_trace_packet(ppHeader);
+}
+
+void vktrace_cmdbatch_write_pending_batch() {
+    std::lock_guard<std::mutex> lock(g_batchMutex);
+    if (g_batch.info.call_count > 0) {
+        write_batch(g_batch);
+    }
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2019 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//  Command batching
+//
+//     vkCmd* calls are the most frequent calls of an application, and writing each of their packets to the trace file
+//     as it is captured costs a socket message per call. When the VKTRACE_BATCH_COMMANDS env var is set to 1, the trace
+//     layer appends the packets of vkCmd* calls to a pending batch instead, and writes the batch as a single
+//     VKTRACE_TPI_VK_CommandBatch packet just before the next packet that isn't batched, so the calls keep their place
+//     among the other packets of the trace. Each call of a batch keeps the body of its packet, but its header is replaced
+//     by a small record holding the packet id, thread and deltas of its packet index and timestamps.
+//
+//     Batches are also written when a batch grows large, and when the deltas of a call don't fit in its record. The vktrace
+//     process expands each batch back into the packets of its calls before writing them to the trace file, so the trace
+//     file is the same as without batching and only the number of socket writes goes down. Each call still builds its own
+//     packet, which is copied into the batch, and the calls of all threads go to one batch under one mutex so that they
+//     keep their order.
+//
+//     Trim keeps the packets of command buffers on its own, so commands aren't batched when trim is enabled.
+
+#pragma once
+
+#include <atomic>
+
+#include "vulkan/vulkan.h"
+#include "vktrace_common.h"
+#include "vktrace_trace_packet_utils.h"
+
+// VKTRACE_BATCH_COMMANDS env var enables command batching if the value is 1.
+// It is disabled by default.
+#define VKTRACE_BATCH_COMMANDS_ENV "VKTRACE_BATCH_COMMANDS"
+
+extern bool g_vktraceCmdBatchEnabled;
+extern std::atomic<bool> g_vktraceCmdBatchPending;
+
+void vktrace_cmdbatch_initialize();
+
+// Finishes the packet of a vkCmd* call and deletes it. The packet is appended to the pending batch if batching is enabled,
+// or else written to the trace file.
+void vktrace_cmdbatch_finish_packet(vktrace_trace_packet_header** ppHeader);
+
+// Writes the pending batch to the trace file, if there is one.
+void vktrace_cmdbatch_write_pending_batch();
+
+// Called before any packet that isn't batched is written.
+static inline void vktrace_cmdbatch_flush() {
+    if (g_vktraceCmdBatchPending.load(std::memory_order_acquire)) {
+        vktrace_cmdbatch_write_pending_batch();
+    }
+}
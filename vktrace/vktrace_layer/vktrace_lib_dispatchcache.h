@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2019 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//  Dispatch data cache
+//
+//     Every hooked call looks up the dispatch data of its first parameter with mdd() or mid(), by the dispatch key of the
+//     object. The maps of the dispatch data are hashed on each lookup, so a small direct-mapped cache sits in front of
+//     them. Each slot holds the dispatch data of one dispatch key, and the dispatch data keeps its own key, so a lookup
+//     is a single atomic load and a compare, and a slot is never seen half written by another thread.
+//
+//     A slot is filled on a miss, and cleared when the device or instance of its data is destroyed. Dispatch data is
+//     never freed, so a thread that read a slot just before it was replaced still holds valid data.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+// T is the dispatch data kept for a dispatch key, which has to have a "void* key" member holding that key.
+template <typename T>
+class DispatchDataCache {
+   public:
+    DispatchDataCache() {
+        for (uint32_t i = 0; i < kSlotCount; i++) {
+            m_slots[i].store(NULL, std::memory_order_relaxed);
+        }
+    }
+
+    // Returns the cached dispatch data of key, or NULL if it isn't cached.
+    T* find(void* key) const {
+        T* pData = m_slots[slot(key)].load(std::memory_order_acquire);
+        return (pData != NULL && pData->key == key) ? pData : NULL;
+    }
+
+    void insert(T* pData) { m_slots[slot(pData->key)].store(pData, std::memory_order_release); }
+
+    // Clears the slot of key, unless the slot already holds the data of another key.
+    void erase(void* key) {
+        std::atomic<T*>& cached = m_slots[slot(key)];
+        T* pData = cached.load(std::memory_order_acquire);
+        if (pData != NULL && pData->key == key) {
+            cached.compare_exchange_strong(pData, NULL, std::memory_order_acq_rel);
+        }
+    }
+
+   private:
+    static const uint32_t kSlotCount = 64;
+
+    // Dispatch keys are pointers to dispatch tables allocated by the loader, so their low bits are always zero.
+    static uint32_t slot(void* key) {
+        uintptr_t bits = (uintptr_t)key;
+        return (uint32_t)((bits >> 4) ^ (bits >> 12)) % kSlotCount;
+    }
+
+    std::atomic<T*> m_slots[kSlotCount];
+};
@@ -29,6 +29,7 @@
 
 #include "vk_layer_dispatch_table.h"
 #include "vk_struct_size_helper.h"
+#include "vktrace_lib_dispatchcache.h"
 
 // utilities to convert API handles to uint64_t type and vice versa
 template <typename T>
@@ -68,10 +69,12 @@ typedef struct _VKMemInfo {
 } VKMemInfo;
 
 typedef struct _layer_device_data {
+    void *key;
     VkLayerDispatchTable devTable;
     bool KHRDeviceSwapchainEnabled;
 } layer_device_data;
 typedef struct _layer_instance_data {
+    void *key;
     VkLayerInstanceDispatchTable instTable;
     bool LunargDebugReportEnabled;
     bool KHRSurfaceEnabled;
@@ -87,6 +90,8 @@ extern VKMemInfo g_memInfo;
 extern VKTRACE_CRITICAL_SECTION g_memInfoLock;
 extern std::unordered_map<void *, layer_device_data *> g_deviceDataMap;
 extern std::unordered_map<void *, layer_instance_data *> g_instanceDataMap;
+extern DispatchDataCache<layer_device_data> g_deviceDataCache;
+extern DispatchDataCache<layer_instance_data> g_instanceDataCache;
 extern VkPhysicalDeviceMemoryProperties g_savedDevMemProps;
 
 typedef void *dispatch_key;
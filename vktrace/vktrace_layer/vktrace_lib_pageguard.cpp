@@ -21,6 +21,8 @@
 #include "vktrace_lib_pageguardcapture.h"
 #include "vktrace_lib_pageguard.h"
 #include "vktrace_lib_trim.h"
+#include "vktrace_lib_stats.h"
+#include "vktrace_lib_cmdbatch.h"
 
 static const bool PAGEGUARD_PAGEGUARD_ENABLE_DEFAULT = true;
 
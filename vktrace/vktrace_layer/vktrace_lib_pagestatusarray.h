@@ -24,7 +24,6 @@
 #include "vktrace_interconnect.h"
 #include "vktrace_filelike.h"
 #include "vktrace_trace_packet_utils.h"
-#include "vktrace_vk_exts.h"
 #include <stdio.h>
 
 static const int BLOCK_FLAG_ARRAY_CHANGED = 0;
@@ -0,0 +1,282 @@
+/*
+ * Copyright (C) 2019 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <inttypes.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#if defined(PLATFORM_LINUX) && !defined(ANDROID)
+#include <signal.h>
+#endif
+
+#include "vktrace_lib_stats.h"
+#include "vktrace_vk_packet_id.h"
+
+bool g_vktraceStatsEnabled = false;
+
+namespace {
+
+// Counters are only ever written by the thread that owns them, so relaxed loads and stores are enough;
+// the atomics just let the dump read them while the owning thread keeps capturing.
+struct StageCounters {
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> totalTime;
+    std::atomic<uint64_t> maxTime;
+    std::atomic<uint64_t> histogram[VKTRACE_STATS_HISTOGRAM_BUCKETS];
+};
+
+struct EntrypointCounters {
+    StageCounters stages[VKTRACE_STATS_STAGE_COUNT];
+};
+
+// Packet ids are looked up in pages of 256 entrypoints so that a thread only allocates counters for the ids it uses.
+const uint32_t kPageSize = 256;
+const uint32_t kPageCount = 65536 / kPageSize;
+
+struct CounterPage {
+    std::atomic<EntrypointCounters*> entrypoints[kPageSize];
+};
+
+struct ThreadCounters {
+    std::atomic<CounterPage*> pages[kPageCount];
+};
+
+std::mutex g_threadCountersMutex;
+std::vector<ThreadCounters*> g_threadCounters;
+std::mutex g_dumpMutex;
+std::atomic<bool> g_dumpRequested(false);
+VKTRACE_THREAD_LOCAL ThreadCounters* t_pThreadCounters = NULL;
+
+const char* const kStageNames[VKTRACE_STATS_STAGE_COUNT] = {"call", "packet", "pnext", "pageguard", "write"};
+
+template <typename T>
+T* allocate_zeroed() {
+    // The counters are plain arrays of atomics, which are zero-initialized the same way as the integers they wrap.
+    T* pObject = new T;
+    memset((void*)pObject, 0, sizeof(T));
+    return pObject;
+}
+
+ThreadCounters* get_thread_counters() {
+    if (t_pThreadCounters == NULL) {
+        ThreadCounters* pCounters = allocate_zeroed<ThreadCounters>();
+        // Threads register once; the counters are kept after the thread exits so that the dump still includes them.
+        std::lock_guard<std::mutex> lock(g_threadCountersMutex);
+        g_threadCounters.push_back(pCounters);
+        t_pThreadCounters = pCounters;
+    }
+    return t_pThreadCounters;
+}
+
+EntrypointCounters* get_entrypoint_counters(ThreadCounters* pThread, uint16_t packetId) {
+    std::atomic<CounterPage*>& page = pThread->pages[packetId / kPageSize];
+    CounterPage* pPage = page.load(std::memory_order_relaxed);
+    if (pPage == NULL) {
+        pPage = allocate_zeroed<CounterPage>();
+        page.store(pPage, std::memory_order_release);
+    }
+
+    std::atomic<EntrypointCounters*>& entrypoint = pPage->entrypoints[packetId % kPageSize];
+    EntrypointCounters* pEntrypoint = entrypoint.load(std::memory_order_relaxed);
+    if (pEntrypoint == NULL) {
+        pEntrypoint = allocate_zeroed<EntrypointCounters>();
+        entrypoint.store(pEntrypoint, std::memory_order_release);
+    }
+    return pEntrypoint;
+}
+
+uint32_t get_histogram_bucket(uint64_t duration) {
+    uint32_t bucket = 0;
+    while (duration != 0 && bucket < VKTRACE_STATS_HISTOGRAM_BUCKETS - 1) {
+        duration >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+void add_relaxed(std::atomic<uint64_t>& counter, uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+#if defined(PLATFORM_LINUX) && !defined(ANDROID)
+// The handler the application had for SIGUSR2 before the layer installed its own.
+struct sigaction g_previousSigusr2Action;
+
+void dump_signal_handler(int signal, siginfo_t* pInfo, void* pContext) {
+    // Logging isn't safe in a signal handler, so the next captured packet writes the dump instead.
+    g_dumpRequested.store(true, std::memory_order_relaxed);
+
+    // The application still gets the signal if it handles it. The default action of SIGUSR2 would end the process, so it
+    // is only taken when the application sets a handler of its own.
+    if (g_previousSigusr2Action.sa_flags & SA_SIGINFO) {
+        g_previousSigusr2Action.sa_sigaction(signal, pInfo, pContext);
+    } else if (g_previousSigusr2Action.sa_handler != SIG_DFL && g_previousSigusr2Action.sa_handler != SIG_IGN) {
+        g_previousSigusr2Action.sa_handler(signal);
+    }
+}
+#endif
+
+// Totals of one stage of one entrypoint, summed over all threads.
+struct StageTotals {
+    uint64_t count;
+    uint64_t totalTime;
+    uint64_t maxTime;
+    uint64_t histogram[VKTRACE_STATS_HISTOGRAM_BUCKETS];
+};
+
+struct EntrypointTotals {
+    uint16_t packetId;
+    StageTotals stages[VKTRACE_STATS_STAGE_COUNT];
+
+    // time spent in the layer rather than in the call itself
+    uint64_t overheadTime() const {
+        return stages[VKTRACE_STATS_STAGE_PACKET].totalTime + stages[VKTRACE_STATS_STAGE_PAGEGUARD].totalTime +
+               stages[VKTRACE_STATS_STAGE_WRITE].totalTime;
+    }
+};
+
+// Upper bound of the bucket that holds the given fraction of the samples.
+uint64_t get_percentile(const StageTotals& stage, double fraction) {
+    uint64_t threshold = (uint64_t)(stage.count * fraction);
+    uint64_t samples = 0;
+    for (uint32_t bucket = 0; bucket < VKTRACE_STATS_HISTOGRAM_BUCKETS; bucket++) {
+        samples += stage.histogram[bucket];
+        if (samples > threshold) {
+            return std::min((uint64_t)1 << bucket, stage.maxTime);
+        }
+    }
+    return stage.maxTime;
+}
+
+}  // namespace
+
+void vktrace_stats_initialize() {
+    const char* env_stats = vktrace_get_global_var(VKTRACE_LAYER_STATS_ENV);
+    g_vktraceStatsEnabled = (env_stats != NULL && strcmp(env_stats, "1") == 0);
+    if (!g_vktraceStatsEnabled) {
+        return;
+    }
+
+#if defined(PLATFORM_LINUX) && !defined(ANDROID)
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    sigemptyset(&action.sa_mask);
+    action.sa_sigaction = dump_signal_handler;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigaction(SIGUSR2, &action, &g_previousSigusr2Action);
+    vktrace_LogAlways("Capture overhead statistics enabled, send SIGUSR2 to process %d to write them to the log.",
+                      (int)vktrace_get_pid());
+#else
+    vktrace_LogAlways("Capture overhead statistics enabled.");
+#endif
+}
+
+void vktrace_stats_record(uint16_t packetId, VktraceStatsStage stage, uint64_t duration) {
+    StageCounters& counters = get_entrypoint_counters(get_thread_counters(), packetId)->stages[stage];
+    add_relaxed(counters.count, 1);
+    add_relaxed(counters.totalTime, duration);
+    if (duration > counters.maxTime.load(std::memory_order_relaxed)) {
+        counters.maxTime.store(duration, std::memory_order_relaxed);
+    }
+    add_relaxed(counters.histogram[get_histogram_bucket(duration)], 1);
+}
+
+void vktrace_stats_record_packet(const vktrace_trace_packet_header* pHeader) {
+    uint64_t callTime = pHeader->entrypoint_end_time - pHeader->entrypoint_begin_time;
+    uint64_t layerTime = pHeader->vktrace_end_time - pHeader->vktrace_begin_time;
+    vktrace_stats_record(pHeader->packet_id, VKTRACE_STATS_STAGE_API_CALL, callTime);
+    vktrace_stats_record(pHeader->packet_id, VKTRACE_STATS_STAGE_PACKET, (layerTime > callTime) ? layerTime - callTime : 0);
+
+    if (g_dumpRequested.load(std::memory_order_relaxed) && g_dumpRequested.exchange(false)) {
+        vktrace_stats_dump();
+    }
+}
+
+void vktrace_stats_dump() {
+    if (!g_vktraceStatsEnabled) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> dumpLock(g_dumpMutex);
+    std::vector<ThreadCounters*> threads;
+    {
+        std::lock_guard<std::mutex> lock(g_threadCountersMutex);
+        threads = g_threadCounters;
+    }
+
+    // sum up each entrypoint over all threads
+    std::vector<EntrypointTotals> entrypoints;
+    for (uint32_t page = 0; page < kPageCount; page++) {
+        for (uint32_t index = 0; index < kPageSize; index++) {
+            EntrypointTotals totals;
+            memset(&totals, 0, sizeof(totals));
+            totals.packetId = (uint16_t)(page * kPageSize + index);
+
+            bool bUsed = false;
+            for (ThreadCounters* pThread : threads) {
+                CounterPage* pPage = pThread->pages[page].load(std::memory_order_acquire);
+                EntrypointCounters* pCounters = (pPage != NULL) ? pPage->entrypoints[index].load(std::memory_order_acquire) : NULL;
+                if (pCounters == NULL) {
+                    continue;
+                }
+
+                bUsed = true;
+                for (uint32_t stage = 0; stage < VKTRACE_STATS_STAGE_COUNT; stage++) {
+                    const StageCounters& counters = pCounters->stages[stage];
+                    StageTotals& stageTotals = totals.stages[stage];
+                    stageTotals.count += counters.count.load(std::memory_order_relaxed);
+                    stageTotals.totalTime += counters.totalTime.load(std::memory_order_relaxed);
+                    stageTotals.maxTime = std::max(stageTotals.maxTime, counters.maxTime.load(std::memory_order_relaxed));
+                    for (uint32_t bucket = 0; bucket < VKTRACE_STATS_HISTOGRAM_BUCKETS; bucket++) {
+                        stageTotals.histogram[bucket] += counters.histogram[bucket].load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            if (bUsed) {
+                entrypoints.push_back(totals);
+            }
+        }
+    }
+
+    // the entrypoints that add the most capture overhead come first
+    std::sort(entrypoints.begin(), entrypoints.end(), [](const EntrypointTotals& a, const EntrypointTotals& b) {
+        return a.overheadTime() > b.overheadTime();
+    });
+
+    vktrace_LogAlways("Capture overhead statistics (%u threads), times in microseconds:", (uint32_t)threads.size());
+    for (const EntrypointTotals& totals : entrypoints) {
+        const char* pName = (totals.packetId >= VKTRACE_TPI_VK_vkApiVersion)
+                                ? vktrace_vk_packet_id_name((VKTRACE_TRACE_PACKET_ID_VK)totals.packetId)
+                                : "(non-API packet)";
+        vktrace_LogAlways("  %s: %" PRIu64 " calls, %.1f overhead", pName, totals.stages[VKTRACE_STATS_STAGE_API_CALL].count,
+                          totals.overheadTime() / 1000.0);
+
+        for (uint32_t stage = 0; stage < VKTRACE_STATS_STAGE_COUNT; stage++) {
+            const StageTotals& stageTotals = totals.stages[stage];
+            if (stageTotals.count == 0) {
+                continue;
+            }
+
+            vktrace_LogAlways("    %-9s total %.1f, mean %.2f, p50 < %.2f, p99 < %.2f, max %.2f", kStageNames[stage],
+                              stageTotals.totalTime / 1000.0, (double)stageTotals.totalTime / stageTotals.count / 1000.0,
+                              get_percentile(stageTotals, 0.5) / 1000.0, get_percentile(stageTotals, 0.99) / 1000.0,
+                              stageTotals.maxTime / 1000.0);
+        }
+    }
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2019 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//  Capture overhead statistics
+//
+//     When the VKTRACE_LAYER_STATS env var is set to 1, the trace layer measures how long each hooked entrypoint spends in
+//     each stage of capturing a call, and keeps a count, a total and a log2-bucketed latency histogram per stage and
+//     entrypoint. The counters are kept per thread, so recording a sample never takes a lock.
+//
+//     The statistics are written to the log when the last instance is destroyed, and on Linux whenever the traced
+//     process receives SIGUSR2. A SIGUSR2 handler the application installed before the layer is still called.
+//
+//     Only packets that are written to the trace file as they are captured are counted; packets that trim holds on to
+//     are not.
+
+#pragma once
+
+#include "vktrace_common.h"
+#include "vktrace_filelike.h"
+#include "vktrace_trace_packet_utils.h"
+
+// VKTRACE_LAYER_STATS env var enables the capture overhead statistics if
+// the value is 1. They are disabled by default.
+#define VKTRACE_LAYER_STATS_ENV "VKTRACE_LAYER_STATS"
+
+enum VktraceStatsStage {
+    VKTRACE_STATS_STAGE_API_CALL,   // the call down the layer chain
+    VKTRACE_STATS_STAGE_PACKET,     // building the packet around the call, including pNext serialization
+    VKTRACE_STATS_STAGE_PNEXT,      // serializing pNext chains into the packet
+    VKTRACE_STATS_STAGE_PAGEGUARD,  // page guard handling of mapped memory
+    VKTRACE_STATS_STAGE_WRITE,      // writing the packet to the trace file or socket
+    VKTRACE_STATS_STAGE_COUNT
+};
+
+// Histogram bucket i counts samples of less than 2^i nanoseconds; the last bucket also counts everything longer.
+#define VKTRACE_STATS_HISTOGRAM_BUCKETS 32
+
+extern bool g_vktraceStatsEnabled;
+
+void vktrace_stats_initialize();
+void vktrace_stats_record(uint16_t packetId, VktraceStatsStage stage, uint64_t duration);
+
+// Records the API call and packet stages from the timestamps in a finalized packet header.
+void vktrace_stats_record_packet(const vktrace_trace_packet_header* pHeader);
+
+// Writes the statistics of all threads to the log.
+void vktrace_stats_dump();
+
+// Writes pHeader to pFile, recording the stages of its packet and the write if the statistics are enabled.
+static inline void vktrace_stats_write_trace_packet(const vktrace_trace_packet_header* pHeader, FileLike* pFile) {
+    if (!g_vktraceStatsEnabled) {
+        vktrace_write_trace_packet(pHeader, pFile);
+        return;
+    }
+
+    vktrace_stats_record_packet(pHeader);
+    uint64_t startTime = vktrace_get_time();
+    vktrace_write_trace_packet(pHeader, pFile);
+    vktrace_stats_record(pHeader->packet_id, VKTRACE_STATS_STAGE_WRITE, vktrace_get_time() - startTime);
+}
+
+static inline void vktrace_stats_add_pnext_structs_to_trace_packet(vktrace_trace_packet_header* pHeader, void* pOut,
+                                                                   const void* pIn) {
+    if (!g_vktraceStatsEnabled) {
+        vktrace_add_pnext_structs_to_trace_packet(pHeader, pOut, pIn);
+        return;
+    }
+
+    uint64_t startTime = vktrace_get_time();
+    vktrace_add_pnext_structs_to_trace_packet(pHeader, pOut, pIn);
+    vktrace_stats_record(pHeader->packet_id, VKTRACE_STATS_STAGE_PNEXT, vktrace_get_time() - startTime);
+}
+
+// Records the time from construction to destruction as one sample of the given stage.
+class VktraceStatsStageTimer {
+   public:
+    VktraceStatsStageTimer(uint16_t packetId, VktraceStatsStage stage)
+        : m_packetId(packetId), m_stage(stage), m_startTime(g_vktraceStatsEnabled ? vktrace_get_time() : 0) {}
+
+    ~VktraceStatsStageTimer() {
+        if (g_vktraceStatsEnabled) {
+            vktrace_stats_record(m_packetId, m_stage, vktrace_get_time() - m_startTime);
+        }
+    }
+
+   private:
+    uint16_t m_packetId;
+    VktraceStatsStage m_stage;
+    uint64_t m_startTime;
+};
@@ -26,18 +26,31 @@
 #define VKREPLAY
 
 #include <inttypes.h>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 #include "vkreplay.h"
 #include "vkreplay_vkreplay.h"
 #include "vktrace_vk_packet_id.h"
 #include "vktrace_tracelog.h"
 
-static vkreplayer_settings s_defaultVkReplaySettings = {NULL, 1, UINT_MAX, UINT_MAX, true, false, NULL, NULL, NULL, "xcb"};
+static vkreplayer_settings s_defaultVkReplaySettings = {NULL, 1, UINT_MAX, UINT_MAX, true, false, NULL, NULL, NULL, "xcb", NULL, 0,
+                                                        false, false, false, false, false, 0, NULL, 60};
 
 vkReplay* g_pReplayer = NULL;
 VKTRACE_CRITICAL_SECTION g_handlerLock;
 PFN_vkDebugReportCallbackEXT g_fpDbgMsgCallback;
 vktrace_replay::VKTRACE_DBG_MSG_CALLBACK_FUNCTION g_fpVktraceCallback = NULL;
 
+// Packets interpreted ahead of replay by the worker threads of a parallel sequencer keep the structs whose pNext chains
+// hold handles, and the handles are remapped by the replay thread when the packet is replayed: the object mapper belongs
+// to the replay thread, and the objects of the handles may not have been created when the packet is interpreted.
+static VKTRACE_THREAD_LOCAL std::vector<void*>* t_pDeferredPnextStructs = NULL;
+static std::mutex s_deferredPnextMutex;
+static std::unordered_map<vktrace_trace_packet_header*, std::vector<void*> > s_deferredPnextStructs;
+static std::atomic<size_t> s_deferredPnextPacketCount(0);
+
 static VKAPI_ATTR VkBool32 VKAPI_CALL vkErrorHandler(VkFlags msgFlags, VkDebugReportObjectTypeEXT objType, uint64_t srcObjectHandle,
                                                      size_t location, int32_t msgCode, const char* pLayerPrefix, const char* pMsg,
                                                      void* pUserData) {
@@ -130,9 +143,48 @@ vktrace_trace_packet_header* VKTRACER_CDECL VkReplayInterpret(vktrace_trace_pack
     return pInterpretedHeader;
 }
 
+vktrace_trace_packet_header* VKTRACER_CDECL VkReplayInterpretAhead(vktrace_trace_packet_header* pPacket) {
+    std::vector<void*> pnextStructs;
+    t_pDeferredPnextStructs = &pnextStructs;
+    vktrace_trace_packet_header* pInterpretedHeader = interpret_trace_packet_vk(pPacket);
+    t_pDeferredPnextStructs = NULL;
+    if (pInterpretedHeader == NULL) {
+        vktrace_LogError("Unrecognized Vulkan packet_id: %u", pPacket->packet_id);
+    }
+
+    // the structs of a packet that was read ahead and dropped before it was replayed are left behind, and are replaced by
+    // those of the next packet at the same address
+    if (!pnextStructs.empty() || s_deferredPnextPacketCount.load(std::memory_order_acquire) > 0) {
+        std::lock_guard<std::mutex> lock(s_deferredPnextMutex);
+        if (pnextStructs.empty()) {
+            s_deferredPnextStructs.erase(pPacket);
+        } else {
+            s_deferredPnextStructs[pPacket].swap(pnextStructs);
+        }
+        s_deferredPnextPacketCount.store(s_deferredPnextStructs.size(), std::memory_order_release);
+    }
+    return pInterpretedHeader;
+}
+
+static void remap_deferred_pnext_handles(vktrace_trace_packet_header* pPacket) {
+    std::lock_guard<std::mutex> lock(s_deferredPnextMutex);
+    auto pnextStructs = s_deferredPnextStructs.find(pPacket);
+    if (pnextStructs == s_deferredPnextStructs.end()) {
+        return;
+    }
+    for (void* pStruct : pnextStructs->second) {
+        g_pReplayer->interpret_pnext_handles(pStruct);
+    }
+    s_deferredPnextStructs.erase(pnextStructs);
+    s_deferredPnextPacketCount.store(s_deferredPnextStructs.size(), std::memory_order_release);
+}
+
 vktrace_replay::VKTRACE_REPLAY_RESULT VKTRACER_CDECL VkReplayReplay(vktrace_trace_packet_header* pPacket) {
     vktrace_replay::VKTRACE_REPLAY_RESULT result = vktrace_replay::VKTRACE_REPLAY_ERROR;
     if (g_pReplayer != NULL) {
+        if (s_deferredPnextPacketCount.load(std::memory_order_acquire) > 0) {
+            remap_deferred_pnext_handles(pPacket);
+        }
         result = g_pReplayer->replay(pPacket);
 
         if (result == vktrace_replay::VKTRACE_REPLAY_SUCCESS) result = g_pReplayer->pop_validation_msgs();
@@ -161,10 +213,25 @@ void VKTRACER_CDECL VkReplayResetFrameNumber(int frameNumber) {
     }
 }
 
+void VKTRACER_CDECL VkReplayGetRemapStats(uint64_t* pCount, uint64_t* pTime) {
+    *pCount = 0;
+    *pTime = 0;
+    if (g_pReplayer != NULL) {
+        g_pReplayer->get_remap_stats(pCount, pTime);
+    }
+}
+
 // This function is called from vkreplay_process_pnext_structs in vktrace_vk_vk_packets.h
 // to translate handles inside of pnext structures.  We call g_pReplayer->interpret_pnext_handles
 // because only an instance of the vkReplay class can interpret handles.
 void vkreplay_interpret_pnext_handles(void* struct_ptr) {
+    if (t_pDeferredPnextStructs != NULL) {
+        // the handles of the struct itself aren't remapped here, only those of its pNext chain
+        if (struct_ptr != NULL && ((VkApplicationInfo*)struct_ptr)->pNext != NULL) {
+            t_pDeferredPnextStructs->push_back(struct_ptr);
+        }
+        return;
+    }
     if (g_pReplayer != NULL) {
         g_pReplayer->interpret_pnext_handles(struct_ptr);
     }
@@ -33,9 +33,11 @@ extern int VKTRACER_CDECL VkReplayInitialize(vktrace_replay::ReplayDisplay* pDis
                                              vktrace_trace_file_header* pFileheader);
 extern void VKTRACER_CDECL VkReplayDeinitialize();
 extern vktrace_trace_packet_header* VKTRACER_CDECL VkReplayInterpret(vktrace_trace_packet_header* pPacket);
+extern vktrace_trace_packet_header* VKTRACER_CDECL VkReplayInterpretAhead(vktrace_trace_packet_header* pPacket);
 extern vktrace_replay::VKTRACE_REPLAY_RESULT VKTRACER_CDECL VkReplayReplay(vktrace_trace_packet_header* pPacket);
 extern int VKTRACER_CDECL VkReplayDump();
 extern int VKTRACER_CDECL VkReplayGetFrameNumber();
 extern void VKTRACER_CDECL VkReplayResetFrameNumber(int frameNumber);
+extern void VKTRACER_CDECL VkReplayGetRemapStats(uint64_t* pCount, uint64_t* pTime);
 
 extern PFN_vkDebugReportCallbackEXT g_fpDbgMsgCallback;
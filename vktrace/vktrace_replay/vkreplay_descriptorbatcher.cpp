@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2019 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vkreplay_descriptorbatcher.h"
+
+enum DescriptorInfoKind { DESCRIPTOR_INFO_NONE, DESCRIPTOR_INFO_IMAGE, DESCRIPTOR_INFO_BUFFER, DESCRIPTOR_INFO_TEXEL_BUFFER };
+
+static DescriptorInfoKind getDescriptorInfoKind(VkDescriptorType type) {
+    switch (type) {
+        case VK_DESCRIPTOR_TYPE_SAMPLER:
+        case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+        case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+        case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+        case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+            return DESCRIPTOR_INFO_IMAGE;
+        case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+        case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+        case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+        case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+            return DESCRIPTOR_INFO_BUFFER;
+        case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+        case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+            return DESCRIPTOR_INFO_TEXEL_BUFFER;
+        default:
+            // inline uniform blocks and acceleration structures are written through the pNext chain
+            return DESCRIPTOR_INFO_NONE;
+    }
+}
+
+bool vkReplayDescriptorBatcher::getContents(const VkWriteDescriptorSet& write, DescriptorContents* pContents) const {
+    if (write.pNext != NULL || write.descriptorCount != 1) {
+        return false;
+    }
+
+    pContents->type = write.descriptorType;
+    switch (getDescriptorInfoKind(write.descriptorType)) {
+        case DESCRIPTOR_INFO_IMAGE:
+            pContents->values[0] = (uint64_t)write.pImageInfo[0].sampler;
+            pContents->values[1] = (uint64_t)write.pImageInfo[0].imageView;
+            pContents->values[2] = (uint64_t)write.pImageInfo[0].imageLayout;
+            return true;
+        case DESCRIPTOR_INFO_BUFFER:
+            pContents->values[0] = (uint64_t)write.pBufferInfo[0].buffer;
+            pContents->values[1] = write.pBufferInfo[0].offset;
+            pContents->values[2] = write.pBufferInfo[0].range;
+            return true;
+        case DESCRIPTOR_INFO_TEXEL_BUFFER:
+            pContents->values[0] = (uint64_t)write.pTexelBufferView[0];
+            pContents->values[1] = 0;
+            pContents->values[2] = 0;
+            return true;
+        default:
+            return false;
+    }
+}
+
+void vkReplayDescriptorBatcher::addHandleReferences(VkDescriptorSet set, const DescriptorContents& contents) {
+    // the sampler and image view of image infos, and the buffer or buffer view of the others
+    uint32_t handleCount = (getDescriptorInfoKind(contents.type) == DESCRIPTOR_INFO_IMAGE) ? 2 : 1;
+    for (uint32_t i = 0; i < handleCount; i++) {
+        if (contents.values[i] != 0) {
+            m_setsByHandle[contents.values[i]].insert(set);
+        }
+    }
+}
+
+void vkReplayDescriptorBatcher::forgetHandle(uint64_t handle) {
+    auto sets = m_setsByHandle.find(handle);
+    if (sets == m_setsByHandle.end()) {
+        return;
+    }
+    for (VkDescriptorSet set : sets->second) {
+        forgetSet(set);
+    }
+    m_setsByHandle.erase(sets);
+}
+
+uint32_t vkReplayDescriptorBatcher::removeRedundantWrites(uint32_t writeCount, VkWriteDescriptorSet* pWrites) {
+    if (!m_enabled) {
+        return writeCount;
+    }
+
+    uint32_t keptCount = 0;
+    for (uint32_t i = 0; i < writeCount; i++) {
+        const VkWriteDescriptorSet& write = pWrites[i];
+        DescriptorContents contents;
+        if (!getContents(write, &contents)) {
+            forgetSet(write.dstSet);
+        } else {
+            std::unordered_map<uint64_t, DescriptorContents>& descriptors = m_sets[write.dstSet];
+            uint64_t key = ((uint64_t)write.dstBinding << 32) | write.dstArrayElement;
+            auto descriptor = descriptors.find(key);
+            if (descriptor != descriptors.end() && descriptor->second == contents) {
+                m_redundantWriteCount++;
+                continue;
+            }
+            descriptors[key] = contents;
+            addHandleReferences(write.dstSet, contents);
+        }
+
+        if (keptCount != i) {
+            pWrites[keptCount] = write;
+        }
+        keptCount++;
+    }
+    return keptCount;
+}
+
+bool vkReplayDescriptorBatcher::canBatch(uint32_t writeCount, const VkWriteDescriptorSet* pWrites, uint32_t copyCount) const {
+    if (!m_enabled || copyCount > 0) {
+        return false;
+    }
+    for (uint32_t i = 0; i < writeCount; i++) {
+        if (pWrites[i].pNext != NULL || getDescriptorInfoKind(pWrites[i].descriptorType) == DESCRIPTOR_INFO_NONE) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void vkReplayDescriptorBatcher::add(VkDevice device, uint32_t writeCount, const VkWriteDescriptorSet* pWrites) {
+    m_device = device;
+    m_pendingCallCount++;
+
+    for (uint32_t i = 0; i < writeCount; i++) {
+        const VkWriteDescriptorSet& write = pWrites[i];
+        PendingWrite pendingWrite;
+        pendingWrite.info = write;
+        switch (getDescriptorInfoKind(write.descriptorType)) {
+            case DESCRIPTOR_INFO_IMAGE:
+                pendingWrite.firstInfo = m_imageInfos.size();
+                m_imageInfos.insert(m_imageInfos.end(), write.pImageInfo, write.pImageInfo + write.descriptorCount);
+                break;
+            case DESCRIPTOR_INFO_BUFFER:
+                pendingWrite.firstInfo = m_bufferInfos.size();
+                m_bufferInfos.insert(m_bufferInfos.end(), write.pBufferInfo, write.pBufferInfo + write.descriptorCount);
+                break;
+            default:
+                pendingWrite.firstInfo = m_texelBufferViews.size();
+                m_texelBufferViews.insert(m_texelBufferViews.end(), write.pTexelBufferView,
+                                          write.pTexelBufferView + write.descriptorCount);
+                break;
+        }
+        m_writes.push_back(pendingWrite);
+    }
+}
+
+void vkReplayDescriptorBatcher::flush(PFN_vkUpdateDescriptorSets pfnUpdateDescriptorSets) {
+    if (!isPending()) {
+        return;
+    }
+
+    m_writeInfos.clear();
+    for (const PendingWrite& pendingWrite : m_writes) {
+        VkWriteDescriptorSet info = pendingWrite.info;
+        // only the array of the descriptor type is valid, the others may point anywhere in the freed packet
+        info.pImageInfo = NULL;
+        info.pBufferInfo = NULL;
+        info.pTexelBufferView = NULL;
+        if (info.descriptorCount > 0) {
+            switch (getDescriptorInfoKind(info.descriptorType)) {
+                case DESCRIPTOR_INFO_IMAGE:
+                    info.pImageInfo = &m_imageInfos[pendingWrite.firstInfo];
+                    break;
+                case DESCRIPTOR_INFO_BUFFER:
+                    info.pBufferInfo = &m_bufferInfos[pendingWrite.firstInfo];
+                    break;
+                default:
+                    info.pTexelBufferView = &m_texelBufferViews[pendingWrite.firstInfo];
+                    break;
+            }
+        }
+        m_writeInfos.push_back(info);
+    }
+
+    if (!m_writeInfos.empty()) {
+        pfnUpdateDescriptorSets(m_device, (uint32_t)m_writeInfos.size(), m_writeInfos.data(), 0, NULL);
+        m_updateCallCount++;
+        m_batchedCallCount += m_pendingCallCount - 1;
+    }
+
+    m_device = VK_NULL_HANDLE;
+    m_pendingCallCount = 0;
+    m_writes.clear();
+    m_imageInfos.clear();
+    m_bufferInfos.clear();
+    m_texelBufferViews.clear();
+}
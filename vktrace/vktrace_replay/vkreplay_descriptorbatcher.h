@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2019 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//  Replay descriptor update batcher
+//
+//     Descriptor heavy applications call vkUpdateDescriptorSets thousands of times per frame, often with a single write
+//     and often rewriting what the descriptor already holds. When batching is enabled, vkreplay:
+//
+//     - drops the writes of a single descriptor that write the same handles, offsets and layouts as the last write to
+//       that descriptor. Writes of several descriptors can continue into the next bindings, which aren't known here, so
+//       they make the contents of their whole set unknown, as do copies, template updates and the reallocation of a set.
+//       The destruction of an image view, buffer, buffer view or sampler makes the contents of every set it was written
+//       to unknown, as the driver may hand out its handle again.
+//
+//     - holds back the remapped writes of a vkUpdateDescriptorSets without copies instead of making the call, and
+//       appends the writes of the following vkUpdateDescriptorSets of the same device. The batch is written with a
+//       single vkUpdateDescriptorSets as soon as any other packet is replayed, so the sets are up to date before they are
+//       bound, copied or freed. Copies aren't batched as they would see the writes of the later packets.
+//
+//     Writes with a pNext chain are never held back or dropped.
+
+#pragma once
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+class vkReplayDescriptorBatcher {
+   public:
+    vkReplayDescriptorBatcher()
+        : m_enabled(false),
+          m_device(VK_NULL_HANDLE),
+          m_pendingCallCount(0),
+          m_updateCallCount(0),
+          m_batchedCallCount(0),
+          m_redundantWriteCount(0) {}
+    ~vkReplayDescriptorBatcher() {}
+
+    void setEnabled(bool enabled) { m_enabled = enabled; }
+    bool isEnabled() const { return m_enabled; }
+
+    // Removes the remapped writes that don't change their descriptor from pWrites, keeping the order of the other writes,
+    // and returns the number of writes left.
+    uint32_t removeRedundantWrites(uint32_t writeCount, VkWriteDescriptorSet* pWrites);
+
+    // Forgets the contents of set, which has been copied to, updated with a template, freed or allocated.
+    void forgetSet(VkDescriptorSet set) { m_sets.erase(set); }
+
+    // Forgets the contents of the sets that handle, a remapped image view, buffer, buffer view or sampler that has been
+    // destroyed, was written to.
+    void forgetHandle(uint64_t handle);
+
+    bool canBatch(uint32_t writeCount, const VkWriteDescriptorSet* pWrites, uint32_t copyCount) const;
+
+    bool isPending() const { return m_device != VK_NULL_HANDLE; }
+    VkDevice getPendingDevice() const { return m_device; }
+
+    // Copies the remapped writes into the pending batch of device.
+    void add(VkDevice device, uint32_t writeCount, const VkWriteDescriptorSet* pWrites);
+
+    // Writes the pending batch, if any.
+    void flush(PFN_vkUpdateDescriptorSets pfnUpdateDescriptorSets);
+
+    uint64_t getUpdateCallCount() const { return m_updateCallCount; }
+    uint64_t getBatchedCallCount() const { return m_batchedCallCount; }
+    uint64_t getRedundantWriteCount() const { return m_redundantWriteCount; }
+
+   private:
+    // The handles, offset, range or layout written to one descriptor.
+    struct DescriptorContents {
+        VkDescriptorType type;
+        uint64_t values[3];
+
+        bool operator==(const DescriptorContents& other) const {
+            return type == other.type && values[0] == other.values[0] && values[1] == other.values[1] &&
+                   values[2] == other.values[2];
+        }
+    };
+
+    // The info arrays of the pending writes are stored by index, as the vectors move when they grow.
+    struct PendingWrite {
+        VkWriteDescriptorSet info;
+        size_t firstInfo;
+    };
+
+    bool getContents(const VkWriteDescriptorSet& write, DescriptorContents* pContents) const;
+    void addHandleReferences(VkDescriptorSet set, const DescriptorContents& contents);
+
+    bool m_enabled;
+
+    // Last contents of the descriptors of each set, by binding in the high and array element in the low 32 bits.
+    std::unordered_map<VkDescriptorSet, std::unordered_map<uint64_t, DescriptorContents> > m_sets;
+
+    // Sets whose remembered contents may refer to a handle. Sets aren't removed when they are forgotten or rewritten,
+    // which only makes the destruction of the handle forget a set needlessly.
+    std::unordered_map<uint64_t, std::unordered_set<VkDescriptorSet> > m_setsByHandle;
+
+    VkDevice m_device;
+    uint32_t m_pendingCallCount;
+    std::vector<PendingWrite> m_writes;
+    std::vector<VkDescriptorImageInfo> m_imageInfos;
+    std::vector<VkDescriptorBufferInfo> m_bufferInfos;
+    std::vector<VkBufferView> m_texelBufferViews;
+    std::vector<VkWriteDescriptorSet> m_writeInfos;
+
+    // vkUpdateDescriptorSets calls made by the batcher, traced vkUpdateDescriptorSets that were merged into another call,
+    // and writes that weren't made because they didn't change their descriptor.
+    uint64_t m_updateCallCount;
+    uint64_t m_batchedCallCount;
+    uint64_t m_redundantWriteCount;
+};
@@ -54,10 +54,12 @@ vktrace_trace_packet_replay_library* ReplayFactory::Create(uint8_t tracerId) {
             pReplayer->Initialize = VkReplayInitialize;
             pReplayer->Deinitialize = VkReplayDeinitialize;
             pReplayer->Interpret = VkReplayInterpret;
+            pReplayer->InterpretAhead = VkReplayInterpretAhead;
             pReplayer->Replay = VkReplayReplay;
             pReplayer->Dump = VkReplayDump;
             pReplayer->GetFrameNumber = VkReplayGetFrameNumber;
             pReplayer->ResetFrameNumber = VkReplayResetFrameNumber;
+            pReplayer->GetRemapStats = VkReplayGetRemapStats;
         }
     }
 
@@ -66,6 +66,7 @@ typedef vktrace_replay::VKTRACE_REPLAY_RESULT(VKTRACER_CDECL *funcptr_vkreplayer
 typedef int(VKTRACER_CDECL *funcptr_vkreplayer_dump)();
 typedef int(VKTRACER_CDECL *funcptr_vkreplayer_getframenumber)();
 typedef void(VKTRACER_CDECL *funcptr_vkreplayer_resetframenumber)(int frameNumber);
+typedef void(VKTRACER_CDECL *funcptr_vkreplayer_getremapstats)(uint64_t *pCount, uint64_t *pTime);
 }
 
 struct vktrace_trace_packet_replay_library {
@@ -79,10 +80,12 @@ struct vktrace_trace_packet_replay_library {
     funcptr_vkreplayer_initialize Initialize;
     funcptr_vkreplayer_deinitialize Deinitialize;
     funcptr_vkreplayer_interpret Interpret;
+    funcptr_vkreplayer_interpret InterpretAhead;  // Interpret for threads other than the replay thread
     funcptr_vkreplayer_replay Replay;
     funcptr_vkreplayer_dump Dump;
     funcptr_vkreplayer_getframenumber GetFrameNumber;
     funcptr_vkreplayer_resetframenumber ResetFrameNumber;
+    funcptr_vkreplayer_getremapstats GetRemapStats;
 };
 
 class ReplayFactory {
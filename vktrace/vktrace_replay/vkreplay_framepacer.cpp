@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2019 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vkreplay_framepacer.h"
+
+#include <inttypes.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+
+extern "C" {
+#include "vktrace_tracelog.h"
+#include "vktrace_trace_packet_utils.h"
+}
+
+namespace vktrace_replay {
+
+// Waits spin for their last 2 ms, which covers the oversleep of a sleep on most systems.
+static const uint64_t kSpinTime = 2000000;
+
+// Frames longer than their target by more than 1 ms are counted as late.
+static const uint64_t kLateThreshold = 1000000;
+
+FramePacer::FramePacer(FramePacingMode mode, unsigned int frameRate)
+    : m_mode(mode),
+      m_framePeriod(frameRate > 0 ? 1000000000 / frameRate : 0),
+      m_frameStarted(false),
+      m_traceFrameStart(0),
+      m_replayFrameStart(0),
+      m_frameCount(0),
+      m_lateFrameCount(0),
+      m_totalDeviation(0),
+      m_maxDeviation(0) {}
+
+bool FramePacer::parse_mode(const char *pName, FramePacingMode *pMode) {
+    if (pName == NULL || !strcmp(pName, "none")) {
+        *pMode = FRAME_PACING_NONE;
+    } else if (!strcmp(pName, "captured")) {
+        *pMode = FRAME_PACING_CAPTURED;
+    } else if (!strcmp(pName, "fixed")) {
+        *pMode = FRAME_PACING_FIXED;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void FramePacer::wait_until(uint64_t time) const {
+    uint64_t now = vktrace_get_time();
+    if (time > now + kSpinTime) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(time - now - kSpinTime));
+    }
+    while (vktrace_get_time() < time) {
+    }
+}
+
+void FramePacer::wait_for_packet(const vktrace_trace_packet_header *pPacket) {
+    if (m_mode != FRAME_PACING_CAPTURED) {
+        return;
+    }
+
+    if (!m_frameStarted) {
+        m_traceFrameStart = pPacket->entrypoint_begin_time;
+        m_replayFrameStart = vktrace_get_time();
+        m_frameStarted = true;
+    } else if (pPacket->entrypoint_begin_time > m_traceFrameStart) {
+        wait_until(m_replayFrameStart + (pPacket->entrypoint_begin_time - m_traceFrameStart));
+    }
+}
+
+void FramePacer::end_frame(const vktrace_trace_packet_header *pPacket) {
+    uint64_t now = vktrace_get_time();
+    if (m_mode == FRAME_PACING_CAPTURED) {
+        if (m_frameStarted && pPacket->entrypoint_end_time > m_traceFrameStart) {
+            add_frame_time(now - m_replayFrameStart, pPacket->entrypoint_end_time - m_traceFrameStart);
+        }
+        m_traceFrameStart = pPacket->entrypoint_end_time;
+        m_replayFrameStart = now;
+        m_frameStarted = true;
+    } else if (m_mode == FRAME_PACING_FIXED) {
+        if (!m_frameStarted) {
+            m_replayFrameStart = now;
+            m_frameStarted = true;
+            return;
+        }
+
+        uint64_t frameDue = m_replayFrameStart + m_framePeriod;
+        wait_until(frameDue);
+        now = vktrace_get_time();
+        add_frame_time(now - m_replayFrameStart, m_framePeriod);
+        m_replayFrameStart = (now - frameDue < m_framePeriod) ? frameDue : now;
+    }
+}
+
+void FramePacer::reset() { m_frameStarted = false; }
+
+void FramePacer::add_frame_time(uint64_t frameTime, uint64_t targetTime) {
+    uint64_t deviation = (frameTime > targetTime) ? frameTime - targetTime : targetTime - frameTime;
+    m_frameCount++;
+    m_totalDeviation += deviation;
+    if (deviation > m_maxDeviation) {
+        m_maxDeviation = deviation;
+    }
+    if (frameTime > targetTime + kLateThreshold) {
+        m_lateFrameCount++;
+    }
+}
+
+void FramePacer::report() const {
+    if (m_frameCount == 0) {
+        return;
+    }
+    vktrace_LogAlways("Frame pacing: %" PRIu64 " frame%s, deviation from target mean %.3f ms, max %.3f ms, %" PRIu64 " late",
+                      m_frameCount, m_frameCount != 1 ? "s" : "", (double)m_totalDeviation / m_frameCount / 1000000,
+                      (double)m_maxDeviation / 1000000, m_lateFrameCount);
+}
+
+} /* namespace vktrace_replay */
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2019 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//  Replay frame pacer
+//
+//     By default packets are replayed back to back, as fast as the driver takes them. The frame pacer can instead
+//     replay them with the timing they were captured with, or at a fixed frame rate:
+//
+//     - with captured timing, each packet is replayed no earlier than it was called in the trace, relative to the end of
+//       the last present. Frames that take longer to replay than they took in the trace aren't made up for, so the pacing
+//       problems of the trace are reproduced without the delays of the replay adding up.
+//
+//     - at a fixed rate, the replay waits after each present until the next frame is due. A frame that is late by more
+//       than a frame period restarts the schedule instead of making the following frames short.
+//
+//     Waits sleep until shortly before they end and spin for the rest, as sleeps alone aren't precise enough. The time
+//     of each frame is compared to the time of the frame in the trace or to the frame period, and the deviation is
+//     reported at the end of the replay.
+
+#pragma once
+
+#include <stdint.h>
+
+extern "C" {
+#include "vktrace_trace_packet_identifiers.h"
+}
+
+namespace vktrace_replay {
+
+enum FramePacingMode { FRAME_PACING_NONE, FRAME_PACING_CAPTURED, FRAME_PACING_FIXED };
+
+class FramePacer {
+   public:
+    FramePacer(FramePacingMode mode, unsigned int frameRate);
+    ~FramePacer() {}
+
+    // Parses a -fp setting, where NULL selects FRAME_PACING_NONE. Returns false for an unknown mode.
+    static bool parse_mode(const char *pName, FramePacingMode *pMode);
+
+    bool is_enabled() const { return m_mode != FRAME_PACING_NONE; }
+
+    // Waits until pPacket is due. Called before each API packet is replayed.
+    void wait_for_packet(const vktrace_trace_packet_header *pPacket);
+
+    // Records the time of the frame ended by pPacket, and waits for the next frame to be due. Called after the packet
+    // that ended a frame has been replayed.
+    void end_frame(const vktrace_trace_packet_header *pPacket);
+
+    // Forgets the frame in progress, as the replay restarts from a bookmark.
+    void reset();
+
+    // Logs the deviation of the frame times from their targets.
+    void report() const;
+
+   private:
+    void wait_until(uint64_t time) const;
+    void add_frame_time(uint64_t frameTime, uint64_t targetTime);
+
+    FramePacingMode m_mode;
+    uint64_t m_framePeriod;
+
+    // The trace and replay times at which the frame in progress started, if m_frameStarted is true.
+    bool m_frameStarted;
+    uint64_t m_traceFrameStart;
+    uint64_t m_replayFrameStart;
+
+    uint64_t m_frameCount;
+    uint64_t m_lateFrameCount;
+    uint64_t m_totalDeviation;
+    uint64_t m_maxDeviation;
+};
+
+} /* namespace vktrace_replay */
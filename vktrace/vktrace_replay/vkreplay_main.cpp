@@ -37,11 +37,14 @@
 #include "vkreplay_main.h"
 #include "vkreplay_factory.h"
 #include "vkreplay_seq.h"
+#include "vkreplay_parallelseq.h"
+#include "vkreplay_framepacer.h"
 #include "vkreplay_vkdisplay.h"
 #include "screenshot_parsing.h"
 #include "vktrace_vk_packet_id.h"
 
-vkreplayer_settings replaySettings = {NULL, 1, UINT_MAX, UINT_MAX, true, false, NULL, NULL, NULL, NULL};
+vkreplayer_settings replaySettings = {NULL, 1, UINT_MAX, UINT_MAX, true, false, NULL, NULL, NULL, NULL, NULL, 0,
+                                      false, false, false, false, false, 0, NULL, 60};
 
 #if defined(ANDROID)
 const char* env_var_screenshot_frames = "debug.vulkan.screenshot";
@@ -118,6 +121,76 @@ vktrace_SettingInfo g_settings_info[] = {
      {&replaySettings.exitOnAnyError},
      TRUE,
      "Exit if an error occurs during replay, default is FALSE"},
+    {"ps",
+     "PerfStats",
+     VKTRACE_SETTING_STRING,
+     {&replaySettings.perfStatsFile},
+     {&replaySettings.perfStatsFile},
+     TRUE,
+     "Write the time spent reading, interpreting and replaying packets and remapping handles as JSON to <string>."},
+    {"sa",
+     "SubAllocate",
+     VKTRACE_SETTING_UINT,
+     {&replaySettings.subAllocationBlockSize},
+     {&replaySettings.subAllocationBlockSize},
+     TRUE,
+     "Carve the memory allocations of the trace out of blocks of <uint> MB per memory type, default is 0 (disabled)."},
+    {"pm",
+     "PersistentMap",
+     VKTRACE_SETTING_BOOL,
+     {&replaySettings.persistentMapping},
+     {&replaySettings.persistentMapping},
+     TRUE,
+     "Map host visible memory once and keep it mapped until it is freed, default is FALSE."},
+    {"cs",
+     "CoalesceSubmits",
+     VKTRACE_SETTING_BOOL,
+     {&replaySettings.coalesceSubmits},
+     {&replaySettings.coalesceSubmits},
+     TRUE,
+     "Merge consecutive vkQueueSubmits to the same queue into one call, default is FALSE."},
+    {"bd",
+     "BatchDescriptorUpdates",
+     VKTRACE_SETTING_BOOL,
+     {&replaySettings.batchDescriptorUpdates},
+     {&replaySettings.batchDescriptorUpdates},
+     TRUE,
+     "Skip redundant descriptor writes and merge consecutive vkUpdateDescriptorSets into one call, default is FALSE."},
+    {"rs",
+     "RemoveRedundantState",
+     VKTRACE_SETTING_BOOL,
+     {&replaySettings.removeRedundantState},
+     {&replaySettings.removeRedundantState},
+     TRUE,
+     "Skip pipeline, descriptor set, viewport, scissor and vertex buffer bindings that are already bound, default is FALSE."},
+    {"rw",
+     "RelaxWaits",
+     VKTRACE_SETTING_BOOL,
+     {&replaySettings.relaxWaits},
+     {&replaySettings.relaxWaits},
+     TRUE,
+     "Defer fence and idle waits to the next packet that depends on them, default is FALSE."},
+    {"it",
+     "InterpretThreads",
+     VKTRACE_SETTING_UINT,
+     {&replaySettings.interpretThreadCount},
+     {&replaySettings.interpretThreadCount},
+     TRUE,
+     "Read and interpret packets ahead of the replay on <uint> worker threads, default is 0 (disabled)."},
+    {"fp",
+     "FramePacing",
+     VKTRACE_SETTING_STRING,
+     {&replaySettings.framePacing},
+     {&replaySettings.framePacing},
+     TRUE,
+     "Pace the replay of frames. Options are \"none\", \"captured\" (timing of the trace) and \"fixed\" (-fr rate)."},
+    {"fr",
+     "FrameRate",
+     VKTRACE_SETTING_UINT,
+     {&replaySettings.frameRate},
+     {&replaySettings.frameRate},
+     TRUE,
+     "Frames per second replayed with fixed frame pacing, default is 60."},
 #if defined(PLATFORM_LINUX)
     {"ds",
      "DisplayServer",
@@ -151,7 +224,66 @@ vktrace_SettingInfo g_settings_info[] = {
 vktrace_SettingGroup g_replaySettingGroup = {"vkreplay", sizeof(g_settings_info) / sizeof(g_settings_info[0]), &g_settings_info[0]};
 
 namespace vktrace_replay {
-int main_loop(vktrace_replay::ReplayDisplay display, Sequencer& seq, vktrace_trace_packet_replay_library* replayerArray[]) {
+
+// Totals for the PerfStats option, times are in nanoseconds.
+struct ReplayPerfStats {
+    uint64_t packets;
+    uint64_t bytes;
+    uint64_t readTime;
+    uint64_t interpretTime;
+    uint64_t replayTime;
+    uint64_t remapCount;
+    uint64_t remapTime;
+};
+
+static double per_packet(uint64_t time, uint64_t packets) { return (packets > 0) ? (double)time / packets : 0.0; }
+
+static void write_perf_stats(const char* pFilename, const ReplayPerfStats& stats, uint64_t totalTime) {
+    double seconds = totalTime / 1000000000.0;
+    double packetsPerSec = (totalTime > 0) ? stats.packets / seconds : 0.0;
+    // remapping happens inside the replay of a packet, so it's part of the replay time
+    vktrace_LogAlways("%" PRIu64 " packets, %.1f packets/s, per packet: read %.1f ns, interpret %.1f ns, replay %.1f ns "
+                      "(remap %.1f ns)",
+                      stats.packets, packetsPerSec, per_packet(stats.readTime, stats.packets),
+                      per_packet(stats.interpretTime, stats.packets), per_packet(stats.replayTime, stats.packets),
+                      per_packet(stats.remapTime, stats.packets));
+
+    FILE* pFile = fopen(pFilename, "w");
+    if (pFile == NULL) {
+        vktrace_LogError("Unable to write replay statistics to %s.", pFilename);
+        return;
+    }
+    fprintf(pFile, "{\n");
+    fprintf(pFile, "    \"packets\": %" PRIu64 ",\n", stats.packets);
+    fprintf(pFile, "    \"bytes\": %" PRIu64 ",\n", stats.bytes);
+    fprintf(pFile, "    \"seconds\": %.6f,\n", seconds);
+    fprintf(pFile, "    \"packets_per_sec\": %.1f,\n", packetsPerSec);
+    fprintf(pFile, "    \"read_ns\": %" PRIu64 ",\n", stats.readTime);
+    fprintf(pFile, "    \"interpret_ns\": %" PRIu64 ",\n", stats.interpretTime);
+    fprintf(pFile, "    \"replay_ns\": %" PRIu64 ",\n", stats.replayTime);
+    fprintf(pFile, "    \"remap_ns\": %" PRIu64 ",\n", stats.remapTime);
+    fprintf(pFile, "    \"remaps\": %" PRIu64 ",\n", stats.remapCount);
+    fprintf(pFile, "    \"read_ns_per_packet\": %.1f,\n", per_packet(stats.readTime, stats.packets));
+    fprintf(pFile, "    \"interpret_ns_per_packet\": %.1f,\n", per_packet(stats.interpretTime, stats.packets));
+    fprintf(pFile, "    \"replay_ns_per_packet\": %.1f,\n", per_packet(stats.replayTime, stats.packets));
+    fprintf(pFile, "    \"remap_ns_per_packet\": %.1f\n", per_packet(stats.remapTime, stats.packets));
+    fprintf(pFile, "}\n");
+    fclose(pFile);
+}
+
+// Interprets the API packets that main_loop replays, on the worker threads of a parallel sequencer.
+static bool interpret_api_packet(vktrace_trace_packet_replay_library* replayerArray[], vktrace_trace_packet_header* pPacket,
+                                 vktrace_trace_packet_header** ppInterpreted) {
+    if (pPacket->packet_id < VKTRACE_TPI_VK_vkApiVersion || pPacket->tracer_id >= VKTRACE_MAX_TRACER_ID_ARRAY_SIZE ||
+        replayerArray[pPacket->tracer_id] == NULL) {
+        return false;
+    }
+    *ppInterpreted = replayerArray[pPacket->tracer_id]->InterpretAhead(pPacket);
+    return true;
+}
+
+int main_loop(vktrace_replay::ReplayDisplay display, AbstractSequencer& seq,
+              vktrace_trace_packet_replay_library* replayerArray[]) {
     int err = 0;
     vktrace_trace_packet_header* packet;
     unsigned int res;
@@ -162,6 +294,16 @@ int main_loop(vktrace_replay::ReplayDisplay display, Sequencer& seq, vktrace_tra
     bool trace_running = true;
     unsigned int prevFrameNumber = UINT_MAX;
 
+    // the steps are only timed when the statistics are written, to keep the clock reads out of normal replays
+    bool bPerfStats = (replaySettings.perfStatsFile != NULL);
+    ReplayPerfStats perfStats;
+    memset(&perfStats, 0, sizeof(perfStats));
+    uint64_t perfStartTime = vktrace_get_time();
+
+    FramePacingMode framePacingMode = FRAME_PACING_NONE;
+    FramePacer::parse_mode(replaySettings.framePacing, &framePacingMode);
+    FramePacer framePacer(framePacingMode, replaySettings.frameRate);
+
     if (replaySettings.loopEndFrame != UINT_MAX) {
         // Increase by 1 because it is comparing with the frame number which is increased right after vkQueuePresentKHR being
         // called.
@@ -196,8 +338,14 @@ int main_loop(vktrace_replay::ReplayDisplay display, Sequencer& seq, vktrace_tra
             if (display.get_pause_status()) {
                 continue;
             } else {
+                uint64_t readStartTime = bPerfStats ? vktrace_get_time() : 0;
                 packet = seq.get_next_packet();
                 if (!packet) break;
+                if (bPerfStats) {
+                    perfStats.readTime += vktrace_get_time() - readStartTime;
+                    perfStats.packets++;
+                    perfStats.bytes += packet->size;
+                }
             }
 
             switch (packet->packet_id) {
@@ -230,8 +378,24 @@ int main_loop(vktrace_replay::ReplayDisplay display, Sequencer& seq, vktrace_tra
                         continue;
                     }
                     if (packet->packet_id >= VKTRACE_TPI_VK_vkApiVersion) {
-                        // replay the API packet
-                        res = replayer->Replay(replayer->Interpret(packet));
+                        // replay the API packet, which a parallel sequencer has already interpreted
+                        vktrace_trace_packet_header* pInterpreted = NULL;
+                        bool interpreted = seq.get_interpreted_packet(&pInterpreted);
+                        if (framePacer.is_enabled()) {
+                            framePacer.wait_for_packet(packet);
+                        }
+                        if (bPerfStats) {
+                            uint64_t interpretStartTime = vktrace_get_time();
+                            if (!interpreted) {
+                                pInterpreted = replayer->Interpret(packet);
+                            }
+                            uint64_t replayStartTime = vktrace_get_time();
+                            res = replayer->Replay(pInterpreted);
+                            perfStats.interpretTime += replayStartTime - interpretStartTime;
+                            perfStats.replayTime += vktrace_get_time() - replayStartTime;
+                        } else {
+                            res = replayer->Replay(interpreted ? pInterpreted : replayer->Interpret(packet));
+                        }
                         if (res != VKTRACE_REPLAY_SUCCESS) {
                             vktrace_LogError("Failed to replay packet_id %d, with global_packet_index %d.", packet->packet_id,
                                              packet->global_packet_index);
@@ -245,6 +409,9 @@ int main_loop(vktrace_replay::ReplayDisplay display, Sequencer& seq, vktrace_tra
                         unsigned int frameNumber = replayer->GetFrameNumber();
                         if (prevFrameNumber != frameNumber) {
                             prevFrameNumber = frameNumber;
+                            if (framePacer.is_enabled()) {
+                                framePacer.end_frame(packet);
+                            }
 
                             // Only set the loop start location and start_time in the first loop when loopStartFrame is not 0
                             if (frameNumber == start_frame && start_frame > 0 && replaySettings.numLoops == totalLoops) {
@@ -277,6 +444,7 @@ int main_loop(vktrace_replay::ReplayDisplay display, Sequencer& seq, vktrace_tra
         totalLoopFrames += end_frame - start_frame;
 
         seq.set_bookmark(startingPacket);
+        framePacer.reset();
         trace_running = true;
         if (replayer != NULL) {
             replayer->ResetFrameNumber(replaySettings.loopStartFrame);
@@ -296,6 +464,14 @@ int main_loop(vktrace_replay::ReplayDisplay display, Sequencer& seq, vktrace_tra
     } else {
         vktrace_LogError("fps error!");
     }
+    framePacer.report();
+
+    if (bPerfStats) {
+        if (replayer != NULL) {
+            replayer->GetRemapStats(&perfStats.remapCount, &perfStats.remapTime);
+        }
+        write_perf_stats(replaySettings.perfStatsFile, perfStats, end_time - perfStartTime);
+    }
 
 out:
     seq.clean_up();
@@ -358,37 +534,116 @@ void loggingCallback(VktraceLogLevel level, const char* pMessage) {
 #endif  // ANDROID
 }
 
-static void freePortabilityTablePackets() {
-    for (size_t i = 0; i < portabilityTablePackets.size(); i++) {
-        vktrace_trace_packet_header* pPacket = (vktrace_trace_packet_header*)portabilityTablePackets[i];
-        if (pPacket) {
-            vktrace_free(pPacket);
-        }
-    }
-}
-
 std::vector<uint64_t> portabilityTable;
-static bool preloadPortabilityTablePackets() {
+
+// Reads every packet of the portability table once, in trace order, and records for each vkAllocateMemory the binds of
+// its memory up to the vkFreeMemory, together with the offset of any vkCreateImage/vkCreateBuffer of the bound resource
+// that comes between the allocation and the bind. Only one packet is held in memory at a time.
+static bool buildPortabilityTableIndex() {
+    // A traced memory handle can be reused after it is freed, so binds go to the allocation that currently owns the handle.
+    struct liveAllocation {
+        size_t tableIdx;
+        portabilityTableAllocation* pBinds;
+    };
+    struct createPacket {
+        size_t tableIdx;
+        uint64_t offset;
+    };
+    std::unordered_map<uint64_t, liveAllocation> liveAllocations;
+    std::unordered_map<uint64_t, createPacket> imageCreates;
+    std::unordered_map<uint64_t, createPacket> bufferCreates;
     uint64_t originalFilePos = vktrace_FileLike_GetCurrentPosition(traceFile);
-    uint64_t portabilityTableTotalPacketSize = 0;
+    uint64_t bindCount = 0;
 
+    auto addBind = [&](uint16_t packetId, uint64_t memory, uint64_t resource, uint64_t memoryOffset) {
+        auto allocation = liveAllocations.find(memory);
+        if (allocation == liveAllocations.end()) {
+            return;
+        }
+        bool bImage = (packetId == VKTRACE_TPI_VK_vkBindImageMemory || packetId == VKTRACE_TPI_VK_vkBindImageMemory2KHR);
+        const std::unordered_map<uint64_t, createPacket>& creates = bImage ? imageCreates : bufferCreates;
+        auto create = creates.find(resource);
+        portabilityTableBind bind;
+        bind.packetId = packetId;
+        bind.resource = resource;
+        bind.memoryOffset = memoryOffset;
+        bind.createPacketOffset =
+            (create != creates.end() && create->second.tableIdx > allocation->second.tableIdx) ? create->second.offset : 0;
+        allocation->second.pBinds->push_back(bind);
+        bindCount++;
+    };
+
+    portabilityTableIndex.clear();
     for (size_t i = 0; i < portabilityTable.size(); i++) {
         if (!vktrace_FileLike_SetCurrentPosition(traceFile, portabilityTable[i])) {
             return false;
         }
-        vktrace_trace_packet_header* pPacket = vktrace_read_trace_packet(traceFile);
-        if (!pPacket) {
+        vktrace_trace_packet_header* pHeader = vktrace_read_trace_packet(traceFile);
+        if (!pHeader) {
             return false;
         }
-        pPacket = interpret_trace_packet_vk(pPacket);
-        portabilityTablePackets[i] = (uintptr_t)pPacket;
-        portabilityTableTotalPacketSize += pPacket->size;
+        pHeader = interpret_trace_packet_vk(pHeader);
+        switch (pHeader->packet_id) {
+            case VKTRACE_TPI_VK_vkAllocateMemory: {
+                packet_vkAllocateMemory* pPacket = (packet_vkAllocateMemory*)pHeader->pBody;
+                liveAllocation allocation;
+                allocation.tableIdx = i;
+                allocation.pBinds = &portabilityTableIndex[pHeader->global_packet_index];
+                liveAllocations[(uint64_t)*pPacket->pMemory] = allocation;
+                break;
+            }
+            case VKTRACE_TPI_VK_vkFreeMemory: {
+                packet_vkFreeMemory* pPacket = (packet_vkFreeMemory*)pHeader->pBody;
+                liveAllocations.erase((uint64_t)pPacket->memory);
+                break;
+            }
+            case VKTRACE_TPI_VK_vkCreateImage: {
+                packet_vkCreateImage* pPacket = (packet_vkCreateImage*)pHeader->pBody;
+                imageCreates[(uint64_t)*pPacket->pImage] = {i, portabilityTable[i]};
+                break;
+            }
+            case VKTRACE_TPI_VK_vkCreateBuffer: {
+                packet_vkCreateBuffer* pPacket = (packet_vkCreateBuffer*)pHeader->pBody;
+                bufferCreates[(uint64_t)*pPacket->pBuffer] = {i, portabilityTable[i]};
+                break;
+            }
+            case VKTRACE_TPI_VK_vkBindImageMemory: {
+                packet_vkBindImageMemory* pPacket = (packet_vkBindImageMemory*)pHeader->pBody;
+                addBind(pHeader->packet_id, (uint64_t)pPacket->memory, (uint64_t)pPacket->image, pPacket->memoryOffset);
+                break;
+            }
+            case VKTRACE_TPI_VK_vkBindBufferMemory: {
+                packet_vkBindBufferMemory* pPacket = (packet_vkBindBufferMemory*)pHeader->pBody;
+                addBind(pHeader->packet_id, (uint64_t)pPacket->memory, (uint64_t)pPacket->buffer, pPacket->memoryOffset);
+                break;
+            }
+            case VKTRACE_TPI_VK_vkBindImageMemory2KHR: {
+                packet_vkBindImageMemory2KHR* pPacket = (packet_vkBindImageMemory2KHR*)pHeader->pBody;
+                for (uint32_t j = 0; j < pPacket->bindInfoCount; j++) {
+                    addBind(pHeader->packet_id, (uint64_t)pPacket->pBindInfos[j].memory, (uint64_t)pPacket->pBindInfos[j].image,
+                            pPacket->pBindInfos[j].memoryOffset);
+                }
+                break;
+            }
+            case VKTRACE_TPI_VK_vkBindBufferMemory2KHR: {
+                packet_vkBindBufferMemory2KHR* pPacket = (packet_vkBindBufferMemory2KHR*)pHeader->pBody;
+                for (uint32_t j = 0; j < pPacket->bindInfoCount; j++) {
+                    addBind(pHeader->packet_id, (uint64_t)pPacket->pBindInfos[j].memory, (uint64_t)pPacket->pBindInfos[j].buffer,
+                            pPacket->pBindInfos[j].memoryOffset);
+                }
+                break;
+            }
+            default:
+                break;
+        }
+        vktrace_delete_trace_packet_no_lock(&pHeader);
     }
 
-    vktrace_LogVerbose("Total packet size preloaded for portability table: %" PRIu64 " bytes", portabilityTableTotalPacketSize);
+    vktrace_LogVerbose("Portability table index: %" PRIu64 " allocations, %" PRIu64 " binds",
+                       (uint64_t)portabilityTableIndex.size(), bindCount);
 
     if (!vktrace_FileLike_SetCurrentPosition(traceFile, originalFilePos)) {
-        freePortabilityTablePackets();
+        portabilityTableIndex.clear();
         return false;
     }
     return true;
@@ -406,7 +661,6 @@ static bool readPortabilityTable() {
         if (!vktrace_FileLike_SetCurrentPosition(traceFile, traceFile->mFileLen - ((tableSize + 1) * sizeof(uint64_t))))
             return false;
         portabilityTable.resize((size_t)tableSize);
-        portabilityTablePackets.resize((size_t)tableSize);
         if (!vktrace_FileLike_ReadRaw(traceFile, &portabilityTable[0], sizeof(uint64_t) * tableSize)) return false;
     }
     if (!vktrace_FileLike_SetCurrentPosition(traceFile, originalFilePos)) return false;
@@ -437,6 +691,13 @@ int vkreplay_main(int argc, char** argv, vktrace_replay::ReplayDisplayImp* pDisp
         return -1;
     }
 
+    FramePacingMode framePacingMode;
+    if (!FramePacer::parse_mode(replaySettings.framePacing, &framePacingMode) ||
+        (framePacingMode == FRAME_PACING_FIXED && replaySettings.frameRate == 0)) {
+        vktrace_LogError("Bad frame pacing");
+        return -1;
+    }
+
     // merge settings so that new settings will get written into the settings file
     vktrace_SettingGroup_merge(&g_replaySettingGroup, &pAllSettings, &numAllSettings);
 
@@ -603,7 +864,7 @@ int vkreplay_main(int argc, char** argv, vktrace_replay::ReplayDisplayImp* pDisp
 
     // read portability table if it exists
     if (pFileHeader->portability_table_valid) pFileHeader->portability_table_valid = readPortabilityTable();
-    if (pFileHeader->portability_table_valid) pFileHeader->portability_table_valid = preloadPortabilityTablePackets();
+    if (pFileHeader->portability_table_valid) pFileHeader->portability_table_valid = buildPortabilityTableIndex();
     if (!pFileHeader->portability_table_valid)
         vktrace_LogAlways("Trace file does not appear to contain portability table. Will not attempt to map memoryType indices.");
 
@@ -636,7 +897,7 @@ int vkreplay_main(int argc, char** argv, vktrace_replay::ReplayDisplayImp* pDisp
         fclose(tracefp);
         vktrace_free(pTraceFile);
         vktrace_free(traceFile);
-        if (pFileHeader->portability_table_valid) freePortabilityTablePackets();
+        portabilityTableIndex.clear();
         vktrace_free(pFileHeader);
         return -1;
     }
@@ -675,7 +936,7 @@ int vkreplay_main(int argc, char** argv, vktrace_replay::ReplayDisplayImp* pDisp
                 fclose(tracefp);
                 vktrace_free(pTraceFile);
                 vktrace_free(traceFile);
-                if (pFileHeader->portability_table_valid) freePortabilityTablePackets();
+                portabilityTableIndex.clear();
                 vktrace_free(pFileHeader);
                 return -1;
             }
@@ -697,7 +958,7 @@ int vkreplay_main(int argc, char** argv, vktrace_replay::ReplayDisplayImp* pDisp
                 fclose(tracefp);
                 vktrace_free(pTraceFile);
                 vktrace_free(traceFile);
-                if (pFileHeader->portability_table_valid) freePortabilityTablePackets();
+                portabilityTableIndex.clear();
                 vktrace_free(pFileHeader);
                 return err;
             }
@@ -712,14 +973,23 @@ int vkreplay_main(int argc, char** argv, vktrace_replay::ReplayDisplayImp* pDisp
         fclose(tracefp);
         vktrace_free(pTraceFile);
         vktrace_free(traceFile);
-        if (pFileHeader->portability_table_valid) freePortabilityTablePackets();
+        portabilityTableIndex.clear();
         vktrace_free(pFileHeader);
         return -1;
     }
 
     // main loop
-    Sequencer sequencer(traceFile);
-    err = vktrace_replay::main_loop(disp, sequencer, replayer);
+    if (replaySettings.interpretThreadCount > 0) {
+        ParallelSequencer::InterpretFunction interpret = [&replayer](vktrace_trace_packet_header* pPacket,
+                                                                     vktrace_trace_packet_header** ppInterpreted) {
+            return interpret_api_packet(replayer, pPacket, ppInterpreted);
+        };
+        ParallelSequencer sequencer(traceFile, interpret, replaySettings.interpretThreadCount);
+        err = vktrace_replay::main_loop(disp, sequencer, replayer);
+    } else {
+        Sequencer sequencer(traceFile);
+        err = vktrace_replay::main_loop(disp, sequencer, replayer);
+    }
 
     for (int i = 0; i < VKTRACE_MAX_TRACER_ID_ARRAY_SIZE; i++) {
         if (replayer[i] != NULL) {
@@ -735,7 +1005,7 @@ int vkreplay_main(int argc, char** argv, vktrace_replay::ReplayDisplayImp* pDisp
     fclose(tracefp);
     vktrace_free(pTraceFile);
     vktrace_free(traceFile);
-    if (pFileHeader->portability_table_valid) freePortabilityTablePackets();
+    portabilityTableIndex.clear();
     vktrace_free(pFileHeader);
 
     return err;
@@ -34,10 +34,35 @@ typedef struct vkreplayer_settings {
     const char* screenshotColorFormat;
     const char* verbosity;
     const char* displayServer;
+    const char* perfStatsFile;
+    unsigned int subAllocationBlockSize;
+    bool persistentMapping;
+    bool coalesceSubmits;
+    bool batchDescriptorUpdates;
+    bool removeRedundantState;
+    bool relaxWaits;
+    unsigned int interpretThreadCount;
+    const char* framePacing;
+    unsigned int frameRate;
 } vkreplayer_settings;
 
+#include <unordered_map>
 #include <vector>
-extern std::vector<uintptr_t> portabilityTablePackets;
+
+// One bind of the memory returned by a traced vkAllocateMemory, found in the portability table.
+struct portabilityTableBind {
+    uint16_t packetId;  // vkBindImageMemory, vkBindBufferMemory or one of their 2KHR variants
+    uint64_t resource;  // traced image or buffer handle
+    uint64_t memoryOffset;
+    // File offset of the vkCreateImage/vkCreateBuffer of the resource if it comes after the vkAllocateMemory, 0 otherwise.
+    uint64_t createPacketOffset;
+};
+
+// The binds of the memory returned by one traced vkAllocateMemory, in trace order, up to its vkFreeMemory.
+typedef std::vector<portabilityTableBind> portabilityTableAllocation;
+
+// Keyed by the global_packet_index of the vkAllocateMemory packet.
+extern std::unordered_map<uint64_t, portabilityTableAllocation> portabilityTableIndex;
 extern FileLike* traceFile;
 
 #endif  // VKREPLAY__MAIN_H
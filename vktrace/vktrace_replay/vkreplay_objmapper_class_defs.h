@@ -28,7 +28,7 @@ class objMemory {
 
 class gpuMemory {
    public:
-    gpuMemory() : m_pendingAlloc(false) { m_allocInfo.allocationSize = 0; }
+    gpuMemory() : m_pendingAlloc(false), m_pPersistentData(NULL), m_hostCoherent(false) { m_allocInfo.allocationSize = 0; }
     ~gpuMemory() {}
     // memory mapping functions for app writes into mapped memory
     bool isPendingAlloc() { return m_pendingAlloc; }
@@ -136,6 +136,14 @@ class gpuMemory {
 
     uint64_t getMemoryMapSize() { return (!m_mapRange.empty()) ? m_mapRange.back().size : 0; }
 
+    // With the PersistentMap replay option the whole allocation is mapped once and every traced map is served from it.
+    void setPersistentMapping(void *pData) { m_pPersistentData = (uint8_t *)pData; }
+    uint8_t *getPersistentMapping() { return m_pPersistentData; }
+
+    // Flushes and invalidations of host coherent memory don't need to reach the driver when it stays mapped.
+    void setHostCoherent(const bool coherent) { m_hostCoherent = coherent; }
+    bool isHostCoherent() { return m_hostCoherent; }
+
    private:
     bool m_pendingAlloc;
     struct MapRange {
@@ -146,6 +154,8 @@ class gpuMemory {
     };
     std::vector<MapRange> m_mapRange;
     VkMemoryAllocateInfo m_allocInfo;
+    uint8_t *m_pPersistentData;
+    bool m_hostCoherent;
 };
 
 typedef struct _imageObj {
@@ -163,12 +173,35 @@ typedef struct _devicememoryObj {
     VkDeviceMemory replayDeviceMemory;
 } devicememoryObj;
 
+// Number of handle lookups and the time spent in them, only collected when vkreplay writes performance statistics.
+typedef struct _remapStats {
+    uint64_t count;
+    uint64_t time;
+} remapStats;
+
+// Adds the time until it goes out of scope to pStats; does nothing when pStats is NULL.
+class remapTimer {
+   public:
+    remapTimer(remapStats *pStats) : m_pStats(pStats), m_startTime((pStats != NULL) ? vktrace_get_time() : 0) {}
+    ~remapTimer() {
+        if (m_pStats != NULL) {
+            m_pStats->count++;
+            m_pStats->time += vktrace_get_time() - m_startTime;
+        }
+    }
+
+   private:
+    remapStats *m_pStats;
+    uint64_t m_startTime;
+};
+
 class vkReplayObjMapper {
    public:
-    vkReplayObjMapper() {}
+    vkReplayObjMapper() : m_pRemapStats(NULL) {}
     ~vkReplayObjMapper() {}
 
-    bool m_adjustForGPU;  // true if replay adjusts behavior based on GPU
+    bool m_adjustForGPU;        // true if replay adjusts behavior based on GPU
+    remapStats *m_pRemapStats;  // NULL unless remap timing is enabled
     void init_objMemCount(const uint64_t handle, const VkDebugReportObjectTypeEXT objectType, const uint32_t &num) {
         switch (objectType) {
             case VK_DEBUG_REPORT_OBJECT_TYPE_BUFFER_EXT: {
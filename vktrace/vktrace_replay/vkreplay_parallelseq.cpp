@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2019 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vkreplay_parallelseq.h"
+
+extern "C" {
+#include "vktrace_trace_packet_utils.h"
+}
+
+namespace vktrace_replay {
+
+static const size_t kRingSize = 1024;
+static const uint64_t kMaxRingBytes = 64 * 1024 * 1024;
+
+ParallelSequencer::ParallelSequencer(FileLike *pFile, const InterpretFunction &interpret, unsigned int workerCount)
+    : m_pFile(pFile),
+      m_interpret(interpret),
+      m_workerCount(workerCount > 0 ? workerCount : 1),
+      m_fileOffset(0),
+      m_ring(kRingSize),
+      m_head(0),
+      m_interpretCount(0),
+      m_readCount(0),
+      m_ringBytes(0),
+      m_holdingHead(false),
+      m_endOfFile(false),
+      m_stopping(false),
+      m_running(false) {
+    m_bookmark.file_offset = 0;
+    if (m_pFile) {
+        m_fileOffset = vktrace_FileLike_GetCurrentPosition(m_pFile);
+    }
+}
+
+void ParallelSequencer::start() {
+    m_reader = std::thread(&ParallelSequencer::read_packets, this);
+    for (unsigned int i = 0; i < m_workerCount; i++) {
+        m_workers.push_back(std::thread(&ParallelSequencer::interpret_packets, this));
+    }
+    m_running = true;
+}
+
+void ParallelSequencer::stop() {
+    if (m_running) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_spaceCondition.notify_all();
+        m_readCondition.notify_all();
+        m_reader.join();
+        for (std::thread &worker : m_workers) {
+            worker.join();
+        }
+        m_workers.clear();
+        m_running = false;
+    }
+
+    for (uint64_t i = m_head; i < m_readCount; i++) {
+        vktrace_delete_trace_packet_no_lock(&m_ring[i % kRingSize].pPacket);
+    }
+    m_head = 0;
+    m_interpretCount = 0;
+    m_readCount = 0;
+    m_ringBytes = 0;
+    m_holdingHead = false;
+    m_endOfFile = false;
+    m_stopping = false;
+}
+
+void ParallelSequencer::read_packets() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            // the ring always takes one packet, however large it is
+            m_spaceCondition.wait(lock, [this] {
+                return m_stopping ||
+                       (m_readCount - m_head < kRingSize && (m_ringBytes < kMaxRingBytes || m_readCount == m_head));
+            });
+            if (m_stopping) {
+                return;
+            }
+        }
+
+        vktrace_trace_packet_header *pPacket = vktrace_read_trace_packet(m_pFile);
+        uint64_t nextFileOffset = vktrace_FileLike_GetCurrentPosition(m_pFile);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (pPacket == NULL) {
+                m_endOfFile = true;
+            } else {
+                Entry &entry = m_ring[m_readCount % kRingSize];
+                entry.pPacket = pPacket;
+                entry.pInterpreted = NULL;
+                entry.nextFileOffset = nextFileOffset;
+                entry.interpreted = false;
+                entry.ready = false;
+                m_ringBytes += pPacket->size;
+                m_readCount++;
+            }
+        }
+        if (pPacket == NULL) {
+            m_readCondition.notify_all();
+            m_readyCondition.notify_one();
+            return;
+        }
+        m_readCondition.notify_one();
+    }
+}
+
+void ParallelSequencer::interpret_packets() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_readCondition.wait(lock, [this] { return m_stopping || m_endOfFile || m_interpretCount < m_readCount; });
+        if (m_stopping || m_interpretCount == m_readCount) {
+            return;
+        }
+
+        // a claimed entry can't be reused before the replay thread has seen it ready
+        Entry &entry = m_ring[m_interpretCount % kRingSize];
+        m_interpretCount++;
+        lock.unlock();
+        entry.interpreted = m_interpret(entry.pPacket, &entry.pInterpreted);
+        lock.lock();
+        entry.ready = true;
+        m_readyCondition.notify_one();
+    }
+}
+
+vktrace_trace_packet_header *ParallelSequencer::get_next_packet() {
+    if (!m_pFile) return (NULL);
+    if (!m_running) {
+        start();
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_holdingHead) {
+        Entry &entry = m_ring[m_head % kRingSize];
+        m_ringBytes -= entry.pPacket->size;
+        vktrace_delete_trace_packet_no_lock(&entry.pPacket);
+        m_head++;
+        m_holdingHead = false;
+        m_spaceCondition.notify_one();
+    }
+
+    m_readyCondition.wait(lock, [this] { return m_head < m_readCount ? m_ring[m_head % kRingSize].ready : m_endOfFile; });
+    if (m_head == m_readCount) {
+        return (NULL);
+    }
+
+    Entry &entry = m_ring[m_head % kRingSize];
+    m_holdingHead = true;
+    m_fileOffset = entry.nextFileOffset;
+    return (entry.pPacket);
+}
+
+bool ParallelSequencer::get_interpreted_packet(vktrace_trace_packet_header **ppInterpreted) {
+    if (!m_holdingHead || !m_ring[m_head % kRingSize].interpreted) {
+        return false;
+    }
+    *ppInterpreted = m_ring[m_head % kRingSize].pInterpreted;
+    return true;
+}
+
+void ParallelSequencer::get_bookmark(seqBookmark &bookmark) { bookmark.file_offset = m_bookmark.file_offset; }
+
+void ParallelSequencer::set_bookmark(const seqBookmark &bookmark) {
+    stop();
+    vktrace_FileLike_SetCurrentPosition(m_pFile, m_bookmark.file_offset);
+    m_fileOffset = m_bookmark.file_offset;
+}
+
+void ParallelSequencer::record_bookmark() { m_bookmark.file_offset = m_fileOffset; }
+
+} /* namespace vktrace_replay */
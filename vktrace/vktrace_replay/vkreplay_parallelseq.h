@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2019 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//  Replay parallel sequencer
+//
+//     Interpreting a packet turns the offsets in its body into pointers. It only touches the packet itself, so packets
+//     can be interpreted in any order on any thread, as long as the handles in pNext chains, which are remapped when a
+//     packet is interpreted on the replay thread, are left for the replay thread to remap when the packet is replayed. The
+//     parallel sequencer reads the trace file on a reader thread and has worker threads interpret the packets read, ahead
+//     of the replay thread. Packets are handed to the replay thread through a ring in trace order, so the replay thread
+//     only remaps handles and calls the driver.
+//
+//     A packet stays in the ring until the replay thread asks for the next one. The reader stops when the ring is full
+//     or holds too many bytes, so that the read-ahead of traces with large memory uploads stays bounded. Setting a
+//     bookmark stops the threads, drops the packets read ahead and restarts from the bookmark.
+
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "vkreplay_seq.h"
+
+namespace vktrace_replay {
+
+class ParallelSequencer : public AbstractSequencer {
+   public:
+    // Interprets pPacket and sets ppInterpreted to the result, or returns false if the packet isn't interpreted before
+    // it is replayed. Called from the worker threads.
+    typedef std::function<bool(vktrace_trace_packet_header *pPacket, vktrace_trace_packet_header **ppInterpreted)>
+        InterpretFunction;
+
+    ParallelSequencer(FileLike *pFile, const InterpretFunction &interpret, unsigned int workerCount);
+    ~ParallelSequencer() { this->clean_up(); }
+
+    void clean_up() { stop(); }
+
+    vktrace_trace_packet_header *get_next_packet();
+    bool get_interpreted_packet(vktrace_trace_packet_header **ppInterpreted);
+    void get_bookmark(seqBookmark &bookmark);
+    void set_bookmark(const seqBookmark &bookmark);
+    void record_bookmark();
+
+   private:
+    struct Entry {
+        vktrace_trace_packet_header *pPacket;
+        vktrace_trace_packet_header *pInterpreted;
+        uint64_t nextFileOffset;
+        bool interpreted;
+        bool ready;
+    };
+
+    void start();
+    void stop();
+    void read_packets();
+    void interpret_packets();
+
+    FileLike *m_pFile;
+    InterpretFunction m_interpret;
+    unsigned int m_workerCount;
+    seqBookmark m_bookmark;
+
+    // The file offset following the packet last returned by get_next_packet.
+    uint64_t m_fileOffset;
+
+    // Packets are counted from the start of the threads. The entries from m_head to m_readCount are in the ring, and those
+    // from m_interpretCount have yet to be claimed by a worker. The entry at m_head is the packet last returned by
+    // get_next_packet if m_holdingHead is true.
+    std::vector<Entry> m_ring;
+    uint64_t m_head;
+    uint64_t m_interpretCount;
+    uint64_t m_readCount;
+    uint64_t m_ringBytes;
+    bool m_holdingHead;
+    bool m_endOfFile;
+    bool m_stopping;
+    bool m_running;
+
+    std::mutex m_mutex;
+    std::condition_variable m_spaceCondition;
+    std::condition_variable m_readCondition;
+    std::condition_variable m_readyCondition;
+    std::thread m_reader;
+    std::vector<std::thread> m_workers;
+};
+
+} /* namespace vktrace_replay */
@@ -41,6 +41,12 @@ class AbstractSequencer {
     virtual vktrace_trace_packet_header *get_next_packet() = 0;
     virtual void get_bookmark(seqBookmark &bookmark) = 0;
     virtual void set_bookmark(const seqBookmark &bookmark) = 0;
+    virtual void record_bookmark() = 0;
+    virtual void clean_up() = 0;
+
+    // Returns true if the packet returned by the last get_next_packet has already been interpreted, and sets
+    // ppInterpreted to the result of its interpretation.
+    virtual bool get_interpreted_packet(vktrace_trace_packet_header **ppInterpreted) { return false; }
 };
 
 class Sequencer : public AbstractSequencer {
@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2019 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vkreplay_statefilter.h"
+
+#include <string.h>
+#include <algorithm>
+
+// Sets values[first, first + count) to pValues, and returns true if all of them already had these values. Values are
+// compared bit for bit, so a viewport holding a NaN is never considered unchanged.
+template <typename T>
+static bool setArrayState(std::vector<T>& values, std::vector<bool>& known, uint32_t first, uint32_t count, const T* pValues) {
+    if (values.size() < first + count) {
+        values.resize(first + count);
+        known.resize(first + count, false);
+    }
+
+    bool unchanged = true;
+    for (uint32_t i = 0; i < count; i++) {
+        if (!known[first + i] || memcmp(&values[first + i], &pValues[i], sizeof(T)) != 0) {
+            values[first + i] = pValues[i];
+            known[first + i] = true;
+            unchanged = false;
+        }
+    }
+    return unchanged;
+}
+
+vkReplayStateFilter::BindPointState* vkReplayStateFilter::getBindPointState(VkCommandBuffer commandBuffer,
+                                                                           VkPipelineBindPoint bindPoint) {
+    if (bindPoint != VK_PIPELINE_BIND_POINT_GRAPHICS && bindPoint != VK_PIPELINE_BIND_POINT_COMPUTE) {
+        return NULL;
+    }
+    return &m_commandBuffers[commandBuffer].bindPoints[bindPoint];
+}
+
+bool vkReplayStateFilter::countCall(bool skip) {
+    m_filteredCallCount++;
+    if (skip) {
+        m_skippedCallCount++;
+    }
+    return skip;
+}
+
+bool vkReplayStateFilter::skipBindPipeline(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipeline pipeline) {
+    if (!m_enabled) {
+        return false;
+    }
+    BindPointState* pState = getBindPointState(commandBuffer, bindPoint);
+    if (pState == NULL) {
+        return countCall(false);
+    }
+    if (pState->pipeline == pipeline && pipeline != VK_NULL_HANDLE) {
+        return countCall(true);
+    }
+
+    pState->pipeline = pipeline;
+    if (bindPoint == VK_PIPELINE_BIND_POINT_GRAPHICS) {
+        CommandBufferState& state = m_commandBuffers[commandBuffer];
+        state.knownViewports.assign(state.knownViewports.size(), false);
+        state.knownScissors.assign(state.knownScissors.size(), false);
+    }
+    return countCall(false);
+}
+
+bool vkReplayStateFilter::skipBindDescriptorSets(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint,
+                                                 VkPipelineLayout layout, uint32_t firstSet, uint32_t descriptorSetCount,
+                                                 const VkDescriptorSet* pDescriptorSets, uint32_t dynamicOffsetCount,
+                                                 const uint32_t* pDynamicOffsets) {
+    if (!m_enabled) {
+        return false;
+    }
+    BindPointState* pState = getBindPointState(commandBuffer, bindPoint);
+    if (pState == NULL) {
+        return countCall(false);
+    }
+
+    DescriptorSetBinding& binding = pState->descriptorSets;
+    if (pState->descriptorSetsKnown && binding.layout == layout && binding.firstSet == firstSet &&
+        binding.sets.size() == descriptorSetCount && binding.dynamicOffsets.size() == dynamicOffsetCount &&
+        std::equal(binding.sets.begin(), binding.sets.end(), pDescriptorSets) &&
+        std::equal(binding.dynamicOffsets.begin(), binding.dynamicOffsets.end(), pDynamicOffsets)) {
+        return countCall(true);
+    }
+
+    pState->descriptorSetsKnown = true;
+    binding.layout = layout;
+    binding.firstSet = firstSet;
+    binding.sets.assign(pDescriptorSets, pDescriptorSets + descriptorSetCount);
+    binding.dynamicOffsets.assign(pDynamicOffsets, pDynamicOffsets + dynamicOffsetCount);
+    return countCall(false);
+}
+
+void vkReplayStateFilter::invalidateDescriptorSets(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint) {
+    if (!m_enabled) {
+        return;
+    }
+    BindPointState* pState = getBindPointState(commandBuffer, bindPoint);
+    if (pState != NULL) {
+        pState->descriptorSetsKnown = false;
+    }
+}
+
+bool vkReplayStateFilter::skipSetViewport(VkCommandBuffer commandBuffer, uint32_t firstViewport, uint32_t viewportCount,
+                                          const VkViewport* pViewports) {
+    if (!m_enabled) {
+        return false;
+    }
+    CommandBufferState& state = m_commandBuffers[commandBuffer];
+    return countCall(setArrayState(state.viewports, state.knownViewports, firstViewport, viewportCount, pViewports));
+}
+
+bool vkReplayStateFilter::skipSetScissor(VkCommandBuffer commandBuffer, uint32_t firstScissor, uint32_t scissorCount,
+                                         const VkRect2D* pScissors) {
+    if (!m_enabled) {
+        return false;
+    }
+    CommandBufferState& state = m_commandBuffers[commandBuffer];
+    return countCall(setArrayState(state.scissors, state.knownScissors, firstScissor, scissorCount, pScissors));
+}
+
+bool vkReplayStateFilter::skipBindVertexBuffers(VkCommandBuffer commandBuffer, uint32_t firstBinding, uint32_t bindingCount,
+                                                const VkBuffer* pBuffers, const VkDeviceSize* pOffsets) {
+    if (!m_enabled) {
+        return false;
+    }
+    CommandBufferState& state = m_commandBuffers[commandBuffer];
+    // both arrays are set even if the buffers alone have changed
+    bool buffersUnchanged = setArrayState(state.vertexBuffers, state.knownVertexBuffers, firstBinding, bindingCount, pBuffers);
+    bool offsetsUnchanged =
+        setArrayState(state.vertexBufferOffsets, state.knownVertexBufferOffsets, firstBinding, bindingCount, pOffsets);
+    return countCall(buffersUnchanged && offsetsUnchanged);
+}
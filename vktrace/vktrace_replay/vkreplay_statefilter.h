@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2019 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//  Replay redundant state filter
+//
+//     Engines often record the same pipeline, descriptor set, viewport, scissor and vertex buffer bindings before every
+//     draw. When the filter is enabled, vkreplay remembers the state each command recorded into a command buffer and
+//     skips the vkCmdBindPipeline, vkCmdBindDescriptorSets, vkCmdSetViewport, vkCmdSetScissor and vkCmdBindVertexBuffers
+//     that would set exactly the state already bound:
+//
+//     - the state of a command buffer is unknown after vkBeginCommandBuffer and vkCmdExecuteCommands, and is dropped when
+//       the command buffer is freed.
+//
+//     - binding a graphics pipeline makes the viewports and scissors unknown, as the pipeline may set them statically.
+//
+//     - vkCmdBindDescriptorSets is only skipped when it repeats the last vkCmdBindDescriptorSets of its bind point with
+//       the same layout, sets and dynamic offsets, and push descriptors make the descriptor sets of their bind point
+//       unknown.
+//
+//     Only the graphics and compute bind points are filtered. Render pass boundaries don't change the bound state.
+
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+class vkReplayStateFilter {
+   public:
+    vkReplayStateFilter() : m_enabled(false), m_filteredCallCount(0), m_skippedCallCount(0) {}
+    ~vkReplayStateFilter() {}
+
+    void setEnabled(bool enabled) { m_enabled = enabled; }
+    bool isEnabled() const { return m_enabled; }
+
+    // Forgets the state of commandBuffer, which has been begun, executed secondary command buffers or been freed.
+    void forgetCommandBuffer(VkCommandBuffer commandBuffer) { m_commandBuffers.erase(commandBuffer); }
+
+    // Each skip function takes the remapped parameters of its command, and returns true if the command wouldn't change
+    // the state of commandBuffer. Otherwise it records the new state, and the command must be made.
+    bool skipBindPipeline(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipeline pipeline);
+    bool skipBindDescriptorSets(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout,
+                                uint32_t firstSet, uint32_t descriptorSetCount, const VkDescriptorSet* pDescriptorSets,
+                                uint32_t dynamicOffsetCount, const uint32_t* pDynamicOffsets);
+    bool skipSetViewport(VkCommandBuffer commandBuffer, uint32_t firstViewport, uint32_t viewportCount,
+                         const VkViewport* pViewports);
+    bool skipSetScissor(VkCommandBuffer commandBuffer, uint32_t firstScissor, uint32_t scissorCount, const VkRect2D* pScissors);
+    bool skipBindVertexBuffers(VkCommandBuffer commandBuffer, uint32_t firstBinding, uint32_t bindingCount,
+                               const VkBuffer* pBuffers, const VkDeviceSize* pOffsets);
+
+    // Forgets the descriptor sets bound to bindPoint of commandBuffer, which have been changed by push descriptors.
+    void invalidateDescriptorSets(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint);
+
+    uint64_t getFilteredCallCount() const { return m_filteredCallCount; }
+    uint64_t getSkippedCallCount() const { return m_skippedCallCount; }
+
+   private:
+    // The arguments of the last vkCmdBindDescriptorSets of a bind point.
+    struct DescriptorSetBinding {
+        VkPipelineLayout layout;
+        uint32_t firstSet;
+        std::vector<VkDescriptorSet> sets;
+        std::vector<uint32_t> dynamicOffsets;
+    };
+
+    struct BindPointState {
+        VkPipeline pipeline;
+        bool descriptorSetsKnown;
+        DescriptorSetBinding descriptorSets;
+
+        BindPointState() : pipeline(VK_NULL_HANDLE), descriptorSetsKnown(false) {}
+    };
+
+    // Array state is kept by index, with a flag telling whether the index has been set since the state became unknown.
+    struct CommandBufferState {
+        BindPointState bindPoints[2];
+        std::vector<VkViewport> viewports;
+        std::vector<bool> knownViewports;
+        std::vector<VkRect2D> scissors;
+        std::vector<bool> knownScissors;
+        std::vector<VkBuffer> vertexBuffers;
+        std::vector<VkDeviceSize> vertexBufferOffsets;
+        std::vector<bool> knownVertexBuffers;
+        std::vector<bool> knownVertexBufferOffsets;
+    };
+
+    // Returns the state of bindPoint in commandBuffer, or NULL if the bind point isn't filtered.
+    BindPointState* getBindPointState(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint);
+
+    // Counts a call, and the call as skipped if skip is true.
+    bool countCall(bool skip);
+
+    bool m_enabled;
+    std::unordered_map<VkCommandBuffer, CommandBufferState> m_commandBuffers;
+
+    // State commands seen by the filter, and those that weren't made because they didn't change the bound state.
+    uint64_t m_filteredCallCount;
+    uint64_t m_skippedCallCount;
+};
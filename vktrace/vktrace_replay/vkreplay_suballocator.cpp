@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2019 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vkreplay_suballocator.h"
+
+#include <inttypes.h>
+#include <algorithm>
+#include <iterator>
+
+#include "vktrace_common.h"
+#include "vktrace_tracelog.h"
+
+// The resources bound to an allocation aren't known when it is replayed, so sub-allocations are aligned to the size of
+// the allocation rounded up to a power of two, up to this limit, on the assumption that no resource needs an alignment
+// larger than the memory allocated for it.
+static const VkDeviceSize kMaxAlignment = 64 * 1024;
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+void vkReplaySubAllocator::addDevice(VkDevice device, const VkPhysicalDeviceLimits& limits, PFN_vkAllocateMemory pfnAllocateMemory,
+                                     PFN_vkFreeMemory pfnFreeMemory, PFN_vkMapMemory pfnMapMemory) {
+    DeviceBlocks& deviceBlocks = m_devices[device];
+    deviceBlocks.limits = limits;
+    deviceBlocks.pfnAllocateMemory = pfnAllocateMemory;
+    deviceBlocks.pfnFreeMemory = pfnFreeMemory;
+    deviceBlocks.pfnMapMemory = pfnMapMemory;
+    deviceBlocks.allocationCount = 0;
+    deviceBlocks.blockCount = 0;
+}
+
+void vkReplaySubAllocator::destroyDevice(VkDevice device) {
+    auto deviceBlocks = m_devices.find(device);
+    if (deviceBlocks == m_devices.end()) {
+        return;
+    }
+
+    for (auto& memoryType : deviceBlocks->second.memoryTypes) {
+        for (Block* pBlock : memoryType.second) {
+            deviceBlocks->second.pfnFreeMemory(device, pBlock->memory, NULL);
+            delete pBlock;
+        }
+    }
+    for (auto subAllocation = m_subAllocations.begin(); subAllocation != m_subAllocations.end();) {
+        if (subAllocation->second.device == device) {
+            subAllocation = m_subAllocations.erase(subAllocation);
+        } else {
+            subAllocation++;
+        }
+    }
+    vktrace_LogVerbose("Sub-allocated %" PRIu64 " memory allocations from %" PRIu64 " blocks.",
+                       deviceBlocks->second.allocationCount, deviceBlocks->second.blockCount);
+    m_devices.erase(deviceBlocks);
+}
+
+bool vkReplaySubAllocator::allocateFromBlock(Block* pBlock, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* pOffset) {
+    for (auto range = pBlock->freeRanges.begin(); range != pBlock->freeRanges.end(); range++) {
+        VkDeviceSize rangeStart = range->first;
+        VkDeviceSize rangeEnd = range->first + range->second;
+        VkDeviceSize offset = alignUp(rangeStart, alignment);
+        if (offset + size > rangeEnd) {
+            continue;
+        }
+
+        pBlock->freeRanges.erase(range);
+        if (offset > rangeStart) {
+            pBlock->freeRanges[rangeStart] = offset - rangeStart;
+        }
+        if (offset + size < rangeEnd) {
+            pBlock->freeRanges[offset + size] = rangeEnd - (offset + size);
+        }
+        pBlock->allocationCount++;
+        *pOffset = offset;
+        return true;
+    }
+    return false;
+}
+
+bool vkReplaySubAllocator::allocate(VkDevice device, VkDeviceMemory traceMemory, const VkMemoryAllocateInfo* pAllocateInfo,
+                                    VkDeviceMemory* pBlockMemory) {
+    auto deviceBlocks = m_devices.find(device);
+    if (!isEnabled() || deviceBlocks == m_devices.end() || pAllocateInfo->pNext != NULL ||
+        pAllocateInfo->allocationSize > m_blockSize / 4) {
+        return false;
+    }
+
+    const VkPhysicalDeviceLimits& limits = deviceBlocks->second.limits;
+    VkDeviceSize alignment = std::max(std::max(limits.bufferImageGranularity, limits.nonCoherentAtomSize),
+                                      std::max((VkDeviceSize)limits.minMemoryMapAlignment, (VkDeviceSize)1));
+    while (alignment < kMaxAlignment && alignment < pAllocateInfo->allocationSize) {
+        alignment *= 2;
+    }
+    VkDeviceSize size = alignUp(std::max(pAllocateInfo->allocationSize, (VkDeviceSize)1), alignment);
+
+    SubAllocation subAllocation;
+    subAllocation.device = device;
+    subAllocation.memoryTypeIndex = pAllocateInfo->memoryTypeIndex;
+    subAllocation.pBlock = NULL;
+    subAllocation.size = size;
+
+    std::vector<Block*>& blocks = deviceBlocks->second.memoryTypes[pAllocateInfo->memoryTypeIndex];
+    for (Block* pBlock : blocks) {
+        if (allocateFromBlock(pBlock, size, alignment, &subAllocation.offset)) {
+            subAllocation.pBlock = pBlock;
+            break;
+        }
+    }
+
+    if (subAllocation.pBlock == NULL) {
+        VkMemoryAllocateInfo blockAllocateInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, NULL, m_blockSize,
+                                                  pAllocateInfo->memoryTypeIndex};
+        VkDeviceMemory blockMemory = VK_NULL_HANDLE;
+        if (deviceBlocks->second.pfnAllocateMemory(device, &blockAllocateInfo, NULL, &blockMemory) != VK_SUCCESS) {
+            // the heap may be too small for another block, let the driver try the allocation by itself
+            vktrace_LogWarning("Unable to allocate a %" PRIu64 " byte block of memory type %u for sub-allocation.", m_blockSize,
+                               pAllocateInfo->memoryTypeIndex);
+            return false;
+        }
+
+        Block* pBlock = new Block;
+        pBlock->memory = blockMemory;
+        pBlock->pMappedData = NULL;
+        pBlock->allocationCount = 0;
+        pBlock->freeRanges[0] = m_blockSize;
+        blocks.push_back(pBlock);
+        deviceBlocks->second.blockCount++;
+
+        allocateFromBlock(pBlock, size, alignment, &subAllocation.offset);
+        subAllocation.pBlock = pBlock;
+    }
+
+    m_subAllocations[traceMemory] = subAllocation;
+    deviceBlocks->second.allocationCount++;
+    *pBlockMemory = subAllocation.pBlock->memory;
+    return true;
+}
+
+bool vkReplaySubAllocator::release(VkDeviceMemory traceMemory) {
+    if (!isEnabled()) {
+        return false;
+    }
+    auto it = m_subAllocations.find(traceMemory);
+    if (it == m_subAllocations.end()) {
+        return false;
+    }
+
+    SubAllocation subAllocation = it->second;
+    m_subAllocations.erase(it);
+
+    Block* pBlock = subAllocation.pBlock;
+    VkDeviceSize offset = subAllocation.offset;
+    VkDeviceSize size = subAllocation.size;
+    auto next = pBlock->freeRanges.lower_bound(offset);
+    if (next != pBlock->freeRanges.end() && offset + size == next->first) {
+        size += next->second;
+        next = pBlock->freeRanges.erase(next);
+    }
+    if (next != pBlock->freeRanges.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset) {
+            offset = previous->first;
+            size += previous->second;
+            pBlock->freeRanges.erase(previous);
+        }
+    }
+    pBlock->freeRanges[offset] = size;
+    pBlock->allocationCount--;
+
+    // An empty block is released unless it is the only one of its memory type, which is kept for the next allocations.
+    DeviceBlocks& deviceBlocks = m_devices[subAllocation.device];
+    std::vector<Block*>& blocks = deviceBlocks.memoryTypes[subAllocation.memoryTypeIndex];
+    if (pBlock->allocationCount == 0 && blocks.size() > 1) {
+        blocks.erase(std::find(blocks.begin(), blocks.end(), pBlock));
+        deviceBlocks.pfnFreeMemory(subAllocation.device, pBlock->memory, NULL);
+        delete pBlock;
+    }
+    return true;
+}
+
+VkDeviceSize vkReplaySubAllocator::getOffset(VkDeviceMemory traceMemory) const {
+    if (!isEnabled()) {
+        return 0;
+    }
+    auto it = m_subAllocations.find(traceMemory);
+    return (it != m_subAllocations.end()) ? it->second.offset : 0;
+}
+
+VkResult vkReplaySubAllocator::map(VkDeviceMemory traceMemory, VkDeviceSize offset, void** ppData) {
+    auto it = m_subAllocations.find(traceMemory);
+    if (it == m_subAllocations.end()) {
+        return VK_ERROR_MEMORY_MAP_FAILED;
+    }
+
+    Block* pBlock = it->second.pBlock;
+    if (pBlock->pMappedData == NULL) {
+        void* pData = NULL;
+        VkResult result = m_devices[it->second.device].pfnMapMemory(it->second.device, pBlock->memory, 0, VK_WHOLE_SIZE, 0, &pData);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+        pBlock->pMappedData = (uint8_t*)pData;
+    }
+    *ppData = pBlock->pMappedData + it->second.offset + offset;
+    return VK_SUCCESS;
+}
+
+void vkReplaySubAllocator::adjustRange(VkDeviceMemory traceMemory, VkMappedMemoryRange* pRange) const {
+    auto it = m_subAllocations.find(traceMemory);
+    if (it == m_subAllocations.end()) {
+        return;
+    }
+
+    // VK_WHOLE_SIZE would reach the end of the block rather than the end of the sub-allocation
+    if (pRange->size == VK_WHOLE_SIZE) {
+        pRange->size = it->second.size - std::min(pRange->offset, it->second.size);
+    }
+    pRange->offset += it->second.offset;
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2019 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//  Replay memory sub-allocator
+//
+//     Traces of applications that don't sub-allocate can contain tens of thousands of vkAllocateMemory calls, which is slow
+//     to replay and can exceed maxMemoryAllocationCount on the replay device. When a block size is set, vkreplay carves
+//     the memory allocations of the trace out of large blocks per device and memory type instead. The traced
+//     VkDeviceMemory is then remapped to its block, and every bind, map and flush of it is moved to its offset in the
+//     block. Blocks are mapped once, on the first vkMapMemory of any allocation in them, and stay mapped until freed.
+//
+//     Allocations with a pNext chain (dedicated, exported or device address allocations) and allocations larger than a
+//     quarter of a block are still made by the driver.
+
+#pragma once
+
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+class vkReplaySubAllocator {
+   public:
+    vkReplaySubAllocator() : m_blockSize(0) {}
+    ~vkReplaySubAllocator() {}
+
+    // Sub-allocation is disabled until a block size is set.
+    void setBlockSize(VkDeviceSize blockSize) { m_blockSize = blockSize; }
+    bool isEnabled() const { return m_blockSize != 0; }
+
+    // Must be called for each replay device before allocating from it.
+    void addDevice(VkDevice device, const VkPhysicalDeviceLimits& limits, PFN_vkAllocateMemory pfnAllocateMemory,
+                   PFN_vkFreeMemory pfnFreeMemory, PFN_vkMapMemory pfnMapMemory);
+
+    // Frees all blocks of the device, which must be called before the device is destroyed.
+    void destroyDevice(VkDevice device);
+
+    // Carves traceMemory out of a block and returns the block in pBlockMemory. Returns false if the allocation has to be
+    // made by the driver instead.
+    bool allocate(VkDevice device, VkDeviceMemory traceMemory, const VkMemoryAllocateInfo* pAllocateInfo,
+                  VkDeviceMemory* pBlockMemory);
+
+    // Returns false if traceMemory isn't sub-allocated and still has to be freed by the driver.
+    bool release(VkDeviceMemory traceMemory);
+
+    bool isSubAllocated(VkDeviceMemory traceMemory) const {
+        return isEnabled() && m_subAllocations.find(traceMemory) != m_subAllocations.end();
+    }
+
+    // Offset of traceMemory in its block, 0 if it isn't sub-allocated.
+    VkDeviceSize getOffset(VkDeviceMemory traceMemory) const;
+
+    // Returns the address of offset in the sub-allocation, mapping its block if it isn't mapped yet.
+    VkResult map(VkDeviceMemory traceMemory, VkDeviceSize offset, void** ppData);
+
+    // Moves a flushed or invalidated range of traceMemory to the range of its block.
+    void adjustRange(VkDeviceMemory traceMemory, VkMappedMemoryRange* pRange) const;
+
+   private:
+    struct Block {
+        VkDeviceMemory memory;
+        uint8_t* pMappedData;
+        uint32_t allocationCount;
+        // Free ranges of the block, offset to size, merged with their neighbours when freed.
+        std::map<VkDeviceSize, VkDeviceSize> freeRanges;
+    };
+
+    struct DeviceBlocks {
+        VkPhysicalDeviceLimits limits;
+        PFN_vkAllocateMemory pfnAllocateMemory;
+        PFN_vkFreeMemory pfnFreeMemory;
+        PFN_vkMapMemory pfnMapMemory;
+        std::unordered_map<uint32_t, std::vector<Block*> > memoryTypes;
+        uint64_t allocationCount;
+        uint64_t blockCount;
+    };
+
+    struct SubAllocation {
+        VkDevice device;
+        uint32_t memoryTypeIndex;
+        Block* pBlock;
+        VkDeviceSize offset;
+        VkDeviceSize size;
+    };
+
+    bool allocateFromBlock(Block* pBlock, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* pOffset);
+
+    VkDeviceSize m_blockSize;
+    std::unordered_map<VkDevice, DeviceBlocks> m_devices;
+    std::unordered_map<VkDeviceMemory, SubAllocation> m_subAllocations;
+};
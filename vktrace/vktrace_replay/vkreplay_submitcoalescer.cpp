@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2019 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vkreplay_submitcoalescer.h"
+
+bool vkReplaySubmitCoalescer::canCoalesce(uint32_t submitCount, const VkSubmitInfo* pSubmits) const {
+    if (!m_enabled) {
+        return false;
+    }
+    // timeline semaphore values, device masks and other extension structures aren't copied
+    for (uint32_t i = 0; i < submitCount; i++) {
+        if (pSubmits[i].pNext != NULL) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void vkReplaySubmitCoalescer::add(VkQueue queue, uint32_t submitCount, const VkSubmitInfo* pSubmits) {
+    m_queue = queue;
+    m_pendingCallCount++;
+
+    for (uint32_t i = 0; i < submitCount; i++) {
+        const VkSubmitInfo& submit = pSubmits[i];
+        PendingSubmit pendingSubmit;
+        pendingSubmit.info = submit;
+        pendingSubmit.firstWaitSemaphore = m_waitSemaphores.size();
+        pendingSubmit.firstCommandBuffer = m_commandBuffers.size();
+        pendingSubmit.firstSignalSemaphore = m_signalSemaphores.size();
+        m_submits.push_back(pendingSubmit);
+
+        if (submit.pWaitSemaphores != NULL) {
+            m_waitSemaphores.insert(m_waitSemaphores.end(), submit.pWaitSemaphores,
+                                    submit.pWaitSemaphores + submit.waitSemaphoreCount);
+        }
+        if (submit.pWaitDstStageMask != NULL) {
+            m_waitDstStageMasks.insert(m_waitDstStageMasks.end(), submit.pWaitDstStageMask,
+                                       submit.pWaitDstStageMask + submit.waitSemaphoreCount);
+        } else {
+            m_waitDstStageMasks.resize(m_waitSemaphores.size(), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+        }
+        if (submit.pCommandBuffers != NULL) {
+            m_commandBuffers.insert(m_commandBuffers.end(), submit.pCommandBuffers,
+                                    submit.pCommandBuffers + submit.commandBufferCount);
+        }
+        if (submit.pSignalSemaphores != NULL) {
+            m_signalSemaphores.insert(m_signalSemaphores.end(), submit.pSignalSemaphores,
+                                      submit.pSignalSemaphores + submit.signalSemaphoreCount);
+        }
+    }
+}
+
+VkResult vkReplaySubmitCoalescer::flush(PFN_vkQueueSubmit pfnQueueSubmit, VkFence fence) {
+    if (!isPending()) {
+        return VK_SUCCESS;
+    }
+
+    m_submitInfos.clear();
+    for (const PendingSubmit& pendingSubmit : m_submits) {
+        VkSubmitInfo info = pendingSubmit.info;
+        info.pWaitSemaphores = (info.waitSemaphoreCount > 0) ? &m_waitSemaphores[pendingSubmit.firstWaitSemaphore] : NULL;
+        info.pWaitDstStageMask = (info.waitSemaphoreCount > 0) ? &m_waitDstStageMasks[pendingSubmit.firstWaitSemaphore] : NULL;
+        info.pCommandBuffers = (info.commandBufferCount > 0) ? &m_commandBuffers[pendingSubmit.firstCommandBuffer] : NULL;
+        info.pSignalSemaphores =
+            (info.signalSemaphoreCount > 0) ? &m_signalSemaphores[pendingSubmit.firstSignalSemaphore] : NULL;
+        m_submitInfos.push_back(info);
+    }
+
+    VkResult result =
+        pfnQueueSubmit(m_queue, (uint32_t)m_submitInfos.size(), m_submitInfos.empty() ? NULL : m_submitInfos.data(), fence);
+    m_submitCallCount++;
+    m_coalescedCallCount += m_pendingCallCount - 1;
+
+    m_queue = VK_NULL_HANDLE;
+    m_pendingCallCount = 0;
+    m_submits.clear();
+    m_waitSemaphores.clear();
+    m_waitDstStageMasks.clear();
+    m_commandBuffers.clear();
+    m_signalSemaphores.clear();
+    return result;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2019 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//  Replay queue submit coalescer
+//
+//     Many applications call vkQueueSubmit several times per frame with a single command buffer each. When coalescing is
+//     enabled, vkreplay holds back the remapped VkSubmitInfos of a vkQueueSubmit without a fence instead of submitting
+//     them, and appends the VkSubmitInfos of the following vkQueueSubmits to the same queue. The batch is submitted with
+//     a single vkQueueSubmit as soon as any other packet is replayed, a vkQueueSubmit to another queue or with a fence is
+//     replayed, or vkreplay exits.
+//
+//     Batches of one vkQueueSubmit are executed in the order of their VkSubmitInfos, with the same semaphore waits and
+//     signals as separate vkQueueSubmits, so merging only consecutive packets keeps the semantics of the trace: fence
+//     waits, host reads of memory and submits to other queues are separate packets that submit the batch first.
+//     VkSubmitInfos with a pNext chain are never held back.
+
+#pragma once
+
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+class vkReplaySubmitCoalescer {
+   public:
+    vkReplaySubmitCoalescer()
+        : m_enabled(false), m_queue(VK_NULL_HANDLE), m_pendingCallCount(0), m_submitCallCount(0), m_coalescedCallCount(0) {}
+    ~vkReplaySubmitCoalescer() {}
+
+    void setEnabled(bool enabled) { m_enabled = enabled; }
+    bool isEnabled() const { return m_enabled; }
+
+    // Returns true if the remapped submits can be added to the pending batch, which must be flushed first if it is for
+    // another queue.
+    bool canCoalesce(uint32_t submitCount, const VkSubmitInfo* pSubmits) const;
+
+    bool isPending() const { return m_queue != VK_NULL_HANDLE; }
+    VkQueue getPendingQueue() const { return m_queue; }
+
+    // Copies the remapped submits into the pending batch of queue.
+    void add(VkQueue queue, uint32_t submitCount, const VkSubmitInfo* pSubmits);
+
+    // Submits the pending batch, signaling fence once all of it has completed. Does nothing and returns VK_SUCCESS if no
+    // batch is pending and fence is VK_NULL_HANDLE.
+    VkResult flush(PFN_vkQueueSubmit pfnQueueSubmit, VkFence fence);
+
+    uint64_t getSubmitCallCount() const { return m_submitCallCount; }
+    uint64_t getCoalescedCallCount() const { return m_coalescedCallCount; }
+
+   private:
+    // The arrays of the pending VkSubmitInfos are stored by index, as the vectors move when they grow.
+    struct PendingSubmit {
+        VkSubmitInfo info;
+        size_t firstWaitSemaphore;
+        size_t firstCommandBuffer;
+        size_t firstSignalSemaphore;
+    };
+
+    bool m_enabled;
+    VkQueue m_queue;
+    uint32_t m_pendingCallCount;
+    std::vector<PendingSubmit> m_submits;
+    std::vector<VkSemaphore> m_waitSemaphores;
+    std::vector<VkPipelineStageFlags> m_waitDstStageMasks;
+    std::vector<VkCommandBuffer> m_commandBuffers;
+    std::vector<VkSemaphore> m_signalSemaphores;
+    std::vector<VkSubmitInfo> m_submitInfos;
+
+    // vkQueueSubmit calls made by the coalescer, and traced vkQueueSubmits that were merged into another call.
+    uint64_t m_submitCallCount;
+    uint64_t m_coalescedCallCount;
+};
@@ -30,6 +30,7 @@
 #include "vkreplay_settings.h"
 #include "vkreplay_main.h"
 
+#include <inttypes.h>
 #include <algorithm>
 
 #include "vktrace_vk_vk_packets.h"
@@ -64,21 +65,64 @@ vkReplay::vkReplay(vkreplayer_settings *pReplaySettings, vktrace_trace_file_head
 
     //    m_pVktraceSnapshotPrint = NULL;
     m_objMapper.m_adjustForGPU = false;
+    // timing every handle lookup isn't free, so it's only done when the statistics are written
+    memset(&m_remapStats, 0, sizeof(m_remapStats));
+    if (pReplaySettings->perfStatsFile != NULL) {
+        m_objMapper.m_pRemapStats = &m_remapStats;
+    }
+
+    if (pReplaySettings->subAllocationBlockSize != 0) {
+        m_subAllocator.setBlockSize((VkDeviceSize)pReplaySettings->subAllocationBlockSize * 1024 * 1024);
+    }
+    m_submitCoalescer.setEnabled(pReplaySettings->coalesceSubmits);
+    m_descriptorBatcher.setEnabled(pReplaySettings->batchDescriptorUpdates);
+    m_stateFilter.setEnabled(pReplaySettings->removeRedundantState);
+    m_waitRelaxer.setEnabled(pReplaySettings->relaxWaits);
 
     m_frameNumber = 0;
     m_pFileHeader = pFileHeader;
     m_pGpuinfo = (struct_gpuinfo *)(pFileHeader + 1);
     m_platformMatch = -1;
+    m_pPacketLookupFile = NULL;
+    m_pPacketLookupFileLike = NULL;
 }
 
-std::vector<uintptr_t> portabilityTablePackets;
+std::unordered_map<uint64_t, portabilityTableAllocation> portabilityTableIndex;
 FileLike *traceFile;
 
 vkReplay::~vkReplay() {
+    // the trace may end with submits and descriptor updates that are still held back
+    m_descriptorBatcher.flush(m_vkDeviceFuncs.UpdateDescriptorSets);
+    flushCoalescedQueueSubmits();
+    resolveRelaxedWaits();
+    if (m_submitCoalescer.isEnabled()) {
+        vktrace_LogVerbose("Merged %" PRIu64 " vkQueueSubmit calls into %" PRIu64 " calls.",
+                           m_submitCoalescer.getCoalescedCallCount() + m_submitCoalescer.getSubmitCallCount(),
+                           m_submitCoalescer.getSubmitCallCount());
+    }
+    if (m_descriptorBatcher.isEnabled()) {
+        vktrace_LogVerbose("Merged %" PRIu64 " vkUpdateDescriptorSets calls into %" PRIu64 " calls, skipped %" PRIu64
+                           " redundant descriptor writes.",
+                           m_descriptorBatcher.getBatchedCallCount() + m_descriptorBatcher.getUpdateCallCount(),
+                           m_descriptorBatcher.getUpdateCallCount(), m_descriptorBatcher.getRedundantWriteCount());
+    }
+    if (m_stateFilter.isEnabled()) {
+        vktrace_LogVerbose("Skipped %" PRIu64 " of %" PRIu64 " state commands that didn't change the bound state.",
+                           m_stateFilter.getSkippedCallCount(), m_stateFilter.getFilteredCallCount());
+    }
+    if (m_waitRelaxer.isEnabled()) {
+        vktrace_LogVerbose("Deferred %" PRIu64 " waits, %" PRIu64 " of which were covered by other waits and dropped.",
+                           m_waitRelaxer.getDeferredWaitCount(), m_waitRelaxer.getDroppedWaitCount());
+    }
+
     for (auto subobj = traceQueueFamilyProperties.begin(); subobj != traceQueueFamilyProperties.end(); subobj++) {
         free(subobj->second.queueFamilyProperties);
     }
     traceQueueFamilyProperties.clear();
+    if (m_pPacketLookupFile != NULL) {
+        vktrace_free(m_pPacketLookupFileLike);
+        fclose(m_pPacketLookupFile);
+    }
     for (auto subobj = replayQueueFamilyProperties.begin(); subobj != replayQueueFamilyProperties.end(); subobj++) {
         free(subobj->second.queueFamilyProperties);
     }
@@ -223,10 +267,12 @@ vkReplay::~vkReplay() {
 
         // DeviceMemory
         for (auto subobj = m_objMapper.m_devicememorys.begin(); subobj != m_objMapper.m_devicememorys.end(); subobj++) {
-            if (replayDeviceMemoryToDevice[subobj->second.replayDeviceMemory] == obj->second) {
+            if (replayDeviceMemoryToDevice[subobj->second.replayDeviceMemory] == obj->second &&
+                !m_subAllocator.isSubAllocated(subobj->first)) {
                 m_vkDeviceFuncs.FreeMemory(obj->second, subobj->second.replayDeviceMemory, NULL);
             }
         }
+        m_subAllocator.destroyDevice(obj->second);
 
         // SwapchainKHR
         for (auto subobj = m_objMapper.m_swapchainkhrs.begin(); subobj != m_objMapper.m_swapchainkhrs.end(); subobj++) {
@@ -769,6 +815,13 @@ VkResult vkReplay::manually_replay_vkCreateDevice(packet_vkCreateDevice *pPacket
 
         // Build device dispatch table
         layer_init_device_dispatch_table(device, &m_vkDeviceFuncs, m_vkDeviceFuncs.GetDeviceProcAddr);
+
+        if (m_subAllocator.isEnabled()) {
+            VkPhysicalDeviceProperties properties;
+            m_vkFuncs.GetPhysicalDeviceProperties(remappedPhysicalDevice, &properties);
+            m_subAllocator.addDevice(device, properties.limits, m_vkDeviceFuncs.AllocateMemory, m_vkDeviceFuncs.FreeMemory,
+                                     m_vkDeviceFuncs.MapMemory);
+        }
     } else if (replayResult == VK_ERROR_EXTENSION_NOT_PRESENT) {
         vktrace_LogVerbose("vkCreateDevice failed with VK_ERROR_EXTENSION_NOT_PRESENT");
         vktrace_LogVerbose("List of requested extensions:");
@@ -950,6 +1003,7 @@ void vkReplay::manually_replay_vkDestroyBuffer(packet_vkDestroyBuffer *pPacket)
     }
     m_vkDeviceFuncs.DestroyBuffer(remappedDevice, remappedBuffer, pPacket->pAllocator);
     m_objMapper.rm_from_buffers_map(pPacket->buffer);
+    m_descriptorBatcher.forgetHandle((uint64_t)remappedBuffer);
     if (replayGetBufferMemoryRequirements.find(remappedBuffer) != replayGetBufferMemoryRequirements.end())
         replayGetBufferMemoryRequirements.erase(remappedBuffer);
     return;
@@ -1035,10 +1089,51 @@ VkResult vkReplay::manually_replay_vkQueueSubmit(packet_vkQueueSubmit *pPacket)
             }
         }
     }
+
+    // resubmitting a command buffer needs the waits that guard its previous submission, and a submit to another queue
+    // needs the waits the application ordered it after
+    if (m_waitRelaxer.addSubmits(remappedQueue, pPacket->submitCount, remappedSubmits, remappedFence)) {
+        resolveRelaxedWaits();
+    }
+
+    if (m_submitCoalescer.canCoalesce(pPacket->submitCount, remappedSubmits)) {
+        if (m_submitCoalescer.isPending() && m_submitCoalescer.getPendingQueue() != remappedQueue) {
+            flushCoalescedQueueSubmits();
+        }
+        m_submitCoalescer.add(remappedQueue, pPacket->submitCount, remappedSubmits);
+        // the fence has to signal once the whole batch has completed, so the batch ends here
+        if (remappedFence == VK_NULL_HANDLE) {
+            return VK_SUCCESS;
+        }
+        return m_submitCoalescer.flush(m_vkDeviceFuncs.QueueSubmit, remappedFence);
+    }
+
+    flushCoalescedQueueSubmits();
     replayResult = m_vkDeviceFuncs.QueueSubmit(remappedQueue, pPacket->submitCount, remappedSubmits, remappedFence);
     return replayResult;
 }
 
+void vkReplay::flushCoalescedQueueSubmits() {
+    if (!m_submitCoalescer.isPending()) {
+        return;
+    }
+    VkResult replayResult = m_submitCoalescer.flush(m_vkDeviceFuncs.QueueSubmit, VK_NULL_HANDLE);
+    if (replayResult != VK_SUCCESS) {
+        vktrace_LogError("vkQueueSubmit() of coalesced submits failed with result = 0x%X.", replayResult);
+    }
+}
+
+void vkReplay::resolveRelaxedWaits() {
+    if (!m_waitRelaxer.isPending()) {
+        return;
+    }
+    VkResult replayResult =
+        m_waitRelaxer.resolve(m_vkDeviceFuncs.WaitForFences, m_vkDeviceFuncs.QueueWaitIdle, m_vkDeviceFuncs.DeviceWaitIdle);
+    if (replayResult != VK_SUCCESS) {
+        vktrace_LogError("Deferred wait failed with result = 0x%X.", replayResult);
+    }
+}
+
 VkResult vkReplay::manually_replay_vkQueueBindSparse(packet_vkQueueBindSparse *pPacket) {
     VkResult replayResult = VK_ERROR_VALIDATION_FAILED_EXT;
     VkQueue remappedQueue = m_objMapper.remap_queues(pPacket->queue);
@@ -1090,6 +1185,8 @@ VkResult vkReplay::manually_replay_vkQueueBindSparse(packet_vkQueueBindSparse *p
                     vktrace_LogError("Skipping vkQueueBindSparse() due to invalid remapped VkDeviceMemory.");
                     goto FAILURE;
                 }
+                pRemappedBufferMemories[bindCountIdx].memoryOffset +=
+                    m_subAllocator.getOffset(pRemappedBufferMemories[bindCountIdx].memory);
                 pRemappedBufferMemories[bindCountIdx].memory = replay_mem;
             }
             sBMBinf->pBinds = pRemappedBufferMemories;
@@ -1120,6 +1217,8 @@ VkResult vkReplay::manually_replay_vkQueueBindSparse(packet_vkQueueBindSparse *p
                     vktrace_LogError("Skipping vkQueueBindSparse() due to invalid remapped VkDeviceMemory.");
                     goto FAILURE;
                 }
+                pRemappedImageMemories[bindCountIdx].memoryOffset +=
+                    m_subAllocator.getOffset(pRemappedImageMemories[bindCountIdx].memory);
                 pRemappedImageMemories[bindCountIdx].memory = replay_mem;
             }
             sIMBinf->pBinds = pRemappedImageMemories;
@@ -1151,6 +1250,8 @@ VkResult vkReplay::manually_replay_vkQueueBindSparse(packet_vkQueueBindSparse *p
                     vktrace_LogError("Skipping vkQueueBindSparse() due to invalid remapped VkDeviceMemory.");
                     goto FAILURE;
                 }
+                pRemappedImageOpaqueMemories[bindCountIdx].memoryOffset +=
+                    m_subAllocator.getOffset(pRemappedImageOpaqueMemories[bindCountIdx].memory);
                 pRemappedImageOpaqueMemories[bindCountIdx].memory = replay_mem;
             }
             sIMOBinf->pBinds = pRemappedImageOpaqueMemories;
@@ -1208,85 +1309,49 @@ void vkReplay::manually_replay_vkUpdateDescriptorSets(packet_vkUpdateDescriptorS
 
         pRemappedWrites[i].dstSet = dstSet;
 
+        // the handles of each write are remapped in place with one pass over its info array
+        VkDescriptorImageInfo *pImageInfo = const_cast<VkDescriptorImageInfo *>(pRemappedWrites[i].pImageInfo);
+        VkDescriptorBufferInfo *pBufferInfo = const_cast<VkDescriptorBufferInfo *>(pRemappedWrites[i].pBufferInfo);
+        uint32_t descriptorCount = pPacket->pDescriptorWrites[i].descriptorCount;
         switch (pPacket->pDescriptorWrites[i].descriptorType) {
             case VK_DESCRIPTOR_TYPE_SAMPLER:
-                for (uint32_t j = 0; j < pPacket->pDescriptorWrites[i].descriptorCount; j++) {
-                    if (pPacket->pDescriptorWrites[i].pImageInfo[j].sampler != VK_NULL_HANDLE) {
-                        const_cast<VkDescriptorImageInfo *>(pRemappedWrites[i].pImageInfo)[j].sampler =
-                            m_objMapper.remap_samplers(pPacket->pDescriptorWrites[i].pImageInfo[j].sampler);
-                        if (pRemappedWrites[i].pImageInfo[j].sampler == VK_NULL_HANDLE) {
-                            vktrace_LogError("Skipping vkUpdateDescriptorSets() due to invalid remapped VkSampler.");
-                            errorBadRemap = true;
-                            break;
-                        }
-                    }
+                if (!m_objMapper.remap_samplers(&pImageInfo->sampler, descriptorCount, sizeof(VkDescriptorImageInfo))) {
+                    vktrace_LogError("Skipping vkUpdateDescriptorSets() due to invalid remapped VkSampler.");
+                    errorBadRemap = true;
                 }
                 break;
             case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
             case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
             case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
-                for (uint32_t j = 0; j < pPacket->pDescriptorWrites[i].descriptorCount; j++) {
-                    if (pPacket->pDescriptorWrites[i].pImageInfo[j].imageView != VK_NULL_HANDLE) {
-                        const_cast<VkDescriptorImageInfo *>(pRemappedWrites[i].pImageInfo)[j].imageView =
-                            m_objMapper.remap_imageviews(pPacket->pDescriptorWrites[i].pImageInfo[j].imageView);
-                        if (pRemappedWrites[i].pImageInfo[j].imageView == VK_NULL_HANDLE) {
-                            vktrace_LogError("Skipping vkUpdateDescriptorSets() due to invalid remapped VkImageView.");
-                            errorBadRemap = true;
-                            break;
-                        }
-                    }
+                if (!m_objMapper.remap_imageviews(&pImageInfo->imageView, descriptorCount, sizeof(VkDescriptorImageInfo))) {
+                    vktrace_LogError("Skipping vkUpdateDescriptorSets() due to invalid remapped VkImageView.");
+                    errorBadRemap = true;
                 }
                 break;
             case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
-                for (uint32_t j = 0; j < pPacket->pDescriptorWrites[i].descriptorCount; j++) {
-                    if (pPacket->pDescriptorWrites[i].pImageInfo[j].sampler != VK_NULL_HANDLE) {
-                        const_cast<VkDescriptorImageInfo *>(pRemappedWrites[i].pImageInfo)[j].sampler =
-                            m_objMapper.remap_samplers(pPacket->pDescriptorWrites[i].pImageInfo[j].sampler);
-                        if (pRemappedWrites[i].pImageInfo[j].sampler == VK_NULL_HANDLE) {
-                            vktrace_LogError("Skipping vkUpdateDescriptorSets() due to invalid remapped VkSampler.");
-                            errorBadRemap = true;
-                            break;
-                        }
-                    }
-                    if (pPacket->pDescriptorWrites[i].pImageInfo[j].imageView != VK_NULL_HANDLE) {
-                        const_cast<VkDescriptorImageInfo *>(pRemappedWrites[i].pImageInfo)[j].imageView =
-                            m_objMapper.remap_imageviews(pPacket->pDescriptorWrites[i].pImageInfo[j].imageView);
-                        if (pRemappedWrites[i].pImageInfo[j].imageView == VK_NULL_HANDLE) {
-                            vktrace_LogError("Skipping vkUpdateDescriptorSets() due to invalid remapped VkImageView.");
-                            errorBadRemap = true;
-                            break;
-                        }
-                    }
+                if (!m_objMapper.remap_samplers(&pImageInfo->sampler, descriptorCount, sizeof(VkDescriptorImageInfo))) {
+                    vktrace_LogError("Skipping vkUpdateDescriptorSets() due to invalid remapped VkSampler.");
+                    errorBadRemap = true;
+                } else if (!m_objMapper.remap_imageviews(&pImageInfo->imageView, descriptorCount, sizeof(VkDescriptorImageInfo))) {
+                    vktrace_LogError("Skipping vkUpdateDescriptorSets() due to invalid remapped VkImageView.");
+                    errorBadRemap = true;
                 }
                 break;
             case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
             case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
-                for (uint32_t j = 0; j < pPacket->pDescriptorWrites[i].descriptorCount; j++) {
-                    if (pPacket->pDescriptorWrites[i].pTexelBufferView[j] != VK_NULL_HANDLE) {
-                        const_cast<VkBufferView *>(pRemappedWrites[i].pTexelBufferView)[j] =
-                            m_objMapper.remap_bufferviews(pPacket->pDescriptorWrites[i].pTexelBufferView[j]);
-                        if (pRemappedWrites[i].pTexelBufferView[j] == VK_NULL_HANDLE) {
-                            vktrace_LogError("Skipping vkUpdateDescriptorSets() due to invalid remapped VkBufferView.");
-                            errorBadRemap = true;
-                            break;
-                        }
-                    }
+                if (!m_objMapper.remap_bufferviews(const_cast<VkBufferView *>(pRemappedWrites[i].pTexelBufferView), descriptorCount,
+                                                   sizeof(VkBufferView))) {
+                    vktrace_LogError("Skipping vkUpdateDescriptorSets() due to invalid remapped VkBufferView.");
+                    errorBadRemap = true;
                 }
                 break;
             case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
             case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
             case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
             case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
-                for (uint32_t j = 0; j < pPacket->pDescriptorWrites[i].descriptorCount; j++) {
-                    if (pPacket->pDescriptorWrites[i].pBufferInfo[j].buffer != VK_NULL_HANDLE) {
-                        const_cast<VkDescriptorBufferInfo *>(pRemappedWrites[i].pBufferInfo)[j].buffer =
-                            m_objMapper.remap_buffers(pPacket->pDescriptorWrites[i].pBufferInfo[j].buffer);
-                        if (pRemappedWrites[i].pBufferInfo[j].buffer == VK_NULL_HANDLE) {
-                            vktrace_LogError("Skipping vkUpdateDescriptorSets() due to invalid remapped VkBufferView.");
-                            errorBadRemap = true;
-                            break;
-                        }
-                    }
+                if (!m_objMapper.remap_buffers(&pBufferInfo->buffer, descriptorCount, sizeof(VkDescriptorBufferInfo))) {
+                    vktrace_LogError("Skipping vkUpdateDescriptorSets() due to invalid remapped VkBufferView.");
+                    errorBadRemap = true;
                 }
             /* Nothing to do, already copied the constant values into the new descriptor info */
             default:
@@ -1313,8 +1378,25 @@ void vkReplay::manually_replay_vkUpdateDescriptorSets(packet_vkUpdateDescriptorS
     if (!errorBadRemap) {
         // If an error occurred, don't call the real function, but skip ahead so that memory is cleaned up!
 
-        m_vkDeviceFuncs.UpdateDescriptorSets(remappedDevice, pPacket->descriptorWriteCount, pRemappedWrites,
-                                             pPacket->descriptorCopyCount, pRemappedCopies);
+        uint32_t descriptorWriteCount = m_descriptorBatcher.removeRedundantWrites(pPacket->descriptorWriteCount, pRemappedWrites);
+        for (uint32_t i = 0; i < pPacket->descriptorCopyCount; i++) {
+            m_descriptorBatcher.forgetSet(pRemappedCopies[i].dstSet);
+        }
+        if (descriptorWriteCount == 0 && pPacket->descriptorCopyCount == 0) {
+            return;
+        }
+
+        if (m_descriptorBatcher.canBatch(descriptorWriteCount, pRemappedWrites, pPacket->descriptorCopyCount)) {
+            if (m_descriptorBatcher.isPending() && m_descriptorBatcher.getPendingDevice() != remappedDevice) {
+                m_descriptorBatcher.flush(m_vkDeviceFuncs.UpdateDescriptorSets);
+            }
+            m_descriptorBatcher.add(remappedDevice, descriptorWriteCount, pRemappedWrites);
+            return;
+        }
+
+        m_descriptorBatcher.flush(m_vkDeviceFuncs.UpdateDescriptorSets);
+        m_vkDeviceFuncs.UpdateDescriptorSets(remappedDevice, descriptorWriteCount, pRemappedWrites, pPacket->descriptorCopyCount,
+                                             pRemappedCopies);
     }
 }
 
@@ -1405,6 +1487,8 @@ VkResult vkReplay::manually_replay_vkAllocateDescriptorSets(packet_vkAllocateDes
     if (replayResult == VK_SUCCESS) {
         for (uint32_t i = 0; i < pPacket->pAllocateInfo->descriptorSetCount; ++i) {
             m_objMapper.add_to_descriptorsets_map(pPacket->pDescriptorSets[i], localDSs[i]);
+            // the driver may return the handle of a set that was freed or reset
+            m_descriptorBatcher.forgetSet(localDSs[i]);
         }
     }
     VKTRACE_DELETE(localDSs);
@@ -1444,6 +1528,7 @@ VkResult vkReplay::manually_replay_vkFreeDescriptorSets(packet_vkFreeDescriptorS
     if (replayResult == VK_SUCCESS) {
         for (i = 0; i < pPacket->descriptorSetCount; ++i) {
             m_objMapper.rm_from_descriptorsets_map(pPacket->pDescriptorSets[i]);
+            m_descriptorBatcher.forgetSet(localDSs[i]);
         }
     }
     VKTRACE_DELETE(localDSs);
@@ -1472,6 +1557,11 @@ void vkReplay::manually_replay_vkCmdBindDescriptorSets(packet_vkCmdBindDescripto
         }
     }
 
+    if (m_stateFilter.skipBindDescriptorSets(remappedCommandBuffer, pPacket->pipelineBindPoint, remappedLayout, pPacket->firstSet,
+                                             pPacket->descriptorSetCount, pRemappedSets, pPacket->dynamicOffsetCount,
+                                             pPacket->pDynamicOffsets)) {
+        return;
+    }
     m_vkDeviceFuncs.CmdBindDescriptorSets(remappedCommandBuffer, pPacket->pipelineBindPoint, remappedLayout, pPacket->firstSet,
                                           pPacket->descriptorSetCount, pRemappedSets, pPacket->dynamicOffsetCount,
                                           pPacket->pDynamicOffsets);
@@ -1496,6 +1586,10 @@ void vkReplay::manually_replay_vkCmdBindVertexBuffers(packet_vkCmdBindVertexBuff
             }
         }
     }
+    if (m_stateFilter.skipBindVertexBuffers(remappedCommandBuffer, pPacket->firstBinding, pPacket->bindingCount, pPacket->pBuffers,
+                                            pPacket->pOffsets)) {
+        return;
+    }
     m_vkDeviceFuncs.CmdBindVertexBuffers(remappedCommandBuffer, pPacket->firstBinding, pPacket->bindingCount, pPacket->pBuffers,
                                          pPacket->pOffsets);
     return;
@@ -1910,6 +2004,11 @@ VkResult vkReplay::manually_replay_vkBeginCommandBuffer(packet_vkBeginCommandBuf
         *pRP = m_objMapper.remap_renderpasss(savedRP);
         *pFB = m_objMapper.remap_framebuffers(savedFB);
     }
+    m_stateFilter.forgetCommandBuffer(remappedCommandBuffer);
+    if (m_waitRelaxer.isCommandBufferPending(remappedCommandBuffer)) {
+        resolveRelaxedWaits();
+    }
+    m_waitRelaxer.forgetCommandBuffer(remappedCommandBuffer);
     replayResult = m_vkDeviceFuncs.BeginCommandBuffer(remappedCommandBuffer, pPacket->pBeginInfo);
     if (pInfo != NULL && pHinfo != NULL) {
         pHinfo->renderPass = savedRP;
@@ -1936,6 +2035,12 @@ VkResult vkReplay::manually_replay_vkWaitForFences(packet_vkWaitForFences *pPack
             return VK_ERROR_VALIDATION_FAILED_EXT;
         }
     }
+    if (pPacket->result == VK_SUCCESS &&
+        m_waitRelaxer.deferWaitForFences(remappedDevice, pPacket->fenceCount, pFence, pPacket->waitAll)) {
+        return VK_SUCCESS;
+    }
+    // a wait that isn't deferred could see a fence that a deferred wait is waiting for
+    resolveRelaxedWaits();
     if (pPacket->result == VK_SUCCESS) {
         replayResult = m_vkDeviceFuncs.WaitForFences(remappedDevice, pPacket->fenceCount, pFence, pPacket->waitAll,
                                                      UINT64_MAX);  // mean as long as possible
@@ -2024,20 +2129,32 @@ fail:
     return false;
 }
 
+// Reads the packet at the given offset of the trace file. The trace file is opened again for these reads on first use, so
+// they don't move the position of traceFile.
+vktrace_trace_packet_header *vkReplay::readPacketAtOffset(uint64_t offset) {
+    if (m_pPacketLookupFile == NULL) {
+        if (g_pReplaySettings->pTraceFilePath != NULL) {
+            m_pPacketLookupFile = fopen(g_pReplaySettings->pTraceFilePath, "rb");
+        }
+        if (m_pPacketLookupFile == NULL) {
+            vktrace_LogError("Cannot open trace file to look up packets referenced by the portability table.");
+            return NULL;
+        }
+        m_pPacketLookupFileLike = vktrace_FileLike_create_file(m_pPacketLookupFile);
+    }
+    if (!vktrace_FileLike_SetCurrentPosition(m_pPacketLookupFileLike, offset)) return NULL;
+    vktrace_trace_packet_header *pHeader = vktrace_read_trace_packet(m_pPacketLookupFileLike);
+    return pHeader ? interpret_trace_packet_vk(pHeader) : NULL;
+}
+
 bool vkReplay::modifyMemoryTypeIndexInAllocateMemoryPacket(VkDevice remappedDevice, packet_vkAllocateMemory *pPacket) {
     bool rval = false;
     uint32_t replayMemTypeIndex;
-    vktrace_trace_packet_header *pPacketHeader1;
-    VkDeviceMemory traceAllocateMemoryRval = VK_NULL_HANDLE;
-    bool foundBindMem;
-    VkDeviceSize bimMemoryOffset;
-    packet_vkFreeMemory *pFreeMemoryPacket;
+    const portabilityTableBind *pBind = NULL;
+    bool bImage = false;
     VkMemoryRequirements memRequirements;
-    size_t n, amIdx;
     VkDeviceSize replayAllocationSize;
-    static size_t amSearchPos = 0;
     VkImage remappedImage = VK_NULL_HANDLE;
-    size_t bindMemIdx;
     VkImage bindMemImage = VK_NULL_HANDLE;
     bool doDestroyImage = false;
 
@@ -2045,156 +2162,86 @@ bool vkReplay::modifyMemoryTypeIndexInAllocateMemoryPacket(VkDevice remappedDevi
     // does not match the trace platform
     assert(g_pReplaySettings->compatibilityMode && m_pFileHeader->portability_table_valid && !platformMatch());
 
-    // First find this vkAM call in portabilityTablePackets
-    // In order to speed up the search, we start searching at amSearchPos,
-    // wrapping the search back to 0.
+    // Look up the binds of the memory returned by this vkAM call in the portability table index
     pPacket->header = (vktrace_trace_packet_header *)((PBYTE)pPacket - sizeof(vktrace_trace_packet_header));
-    for (n = 0, amIdx = amSearchPos; n < portabilityTablePackets.size(); n++, amIdx++) {
-        if (amIdx == portabilityTablePackets.size())
-            // amIdx is past the end of the array, wrap back to the start of the array
-            amIdx = 0;
-        pPacketHeader1 = (vktrace_trace_packet_header *)portabilityTablePackets[amIdx];
-        if (pPacketHeader1->global_packet_index == pPacket->header->global_packet_index &&
-            pPacketHeader1->packet_id == VKTRACE_TPI_VK_vkAllocateMemory) {
-            // Found it
-            // Save the vkAM return value from the trace file
-            traceAllocateMemoryRval = *pPacket->pMemory;
-            // Save the index where we will start the next search for vkAM
-            amSearchPos = amIdx + 1;
-            break;
-        }
-    }
-    if (n == portabilityTablePackets.size()) {
+    auto allocation = portabilityTableIndex.find(pPacket->header->global_packet_index);
+    if (allocation == portabilityTableIndex.end()) {
         // Didn't find the current vkAM packet, something is wrong with the trace file.
         // Just use the index from the trace file and attempt to continue.
         vktrace_LogError("Replay of vkAllocateMemory() failed, trace file may be corrupt.");
-        goto out;
-    }
-
-    // Search forward from amIdx for vkBIM/vkBBM/vkBIM2/vkBBM2 call that binds this memory.
-    // If we don't find one, generate an error and do the best we can.
-    foundBindMem = false;
-    for (size_t i = amIdx + 1; !foundBindMem && i < portabilityTablePackets.size(); i++) {
-        pPacketHeader1 = (vktrace_trace_packet_header *)portabilityTablePackets[i];
-        if (pPacketHeader1->packet_id == VKTRACE_TPI_VK_vkFreeMemory) {
-            pFreeMemoryPacket = (packet_vkFreeMemory *)(pPacketHeader1->pBody);
-            if (pFreeMemoryPacket->memory == traceAllocateMemoryRval) {
-                // Found a free of this memory, end the forward search
-                vktrace_LogWarning("Memory allocated by vkAllocateMemory is not used.");
-                break;
-            }
-        }
-
-        if (pPacketHeader1->packet_id == VKTRACE_TPI_VK_vkBindImageMemory2KHR ||
-            pPacketHeader1->packet_id == VKTRACE_TPI_VK_vkBindBufferMemory2KHR) {
-            // Search the memory bind list in vkBIM2/vkBBM2 packet for traceAllocateMemoryRval
-            packet_vkBindImageMemory2KHR *pBim2Packet = (packet_vkBindImageMemory2KHR *)(pPacketHeader1->pBody);
-            for (uint32_t bindCounter = 0; bindCounter < pBim2Packet->bindInfoCount; bindCounter++) {
-                if (pBim2Packet->pBindInfos[bindCounter].memory == traceAllocateMemoryRval) {
-                    // Found a bind
-                    if (pPacketHeader1->packet_id == VKTRACE_TPI_VK_vkBindImageMemory2KHR)
-                        remappedImage = m_objMapper.remap_images(pBim2Packet->pBindInfos[bindCounter].image);
-                    else
-                        remappedImage = (VkImage)m_objMapper.remap_buffers((VkBuffer)pBim2Packet->pBindInfos[bindCounter].image);
-
-                    if (pPacketHeader1->packet_id == VKTRACE_TPI_VK_vkBindImageMemory2KHR && remappedImage &&
-                        replayImageToTiling[remappedImage] == VK_IMAGE_TILING_OPTIMAL) {
-                        // Skip optimal tiling image
-                        remappedImage = VK_NULL_HANDLE;
-                    } else {
-                        foundBindMem = true;
-                        bindMemIdx = i;
-                        bindMemImage = pBim2Packet->pBindInfos[bindCounter].image;
-                        bimMemoryOffset = pBim2Packet->pBindInfos[bindCounter].memoryOffset;
-                        break;
-                    }
-                }
-            }
-        } else if (pPacketHeader1->packet_id == VKTRACE_TPI_VK_vkBindImageMemory ||
-                   pPacketHeader1->packet_id == VKTRACE_TPI_VK_vkBindBufferMemory) {
-            packet_vkBindImageMemory *bim = (packet_vkBindImageMemory *)(pPacketHeader1->pBody);
-            if (traceAllocateMemoryRval == bim->memory) {
-                // A vkBIM/vkBBM binds memory allocated by this vkAM call.
-                if (pPacketHeader1->packet_id == VKTRACE_TPI_VK_vkBindImageMemory)
-                    remappedImage = m_objMapper.remap_images(bim->image);
-                else
-                    remappedImage = (VkImage)m_objMapper.remap_buffers((VkBuffer)bim->image);
+        return false;
+    }
 
-                if (pPacketHeader1->packet_id == VKTRACE_TPI_VK_vkBindImageMemory && remappedImage &&
-                    replayImageToTiling[remappedImage] == VK_IMAGE_TILING_OPTIMAL) {
-                    // Skip optimal tiling image
-                    remappedImage = VK_NULL_HANDLE;
-                } else {
-                    foundBindMem = true;
-                    bindMemIdx = i;
-                    bindMemImage = bim->image;
-                    bimMemoryOffset = bim->memoryOffset;
-                }
+    // Use the first vkBIM/vkBBM/vkBIM2/vkBBM2 call that binds this memory to anything but an optimal tiling image.
+    for (const portabilityTableBind &bind : allocation->second) {
+        bImage = (bind.packetId == VKTRACE_TPI_VK_vkBindImageMemory || bind.packetId == VKTRACE_TPI_VK_vkBindImageMemory2KHR);
+        if (bImage)
+            remappedImage = m_objMapper.remap_images((VkImage)bind.resource);
+        else
+            remappedImage = (VkImage)m_objMapper.remap_buffers((VkBuffer)bind.resource);
 
-                // Need to implement:
-                // Check for uses of the memory returned by this vkAM call in vkQueueBindSparse calls to find
-                // an image/buffer that uses the memory.
-                // ....
-            }
+        if (bImage && remappedImage && replayImageToTiling[remappedImage] == VK_IMAGE_TILING_OPTIMAL) {
+            // Skip optimal tiling image
+            remappedImage = VK_NULL_HANDLE;
+        } else {
+            pBind = &bind;
+            bindMemImage = (VkImage)bind.resource;
+            break;
         }
+
+        // Need to implement:
+        // Check for uses of the memory returned by this vkAM call in vkQueueBindSparse calls to find
+        // an image/buffer that uses the memory.
+        // ....
     }
 
-    if (!foundBindMem) {
+    if (!pBind) {
         // Didn't find vkBind{Image|Buffer}Memory call for this vkAllocateMemory or the memory is allocated for optimal image(s)
         // only.
         // This isn't an error - the memory is either allocated but never used or needs to be skipped (optimal image(s) memory
         // allocation will be done in replaying vkBindImageMemory).
         // So just skip the memory allocation.
-        goto out;
+        if (allocation->second.empty()) vktrace_LogWarning("Memory allocated by vkAllocateMemory is not used.");
+        return false;
     }
 
     if (!remappedImage) {
         // The CreateImage/Buffer command after the AllocMem command, so the image/buffer hasn't
-        // been created yet. Search backwards from the bindMem cmd for the CreateImage/Buffer
-        // command and execute it
+        // been created yet. Read the CreateImage/Buffer command recorded for the bind from the trace file
+        // and execute it
         // The newly created image/buffer needs to be destroyed after getting image/buffer memory requirements to keep the
         // sequence of API calls in the trace file. The destroy will prevent from creating a buffer too early which may be used
         // unexpectedly in a later call since two buffers may have the same handle if one of them is created after another one
         // being destroyed. e.g. Without destroy, a dstBuffer may be used as srcBuffer unexpectedly in vkCmdCopyBuffer if the
         // dstBuffer's memory is allocated before the creation of the expected srcBuffer with the same buffer handle. (The
         // srcBuffer is created and destroyed before the dstBuffer being created.)
-        for (size_t i = bindMemIdx - 1; true; i--) {
-            vktrace_trace_packet_header *pCreatePacketFull = (vktrace_trace_packet_header *)portabilityTablePackets[i];
-            if ((pPacketHeader1->packet_id == VKTRACE_TPI_VK_vkBindImageMemory &&
-                 pCreatePacketFull->packet_id == VKTRACE_TPI_VK_vkCreateImage) ||
-                (pPacketHeader1->packet_id == VKTRACE_TPI_VK_vkBindBufferMemory &&
-                 pCreatePacketFull->packet_id == VKTRACE_TPI_VK_vkCreateBuffer)) {
-                packet_vkCreateImage *pCreatePacket = (packet_vkCreateImage *)(pCreatePacketFull->pBody);
-                if (*(pCreatePacket->pImage) == bindMemImage) {
-                    VkResult replayResult;
-                    // Create the image/buffer
-                    if (pCreatePacketFull->packet_id == VKTRACE_TPI_VK_vkCreateBuffer)
-                        replayResult = manually_replay_vkCreateBuffer((packet_vkCreateBuffer *)pCreatePacket);
-                    else
-                        replayResult = manually_replay_vkCreateImage((packet_vkCreateImage *)pCreatePacket);
-                    if (replayResult != VK_SUCCESS) {
-                        vktrace_LogError("vkCreateBuffer/Image failed during vkAllocateMemory()");
-                        return false;
-                    }
-                    if (pPacketHeader1->packet_id == VKTRACE_TPI_VK_vkBindImageMemory)
-                        remappedImage = m_objMapper.remap_images(bindMemImage);
-                    else
-                        remappedImage = (VkImage)m_objMapper.remap_buffers((VkBuffer)bindMemImage);
-                    doDestroyImage = true;
-                    break;
-                }
-            }
-            if (i == amIdx) {
-                // This image/buffer is not created before it is bound
-                vktrace_LogError("Bad buffer/image in call to vkBindImageMemory/vkBindBuffer");
-                return false;
-            }
-        }
+        vktrace_trace_packet_header *pCreatePacketFull =
+            (pBind->createPacketOffset != 0) ? readPacketAtOffset(pBind->createPacketOffset) : NULL;
+        if (!pCreatePacketFull) {
+            // This image/buffer is not created before it is bound
+            vktrace_LogError("Bad buffer/image in call to vkBindImageMemory/vkBindBuffer");
+            return false;
+        }
+        VkResult replayResult;
+        // Create the image/buffer
+        if (pCreatePacketFull->packet_id == VKTRACE_TPI_VK_vkCreateBuffer)
+            replayResult = manually_replay_vkCreateBuffer((packet_vkCreateBuffer *)pCreatePacketFull->pBody);
+        else
+            replayResult = manually_replay_vkCreateImage((packet_vkCreateImage *)pCreatePacketFull->pBody);
+        vktrace_delete_trace_packet_no_lock(&pCreatePacketFull);
+        if (replayResult != VK_SUCCESS) {
+            vktrace_LogError("vkCreateBuffer/Image failed during vkAllocateMemory()");
+            return false;
+        }
+        if (bImage)
+            remappedImage = m_objMapper.remap_images(bindMemImage);
+        else
+            remappedImage = (VkImage)m_objMapper.remap_buffers((VkBuffer)bindMemImage);
+        doDestroyImage = true;
     }
 
     // Call GIMR/GBMR for the replay image/buffer
-    if (pPacketHeader1->packet_id == VKTRACE_TPI_VK_vkBindImageMemory ||
-        pPacketHeader1->packet_id == VKTRACE_TPI_VK_vkBindImageMemory2KHR) {
+    if (bImage) {
         if (replayGetImageMemoryRequirements.find(remappedImage) == replayGetImageMemoryRequirements.end()) {
             m_vkDeviceFuncs.GetImageMemoryRequirements(remappedDevice, remappedImage, &memRequirements);
             replayGetImageMemoryRequirements[remappedImage] = memRequirements;
@@ -2209,7 +2256,7 @@ bool vkReplay::modifyMemoryTypeIndexInAllocateMemoryPacket(VkDevice remappedDevi
     }
 
     replayAllocationSize = memRequirements.size;
-    if (bimMemoryOffset > 0) {
+    if (pBind->memoryOffset > 0) {
         // Do alignment for allocationSize in traced vkBIM/vkBBM
         VkDeviceSize traceAllocationSize = *((VkDeviceSize *)&pPacket->pAllocateInfo->allocationSize);
         VkDeviceSize alignedAllocationSize =
@@ -2217,7 +2264,7 @@ bool vkReplay::modifyMemoryTypeIndexInAllocateMemoryPacket(VkDevice remappedDevi
 
         // Do alignment for memory offset
         replayAllocationSize +=
-            ((bimMemoryOffset + memRequirements.alignment - 1) / memRequirements.alignment) * memRequirements.alignment;
+            ((pBind->memoryOffset + memRequirements.alignment - 1) / memRequirements.alignment) * memRequirements.alignment;
         if (alignedAllocationSize != replayAllocationSize) {
             vktrace_LogWarning(
                 "alignedAllocationSize: 0x%x does not match replayAllocationSize: 0x%x, traceAllocationSize: 0x%x, "
@@ -2236,10 +2283,9 @@ bool vkReplay::modifyMemoryTypeIndexInAllocateMemoryPacket(VkDevice remappedDevi
         vktrace_LogError("vkAllocateMemory() failed, couldn't find memory type for memoryTypeIndex");
     }
 
-out:
     if (doDestroyImage) {
         // Destroy temporarily created image/buffer and clean up obj map.
-        if (pPacketHeader1->packet_id == VKTRACE_TPI_VK_vkBindImageMemory) {
+        if (bImage) {
             m_vkDeviceFuncs.DestroyImage(remappedDevice, remappedImage, NULL);
             m_objMapper.rm_from_images_map(bindMemImage);
             if (replayGetImageMemoryRequirements.find(remappedImage) != replayGetImageMemoryRequirements.end())
@@ -2276,12 +2322,19 @@ VkResult vkReplay::manually_replay_vkAllocateMemory(packet_vkAllocateMemory *pPa
     if (g_pReplaySettings->compatibilityMode && m_pFileHeader->portability_table_valid && !platformMatch())
         doAllocate = modifyMemoryTypeIndexInAllocateMemoryPacket(remappedDevice, pPacket);
 
-    if (doAllocate)
-        replayResult = m_vkDeviceFuncs.AllocateMemory(remappedDevice, pPacket->pAllocateInfo, NULL, &local_mem.replayDeviceMemory);
+    if (doAllocate) {
+        if (m_subAllocator.allocate(remappedDevice, *(pPacket->pMemory), pPacket->pAllocateInfo, &local_mem.replayDeviceMemory))
+            replayResult = VK_SUCCESS;
+        else
+            replayResult =
+                m_vkDeviceFuncs.AllocateMemory(remappedDevice, pPacket->pAllocateInfo, NULL, &local_mem.replayDeviceMemory);
+    }
 
     if (replayResult == VK_SUCCESS) {
         local_mem.pGpuMem = new (gpuMemory);
         if (local_mem.pGpuMem) local_mem.pGpuMem->setAllocInfo(pPacket->pAllocateInfo, false);
+        if (local_mem.pGpuMem && g_pReplaySettings->persistentMapping)
+            local_mem.pGpuMem->setHostCoherent(isHostCoherentMemoryType(remappedDevice, pPacket->pAllocateInfo->memoryTypeIndex));
         m_objMapper.add_to_devicememorys_map(*(pPacket->pMemory), local_mem);
         replayDeviceMemoryToDevice[local_mem.replayDeviceMemory] = remappedDevice;
     } else {
@@ -2321,7 +2374,9 @@ void vkReplay::manually_replay_vkFreeMemory(packet_vkFreeMemory *pPacket) {
     devicememoryObj local_mem;
     local_mem = m_objMapper.m_devicememorys.find(pPacket->memory)->second;
     // TODO how/when to free pendingAlloc that did not use and existing devicememoryObj
-    m_vkDeviceFuncs.FreeMemory(remappedDevice, local_mem.replayDeviceMemory, NULL);
+    if (!m_subAllocator.release(pPacket->memory)) {
+        m_vkDeviceFuncs.FreeMemory(remappedDevice, local_mem.replayDeviceMemory, NULL);
+    }
 
     if (g_pReplaySettings->compatibilityMode && m_pFileHeader->portability_table_valid && !platformMatch() &&
         traceDeviceMemoryToMemoryTypeIndex.find(pPacket->memory) != traceDeviceMemoryToMemoryTypeIndex.end()) {
@@ -2354,8 +2409,21 @@ VkResult vkReplay::manually_replay_vkMapMemory(packet_vkMapMemory *pPacket) {
     devicememoryObj local_mem = m_objMapper.m_devicememorys.find(pPacket->memory)->second;
     void *pData;
     if (!local_mem.pGpuMem->isPendingAlloc()) {
-        replayResult = m_vkDeviceFuncs.MapMemory(remappedDevice, local_mem.replayDeviceMemory, pPacket->offset, pPacket->size,
-                                                 pPacket->flags, &pData);
+        if (m_subAllocator.isSubAllocated(pPacket->memory))
+            replayResult = m_subAllocator.map(pPacket->memory, pPacket->offset, &pData);
+        else if (g_pReplaySettings->persistentMapping) {
+            // the whole allocation is mapped by its first vkMapMemory, later maps return a pointer into that mapping
+            replayResult = VK_SUCCESS;
+            if (local_mem.pGpuMem->getPersistentMapping() == NULL) {
+                void *pMapping = NULL;
+                replayResult = m_vkDeviceFuncs.MapMemory(remappedDevice, local_mem.replayDeviceMemory, 0, VK_WHOLE_SIZE,
+                                                         pPacket->flags, &pMapping);
+                if (replayResult == VK_SUCCESS) local_mem.pGpuMem->setPersistentMapping(pMapping);
+            }
+            if (replayResult == VK_SUCCESS) pData = local_mem.pGpuMem->getPersistentMapping() + pPacket->offset;
+        } else
+            replayResult = m_vkDeviceFuncs.MapMemory(remappedDevice, local_mem.replayDeviceMemory, pPacket->offset, pPacket->size,
+                                                     pPacket->flags, &pData);
         if (replayResult == VK_SUCCESS) {
             if (local_mem.pGpuMem) {
                 local_mem.pGpuMem->setMemoryMapRange(pData, pPacket->size, pPacket->offset, false);
@@ -2392,7 +2460,10 @@ void vkReplay::manually_replay_vkUnmapMemory(packet_vkUnmapMemory *pPacket) {
             if (pPacket->pData)
                 local_mem.pGpuMem->copyMappingData(pPacket->pData, true, 0, 0);  // copies data from packet into memory buffer
         }
-        m_vkDeviceFuncs.UnmapMemory(remappedDevice, local_mem.replayDeviceMemory);
+        // blocks of sub-allocated memory and persistently mapped memory stay mapped until they are freed
+        if (!m_subAllocator.isSubAllocated(pPacket->memory) && local_mem.pGpuMem->getPersistentMapping() == NULL) {
+            m_vkDeviceFuncs.UnmapMemory(remappedDevice, local_mem.replayDeviceMemory);
+        }
     } else {
         if (local_mem.pGpuMem) {
             unsigned char *pBuf = (unsigned char *)vktrace_malloc(local_mem.pGpuMem->getMemoryMapSize());
@@ -2430,6 +2501,14 @@ VkResult vkReplay::manually_replay_vkFlushMappedMemoryRanges(packet_vkFlushMappe
 
     VkMappedMemoryRange *localRanges = (VkMappedMemoryRange *)pPacket->pMemoryRanges;
 
+    // the ranges of sub-allocated memory are moved into their blocks after the data is copied at the traced offsets
+    std::vector<VkDeviceMemory> traceMemories;
+    if (m_subAllocator.isEnabled()) {
+        for (uint32_t i = 0; i < pPacket->memoryRangeCount; i++) traceMemories.push_back(pPacket->pMemoryRanges[i].memory);
+    }
+
+    // with the PersistentMap option, flushes of host coherent memory only need to copy the data
+    bool hostCoherent = g_pReplaySettings->persistentMapping;
     devicememoryObj *pLocalMems = VKTRACE_NEW_ARRAY(devicememoryObj, pPacket->memoryRangeCount);
     std::set<VkDeviceMemory> flushed_mem;
     for (uint32_t i = 0; i < pPacket->memoryRangeCount; i++) {
@@ -2448,6 +2527,7 @@ VkResult vkReplay::manually_replay_vkFlushMappedMemoryRanges(packet_vkFlushMappe
             VKTRACE_DELETE(pLocalMems);
             return VK_ERROR_VALIDATION_FAILED_EXT;
         }
+        hostCoherent = hostCoherent && pLocalMems[i].pGpuMem->isHostCoherent();
 
         if (flushed_mem.find(pPacket->pMemoryRanges[i].memory) != flushed_mem.end()) continue;
         flushed_mem.insert(pPacket->pMemoryRanges[i].memory);
@@ -2490,7 +2570,12 @@ VkResult vkReplay::manually_replay_vkFlushMappedMemoryRanges(packet_vkFlushMappe
     if (!vktrace_check_min_version(VKTRACE_TRACE_FILE_VERSION_5) || !isvkFlushMappedMemoryRangesSpecial((PBYTE)pPacket->ppData[0]))
 #endif
     {
-        replayResult = m_vkDeviceFuncs.FlushMappedMemoryRanges(remappedDevice, pPacket->memoryRangeCount, localRanges);
+        if (hostCoherent) {
+            replayResult = VK_SUCCESS;
+        } else {
+            for (size_t i = 0; i < traceMemories.size(); i++) m_subAllocator.adjustRange(traceMemories[i], &localRanges[i]);
+            replayResult = m_vkDeviceFuncs.FlushMappedMemoryRanges(remappedDevice, pPacket->memoryRangeCount, localRanges);
+        }
     }
 
     VKTRACE_DELETE(pLocalMems);
@@ -2511,6 +2596,12 @@ VkResult vkReplay::manually_replay_vkInvalidateMappedMemoryRanges(packet_vkInval
 
     VkMappedMemoryRange *localRanges = (VkMappedMemoryRange *)pPacket->pMemoryRanges;
 
+    std::vector<VkDeviceMemory> traceMemories;
+    if (m_subAllocator.isEnabled()) {
+        for (uint32_t i = 0; i < pPacket->memoryRangeCount; i++) traceMemories.push_back(pPacket->pMemoryRanges[i].memory);
+    }
+
+    bool hostCoherent = g_pReplaySettings->persistentMapping;
     devicememoryObj *pLocalMems = VKTRACE_NEW_ARRAY(devicememoryObj, pPacket->memoryRangeCount);
     for (uint32_t i = 0; i < pPacket->memoryRangeCount; i++) {
         if (m_objMapper.m_devicememorys.find(pPacket->pMemoryRanges[i].memory) != m_objMapper.m_devicememorys.end()) {
@@ -2522,6 +2613,7 @@ VkResult vkReplay::manually_replay_vkInvalidateMappedMemoryRanges(packet_vkInval
             VKTRACE_DELETE(pLocalMems);
             return VK_ERROR_VALIDATION_FAILED_EXT;
         }
+        hostCoherent = hostCoherent && pLocalMems[i].pGpuMem->isHostCoherent();
 
         if (!pLocalMems[i].pGpuMem->isPendingAlloc()) {
             if (pPacket->pMemoryRanges[i].size != 0) {
@@ -2539,13 +2631,35 @@ VkResult vkReplay::manually_replay_vkInvalidateMappedMemoryRanges(packet_vkInval
         }
     }
 
-    replayResult = m_vkDeviceFuncs.InvalidateMappedMemoryRanges(remappedDevice, pPacket->memoryRangeCount, localRanges);
+    if (hostCoherent) {
+        replayResult = VK_SUCCESS;
+    } else {
+        for (size_t i = 0; i < traceMemories.size(); i++) m_subAllocator.adjustRange(traceMemories[i], &localRanges[i]);
+        replayResult = m_vkDeviceFuncs.InvalidateMappedMemoryRanges(remappedDevice, pPacket->memoryRangeCount, localRanges);
+    }
 
     VKTRACE_DELETE(pLocalMems);
 
     return replayResult;
 }
 
+bool vkReplay::isHostCoherentMemoryType(VkDevice replayDevice, uint32_t memoryTypeIndex) {
+    auto physicalDevice = replayPhysicalDevices.find(replayDevice);
+    if (physicalDevice == replayPhysicalDevices.end()) {
+        return false;
+    }
+
+    // the trace may never have queried the memory properties of the replay device
+    auto memoryProperties = replayMemoryProperties.find(physicalDevice->second);
+    if (memoryProperties == replayMemoryProperties.end()) {
+        VkPhysicalDeviceMemoryProperties properties;
+        m_vkFuncs.GetPhysicalDeviceMemoryProperties(physicalDevice->second, &properties);
+        memoryProperties = replayMemoryProperties.insert(std::make_pair(physicalDevice->second, properties)).first;
+    }
+    return memoryTypeIndex < memoryProperties->second.memoryTypeCount &&
+           (memoryProperties->second.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+}
+
 void vkReplay::manually_replay_vkGetPhysicalDeviceProperties(packet_vkGetPhysicalDeviceProperties *pPacket) {
     VkPhysicalDevice remappedphysicalDevice = m_objMapper.remap_physicaldevices(pPacket->physicalDevice);
     if (pPacket->physicalDevice != VK_NULL_HANDLE && remappedphysicalDevice == VK_NULL_HANDLE) {
@@ -2890,9 +3004,11 @@ VkResult vkReplay::manually_replay_vkBindBufferMemory(packet_vkBindBufferMemory
         memOffsetTemp = pPacket->memoryOffset + replayGetBufferMemoryRequirements[remappedbuffer].alignment - 1;
         memOffsetTemp = memOffsetTemp / replayGetBufferMemoryRequirements[remappedbuffer].alignment;
         memOffsetTemp = memOffsetTemp * replayGetBufferMemoryRequirements[remappedbuffer].alignment;
-        replayResult = m_vkDeviceFuncs.BindBufferMemory(remappeddevice, remappedbuffer, remappedmemory, memOffsetTemp);
+        replayResult = m_vkDeviceFuncs.BindBufferMemory(remappeddevice, remappedbuffer, remappedmemory,
+                                                        memOffsetTemp + m_subAllocator.getOffset(pPacket->memory));
     } else {
-        replayResult = m_vkDeviceFuncs.BindBufferMemory(remappeddevice, remappedbuffer, remappedmemory, pPacket->memoryOffset);
+        replayResult = m_vkDeviceFuncs.BindBufferMemory(remappeddevice, remappedbuffer, remappedmemory,
+                                                        pPacket->memoryOffset + m_subAllocator.getOffset(pPacket->memory));
     }
     return replayResult;
 }
@@ -2953,10 +3069,11 @@ VkResult vkReplay::manually_replay_vkBindImageMemory(packet_vkBindImageMemory *p
             memoryOffset = pPacket->memoryOffset + replayGetImageMemoryRequirements[remappedimage].alignment - 1;
             memoryOffset = memoryOffset / replayGetImageMemoryRequirements[remappedimage].alignment;
             memoryOffset = memoryOffset * replayGetImageMemoryRequirements[remappedimage].alignment;
+            memoryOffset += m_subAllocator.getOffset(pPacket->memory);
         }
     } else {
         remappedmemory = m_objMapper.remap_devicememorys(pPacket->memory);
-        memoryOffset = pPacket->memoryOffset;
+        memoryOffset = pPacket->memoryOffset + m_subAllocator.getOffset(pPacket->memory);
     }
 
     if (pPacket->memory != VK_NULL_HANDLE && remappedmemory == VK_NULL_HANDLE) {
@@ -4299,52 +4416,42 @@ void vkReplay::remapHandlesInDescriptorSetWithTemplateData(VkDescriptorUpdateTem
         return;
     }
 
-    for (uint32_t i = 0; i < descriptorUpdateTemplateCreateInfo[remappedDescriptorUpdateTemplate]->descriptorUpdateEntryCount;
-         i++) {
-        for (uint32_t j = 0;
-             j < descriptorUpdateTemplateCreateInfo[remappedDescriptorUpdateTemplate]->pDescriptorUpdateEntries[i].descriptorCount;
-             j++) {
-            size_t offset =
-                descriptorUpdateTemplateCreateInfo[remappedDescriptorUpdateTemplate]->pDescriptorUpdateEntries[i].offset +
-                j * descriptorUpdateTemplateCreateInfo[remappedDescriptorUpdateTemplate]->pDescriptorUpdateEntries[i].stride;
-            char *update_entry = pData + offset;
-            switch (
-                descriptorUpdateTemplateCreateInfo[remappedDescriptorUpdateTemplate]->pDescriptorUpdateEntries[i].descriptorType) {
-                case VK_DESCRIPTOR_TYPE_SAMPLER: {
-                    auto image_entry = reinterpret_cast<VkDescriptorImageInfo *>(update_entry);
-                    image_entry->sampler = m_objMapper.remap_samplers(image_entry->sampler);
-                    break;
-                }
-                case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER: {
-                    auto image_entry = reinterpret_cast<VkDescriptorImageInfo *>(update_entry);
-                    image_entry->sampler = m_objMapper.remap_samplers(image_entry->sampler);
-                    image_entry->imageView = m_objMapper.remap_imageviews(image_entry->imageView);
-                    break;
-                }
-                case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
-                case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
-                case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT: {
-                    auto image_entry = reinterpret_cast<VkDescriptorImageInfo *>(update_entry);
-                    image_entry->imageView = m_objMapper.remap_imageviews(image_entry->imageView);
-                    break;
-                }
-                case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
-                case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
-                case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
-                case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC: {
-                    auto buffer_entry = reinterpret_cast<VkDescriptorBufferInfo *>(update_entry);
-                    buffer_entry->buffer = m_objMapper.remap_buffers(buffer_entry->buffer);
-                    break;
-                }
-                case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
-                case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER: {
-                    auto buffer_view_handle = reinterpret_cast<VkBufferView *>(update_entry);
-                    *buffer_view_handle = m_objMapper.remap_bufferviews(*buffer_view_handle);
-                    break;
-                }
-                default:
-                    assert(0);
-            }
+    const VkDescriptorUpdateTemplateCreateInfoKHR *pCreateInfo =
+        descriptorUpdateTemplateCreateInfo[remappedDescriptorUpdateTemplate];
+    for (uint32_t i = 0; i < pCreateInfo->descriptorUpdateEntryCount; i++) {
+        const VkDescriptorUpdateTemplateEntryKHR &entry = pCreateInfo->pDescriptorUpdateEntries[i];
+        if (entry.descriptorCount == 0) {
+            continue;
+        }
+        // the handles of each entry are remapped in place with one pass over its strided array
+        char *update_entry = pData + entry.offset;
+        auto image_entry = reinterpret_cast<VkDescriptorImageInfo *>(update_entry);
+        switch (entry.descriptorType) {
+            case VK_DESCRIPTOR_TYPE_SAMPLER:
+                m_objMapper.remap_samplers(&image_entry->sampler, entry.descriptorCount, entry.stride);
+                break;
+            case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+                m_objMapper.remap_samplers(&image_entry->sampler, entry.descriptorCount, entry.stride);
+                m_objMapper.remap_imageviews(&image_entry->imageView, entry.descriptorCount, entry.stride);
+                break;
+            case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+            case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+            case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+                m_objMapper.remap_imageviews(&image_entry->imageView, entry.descriptorCount, entry.stride);
+                break;
+            case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+            case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+            case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+            case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+                m_objMapper.remap_buffers(&reinterpret_cast<VkDescriptorBufferInfo *>(update_entry)->buffer, entry.descriptorCount,
+                                          entry.stride);
+                break;
+            case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+            case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+                m_objMapper.remap_bufferviews(reinterpret_cast<VkBufferView *>(update_entry), entry.descriptorCount, entry.stride);
+                break;
+            default:
+                assert(0);
         }
     }
 }
@@ -4375,6 +4482,7 @@ void vkReplay::manually_replay_vkUpdateDescriptorSetWithTemplate(packet_vkUpdate
 
     m_vkDeviceFuncs.UpdateDescriptorSetWithTemplate(remappeddevice, remappedDescriptorSet, remappedDescriptorUpdateTemplate,
                                                     pPacket->pData);
+    m_descriptorBatcher.forgetSet(remappedDescriptorSet);
 }
 
 void vkReplay::manually_replay_vkUpdateDescriptorSetWithTemplateKHR(packet_vkUpdateDescriptorSetWithTemplateKHR *pPacket) {
@@ -4404,6 +4512,7 @@ void vkReplay::manually_replay_vkUpdateDescriptorSetWithTemplateKHR(packet_vkUpd
 
     m_vkDeviceFuncs.UpdateDescriptorSetWithTemplateKHR(remappeddevice, remappedDescriptorSet, remappedDescriptorUpdateTemplate,
                                                        pPacket->pData);
+    m_descriptorBatcher.forgetSet(remappedDescriptorSet);
 }
 
 void vkReplay::manually_replay_vkCmdPushDescriptorSetKHR(packet_vkCmdPushDescriptorSetKHR *pPacket) {
@@ -4518,6 +4627,7 @@ void vkReplay::manually_replay_vkCmdPushDescriptorSetKHR(packet_vkCmdPushDescrip
 
     if (!errorBadRemap) {
         // If an error occurred, don't call the real function, but skip ahead so that memory is cleaned up!
+        m_stateFilter.invalidateDescriptorSets(remappedcommandBuffer, pPacket->pipelineBindPoint);
         m_vkDeviceFuncs.CmdPushDescriptorSetKHR(remappedcommandBuffer, pPacket->pipelineBindPoint, remappedlayout, pPacket->set,
                                                 pPacket->descriptorWriteCount, pRemappedWrites);
     }
@@ -4547,6 +4657,9 @@ void vkReplay::manually_replay_vkCmdPushDescriptorSetWithTemplateKHR(packet_vkCm
     // Map handles inside of pData
     remapHandlesInDescriptorSetWithTemplateData(remappedDescriptorUpdateTemplate, (char *)pPacket->pData);
 
+    // the bind point is part of the template, so the sets of both bind points are no longer known
+    m_stateFilter.invalidateDescriptorSets(remappedcommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS);
+    m_stateFilter.invalidateDescriptorSets(remappedcommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE);
     m_vkDeviceFuncs.CmdPushDescriptorSetWithTemplateKHR(remappedcommandBuffer, remappedDescriptorUpdateTemplate, remappedlayout,
                                                         pPacket->set, pPacket->pData);
 }
@@ -4632,6 +4745,7 @@ VkResult vkReplay::manually_replay_vkBindBufferMemory2KHR(packet_vkBindBufferMem
             vktrace_LogError("Error detected in BindBufferMemory2KHR() due to invalid remapped VkBuffer.");
             return VK_ERROR_VALIDATION_FAILED_EXT;
         }
+        VkDeviceSize subAllocationOffset = m_subAllocator.getOffset(pPacket->pBindInfos[i].memory);
         *((VkBuffer *)&pPacket->pBindInfos[i].buffer) = remappedBuffer;
         *((VkDeviceMemory *)&pPacket->pBindInfos[i].memory) = m_objMapper.remap_devicememorys(pPacket->pBindInfos[i].memory);
         if (g_pReplaySettings->compatibilityMode && m_pFileHeader->portability_table_valid && !platformMatch()) {
@@ -4652,6 +4766,7 @@ VkResult vkReplay::manually_replay_vkBindBufferMemory2KHR(packet_vkBindBufferMem
             memOffsetTemp = memOffsetTemp * replayGetBufferMemoryRequirements[remappedBuffer].alignment;
             *((VkDeviceSize *)&pPacket->pBindInfos[i].memoryOffset) = memOffsetTemp;
         }
+        *((VkDeviceSize *)&pPacket->pBindInfos[i].memoryOffset) += subAllocationOffset;
     }
     replayResult = m_vkDeviceFuncs.BindBufferMemory2KHR(remappeddevice, pPacket->bindInfoCount, pPacket->pBindInfos);
     return replayResult;
@@ -4673,6 +4788,7 @@ VkResult vkReplay::manually_replay_vkBindImageMemory2KHR(packet_vkBindImageMemor
             return VK_ERROR_VALIDATION_FAILED_EXT;
         }
         *((VkImage *)&pPacket->pBindInfos[i].image) = remappedImage;
+        VkDeviceSize subAllocationOffset = m_subAllocator.getOffset(pPacket->pBindInfos[i].memory);
 
         if (g_pReplaySettings->compatibilityMode && m_pFileHeader->portability_table_valid && !platformMatch()) {
             if (replayImageToTiling.find(remappedImage) == replayImageToTiling.end()) {
@@ -4723,10 +4839,11 @@ VkResult vkReplay::manually_replay_vkBindImageMemory2KHR(packet_vkBindImageMemor
                 memoryOffset = pPacket->pBindInfos[i].memoryOffset + replayGetImageMemoryRequirements[remappedImage].alignment - 1;
                 memoryOffset = memoryOffset / replayGetImageMemoryRequirements[remappedImage].alignment;
                 memoryOffset = memoryOffset * replayGetImageMemoryRequirements[remappedImage].alignment;
-                *((VkDeviceSize *)&pPacket->pBindInfos[i].memoryOffset) = memoryOffset;
+                *((VkDeviceSize *)&pPacket->pBindInfos[i].memoryOffset) = memoryOffset + subAllocationOffset;
             }
         } else {
             *((VkDeviceMemory *)&pPacket->pBindInfos[i].memory) = m_objMapper.remap_devicememorys(pPacket->pBindInfos[i].memory);
+            *((VkDeviceSize *)&pPacket->pBindInfos[i].memoryOffset) += subAllocationOffset;
         }
     }
     replayResult = m_vkDeviceFuncs.BindImageMemory2KHR(remappeddevice, pPacket->bindInfoCount, pPacket->pBindInfos);
@@ -4748,6 +4865,7 @@ VkResult vkReplay::manually_replay_vkBindBufferMemory2(packet_vkBindBufferMemory
             vktrace_LogError("Error detected in BindBufferMemory2() due to invalid remapped VkBuffer.");
             return VK_ERROR_VALIDATION_FAILED_EXT;
         }
+        VkDeviceSize subAllocationOffset = m_subAllocator.getOffset(pPacket->pBindInfos[i].memory);
         *(reinterpret_cast<VkBuffer *>(&(const_cast<VkBindBufferMemoryInfo *>(pPacket->pBindInfos)[i]).buffer)) = remappedBuffer;
         *(reinterpret_cast<VkDeviceMemory *>(&(const_cast<VkBindBufferMemoryInfo *>(pPacket->pBindInfos)[i]).memory)) =
             m_objMapper.remap_devicememorys(pPacket->pBindInfos[i].memory);
@@ -4770,6 +4888,8 @@ VkResult vkReplay::manually_replay_vkBindBufferMemory2(packet_vkBindBufferMemory
             *(reinterpret_cast<VkDeviceSize *>(&(const_cast<VkBindBufferMemoryInfo *>(pPacket->pBindInfos)[i]).memoryOffset)) =
                 memOffsetTemp;
         }
+        *(reinterpret_cast<VkDeviceSize *>(&(const_cast<VkBindBufferMemoryInfo *>(pPacket->pBindInfos)[i]).memoryOffset)) +=
+            subAllocationOffset;
     }
     replayResult = m_vkDeviceFuncs.BindBufferMemory2(remappeddevice, pPacket->bindInfoCount, pPacket->pBindInfos);
     return replayResult;
@@ -4791,6 +4911,7 @@ VkResult vkReplay::manually_replay_vkBindImageMemory2(packet_vkBindImageMemory2
             return VK_ERROR_VALIDATION_FAILED_EXT;
         }
         *(reinterpret_cast<VkImage *>(&(const_cast<VkBindImageMemoryInfo *>(pPacket->pBindInfos)[i]).image)) = remappedImage;
+        VkDeviceSize subAllocationOffset = m_subAllocator.getOffset(pPacket->pBindInfos[i].memory);
 
         if (g_pReplaySettings->compatibilityMode && m_pFileHeader->portability_table_valid && !platformMatch()) {
             if (replayImageToTiling.find(remappedImage) == replayImageToTiling.end()) {
@@ -4845,11 +4966,13 @@ VkResult vkReplay::manually_replay_vkBindImageMemory2(packet_vkBindImageMemory2
                 memoryOffset = memoryOffset / replayGetImageMemoryRequirements[remappedImage].alignment;
                 memoryOffset = memoryOffset * replayGetImageMemoryRequirements[remappedImage].alignment;
                 *(reinterpret_cast<VkDeviceSize *>(&(const_cast<VkBindImageMemoryInfo *>(pPacket->pBindInfos)[i]).memoryOffset)) =
-                    memoryOffset;
+                    memoryOffset + subAllocationOffset;
             }
         } else {
             *(reinterpret_cast<VkDeviceMemory *>(&(const_cast<VkBindImageMemoryInfo *>(pPacket->pBindInfos)[i]).memory)) =
                 m_objMapper.remap_devicememorys(pPacket->pBindInfos[i].memory);
+            *(reinterpret_cast<VkDeviceSize *>(&(const_cast<VkBindImageMemoryInfo *>(pPacket->pBindInfos)[i]).memoryOffset)) +=
+                subAllocationOffset;
         }
     }
     replayResult = m_vkDeviceFuncs.BindImageMemory2(remappeddevice, pPacket->bindInfoCount, pPacket->pBindInfos);
@@ -4967,6 +5090,7 @@ void vkReplay::interpret_pnext_handles(void *struct_ptr) {
             case VK_STRUCTURE_TYPE_BIND_ACCELERATION_STRUCTURE_MEMORY_INFO_NV: {
                 VkBindAccelerationStructureMemoryInfoNV *p = (VkBindAccelerationStructureMemoryInfoNV *)pnext;
                 p->accelerationStructure = m_objMapper.remap_accelerationstructurenvs(p->accelerationStructure);
+                p->memoryOffset += m_subAllocator.getOffset(p->memory);
                 p->memory = m_objMapper.remap_devicememorys(p->memory);
             } break;
 
@@ -39,6 +39,7 @@
 #include "vkreplay_window.h"
 #include "vkreplay_factory.h"
 #include "vktrace_trace_packet_identifiers.h"
+#include "vktrace_filelike.h"
 #include <unordered_map>
 
 extern "C" {
@@ -100,6 +101,11 @@ extern "C" {
 
 #include "vkreplay_vkdisplay.h"
 #include "vkreplay_vk_objmapper.h"
+#include "vkreplay_descriptorbatcher.h"
+#include "vkreplay_statefilter.h"
+#include "vkreplay_suballocator.h"
+#include "vkreplay_submitcoalescer.h"
+#include "vkreplay_waitrelaxer.h"
 
 #define CHECK_RETURN_VALUE(entrypoint) returnValue = handle_replay_errors(#entrypoint, replayResult, pPacket->result, returnValue);
 
@@ -124,6 +130,10 @@ class vkReplay {
     int dump_validation_data();
     int get_frame_number() { return m_frameNumber; }
     void reset_frame_number(int frameNumber) { m_frameNumber = frameNumber > 0 ? frameNumber : 0; }
+    void get_remap_stats(uint64_t* pCount, uint64_t* pTime) {
+        *pCount = m_remapStats.count;
+        *pTime = m_remapStats.time;
+    }
     void interpret_pnext_handles(void* struct_ptr);
 
    private:
@@ -132,6 +142,7 @@ class vkReplay {
     VkLayerInstanceDispatchTable m_vkFuncs;
     VkLayerDispatchTable m_vkDeviceFuncs;
     vkReplayObjMapper m_objMapper;
+    remapStats m_remapStats;
     void (*m_pDSDump)(char*);
     void (*m_pCBDump)(char*);
     // VKTRACESNAPSHOT_PRINT_OBJECTS m_pVktraceSnapshotPrint;
@@ -373,12 +384,42 @@ class vkReplay {
 
     bool modifyMemoryTypeIndexInAllocateMemoryPacket(VkDevice remappedDevice, packet_vkAllocateMemory* pPacket);
 
+    // The main loop may read traceFile on a reader thread, so packets referenced by the portability table are read
+    // through a separate handle on the trace file
+    FILE* m_pPacketLookupFile;
+    FileLike* m_pPacketLookupFileLike;
+    vktrace_trace_packet_header* readPacketAtOffset(uint64_t offset);
+
     std::unordered_map<VkImage, VkImageTiling> replayImageToTiling;
     std::unordered_map<VkImage, VkDeviceMemory> replayOptimalImageToDeviceMemory;
     std::unordered_map<VkDeviceMemory, uint32_t> traceDeviceMemoryToMemoryTypeIndex;
 
     std::unordered_set<VkDeviceMemory> traceSkippedDeviceMemories;
 
+    // Carves trace memory allocations out of larger blocks when the SubAllocate option is set
+    vkReplaySubAllocator m_subAllocator;
+
+    // Merges consecutive vkQueueSubmits to the same queue when the CoalesceSubmits option is set
+    vkReplaySubmitCoalescer m_submitCoalescer;
+    void flushCoalescedQueueSubmits();
+
+    // Drops redundant descriptor writes and merges consecutive vkUpdateDescriptorSets when the BatchDescriptorUpdates
+    // option is set
+    vkReplayDescriptorBatcher m_descriptorBatcher;
+
+    // Skips state commands that don't change the state bound to their command buffer when the RemoveRedundantState
+    // option is set
+    vkReplayStateFilter m_stateFilter;
+
+    // Defers the fence and idle waits of the trace to the next packet that depends on them when the RelaxWaits option is
+    // set
+    vkReplayWaitRelaxer m_waitRelaxer;
+    bool isWaitRelaxable(vktrace_trace_packet_header *packet) const;
+    void resolveRelaxedWaits();
+
+    // Used with the PersistentMap option to skip flushes and invalidations that the driver doesn't need
+    bool isHostCoherentMemoryType(VkDevice replayDevice, uint32_t memoryTypeIndex);
+
     bool getReplayMemoryTypeIdx(VkDevice traceDevice, VkDevice replayDevice, uint32_t traceIdx,
                                 VkMemoryRequirements* memRequirements, uint32_t* pReplayIdx);
 
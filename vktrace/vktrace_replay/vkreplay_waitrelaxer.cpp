@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2019 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vkreplay_waitrelaxer.h"
+
+#include <algorithm>
+
+bool vkReplayWaitRelaxer::deferWaitForFences(VkDevice device, uint32_t fenceCount, const VkFence* pFences, VkBool32 waitAll) {
+    // which of the fences has signaled isn't known until the wait is made
+    if (!m_enabled || (fenceCount > 1 && !waitAll)) {
+        return false;
+    }
+
+    m_deferredWaitCount++;
+    if (m_idleDevices.find(device) != m_idleDevices.end()) {
+        m_droppedWaitCount++;
+        return true;
+    }
+
+    FenceWaits& waits = m_fences[device];
+    bool covered = true;
+    for (uint32_t i = 0; i < fenceCount; i++) {
+        if (std::find(waits.fences.begin(), waits.fences.end(), pFences[i]) == waits.fences.end()) {
+            waits.fences.push_back(pFences[i]);
+            covered = false;
+        }
+    }
+    if (covered) {
+        m_droppedWaitCount++;
+    } else {
+        waits.waitCount++;
+    }
+    return true;
+}
+
+bool vkReplayWaitRelaxer::deferQueueWaitIdle(VkQueue queue) {
+    if (!m_enabled) {
+        return false;
+    }
+
+    m_deferredWaitCount++;
+    if (!m_idleQueues.insert(queue).second) {
+        m_droppedWaitCount++;
+    }
+    return true;
+}
+
+bool vkReplayWaitRelaxer::deferDeviceWaitIdle(VkDevice device) {
+    if (!m_enabled) {
+        return false;
+    }
+
+    m_deferredWaitCount++;
+    if (!m_idleDevices.insert(device).second) {
+        m_droppedWaitCount++;
+    }
+    // the idle wait covers the fence waits already deferred for the device
+    auto waits = m_fences.find(device);
+    if (waits != m_fences.end()) {
+        m_droppedWaitCount += waits->second.waitCount;
+        m_fences.erase(waits);
+    }
+    return true;
+}
+
+VkResult vkReplayWaitRelaxer::resolve(PFN_vkWaitForFences pfnWaitForFences, PFN_vkQueueWaitIdle pfnQueueWaitIdle,
+                                      PFN_vkDeviceWaitIdle pfnDeviceWaitIdle) {
+    VkResult result = VK_SUCCESS;
+    for (VkDevice device : m_idleDevices) {
+        VkResult waitResult = pfnDeviceWaitIdle(device);
+        if (result == VK_SUCCESS) {
+            result = waitResult;
+        }
+    }
+    for (VkQueue queue : m_idleQueues) {
+        VkResult waitResult = pfnQueueWaitIdle(queue);
+        if (result == VK_SUCCESS) {
+            result = waitResult;
+        }
+    }
+    for (auto& waits : m_fences) {
+        VkResult waitResult = pfnWaitForFences(waits.first, (uint32_t)waits.second.fences.size(), waits.second.fences.data(),
+                                               VK_TRUE, UINT64_MAX);
+        if (result == VK_SUCCESS) {
+            result = waitResult;
+        }
+    }
+
+    m_idleDevices.clear();
+    m_idleQueues.clear();
+    m_fences.clear();
+    return result;
+}
+
+bool vkReplayWaitRelaxer::waitsOnlyForQueue(VkQueue queue) const {
+    if (!m_idleDevices.empty()) {
+        return false;
+    }
+    for (VkQueue idleQueue : m_idleQueues) {
+        if (idleQueue != queue) {
+            return false;
+        }
+    }
+    for (auto& waits : m_fences) {
+        for (VkFence fence : waits.second.fences) {
+            auto fenceQueue = m_fenceQueues.find(fence);
+            if (fenceQueue == m_fenceQueues.end() || fenceQueue->second != queue) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool vkReplayWaitRelaxer::waitsForQueue(VkQueue queue) const {
+    if (!m_idleDevices.empty() || m_idleQueues.find(queue) != m_idleQueues.end()) {
+        return true;
+    }
+    for (auto& waits : m_fences) {
+        for (VkFence fence : waits.second.fences) {
+            auto fenceQueue = m_fenceQueues.find(fence);
+            if (fenceQueue != m_fenceQueues.end() && fenceQueue->second == queue) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool vkReplayWaitRelaxer::addSubmits(VkQueue queue, uint32_t submitCount, const VkSubmitInfo* pSubmits, VkFence fence) {
+    if (!m_enabled) {
+        return false;
+    }
+
+    bool pending = isPending() && !waitsOnlyForQueue(queue);
+    if (fence != VK_NULL_HANDLE) {
+        m_fenceQueues[fence] = queue;
+    }
+    for (uint32_t i = 0; i < submitCount; i++) {
+        for (uint32_t j = 0; j < pSubmits[i].commandBufferCount; j++) {
+            VkCommandBuffer commandBuffer = pSubmits[i].pCommandBuffers[j];
+            if (!m_pendingCommandBuffers.insert(commandBuffer).second) {
+                pending = true;
+            }
+            auto executed = m_executedCommandBuffers.find(commandBuffer);
+            if (executed == m_executedCommandBuffers.end()) {
+                continue;
+            }
+            for (VkCommandBuffer secondary : executed->second) {
+                if (!m_pendingCommandBuffers.insert(secondary).second) {
+                    pending = true;
+                }
+            }
+        }
+    }
+    return pending;
+}
+
+bool vkReplayWaitRelaxer::isResetBlocked(uint32_t fenceCount, const VkFence* pFences) const {
+    if (!isPending()) {
+        return false;
+    }
+    if (!m_idleDevices.empty()) {
+        return true;
+    }
+    for (uint32_t i = 0; i < fenceCount; i++) {
+        for (auto& waits : m_fences) {
+            if (std::find(waits.second.fences.begin(), waits.second.fences.end(), pFences[i]) != waits.second.fences.end()) {
+                return true;
+            }
+        }
+        // the work of the fence's queue could be what a deferred wait is waiting for
+        auto fenceQueue = m_fenceQueues.find(pFences[i]);
+        if (fenceQueue != m_fenceQueues.end() && waitsForQueue(fenceQueue->second)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void vkReplayWaitRelaxer::addExecutedCommandBuffers(VkCommandBuffer commandBuffer, uint32_t commandBufferCount,
+                                                    const VkCommandBuffer* pCommandBuffers) {
+    if (!m_enabled) {
+        return;
+    }
+
+    std::vector<VkCommandBuffer>& executed = m_executedCommandBuffers[commandBuffer];
+    for (uint32_t i = 0; i < commandBufferCount; i++) {
+        if (std::find(executed.begin(), executed.end(), pCommandBuffers[i]) == executed.end()) {
+            executed.push_back(pCommandBuffers[i]);
+        }
+    }
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2019 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//  Replay wait relaxer
+//
+//     Applications wait for fences and idle queues and devices wherever they need the results of the GPU, and replaying
+//     these waits as they come stalls the replay at the same points. When waits are relaxed, vkreplay doesn't make the
+//     vkWaitForFences, vkQueueWaitIdle and vkDeviceWaitIdle of the trace when they are replayed, but remembers them and
+//     makes them as late as possible: before the first following packet that could depend on the work they wait for.
+//
+//     Waits are only deferred past packets that don't rely on the work being waited for: command recording into command
+//     buffers that aren't pending, presents, image acquisitions, the creation and allocation of new objects, and
+//     - submits of command buffers that aren't pending, to the one queue whose work is waited for. A submit to another
+//       queue, or while a device idle wait is deferred, would lose the host-side ordering between the queues.
+//     - resets of fences that aren't waited for, and weren't submitted to a queue whose work is waited for. A reset of a
+//       fence that is waited for ends the deferral window, since the fence must no longer be in use when it is reset.
+//     Any other packet, such as a host access to memory, a query or fence status read, or the destruction of an object,
+//     makes the deferred waits first. A command buffer is pending from the time it is submitted until it is begun again
+//     or freed, and so are the secondary command buffers it executes.
+//
+//     A deferred wait that is covered by another deferred wait, such as a second idle wait of the same queue or a fence
+//     wait of a device that is idle waited, is dropped. vkWaitForFences that waits for any of several fences, or that
+//     didn't succeed in the trace, is never deferred.
+
+#pragma once
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+class vkReplayWaitRelaxer {
+   public:
+    vkReplayWaitRelaxer() : m_enabled(false), m_deferredWaitCount(0), m_droppedWaitCount(0) {}
+    ~vkReplayWaitRelaxer() {}
+
+    void setEnabled(bool enabled) { m_enabled = enabled; }
+    bool isEnabled() const { return m_enabled; }
+
+    // Each defer function takes the remapped parameters of its wait, and returns true if the wait has been deferred
+    // instead of being made.
+    bool deferWaitForFences(VkDevice device, uint32_t fenceCount, const VkFence* pFences, VkBool32 waitAll);
+    bool deferQueueWaitIdle(VkQueue queue);
+    bool deferDeviceWaitIdle(VkDevice device);
+
+    bool isPending() const { return !m_idleDevices.empty() || !m_idleQueues.empty() || !m_fences.empty(); }
+
+    // Makes the deferred waits, returning the first error.
+    VkResult resolve(PFN_vkWaitForFences pfnWaitForFences, PFN_vkQueueWaitIdle pfnQueueWaitIdle,
+                     PFN_vkDeviceWaitIdle pfnDeviceWaitIdle);
+
+    // Returns true if the deferred waits have to be made before the remapped submits: the waits are for work of other
+    // queues than queue, or one of the command buffers of pSubmits, or one of the secondary command buffers they execute,
+    // is pending. Marks all of them as pending, and remembers that fence is signaled by queue.
+    bool addSubmits(VkQueue queue, uint32_t submitCount, const VkSubmitInfo* pSubmits, VkFence fence);
+
+    // Returns true if the deferred waits have to be made before the remapped fences are reset, because one of them is
+    // waited for, or could be in use by work that is waited for.
+    bool isResetBlocked(uint32_t fenceCount, const VkFence* pFences) const;
+
+    // Remembers the remapped secondary command buffers that vkCmdExecuteCommands records into commandBuffer.
+    void addExecutedCommandBuffers(VkCommandBuffer commandBuffer, uint32_t commandBufferCount,
+                                   const VkCommandBuffer* pCommandBuffers);
+
+    bool isCommandBufferPending(VkCommandBuffer commandBuffer) const {
+        return m_pendingCommandBuffers.find(commandBuffer) != m_pendingCommandBuffers.end();
+    }
+
+    // Marks commandBuffer as no longer pending and forgets the command buffers it executes, as it has been begun or freed.
+    void forgetCommandBuffer(VkCommandBuffer commandBuffer) {
+        m_pendingCommandBuffers.erase(commandBuffer);
+        m_executedCommandBuffers.erase(commandBuffer);
+    }
+
+    uint64_t getDeferredWaitCount() const { return m_deferredWaitCount; }
+    uint64_t getDroppedWaitCount() const { return m_droppedWaitCount; }
+
+   private:
+    // The fences waited for on a device, and the number of deferred waits that still need them.
+    struct FenceWaits {
+        std::vector<VkFence> fences;
+        uint64_t waitCount;
+
+        FenceWaits() : waitCount(0) {}
+    };
+
+    bool m_enabled;
+
+    std::unordered_set<VkDevice> m_idleDevices;
+    std::unordered_set<VkQueue> m_idleQueues;
+    std::unordered_map<VkDevice, FenceWaits> m_fences;
+    std::unordered_set<VkCommandBuffer> m_pendingCommandBuffers;
+
+    // Queue that each fence was last submitted with.
+    std::unordered_map<VkFence, VkQueue> m_fenceQueues;
+
+    // Returns true if all the deferred waits are for work of queue.
+    bool waitsOnlyForQueue(VkQueue queue) const;
+    // Returns true if one of the deferred waits is for work of queue.
+    bool waitsForQueue(VkQueue queue) const;
+
+    // Secondary command buffers executed by each primary command buffer since it was last begun.
+    std::unordered_map<VkCommandBuffer, std::vector<VkCommandBuffer> > m_executedCommandBuffers;
+
+    // Waits of the trace that weren't made when they were replayed, and those of them that were never made because
+    // another wait covered them.
+    uint64_t m_deferredWaitCount;
+    uint64_t m_droppedWaitCount;
+};
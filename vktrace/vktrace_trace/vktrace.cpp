@@ -22,6 +22,7 @@
 #include "vktrace.h"
 
 #include "vktrace_process.h"
+#include "vktrace_capture_stats.h"
 
 extern "C" {
 #include "vktrace_common.h"
@@ -148,6 +149,14 @@ vktrace_SettingInfo g_settings_info[] = {
      TRUE,
      "Enable locking of API calls during trace if TraceLock is set to TRUE,\n\
                                        default is FALSE in which it is enabled only when trimming is enabled."},
+    {"cs",
+     "CaptureStats",
+     VKTRACE_SETTING_STRING,
+     {&g_settings.captureStatsFile},
+     {&g_default_settings.captureStatsFile},
+     TRUE,
+     "Rewrite live capture statistics (packet and byte rates, socket backlog,\n\
+                                       time spent writing the trace file) as JSON to <string> once a second."},
 };
 
 vktrace_SettingGroup g_settingGroup = {"vktrace", sizeof(g_settings_info) / sizeof(g_settings_info[0]), &g_settings_info[0]};
@@ -479,6 +488,10 @@ int main(int argc, char* argv[]) {
         vktrace_set_global_var(VKTRACE_TRIM_MAX_COMMAND_BATCH_SIZE_ENV, "");
     }
 
+    if (g_settings.captureStatsFile != NULL && strlen(g_settings.captureStatsFile) > 0) {
+        vktrace_capture_stats_start(g_settings.captureStatsFile);
+    }
+
     unsigned int serverIndex = 0;
     do {
         // Create and start the process or run in server mode
@@ -575,6 +588,7 @@ int main(int argc, char* argv[]) {
         serverIndex++;
     } while (g_settings.program == NULL);
 
+    vktrace_capture_stats_stop();
     vktrace_SettingGroup_delete(&g_settingGroup);
     vktrace_free(g_default_settings.output_trace);
 
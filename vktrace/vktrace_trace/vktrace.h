@@ -47,6 +47,7 @@ typedef struct vktrace_settings {
     BOOL enable_trim_post_processing;
     BOOL enable_trace_lock;
     const char* trimCmdBatchSizeStr;
+    const char* captureStatsFile;
 } vktrace_settings;
 
 extern vktrace_settings g_settings;
@@ -0,0 +1,260 @@
+/*
+ * Copyright (C) 2019 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vktrace_capture_stats.h"
+
+#include <inttypes.h>
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if defined(PLATFORM_LINUX) || defined(PLATFORM_OSX)
+#include <sys/ioctl.h>
+#endif
+
+extern "C" {
+#include "vktrace_trace_packet_utils.h"
+#include "vktrace_vk_packet_id.h"
+}
+
+namespace {
+
+const uint64_t kStatsInterval = 1000000000;  // nanoseconds between two updates of the stats file
+const size_t kTopPacketCount = 5;
+
+struct PacketTypeStats {
+    uint64_t count;
+    uint64_t bytes;
+};
+
+// Running totals since the start of the capture; rates are computed from the difference between two snapshots.
+struct CaptureTotals {
+    uint64_t packets;
+    uint64_t bytes;
+    uint64_t frames;
+    uint64_t memoryFlushes;
+    uint64_t memoryFlushBytes;
+    uint64_t readTime;
+    uint64_t lockTime;
+    uint64_t writeTime;
+    uint64_t writeErrors;
+};
+
+std::mutex g_statsMutex;
+std::condition_variable g_statsCondition;
+// not a plain std::thread, so that vktrace exiting on an error doesn't terminate on a thread that is still joinable
+std::thread* g_pStatsThread = NULL;
+bool g_bStatsRunning = false;
+std::string g_statsFilename;
+MessageStream* g_pMessageStream = NULL;
+
+CaptureTotals g_totals;
+std::unordered_map<uint16_t, PacketTypeStats> g_intervalPacketTypes;
+
+// Bytes the traced process has sent that are still waiting in the socket, which is how far the recording thread is behind.
+uint64_t get_socket_backlog(MessageStream* pMessageStream) {
+    if (pMessageStream == NULL || pMessageStream->mSocket == INVALID_SOCKET) {
+        return 0;
+    }
+#if defined(WIN32)
+    u_long pendingBytes = 0;
+    if (ioctlsocket(pMessageStream->mSocket, FIONREAD, &pendingBytes) != 0) {
+        return 0;
+    }
+#else
+    int pendingBytes = 0;
+    if (ioctl(pMessageStream->mSocket, FIONREAD, &pendingBytes) != 0) {
+        return 0;
+    }
+#endif
+    return (uint64_t)pendingBytes;
+}
+
+const char* get_packet_name(uint16_t packetId) {
+    switch (packetId) {
+        case VKTRACE_TPI_MESSAGE:
+            return "message";
+        case VKTRACE_TPI_MARKER_CHECKPOINT:
+            return "checkpoint";
+        case VKTRACE_TPI_MARKER_API_BOUNDARY:
+            return "api_boundary";
+        case VKTRACE_TPI_MARKER_API_GROUP_BEGIN:
+            return "api_group_begin";
+        case VKTRACE_TPI_MARKER_API_GROUP_END:
+            return "api_group_end";
+        case VKTRACE_TPI_MARKER_TERMINATE_PROCESS:
+            return "terminate_process";
+        default:
+            break;
+    }
+    if (packetId < VKTRACE_TPI_VK_vkApiVersion) {
+        return "unknown";
+    }
+    return vktrace_vk_packet_id_name((VKTRACE_TRACE_PACKET_ID_VK)packetId);
+}
+
+double to_rate(uint64_t value, uint64_t interval) { return (interval > 0) ? (double)value * kStatsInterval / interval : 0.0; }
+
+double to_fraction(uint64_t time, uint64_t interval) { return (interval > 0) ? (double)time / interval : 0.0; }
+
+void write_stats_file(const CaptureTotals& totals, const CaptureTotals& previousTotals, uint64_t interval,
+                      const std::unordered_map<uint16_t, PacketTypeStats>& packetTypes, uint64_t socketBacklog,
+                      bool bFinished) {
+    std::vector<std::pair<uint16_t, PacketTypeStats> > topPacketTypes(packetTypes.begin(), packetTypes.end());
+    size_t topCount = std::min(kTopPacketCount, topPacketTypes.size());
+    std::partial_sort(topPacketTypes.begin(), topPacketTypes.begin() + topCount, topPacketTypes.end(),
+                      [](const std::pair<uint16_t, PacketTypeStats>& a, const std::pair<uint16_t, PacketTypeStats>& b) {
+                          return a.second.bytes > b.second.bytes;
+                      });
+
+    // write next to the stats file and rename, so that readers never see a partially written file
+    std::string tempFilename = g_statsFilename + ".tmp";
+    FILE* pFile = fopen(tempFilename.c_str(), "w");
+    if (pFile == NULL) {
+        vktrace_LogWarning("Unable to write capture statistics to %s.", tempFilename.c_str());
+        return;
+    }
+
+    const double kMegabyte = 1024.0 * 1024.0;
+    fprintf(pFile, "{\n");
+    fprintf(pFile, "    \"finished\": %s,\n", bFinished ? "true" : "false");
+    fprintf(pFile, "    \"packets\": %" PRIu64 ",\n", totals.packets);
+    fprintf(pFile, "    \"bytes\": %" PRIu64 ",\n", totals.bytes);
+    fprintf(pFile, "    \"frame\": %" PRIu64 ",\n", totals.frames);
+    fprintf(pFile, "    \"packets_per_sec\": %.1f,\n", to_rate(totals.packets - previousTotals.packets, interval));
+    fprintf(pFile, "    \"mb_per_sec\": %.3f,\n", to_rate(totals.bytes - previousTotals.bytes, interval) / kMegabyte);
+    fprintf(pFile, "    \"frames_per_sec\": %.1f,\n", to_rate(totals.frames - previousTotals.frames, interval));
+    fprintf(pFile, "    \"socket_backlog_bytes\": %" PRIu64 ",\n", socketBacklog);
+    fprintf(pFile, "    \"memory_flushes_per_sec\": %.1f,\n",
+            to_rate(totals.memoryFlushes - previousTotals.memoryFlushes, interval));
+    fprintf(pFile, "    \"memory_flush_mb_per_sec\": %.3f,\n",
+            to_rate(totals.memoryFlushBytes - previousTotals.memoryFlushBytes, interval) / kMegabyte);
+    // fractions of the interval the recording thread spent in each step, the remainder is bookkeeping
+    fprintf(pFile, "    \"socket_read_busy\": %.3f,\n", to_fraction(totals.readTime - previousTotals.readTime, interval));
+    fprintf(pFile, "    \"file_lock_busy\": %.3f,\n", to_fraction(totals.lockTime - previousTotals.lockTime, interval));
+    fprintf(pFile, "    \"file_write_busy\": %.3f,\n", to_fraction(totals.writeTime - previousTotals.writeTime, interval));
+    fprintf(pFile, "    \"write_errors\": %" PRIu64 ",\n", totals.writeErrors);
+    fprintf(pFile, "    \"top_packets\": [");
+    for (size_t i = 0; i < topCount; i++) {
+        fprintf(pFile, "%s\n        {\"name\": \"%s\", \"count\": %" PRIu64 ", \"bytes\": %" PRIu64 "}", (i > 0) ? "," : "",
+                get_packet_name(topPacketTypes[i].first), topPacketTypes[i].second.count, topPacketTypes[i].second.bytes);
+    }
+    fprintf(pFile, "%s]\n", (topCount > 0) ? "\n    " : "");
+    fprintf(pFile, "}\n");
+    fclose(pFile);
+
+#if defined(WIN32)
+    if (!MoveFileExA(tempFilename.c_str(), g_statsFilename.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+#else
+    if (rename(tempFilename.c_str(), g_statsFilename.c_str()) != 0) {
+#endif
+        vktrace_LogWarning("Unable to replace capture statistics file %s.", g_statsFilename.c_str());
+    }
+}
+
+void run_stats_thread() {
+    CaptureTotals previousTotals;
+    memset(&previousTotals, 0, sizeof(previousTotals));
+    uint64_t previousTime = vktrace_get_time();
+
+    std::unique_lock<std::mutex> lock(g_statsMutex);
+    bool bFinished = false;
+    while (!bFinished) {
+        g_statsCondition.wait_for(lock, std::chrono::nanoseconds(kStatsInterval), [] { return !g_bStatsRunning; });
+        bFinished = !g_bStatsRunning;
+
+        CaptureTotals totals = g_totals;
+        std::unordered_map<uint16_t, PacketTypeStats> packetTypes;
+        packetTypes.swap(g_intervalPacketTypes);
+        uint64_t socketBacklog = get_socket_backlog(g_pMessageStream);
+        uint64_t time = vktrace_get_time();
+
+        // the file is written without holding the lock so that the recording thread never waits on the disk for it
+        lock.unlock();
+        write_stats_file(totals, previousTotals, time - previousTime, packetTypes, socketBacklog, bFinished);
+        lock.lock();
+
+        previousTotals = totals;
+        previousTime = time;
+    }
+}
+
+}  // namespace
+
+void vktrace_capture_stats_start(const char* pStatsFilename) {
+    std::lock_guard<std::mutex> lock(g_statsMutex);
+    if (g_bStatsRunning) {
+        return;
+    }
+
+    g_statsFilename = pStatsFilename;
+    memset(&g_totals, 0, sizeof(g_totals));
+    g_intervalPacketTypes.clear();
+    g_bStatsRunning = true;
+    g_pStatsThread = new std::thread(run_stats_thread);
+}
+
+void vktrace_capture_stats_stop() {
+    {
+        std::lock_guard<std::mutex> lock(g_statsMutex);
+        if (!g_bStatsRunning) {
+            return;
+        }
+        g_bStatsRunning = false;
+    }
+    g_statsCondition.notify_one();
+    g_pStatsThread->join();
+    delete g_pStatsThread;
+    g_pStatsThread = NULL;
+}
+
+void vktrace_capture_stats_set_message_stream(MessageStream* pMessageStream) {
+    std::lock_guard<std::mutex> lock(g_statsMutex);
+    g_pMessageStream = pMessageStream;
+}
+
+void vktrace_capture_stats_record_packet(const vktrace_trace_packet_header* pHeader, uint64_t readTime, uint64_t lockTime,
+                                         uint64_t writeTime, bool bWriteFailed) {
+    std::lock_guard<std::mutex> lock(g_statsMutex);
+    if (!g_bStatsRunning) {
+        return;
+    }
+
+    g_totals.packets++;
+    g_totals.bytes += pHeader->size;
+    g_totals.readTime += readTime;
+    g_totals.lockTime += lockTime;
+    g_totals.writeTime += writeTime;
+    if (bWriteFailed) {
+        g_totals.writeErrors++;
+    }
+    if (pHeader->packet_id == VKTRACE_TPI_VK_vkQueuePresentKHR) {
+        g_totals.frames++;
+    } else if (pHeader->packet_id == VKTRACE_TPI_VK_vkFlushMappedMemoryRanges) {
+        // the flushes of the application, and with PMB enabled those the layer makes of the pages changed behind mapped
+        // pointers, which the packets don't tell apart
+        g_totals.memoryFlushes++;
+        g_totals.memoryFlushBytes += pHeader->size;
+    }
+
+    PacketTypeStats& packetType = g_intervalPacketTypes[pHeader->packet_id];
+    packetType.count++;
+    packetType.bytes += pHeader->size;
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2019 LunarG, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//  Live capture statistics
+//
+//     While capturing, vktrace can rewrite a small JSON file once a second with the state of the capture: packet and
+//     byte rates, the current frame, how many bytes are waiting in the socket from the traced process, the packet
+//     types that used the most bandwidth over the last second, PMB (persistently mapped buffer) flush rates, and how
+//     much of the last second the recording thread spent reading the socket, waiting for the trace file lock and
+//     writing the trace file. The file is replaced atomically, so a script or viewer can poll it at any time.
+
+#pragma once
+
+extern "C" {
+#include "vktrace_common.h"
+#include "vktrace_interconnect.h"
+#include "vktrace_trace_packet_identifiers.h"
+}
+
+// Starts the thread that writes the statistics to pStatsFilename once a second.
+void vktrace_capture_stats_start(const char* pStatsFilename);
+
+// Writes the final statistics and stops the thread.
+void vktrace_capture_stats_stop();
+
+// The socket of this stream is polled for the number of bytes the traced process has sent but vktrace hasn't read yet.
+// Must be reset to NULL before the stream is destroyed.
+void vktrace_capture_stats_set_message_stream(MessageStream* pMessageStream);
+
+// Records one packet received from the traced process and the time in nanoseconds that the recording thread spent
+// reading it from the socket, waiting for the trace file lock and writing it.
+void vktrace_capture_stats_record_packet(const vktrace_trace_packet_header* pHeader, uint64_t readTime, uint64_t lockTime,
+                                         uint64_t writeTime, bool bWriteFailed);
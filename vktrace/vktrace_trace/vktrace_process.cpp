@@ -19,9 +19,11 @@
  * Author: Peter Lohrmann <peterl@valvesoftware.com>
  */
 
+#include <inttypes.h>
 #include <string>
 #include "vktrace_process.h"
 #include "vktrace.h"
+#include "vktrace_capture_stats.h"
 
 #if defined(PLATFORM_LINUX)
 #include <sys/prctl.h>
@@ -161,6 +163,77 @@ VKTRACE_THREAD_ROUTINE_RETURN_TYPE Process_RunWatchdogThread(LPVOID _procInfoPtr
 bool terminationSignalArrived = false;
 void terminationSignalHandler(int sig) { terminationSignalArrived = true; }
 
+// ------------------------------------------------------------------------------------------------
+// Writes a packet made of pHeader and pBody to the trace file, and adds it to the portability table if the table tracks it.
+// Returns false if it couldn't be written.
+static bool write_trace_packet(FILE* pTraceFile, const vktrace_trace_packet_header* pHeader, const void* pBody,
+                               uint64_t& fileOffset) {
+    uint64_t bodySize = pHeader->size - sizeof(vktrace_trace_packet_header);
+    uint64_t bytes_written = fwrite(pHeader, 1, sizeof(vktrace_trace_packet_header), pTraceFile);
+    bytes_written += fwrite(pBody, 1, (size_t)bodySize, pTraceFile);
+    if (bytes_written != pHeader->size) {
+        vktrace_LogError("Failed to write the packet for packet_id = %hu", pHeader->packet_id);
+    }
+
+    // If the packet is one we need to track, add it to the table
+    if (pHeader->packet_id == VKTRACE_TPI_VK_vkBindImageMemory || pHeader->packet_id == VKTRACE_TPI_VK_vkBindBufferMemory ||
+        pHeader->packet_id == VKTRACE_TPI_VK_vkBindImageMemory2KHR || pHeader->packet_id == VKTRACE_TPI_VK_vkBindBufferMemory2KHR ||
+        pHeader->packet_id == VKTRACE_TPI_VK_vkAllocateMemory || pHeader->packet_id == VKTRACE_TPI_VK_vkDestroyImage ||
+        pHeader->packet_id == VKTRACE_TPI_VK_vkDestroyBuffer || pHeader->packet_id == VKTRACE_TPI_VK_vkFreeMemory ||
+        pHeader->packet_id == VKTRACE_TPI_VK_vkCreateBuffer || pHeader->packet_id == VKTRACE_TPI_VK_vkCreateImage) {
+        vktrace_LogDebug("Add packet to portability table: %s",
+                         vktrace_vk_packet_id_name((VKTRACE_TRACE_PACKET_ID_VK)pHeader->packet_id));
+        portabilityTable.push_back(fileOffset);
+    }
+    lastPacketIndex = pHeader->global_packet_index;
+    lastPacketThreadId = pHeader->thread_id;
+    lastPacketEndTime = pHeader->vktrace_end_time;
+    fileOffset += bytes_written;
+    return bytes_written == pHeader->size;
+}
+
+// Writes the packets of the calls of a command batch in place of the batch, so that the trace file holds the same packets
+// as it would without batching. The header of each packet is rebuilt from the record of its call, as vkreplay does.
+static bool write_command_batch(FILE* pTraceFile, const vktrace_trace_packet_header* pHeader, uint64_t& fileOffset) {
+    uint64_t bodySize = pHeader->size - sizeof(vktrace_trace_packet_header);
+    if (pHeader->size < sizeof(vktrace_trace_packet_header) + sizeof(vktrace_trace_packet_command_batch)) {
+        vktrace_LogError("Command batch with global_packet_index %" PRIu64 " is truncated.", pHeader->global_packet_index);
+        return false;
+    }
+
+    const vktrace_trace_packet_command_batch* pBatch = (const vktrace_trace_packet_command_batch*)pHeader->pBody;
+    vktrace_trace_packet_header callHeader = *pHeader;
+    callHeader.global_packet_index = pBatch->packet_index;
+    callHeader.entrypoint_end_time = pBatch->begin_time;
+    uint64_t offset = sizeof(vktrace_trace_packet_command_batch);
+    for (uint32_t i = 0; i < pBatch->call_count; i++) {
+        const vktrace_trace_packet_command_batch_call* pCall =
+            (const vktrace_trace_packet_command_batch_call*)((char*)pHeader->pBody + offset);
+        if (offset + sizeof(vktrace_trace_packet_command_batch_call) > bodySize || pCall->size < sizeof(*pCall) ||
+            (pCall->size & 0x7) != 0 || offset + pCall->size > bodySize) {
+            vktrace_LogError("Call %u of command batch with global_packet_index %" PRIu64 " is truncated.", i,
+                             pHeader->global_packet_index);
+            return false;
+        }
+
+        callHeader.size = sizeof(vktrace_trace_packet_header) + pCall->size - sizeof(*pCall);
+        callHeader.global_packet_index += pCall->packet_index_delta;
+        callHeader.packet_id = pCall->packet_id;
+        callHeader.thread_id = pCall->thread_id;
+        callHeader.entrypoint_begin_time = callHeader.entrypoint_end_time + pCall->begin_time_delta;
+        callHeader.entrypoint_end_time = callHeader.entrypoint_begin_time + pCall->call_time;
+        callHeader.vktrace_begin_time = callHeader.entrypoint_begin_time;
+        callHeader.vktrace_end_time = callHeader.entrypoint_end_time;
+        callHeader.next_buffers_offset = callHeader.size;
+        offset += pCall->size;
+
+        if (!write_trace_packet(pTraceFile, &callHeader, pCall + 1, fileOffset)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 // ------------------------------------------------------------------------------------------------
 VKTRACE_THREAD_ROUTINE_RETURN_TYPE Process_RunRecordTraceThread(LPVOID _threadInfo) {
     vktrace_process_capture_trace_thread_info* pInfo = (vktrace_process_capture_trace_thread_info*)_threadInfo;
@@ -195,6 +268,7 @@ VKTRACE_THREAD_ROUTINE_RETURN_TYPE Process_RunRecordTraceThread(LPVOID _threadIn
 
     // Open the socket
     fileLikeSocket = vktrace_FileLike_create_msg(pMessageStream);
+    vktrace_capture_stats_set_message_stream(pMessageStream);
 
     // Read the size of the header packet from the socket
     fileHeaderSize = 0;
@@ -247,7 +321,12 @@ VKTRACE_THREAD_ROUTINE_RETURN_TYPE Process_RunRecordTraceThread(LPVOID _threadIn
         // vktrace_LogDebug("Waiting for a packet...");
 
         // read entire packet in
+        uint64_t readBeginTime = vktrace_get_time();
         pHeader = vktrace_read_trace_packet(fileLikeSocket);
+        uint64_t readTime = vktrace_get_time() - readBeginTime;
+        uint64_t lockTime = 0;
+        uint64_t writeTime = 0;
+        bool writeFailed = false;
 
         if (pHeader == NULL) {
             if (pMessageStream->mErrorNum == WSAECONNRESET) {
@@ -281,31 +360,21 @@ VKTRACE_THREAD_ROUTINE_RETURN_TYPE Process_RunRecordTraceThread(LPVOID _threadIn
             }
 
             if (pInfo->pProcessInfo->pTraceFile != NULL) {
+                uint64_t lockBeginTime = vktrace_get_time();
                 vktrace_enter_critical_section(&pInfo->pProcessInfo->traceFileCriticalSection);
-                bytes_written = fwrite(pHeader, 1, (size_t)pHeader->size, pInfo->pProcessInfo->pTraceFile);
+                uint64_t writeBeginTime = vktrace_get_time();
+                if (pHeader->packet_id == VKTRACE_TPI_VK_CommandBatch) {
+                    writeFailed = !write_command_batch(pInfo->pProcessInfo->pTraceFile, pHeader, fileOffset);
+                } else {
+                    writeFailed = !write_trace_packet(pInfo->pProcessInfo->pTraceFile, pHeader, (const void*)pHeader->pBody,
+                                                      fileOffset);
+                }
                 fflush(pInfo->pProcessInfo->pTraceFile);
                 vktrace_leave_critical_section(&pInfo->pProcessInfo->traceFileCriticalSection);
-                if (bytes_written != pHeader->size) {
-                    vktrace_LogError("Failed to write the packet for packet_id = %hu", pHeader->packet_id);
-                }
-
-                // If the packet is one we need to track, add it to the table
-                if (pHeader->packet_id == VKTRACE_TPI_VK_vkBindImageMemory ||
-                    pHeader->packet_id == VKTRACE_TPI_VK_vkBindBufferMemory ||
-                    pHeader->packet_id == VKTRACE_TPI_VK_vkBindImageMemory2KHR ||
-                    pHeader->packet_id == VKTRACE_TPI_VK_vkBindBufferMemory2KHR ||
-                    pHeader->packet_id == VKTRACE_TPI_VK_vkAllocateMemory || pHeader->packet_id == VKTRACE_TPI_VK_vkDestroyImage ||
-                    pHeader->packet_id == VKTRACE_TPI_VK_vkDestroyBuffer || pHeader->packet_id == VKTRACE_TPI_VK_vkFreeMemory ||
-                    pHeader->packet_id == VKTRACE_TPI_VK_vkCreateBuffer || pHeader->packet_id == VKTRACE_TPI_VK_vkCreateImage) {
-                    vktrace_LogDebug("Add packet to portability table: %s",
-                                     vktrace_vk_packet_id_name((VKTRACE_TRACE_PACKET_ID_VK)pHeader->packet_id));
-                    portabilityTable.push_back(fileOffset);
-                }
-                lastPacketIndex = pHeader->global_packet_index;
-                lastPacketThreadId = pHeader->thread_id;
-                lastPacketEndTime = pHeader->vktrace_end_time;
-                fileOffset += bytes_written;
+                writeTime = vktrace_get_time() - writeBeginTime;
+                lockTime = writeBeginTime - lockBeginTime;
             }
+            vktrace_capture_stats_record_packet(pHeader, readTime, lockTime, writeTime, writeFailed);
         }
 
         // clean up
@@ -316,6 +385,7 @@ VKTRACE_THREAD_ROUTINE_RETURN_TYPE Process_RunRecordTraceThread(LPVOID _threadIn
     PostThreadMessage(pInfo->pProcessInfo->parentThreadId, VKTRACE_WM_COMPLETE, 0, 0);
 #endif
 
+    vktrace_capture_stats_set_message_stream(NULL);
     VKTRACE_DELETE(fileLikeSocket);
     vktrace_MessageStream_destroy(&pMessageStream);
 
@@ -20,6 +20,7 @@
  **************************************************************************/
 
 #include <assert.h>
+#include <algorithm>
 #include <QDebug>
 #include <QFileDialog>
 #include <QMoveEvent>
@@ -83,6 +84,9 @@ vktraceviewer::vktraceviewer(QWidget* parent)
       m_pGenerateTraceButton(NULL),
       m_pTimeline(NULL),
       m_pGenerateTraceDialog(NULL),
+      m_pSearchIndex(NULL),
+      m_searchQueryId(0),
+      m_searchIndexedPacketCount(0),
       m_bDelayUpdateUIForContext(false),
       m_bGeneratingTrace(false) {
     ui->setupUi(this);
@@ -227,9 +231,18 @@ void vktraceviewer::set_calltree_model(vktraceviewer_QTraceFileModel* pTraceFile
         return;
     }
 
+    if (m_pTraceFileModel != pTraceFileModel) {
+        // the search index formats packets with the trace file model, so it has to be rebuilt for a new one
+        stop_search_index();
+    }
+
     m_pTraceFileModel = pTraceFileModel;
     m_pProxyModel = pModel;
 
+    if (m_pTraceFileModel != NULL && m_pSearchIndex == NULL) {
+        start_search_index();
+    }
+
     if (m_pTimeline != NULL) {
         m_pTimeline->setModel(pTraceFileModel);
     }
@@ -430,60 +443,16 @@ void vktraceviewer::on_action_Open_triggered() {
     }
 }
 
-typedef struct {
-    uint64_t totalCpuExecutionTime;
-    uint64_t totalTraceOverhead;
-    uint32_t totalCallCount;
-} vtvApiUsageStats;
-
-void vktraceviewer::GenerateTraceFileStats() {
-    // process trace file to extract some API usage stats
-    // (NOTE: this could happen in a background thread)
+void vktraceviewer::GenerateTraceFileStats(const vktraceviewer_trace_file_stats& stats) {
+    // API usage stats are gathered by the trace file loader while it scans the packets
     ui->bottomTabWidget->addTab(m_pTraceStatsTab, "Trace Stats");
 
     QString statText;
     m_pTraceStatsTabText->setText(statText);
 
-    vtvApiUsageStats tmpNewStat;
-    tmpNewStat.totalCallCount = 1;
-    tmpNewStat.totalCpuExecutionTime = 0;
-    tmpNewStat.totalTraceOverhead = 0;
-
-    vtvApiUsageStats totalStats;
-    totalStats.totalCallCount = 0;
-    totalStats.totalCpuExecutionTime = 0;
-    totalStats.totalTraceOverhead = 0;
-
-    uint64_t totalTraceTime = 0;
-
-    if (m_traceFileInfo.packetCount > 0) {
-        uint64_t start = m_traceFileInfo.pPacketOffsets[0].pHeader->entrypoint_begin_time;
-        uint64_t end = m_traceFileInfo.pPacketOffsets[m_traceFileInfo.packetCount - 1].pHeader->entrypoint_end_time;
-        totalTraceTime = end - start;
-    }
-
-    QMap<uint16_t, vtvApiUsageStats> statMap;
-    for (uint64_t i = 0; i < m_traceFileInfo.packetCount; i++) {
-        vktrace_trace_packet_header* pHeader = m_traceFileInfo.pPacketOffsets[i].pHeader;
-        if (pHeader->packet_id >= VKTRACE_TPI_VK_vkApiVersion) {
-            totalStats.totalCallCount++;
-            totalStats.totalCpuExecutionTime += (pHeader->entrypoint_end_time - pHeader->entrypoint_begin_time);
-            totalStats.totalTraceOverhead += ((pHeader->vktrace_end_time - pHeader->vktrace_begin_time) -
-                                              (pHeader->entrypoint_end_time - pHeader->entrypoint_begin_time));
-            if (statMap.contains(pHeader->packet_id)) {
-                statMap[pHeader->packet_id].totalCpuExecutionTime +=
-                    (pHeader->entrypoint_end_time - pHeader->entrypoint_begin_time);
-                statMap[pHeader->packet_id].totalTraceOverhead += ((pHeader->vktrace_end_time - pHeader->vktrace_begin_time) -
-                                                                   (pHeader->entrypoint_end_time - pHeader->entrypoint_begin_time));
-                statMap[pHeader->packet_id].totalCallCount++;
-            } else {
-                tmpNewStat.totalCpuExecutionTime = (pHeader->entrypoint_end_time - pHeader->entrypoint_begin_time);
-                tmpNewStat.totalTraceOverhead = ((pHeader->vktrace_end_time - pHeader->vktrace_begin_time) -
-                                                 (pHeader->entrypoint_end_time - pHeader->entrypoint_begin_time));
-                statMap.insert(pHeader->packet_id, tmpNewStat);
-            }
-        }
-    }
+    const vtvApiUsageStats& totalStats = stats.totalStats;
+    const QMap<uint16_t, vtvApiUsageStats>& statMap = stats.entrypointStats;
+    uint64_t totalTraceTime = stats.totalTraceTime;
 
     uint64_t appTime = totalTraceTime - totalStats.totalCpuExecutionTime - totalStats.totalTraceOverhead;
     uint64_t appDriverTime = totalTraceTime - totalStats.totalTraceOverhead;
@@ -511,7 +480,7 @@ void vktraceviewer::GenerateTraceFileStats() {
         "<table><thead><tr><th align='left'>Entrypoint</th><th align='right'># Calls (%Total)</th><th align='right'>Driver Time "
         "(%Total %AppDr %Driver)</th><th align='right'>VkTrace Overhead (%Total %vktrace)</th></tr></thead><tbody>";
 
-    for (QMap<uint16_t, vtvApiUsageStats>::iterator i = statMap.begin(); i != statMap.end(); i++) {
+    for (QMap<uint16_t, vtvApiUsageStats>::const_iterator i = statMap.begin(); i != statMap.end(); i++) {
         const vtvApiUsageStats stat = i.value();
         const char* entrypoint = m_pController->GetPacketIdString(i.key());
         if (entrypoint == NULL) {
@@ -540,6 +509,25 @@ void vktraceviewer::GenerateTraceFileStats() {
         statText.replace('?', "&nbsp;");
     }
 
+    statText += "</tbody></table><br/>";
+
+    statText +=
+        "<table><thead><tr><th align='left'>Thread</th><th align='right'># Calls (%Total)</th><th align='right'>Driver Time "
+        "(%Driver)</th></tr></thead><tbody>";
+
+    for (QMap<uint32_t, vtvApiUsageStats>::const_iterator i = stats.threadStats.begin(); i != stats.threadStats.end(); i++) {
+        const vtvApiUsageStats stat = i.value();
+        statText += QString("<tr><td>%1</td>").arg(i.key());
+        statText += QString("<td align='right'>%1 (%2%)</td>")
+                        .arg(stat.totalCallCount)
+                        .arg(100 * (float)stat.totalCallCount / (float)totalStats.totalCallCount, 5, 'f', 1, '?');
+        statText += QString("<td align='right'>%1 ns (%2%)</td></tr>")
+                        .arg(stat.totalCpuExecutionTime)
+                        .arg(100 * (float)stat.totalCpuExecutionTime / (float)totalStats.totalCpuExecutionTime, 5, 'f', 1, '?');
+
+        statText.replace('?', "&nbsp;");
+    }
+
     statText += "</tbody></table>";
     m_pTraceStatsTabText->setHtml(statText);
 }
@@ -560,6 +548,10 @@ void vktraceviewer::onTraceFileLoaded(bool bSuccess, const vktraceviewer_trace_f
         QMessageBox::critical(this, tr("Error"), tr("Could not open trace file."));
         close_trace_file();
 
+        // close_trace_file() has stopped the loader, so the file it mapped can be released.
+        vktraceviewer_trace_file_info failedFileInfo = fileInfo;
+        vktraceviewer_unmap_trace_file(&failedFileInfo);
+
         if (m_bGeneratingTrace) {
             // if the user was generating a trace file, but the trace failed to load,
             // then re-spawn the generate trace dialog.
@@ -604,6 +596,9 @@ void vktraceviewer::onTraceFileLoaded(bool bSuccess, const vktraceviewer_trace_f
             //    Functionality may be limited.");
             //}
 
+            // Packets are interpreted by the controller as the UI requests them
+            vktraceviewer_set_packet_interpreter(&m_traceFileInfo, m_pController);
+
             // Update the UI with the controller
             m_pController->LoadTraceFile(&m_traceFileInfo, this);
         }
@@ -621,17 +616,54 @@ void vktraceviewer::onTraceFileLoaded(bool bSuccess, const vktraceviewer_trace_f
 
         // reset flag indicating that the ui may have been generating a trace file.
         m_bGeneratingTrace = false;
+    }
+}
 
-        GenerateTraceFileStats();
+void vktraceviewer::onPacketsLoaded(vktraceviewer_trace_file_packet_offsets* pOffsets, uint64_t count, uint64_t* pFrameEndPackets,
+                                    uint64_t frameEndCount) {
+    if (m_traceFileInfo.pMappedFile != NULL) {
+        if (m_pTraceFileModel != NULL) {
+            m_pTraceFileModel->appendPackets(pOffsets, count, pFrameEndPackets, frameEndCount);
+        } else {
+            vktraceviewer_append_packet_offsets(&m_traceFileInfo, pOffsets, count, pFrameEndPackets, frameEndCount);
+        }
+    }
+
+    VKTRACE_DELETE(pOffsets);
+    VKTRACE_DELETE(pFrameEndPackets);
+
+    if (m_pSearchIndex != NULL) {
+        m_pSearchIndex->scheduleIndexing();
+    }
+}
+
+void vktraceviewer::onTraceFileStatsLoaded(const vktraceviewer_trace_file_stats& stats) {
+    if (m_traceFileInfo.pMappedFile != NULL && m_pController != NULL) {
+        GenerateTraceFileStats(stats);
     }
 }
 
 void vktraceviewer::on_action_Close_triggered() { close_trace_file(); }
 
 void vktraceviewer::close_trace_file() {
+    if (m_traceLoaderThread.isRunning()) {
+        // The loader is still scanning the mapped file, so it must stop before the file is unmapped.
+        // Its Finished() signal is queued to this thread, so quit the thread directly rather than waiting on it.
+        m_traceLoaderThread.requestInterruption();
+        m_traceLoaderThread.quit();
+        m_traceLoaderThread.wait();
+    }
+
+    // Apply anything the loader queued up before it stopped, so none of it reaches the next trace file.
+    QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
+    QCoreApplication::sendPostedEvents(&m_traceLoaderThread, QEvent::MetaCall);
+
+    stop_search_index();
+
     if (m_pController != NULL) {
         ui->bottomTabWidget->removeTab(ui->bottomTabWidget->indexOf(m_pTraceStatsTab));
         m_pController->UnloadTraceFile();
+        vktraceviewer_set_packet_interpreter(&m_traceFileInfo, NULL);
 #if !defined(USE_STATIC_CONTROLLER_LIBRARY)
         m_controllerFactory.Unload(&m_pController);
 #else
@@ -644,18 +676,7 @@ void vktraceviewer::close_trace_file() {
         m_pTimeline->repaint();
     }
 
-    if (m_traceFileInfo.packetCount > 0) {
-        for (unsigned int i = 0; i < m_traceFileInfo.packetCount; i++) {
-            if (m_traceFileInfo.pPacketOffsets[i].pHeader != NULL) {
-                vktrace_free(m_traceFileInfo.pPacketOffsets[i].pHeader);
-                m_traceFileInfo.pPacketOffsets[i].pHeader = NULL;
-            }
-        }
-
-        VKTRACE_DELETE(m_traceFileInfo.pPacketOffsets);
-        m_traceFileInfo.pPacketOffsets = NULL;
-        m_traceFileInfo.packetCount = 0;
-    }
+    vktraceviewer_unmap_trace_file(&m_traceFileInfo);
 
     if (m_traceFileInfo.pFile != NULL) {
         fclose(m_traceFileInfo.pFile);
@@ -702,9 +723,11 @@ void vktraceviewer::on_actionExport_API_Calls_triggered() {
 
         // iterate through every packet
         for (unsigned int i = 0; i < m_traceFileInfo.packetCount; i++) {
-            vktraceviewer_trace_file_packet_offsets* pOffsets = &m_traceFileInfo.pPacketOffsets[i];
-            vktrace_trace_packet_header* pHeader = pOffsets->pHeader;
-            assert(pHeader != NULL);
+            vktrace_trace_packet_header* pHeader = vktraceviewer_get_interpreted_packet(&m_traceFileInfo, i);
+            if (pHeader == NULL) {
+                fprintf(pFile, "Unrecognized packet type: %u\n", m_traceFileInfo.pPacketOffsets[i].pHeader->packet_id);
+                continue;
+            }
             QString string = m_pTraceFileModel->get_packet_string(pHeader);
 
             // output packet string
@@ -779,6 +802,10 @@ void vktraceviewer::open_trace_file_threaded(const QString& filename) {
 
     connect(pTraceLoader, SIGNAL(TraceFileLoaded(bool, vktraceviewer_trace_file_info, const QString&)), this,
             SLOT(onTraceFileLoaded(bool, vktraceviewer_trace_file_info, const QString&)));
+    connect(pTraceLoader, SIGNAL(PacketsLoaded(vktraceviewer_trace_file_packet_offsets*, uint64_t, uint64_t*, uint64_t)), this,
+            SLOT(onPacketsLoaded(vktraceviewer_trace_file_packet_offsets*, uint64_t, uint64_t*, uint64_t)));
+    connect(pTraceLoader, SIGNAL(TraceFileStatsLoaded(vktraceviewer_trace_file_stats)), this,
+            SLOT(onTraceFileStatsLoaded(vktraceviewer_trace_file_stats)));
     connect(pTraceLoader, SIGNAL(Finished()), &m_traceLoaderThread, SLOT(quit()));
     connect(pTraceLoader, SIGNAL(Finished()), pTraceLoader, SLOT(deleteLater()));
 
@@ -868,6 +895,8 @@ void vktraceviewer::on_searchTextBox_textChanged(const QString& searchText) {
         m_pTraceFileModel->set_highlight_search_string(searchText);
     }
 
+    request_search(searchText);
+
     // need to briefly give the treeview focus so that it properly redraws and highlights the matching rows
     // then return focus to the search textbox so that typed keys are not lost
     ui->treeView->setFocus();
@@ -877,6 +906,18 @@ void vktraceviewer::on_searchTextBox_textChanged(const QString& searchText) {
 void vktraceviewer::on_searchNextButton_clicked() {
     if (m_pTraceFileModel != NULL) {
         QModelIndex index = ui->treeView->currentIndex();
+
+        int resultRow = -1;
+        if (find_indexed_search_result(index, true, false, &resultRow)) {
+            if (resultRow >= 0) {
+                selectApicallModelIndex(m_pTraceFileModel->index(resultRow, vktraceviewer_QTraceFileModel::Column_EntrypointName),
+                                        true, true);
+                ui->treeView->setFocus();
+            }
+            return;
+        }
+
+        // The search index is still being built, so search the rows directly.
         if (!index.isValid()) {
             // If there was no valid current index, then get the first index in the trace file model.
             index = m_pTraceFileModel->index(0, vktraceviewer_QTraceFileModel::Column_EntrypointName);
@@ -922,6 +963,18 @@ void vktraceviewer::on_searchNextButton_clicked() {
 void vktraceviewer::on_searchPrevButton_clicked() {
     if (m_pTraceFileModel != NULL) {
         QModelIndex index = ui->treeView->currentIndex();
+
+        int resultRow = -1;
+        if (find_indexed_search_result(index, false, false, &resultRow)) {
+            if (resultRow >= 0) {
+                selectApicallModelIndex(m_pTraceFileModel->index(resultRow, vktraceviewer_QTraceFileModel::Column_EntrypointName),
+                                        true, true);
+                ui->treeView->setFocus();
+            }
+            return;
+        }
+
+        // The search index is still being built, so search the rows directly.
         if (!index.isValid()) {
             // If there was no valid current index, then get the first index in the trace file model.
             index = m_pTraceFileModel->index(0, vktraceviewer_QTraceFileModel::Column_EntrypointName);
@@ -1024,6 +1077,21 @@ void vktraceviewer::on_nextDrawcallButton_clicked() {
 
 void vktraceviewer::on_searchTextBox_returnPressed() {
     if (m_pTraceFileModel != NULL) {
+        int resultRow = -1;
+        if (find_indexed_search_result(ui->treeView->currentIndex(), true, true, &resultRow)) {
+            if (resultRow >= 0) {
+                selectApicallModelIndex(m_pTraceFileModel->index(resultRow, vktraceviewer_QTraceFileModel::Column_EntrypointName),
+                                        true, true);
+                ui->searchTextBox->setFocus();
+            } else {
+                QPalette palette(ui->searchTextBox->palette());
+                palette.setColor(QPalette::Base, Qt::red);
+                ui->searchTextBox->setPalette(palette);
+            }
+            return;
+        }
+
+        // The search index is still being built, so search the rows directly.
         QModelIndex index = ui->treeView->indexBelow(ui->treeView->currentIndex());
         bool bFound = false;
 
@@ -1083,6 +1151,105 @@ void vktraceviewer::on_searchTextBox_returnPressed() {
     }
 }
 
+void vktraceviewer::start_search_index() {
+    m_pSearchIndex = new vktraceviewer_QSearchIndex(&m_traceFileInfo, m_pTraceFileModel);
+    m_searchIndexThread.setObjectName("SearchIndexThread");
+    m_pSearchIndex->moveToThread(&m_searchIndexThread);
+
+    connect(this, SIGNAL(SearchTraceFile(const QString&, uint64_t)), m_pSearchIndex, SLOT(search(const QString&, uint64_t)),
+            Qt::QueuedConnection);
+    connect(m_pSearchIndex, SIGNAL(SearchResultsFound(uint64_t, const QVector<uint32_t>&, uint64_t)), this,
+            SLOT(onSearchResultsFound(uint64_t, const QVector<uint32_t>&, uint64_t)), Qt::QueuedConnection);
+
+    m_searchIndexThread.start(QThread::LowPriority);
+    m_pSearchIndex->scheduleIndexing();
+
+    // pick up any search text that was entered before the index existed
+    request_search(ui->searchTextBox->text());
+}
+
+void vktraceviewer::stop_search_index() {
+    if (m_pSearchIndex == NULL) {
+        return;
+    }
+
+    m_searchIndexThread.requestInterruption();
+    m_searchIndexThread.quit();
+    m_searchIndexThread.wait();
+
+    delete m_pSearchIndex;
+    m_pSearchIndex = NULL;
+
+    // ignore any results that the old index already queued up
+    m_searchQueryId++;
+    m_searchResults.clear();
+    m_searchIndexedPacketCount = 0;
+}
+
+void vktraceviewer::request_search(const QString& searchText) {
+    m_searchQueryId++;
+    m_searchResults.clear();
+    m_searchIndexedPacketCount = 0;
+
+    if (m_pSearchIndex != NULL) {
+        emit SearchTraceFile(searchText, m_searchQueryId);
+    }
+}
+
+void vktraceviewer::onSearchResultsFound(uint64_t queryId, const QVector<uint32_t>& rows, uint64_t indexedPacketCount) {
+    if (queryId != m_searchQueryId) {
+        // results of a search that has since been replaced
+        return;
+    }
+
+    m_searchResults += rows;
+    m_searchIndexedPacketCount = indexedPacketCount;
+}
+
+bool vktraceviewer::find_indexed_search_result(const QModelIndex& treeIndex, bool bForward, bool bWrap, int* pResultRow) {
+    *pResultRow = -1;
+    if (m_pSearchIndex == NULL) {
+        return false;
+    }
+
+    // Need to make sure this index is in model-space
+    QModelIndex index = treeIndex;
+    if (index.model() == m_pProxyModel) {
+        index = mapTreeIndexToModel(index);
+    }
+    int currentRow = index.isValid() ? index.row() : -1;
+
+    const uint32_t* pBegin = m_searchResults.constBegin();
+    const uint32_t* pEnd = m_searchResults.constEnd();
+    if (bForward) {
+        const uint32_t* pNext = (currentRow < 0) ? pBegin : std::upper_bound(pBegin, pEnd, (uint32_t)currentRow);
+        if (pNext != pEnd) {
+            *pResultRow = (int)*pNext;
+            return true;
+        }
+
+        // a later match may be in a packet that hasn't been indexed yet
+        if (m_searchIndexedPacketCount < m_traceFileInfo.packetCount) {
+            return false;
+        }
+
+        if (bWrap && pBegin != pEnd) {
+            *pResultRow = (int)*pBegin;
+        }
+    } else {
+        if (m_searchIndexedPacketCount < (uint64_t)qMax(0, currentRow)) {
+            return false;
+        }
+
+        const uint32_t* pPrev = std::lower_bound(pBegin, pEnd, (uint32_t)qMax(0, currentRow));
+        if (currentRow > 0 && pPrev != pBegin) {
+            *pResultRow = (int)*(pPrev - 1);
+        }
+    }
+
+    return true;
+}
+
 void vktraceviewer::on_contextComboBox_currentIndexChanged(int index) {}
 
 void vktraceviewer::prompt_generate_trace() {
@@ -29,6 +29,7 @@
 #include "vktraceviewer_view.h"
 #include "vktraceviewer_trace_file_utils.h"
 #include "vktraceviewer_qtimelineview.h"
+#include "vktraceviewer_qsearchindex.h"
 #include "vktraceviewer_controller_factory.h"
 #include "vktraceviewer_controller.h"
 #include "vktraceviewer_QTraceFileModel.h"
@@ -90,6 +91,7 @@ class vktraceviewer : public QMainWindow, public vktraceviewer_view {
 
    signals:
     void LoadTraceFile(const QString& filename);
+    void SearchTraceFile(const QString& searchText, uint64_t queryId);
 
    public slots:
 
@@ -104,6 +106,10 @@ class vktraceviewer : public QMainWindow, public vktraceviewer_view {
     void on_settingsSaved(vktrace_SettingGroup* pUpdatedSettings, unsigned int numGroups);
 
     void onTraceFileLoaded(bool bSuccess, const vktraceviewer_trace_file_info& fileInfo, const QString& controllerFilename);
+    void onPacketsLoaded(vktraceviewer_trace_file_packet_offsets* pOffsets, uint64_t count, uint64_t* pFrameEndPackets,
+                         uint64_t frameEndCount);
+    void onTraceFileStatsLoaded(const vktraceviewer_trace_file_stats& stats);
+    void onSearchResultsFound(uint64_t queryId, const QVector<uint32_t>& rows, uint64_t indexedPacketCount);
 
     void on_treeView_clicked(const QModelIndex& index);
     void slot_timeline_clicked(const QModelIndex& index);
@@ -132,14 +138,15 @@ class vktraceviewer : public QMainWindow, public vktraceviewer_view {
     QTextBrowser* m_pTraceStatsTabText;
 
     QThread m_traceLoaderThread;
+    QThread m_searchIndexThread;
     vktraceviewer_QSettingsDialog m_settingsDialog;
 
     // Returns true if the user chose to load the file.
     // Returns false if the user decided NOT to load the file.
     bool prompt_load_new_trace(const QString& tracefile);
 
-    // Scan the trace file packets to extract API usage stats
-    void GenerateTraceFileStats();
+    // Display the API usage stats gathered by the trace file loader
+    void GenerateTraceFileStats(const vktraceviewer_trace_file_stats& stats);
 
     void reset_tracefile_ui();
 
@@ -147,6 +154,14 @@ class vktraceviewer : public QMainWindow, public vktraceviewer_view {
     QModelIndex mapTreeIndexToModel(const QModelIndex& treeIndex) const;
     QModelIndex mapTreeIndexFromModel(const QModelIndex& modelIndex) const;
 
+    void start_search_index();
+    void stop_search_index();
+    void request_search(const QString& searchText);
+
+    // Looks up the next (or previous) match for the search text after the given tree index in the search index.
+    // Returns false if the search index hasn't covered the packets it would need to look at yet.
+    bool find_indexed_search_result(const QModelIndex& treeIndex, bool bForward, bool bWrap, int* pResultRow);
+
     static float u64ToFloat(uint64_t value);
     void build_timeline_model();
 
@@ -163,6 +178,13 @@ class vktraceviewer : public QMainWindow, public vktraceviewer_view {
     vktraceviewer_QGenerateTraceDialog* m_pGenerateTraceDialog;
 
     QColor m_searchTextboxBackgroundColor;
+
+    // Rows matching the current search, as reported by the search index so far
+    vktraceviewer_QSearchIndex* m_pSearchIndex;
+    uint64_t m_searchQueryId;
+    QVector<uint32_t> m_searchResults;
+    uint64_t m_searchIndexedPacketCount;
+
     bool m_bDelayUpdateUIForContext;
     bool m_bGeneratingTrace;
 };
@@ -71,12 +71,14 @@ vktraceviewer_QReplayWorker::vktraceviewer_QReplayWorker()
       m_pReplayWindow(NULL),
       m_pReplayWindowWidth(0),
       m_pReplayWindowHeight(0),
+      m_bSeparateReplayWindow(false),
       m_bPrintReplayInfoMessages(TRUE),
       m_bPrintReplayWarningMessages(TRUE),
       m_bPrintReplayErrorMessages(TRUE),
       m_bPauseOnReplayInfoMessages(FALSE),
       m_bPauseOnReplayWarningMessages(FALSE),
-      m_bPauseOnReplayErrorMessages(FALSE) {
+      m_bPauseOnReplayErrorMessages(FALSE),
+      m_bReplayersHaveState(false) {
     memset(m_pReplayers, 0, sizeof(vktrace_replay::vktrace_trace_packet_replay_library*) * VKTRACE_MAX_TRACER_ID_ARRAY_SIZE);
     g_pWorker = this;
 }
@@ -129,6 +131,7 @@ bool vktraceviewer_QReplayWorker::load_replayers(vktraceviewer_trace_file_info*
     m_pReplayWindow = pReplayWindow;
     m_pReplayWindowWidth = replayWindowWidth;
     m_pReplayWindowHeight = replayWindowHeight;
+    m_bSeparateReplayWindow = separateReplayWindow;
 
     m_pTraceFileInfo = pTraceFileInfo;
 
@@ -218,6 +221,7 @@ bool vktraceviewer_QReplayWorker::load_replayers(vktraceviewer_trace_file_info*
 
 void vktraceviewer_QReplayWorker::unloadReplayers() {
     m_pTraceFileInfo = NULL;
+    m_bReplayersHaveState = false;
 
     // Clean up replayers
     if (m_pReplayers != NULL) {
@@ -232,22 +236,32 @@ void vktraceviewer_QReplayWorker::unloadReplayers() {
 
 void vktraceviewer_QReplayWorker::playCurrentTraceFile(uint64_t startPacketIndex) {
     vktraceviewer_trace_file_info* pTraceFileInfo = m_pTraceFileInfo;
-    vktraceviewer_trace_file_packet_offsets* pCurPacket = NULL;
+    vktrace_trace_packet_header* pCurPacket = NULL;
+    void* pCurPacketAllocation = NULL;
     unsigned int res = vktrace_replay::VKTRACE_REPLAY_ERROR;
     vktrace_replay::vktrace_trace_packet_replay_library* replayer;
 
     m_bReplayInProgress = true;
 
-    for (uint64_t i = startPacketIndex; i < pTraceFileInfo->packetCount; i++) {
+    for (uint64_t i = startPacketIndex; i < vktraceviewer_get_packet_count(pTraceFileInfo); i++) {
         m_currentReplayPacketIndex = i;
         emit ReplayProgressUpdate(m_currentReplayPacketIndex);
 
-        pCurPacket = &pTraceFileInfo->pPacketOffsets[i];
-        s_currentReplayPacket = pCurPacket->pHeader->global_packet_index;
-        switch (pCurPacket->pHeader->packet_id) {
+        // Replay remaps the handles in the packet it replays, and the packet cache frees packets as the UI thread looks up
+        // others, so each packet is replayed from a copy of its own.
+        vktrace_free(pCurPacketAllocation);
+        pCurPacket = vktraceviewer_interpret_packet_copy(pTraceFileInfo, i, &pCurPacketAllocation);
+        if (pCurPacket == NULL) {
+            uint64_t globalPacketIndex = vktraceviewer_get_packet_header(pTraceFileInfo, i)->global_packet_index;
+            replayWorkerLoggingCallback(VKTRACE_LOG_ERROR,
+                                        QString("Unable to interpret packet %1.").arg(globalPacketIndex).toStdString().c_str());
+            continue;
+        }
+        s_currentReplayPacket = pCurPacket->global_packet_index;
+        switch (pCurPacket->packet_id) {
             case VKTRACE_TPI_MESSAGE: {
                 vktrace_trace_packet_message* msgPacket;
-                msgPacket = (vktrace_trace_packet_message*)pCurPacket->pHeader;
+                msgPacket = (vktrace_trace_packet_message*)pCurPacket->pBody;
                 replayWorkerLoggingCallback(msgPacket->type, msgPacket->message);
                 break;
             }
@@ -265,29 +279,29 @@ void vktraceviewer_QReplayWorker::playCurrentTraceFile(uint64_t startPacketIndex
                 break;
             // TODO processing code for all the above cases
             default: {
-                if (pCurPacket->pHeader->tracer_id >= VKTRACE_MAX_TRACER_ID_ARRAY_SIZE ||
-                    pCurPacket->pHeader->tracer_id == VKTRACE_TID_RESERVED) {
+                if (pCurPacket->tracer_id >= VKTRACE_MAX_TRACER_ID_ARRAY_SIZE || pCurPacket->tracer_id == VKTRACE_TID_RESERVED) {
                     replayWorkerLoggingCallback(VKTRACE_LOG_WARNING, QString("Tracer_id from packet num packet %1 invalid.")
-                                                                         .arg(pCurPacket->pHeader->packet_id)
+                                                                         .arg(pCurPacket->packet_id)
                                                                          .toStdString()
                                                                          .c_str());
                     continue;
                 }
-                replayer = m_pReplayers[pCurPacket->pHeader->tracer_id];
+                replayer = m_pReplayers[pCurPacket->tracer_id];
                 if (replayer == NULL) {
                     replayWorkerLoggingCallback(
                         VKTRACE_LOG_WARNING,
-                        QString("Tracer_id %1 has no valid replayer.").arg(pCurPacket->pHeader->tracer_id).toStdString().c_str());
+                        QString("Tracer_id %1 has no valid replayer.").arg(pCurPacket->tracer_id).toStdString().c_str());
                     continue;
                 }
-                if (pCurPacket->pHeader->packet_id >= VKTRACE_TPI_VK_vkApiVersion) {
+                if (pCurPacket->packet_id >= VKTRACE_TPI_VK_vkApiVersion) {
                     // replay the API packet
+                    m_bReplayersHaveState = true;
                     try {
-                        res = replayer->Replay(pCurPacket->pHeader);
+                        res = replayer->Replay(pCurPacket);
                     } catch (std::exception& e) {
                         replayWorkerLoggingCallback(VKTRACE_LOG_ERROR,
                                                     QString("Caught std::exception while replaying packet %1: %2")
-                                                        .arg(pCurPacket->pHeader->global_packet_index)
+                                                        .arg(pCurPacket->global_packet_index)
                                                         .arg(e.what())
                                                         .toStdString()
                                                         .c_str());
@@ -301,14 +315,14 @@ void vktraceviewer_QReplayWorker::playCurrentTraceFile(uint64_t startPacketIndex
                     if (res == vktrace_replay::VKTRACE_REPLAY_ERROR || res == vktrace_replay::VKTRACE_REPLAY_INVALID_ID ||
                         res == vktrace_replay::VKTRACE_REPLAY_CALL_ERROR) {
                         replayWorkerLoggingCallback(VKTRACE_LOG_ERROR, QString("Failed to replay packet %1.")
-                                                                           .arg(pCurPacket->pHeader->global_packet_index)
+                                                                           .arg(pCurPacket->global_packet_index)
                                                                            .toStdString()
                                                                            .c_str());
                     } else if (res == vktrace_replay::VKTRACE_REPLAY_BAD_RETURN) {
                         replayWorkerLoggingCallback(
                             VKTRACE_LOG_WARNING,
                             QString("Replay of packet %1 has diverged from trace due to a different return value.")
-                                .arg(pCurPacket->pHeader->global_packet_index)
+                                .arg(pCurPacket->global_packet_index)
                                 .toStdString()
                                 .c_str());
                     } else if (res == vktrace_replay::VKTRACE_REPLAY_INVALID_PARAMS ||
@@ -317,41 +331,46 @@ void vktraceviewer_QReplayWorker::playCurrentTraceFile(uint64_t startPacketIndex
                         // warnings here.
                     } else if (res != vktrace_replay::VKTRACE_REPLAY_SUCCESS) {
                         replayWorkerLoggingCallback(VKTRACE_LOG_ERROR, QString("Unknown error caused by packet %1.")
-                                                                           .arg(pCurPacket->pHeader->global_packet_index)
+                                                                           .arg(pCurPacket->global_packet_index)
                                                                            .toStdString()
                                                                            .c_str());
                     }
                 } else {
                     replayWorkerLoggingCallback(VKTRACE_LOG_ERROR, QString("Bad packet type id=%1, index=%2.")
-                                                                       .arg(pCurPacket->pHeader->packet_id)
-                                                                       .arg(pCurPacket->pHeader->global_packet_index)
+                                                                       .arg(pCurPacket->packet_id)
+                                                                       .arg(pCurPacket->global_packet_index)
                                                                        .toStdString()
                                                                        .c_str());
                 }
             }
         }
 
+        uint64_t globalPacketIndex = pCurPacket->global_packet_index;
+        vktrace_free(pCurPacketAllocation);
+        pCurPacketAllocation = NULL;
+
         // Process events and pause or stop if needed
-        if (m_bPauseReplay || m_pauseAtPacketIndex == pCurPacket->pHeader->global_packet_index) {
-            if (m_pauseAtPacketIndex == pCurPacket->pHeader->global_packet_index) {
+        if (m_bPauseReplay || m_pauseAtPacketIndex == globalPacketIndex) {
+            if (m_pauseAtPacketIndex == globalPacketIndex) {
                 // reset
                 m_pauseAtPacketIndex = (uint64_t)-1;
             }
 
             m_bReplayInProgress = false;
-            doReplayPaused(pCurPacket->pHeader->global_packet_index);
+            doReplayPaused(globalPacketIndex);
             return;
         }
 
         if (m_bStopReplay) {
             m_bReplayInProgress = false;
-            doReplayStopped(pCurPacket->pHeader->global_packet_index);
+            doReplayStopped(globalPacketIndex);
             return;
         }
     }
 
+    vktrace_free(pCurPacketAllocation);
     m_bReplayInProgress = false;
-    doReplayFinished(pCurPacket->pHeader->global_packet_index);
+    doReplayFinished(vktraceviewer_get_packet_header(pTraceFileInfo, m_currentReplayPacketIndex)->global_packet_index);
 }
 
 void vktraceviewer_QReplayWorker::onPlayToHere() {
@@ -372,6 +391,11 @@ void vktraceviewer_QReplayWorker::StartReplay() {
     // Reset some flags and play the replay from the beginning
     m_bPauseReplay = false;
     m_bStopReplay = false;
+
+    // The objects and memory of the previous replay are still alive in the replayers, so start over with new ones.
+    if (m_bReplayersHaveState) {
+        reset_replayers();
+    }
     playCurrentTraceFile(0);
 }
 
@@ -415,7 +439,7 @@ void vktraceviewer_QReplayWorker::StopReplay() {
         // Replay is not in progress means:
         // 1) replay wasn't started (in which case stop button should be disabled and we can't get to this point),
         // 2) replay is currently paused, so do same actions as if the replay detected that it should stop.
-        uint64_t packetIndex = this->m_pTraceFileInfo->pPacketOffsets[m_currentReplayPacketIndex].pHeader->global_packet_index;
+        uint64_t packetIndex = vktraceviewer_get_packet_header(m_pTraceFileInfo, m_currentReplayPacketIndex)->global_packet_index;
         doReplayStopped(packetIndex);
     }
 }
@@ -440,12 +464,19 @@ vktrace_replay::vktrace_trace_packet_replay_library* vktraceviewer_QReplayWorker
 }
 
 void vktraceviewer_QReplayWorker::DetachReplay(bool detach) {
+    m_bSeparateReplayWindow = detach;
+    reset_replayers();
+}
+
+void vktraceviewer_QReplayWorker::reset_replayers() {
+    m_bReplayersHaveState = false;
+
     for (int i = 0; i < VKTRACE_MAX_TRACER_ID_ARRAY_SIZE; i++) {
         if (m_pReplayers[i] != NULL) {
             m_pReplayers[i]->Deinitialize();
 
             vktrace_replay::ReplayDisplay disp;
-            if (detach) {
+            if (m_bSeparateReplayWindow) {
                 disp = vktrace_replay::ReplayDisplay(m_pReplayWindowWidth, m_pReplayWindowHeight);
             } else {
                 WId hWindow = m_pReplayWindow->winId();
@@ -453,10 +484,19 @@ void vktraceviewer_QReplayWorker::DetachReplay(bool detach) {
                 disp.set_window_handle(&hWindow);
             }
 
+            // the replayer deletes its display implementation when it is deinitialized
+            vktrace_replay::ReplayDisplayImp* pDisp = nullptr;
+            if (GetDisplayImplementation("xcb", &pDisp) == -1) {
+                emit OutputMessage(VKTRACE_LOG_ERROR, QString("Could not initialize display."));
+                m_replayerFactory.Destroy(&m_pReplayers[i]);
+                continue;
+            }
+            disp.set_implementation(pDisp);
+
 #if defined(PLATFORM_LINUX)
-            int err __attribute__((unused)) = m_pReplayers[i]->Initialize(&disp, NULL, NULL);
+            int err __attribute__((unused)) = m_pReplayers[i]->Initialize(&disp, NULL, m_pTraceFileInfo->pHeader);
 #else
-            int err = m_pReplayers[i]->Initialize(&disp, NULL, NULL);
+            int err = m_pReplayers[i]->Initialize(&disp, NULL, m_pTraceFileInfo->pHeader);
 #endif
             assert(err == 0);
         }
@@ -96,6 +96,7 @@ class vktraceviewer_QReplayWorker : public QObject {
     QWidget* m_pReplayWindow;
     int m_pReplayWindowWidth;
     int m_pReplayWindowHeight;
+    bool m_bSeparateReplayWindow;
 
     BOOL m_bPrintReplayInfoMessages;
     BOOL m_bPrintReplayWarningMessages;
@@ -108,6 +109,11 @@ class vktraceviewer_QReplayWorker : public QObject {
     vktrace_replay::ReplayFactory m_replayerFactory;
     vktrace_replay::vktrace_trace_packet_replay_library* m_pReplayers[VKTRACE_MAX_TRACER_ID_ARRAY_SIZE];
 
+    // Set once a packet has been replayed, so the replayers hold objects of the trace
+    bool m_bReplayersHaveState;
+
+    void reset_replayers();
+
     void doReplayPaused(uint64_t packetIndex);
     void doReplayStopped(uint64_t packetIndex);
     void doReplayFinished(uint64_t packetIndex);
@@ -22,6 +22,8 @@
 
 #include <QColor>
 #include <QFont>
+#include <QList>
+#include <QPair>
 #include <QSize>
 #include <qabstractitemmodel.h>
 #include "vktraceviewer_trace_file_utils.h"
@@ -58,6 +60,11 @@ class vktraceviewer_QTraceFileModel : public QAbstractItemModel {
         return get_packet_string(pHeader);
     }
 
+    // Handles that an interpreted packet holds or points to, as pairs of handle type name and value.
+    virtual QList<QPair<const char*, uint64_t> > get_packet_handles(const vktrace_trace_packet_header* pHeader) const {
+        return QList<QPair<const char*, uint64_t> >();
+    }
+
     int rowCount(const QModelIndex& parent = QModelIndex()) const {
         if (parent.column() > 0) {
             return 0;
@@ -120,7 +127,11 @@ class vktraceviewer_QTraceFileModel : public QAbstractItemModel {
         if (role == Qt::DisplayRole) {
             switch (index.column()) {
                 case Column_EntrypointName: {
-                    vktrace_trace_packet_header* pHeader = (vktrace_trace_packet_header*)index.internalPointer();
+                    vktrace_trace_packet_header* pHeader = vktraceviewer_get_interpreted_packet(m_pTraceFileInfo, index.row());
+                    if (pHeader == NULL) {
+                        return QString("Unrecognized packet type: %1")
+                            .arg(((vktrace_trace_packet_header*)index.internalPointer())->packet_id);
+                    }
                     QString apiStr = this->get_packet_string(pHeader);
                     return apiStr;
                 }
@@ -142,7 +153,10 @@ class vktraceviewer_QTraceFileModel : public QAbstractItemModel {
         }
 
         if (role == Qt::ToolTipRole && index.column() == Column_EntrypointName) {
-            vktrace_trace_packet_header* pHeader = (vktrace_trace_packet_header*)index.internalPointer();
+            vktrace_trace_packet_header* pHeader = vktraceviewer_get_interpreted_packet(m_pTraceFileInfo, index.row());
+            if (pHeader == NULL) {
+                return QVariant();
+            }
             QString tip;
             tip += "<html><table>";
 #if defined(_DEBUG)
@@ -191,7 +205,8 @@ class vktraceviewer_QTraceFileModel : public QAbstractItemModel {
             return QModelIndex();
         }
 
-        vktrace_trace_packet_header* pHeader = m_pTraceFileInfo->pPacketOffsets[row].pHeader;
+        // Point into the mapped file so the index stays valid regardless of the interpreted packet cache.
+        vktrace_trace_packet_header* pHeader = (vktrace_trace_packet_header*)m_pTraceFileInfo->pPacketOffsets[row].pHeader;
         void* pData = NULL;
         switch (column) {
             case Column_EntrypointName:
@@ -253,6 +268,21 @@ class vktraceviewer_QTraceFileModel : public QAbstractItemModel {
 
     void set_highlight_search_string(const QString searchString) { m_searchString = searchString; }
 
+    const vktraceviewer_trace_file_info* get_trace_file_info() const { return m_pTraceFileInfo; }
+
+    // Adds a batch of packets discovered by the background trace file loader as a single row insertion.
+    void appendPackets(const vktraceviewer_trace_file_packet_offsets* pOffsets, uint64_t count, const uint64_t* pFrameEndPackets,
+                       uint64_t frameEndCount) {
+        if (m_pTraceFileInfo == NULL || count == 0) {
+            return;
+        }
+
+        int firstRow = (int)m_pTraceFileInfo->packetCount;
+        beginInsertRows(QModelIndex(), firstRow, firstRow + (int)count - 1);
+        vktraceviewer_append_packet_offsets(m_pTraceFileInfo, pOffsets, count, pFrameEndPackets, frameEndCount);
+        endInsertRows();
+    }
+
    private:
     vktraceviewer_trace_file_info* m_pTraceFileInfo;
     QString m_searchString;
@@ -43,16 +43,30 @@ class vktraceviewer_QGroupThreadsProxyModel : public QAbstractProxyModel {
 
     //---------------------------------------------------------------------------------------------
     virtual void setSourceModel(QAbstractItemModel *sourceModel) {
+        if (this->sourceModel() != NULL) {
+            disconnect(this->sourceModel(), SIGNAL(rowsInserted(const QModelIndex &, int, int)), this,
+                       SLOT(onSourceRowsInserted(const QModelIndex &, int, int)));
+        }
+
         QAbstractProxyModel::setSourceModel(sourceModel);
 
         if (sourceModel->inherits("vktraceviewer_QTraceFileModel")) {
             vktraceviewer_QTraceFileModel *pTFM = static_cast<vktraceviewer_QTraceFileModel *>(sourceModel);
             buildGroups(pTFM);
+
+            // The trace file loader keeps appending packets to the source model after it is first displayed.
+            connect(sourceModel, SIGNAL(rowsInserted(const QModelIndex &, int, int)), this,
+                    SLOT(onSourceRowsInserted(const QModelIndex &, int, int)));
         }
     }
 
     //---------------------------------------------------------------------------------------------
     virtual int rowCount(const QModelIndex &parent) const {
+        if (!parent.isValid()) {
+            // only count the packets that have been grouped, the source may already hold more
+            return m_packetIndexToColumn.count();
+        }
+
         // ask the source
         return sourceModel()->rowCount(mapToSource(parent));
     }
@@ -148,6 +162,38 @@ class vktraceviewer_QGroupThreadsProxyModel : public QAbstractProxyModel {
         return results;
     }
 
+    //---------------------------------------------------------------------------------------------
+   private slots:
+    void onSourceRowsInserted(const QModelIndex &parent, int first, int last) {
+        if (parent.isValid()) {
+            return;
+        }
+
+        // Threads that first appear in the new packets get their own column.
+        QList<uint32_t> newThreadIds;
+        for (int i = first; i <= last; i++) {
+            vktrace_trace_packet_header *pHeader = (vktrace_trace_packet_header *)sourceModel()->index(i, 0).internalPointer();
+            if (pHeader != NULL && !m_uniqueThreadIdMapToColumn.contains(pHeader->thread_id) &&
+                !newThreadIds.contains(pHeader->thread_id)) {
+                newThreadIds.append(pHeader->thread_id);
+            }
+        }
+
+        if (!newThreadIds.isEmpty()) {
+            int firstColumn = columnCount(QModelIndex());
+            beginInsertColumns(QModelIndex(), firstColumn, firstColumn + newThreadIds.count() - 1);
+            for (int i = 0; i < newThreadIds.count(); i++) {
+                m_uniqueThreadIdMapToColumn.insert(newThreadIds[i], m_uniqueThreadIdMapToColumn.count());
+            }
+            endInsertColumns();
+        }
+
+        int firstRow = m_packetIndexToColumn.count();
+        beginInsertRows(QModelIndex(), firstRow, firstRow + (last - first));
+        appendPackets(first, last);
+        endInsertRows();
+    }
+
     //---------------------------------------------------------------------------------------------
    private:
     QMap<uint32_t, int> m_uniqueThreadIdMapToColumn;
@@ -168,17 +214,22 @@ class vktraceviewer_QGroupThreadsProxyModel : public QAbstractProxyModel {
         m_packetIndexToColumn.clear();
 
         if (pTFM != NULL) {
-            // Determine how many additional columns are needed by counting the number if different thread Ids being used.
-            for (int i = 0; i < pTFM->rowCount(); i++) {
-                vktrace_trace_packet_header *pHeader = (vktrace_trace_packet_header *)pTFM->index(i, 0).internalPointer();
-                if (pHeader != NULL) {
-                    if (!m_uniqueThreadIdMapToColumn.contains(pHeader->thread_id)) {
-                        int columnIndex = m_uniqueThreadIdMapToColumn.count();
-                        m_uniqueThreadIdMapToColumn.insert(pHeader->thread_id, columnIndex);
-                    }
-
-                    m_packetIndexToColumn.append(m_uniqueThreadIdMapToColumn[pHeader->thread_id]);
+            appendPackets(0, pTFM->rowCount() - 1);
+        }
+    }
+
+    //---------------------------------------------------------------------------------------------
+    void appendPackets(int first, int last) {
+        // Determine how many additional columns are needed by counting the number if different thread Ids being used.
+        for (int i = first; i <= last; i++) {
+            vktrace_trace_packet_header *pHeader = (vktrace_trace_packet_header *)sourceModel()->index(i, 0).internalPointer();
+            if (pHeader != NULL) {
+                if (!m_uniqueThreadIdMapToColumn.contains(pHeader->thread_id)) {
+                    int columnIndex = m_uniqueThreadIdMapToColumn.count();
+                    m_uniqueThreadIdMapToColumn.insert(pHeader->thread_id, columnIndex);
                 }
+
+                m_packetIndexToColumn.append(m_uniqueThreadIdMapToColumn[pHeader->thread_id]);
             }
         }
     }
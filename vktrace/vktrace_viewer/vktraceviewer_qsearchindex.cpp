@@ -0,0 +1,306 @@
+/**************************************************************************
+ *
+ * Copyright 2014-2016 Valve Corporation
+ * Copyright (C) 2014-2016 LunarG, Inc.
+ * All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ **************************************************************************/
+#include "vktraceviewer_qsearchindex.h"
+#include "vktraceviewer_QTraceFileModel.h"
+
+#include <algorithm>
+#include <QThread>
+
+//-----------------------------------------------------------------------------
+// Lowercases the token and strips any "0x" prefix and leading zeros so that
+// values printed with %p and PRIx64 produce the same token.
+static QString normalize_token(const QString& token) {
+    QString normalized = token.toLower();
+    if (normalized.startsWith("0x") && normalized.length() > 2) {
+        normalized.remove(0, 2);
+    }
+
+    int leadingZeros = 0;
+    while (leadingZeros < normalized.length() - 1 && normalized[leadingZeros] == '0') {
+        leadingZeros++;
+    }
+    normalized.remove(0, leadingZeros);
+    return normalized;
+}
+
+//-----------------------------------------------------------------------------
+// Splits text into runs of letters, digits and underscores, as they were written.
+static QStringList split_words(const QString& text) {
+    QStringList words;
+    int wordStart = -1;
+    for (int i = 0; i <= text.length(); i++) {
+        bool bWordChar = (i < text.length()) && (text[i].isLetterOrNumber() || text[i] == '_');
+        if (bWordChar && wordStart < 0) {
+            wordStart = i;
+        } else if (!bWordChar && wordStart >= 0) {
+            words.append(text.mid(wordStart, i - wordStart));
+            wordStart = -1;
+        }
+    }
+    return words;
+}
+
+//-----------------------------------------------------------------------------
+static bool is_numeric_token(const QString& token) {
+    bool bHasDigit = false;
+    for (int i = 0; i < token.length(); i++) {
+        QChar c = token[i];
+        if (c.isDigit()) {
+            bHasDigit = true;
+        } else if (c < 'a' || c > 'f') {
+            return false;
+        }
+    }
+    return bHasDigit;
+}
+
+//-----------------------------------------------------------------------------
+// Numbers and typed handles are looked up exactly, which keeps handle searches a single map lookup.
+static bool is_exact_token(const QString& token) {
+    return is_numeric_token(token) || token.contains(':');
+}
+
+//-----------------------------------------------------------------------------
+static QString typed_handle_token(const QString& typeName, const QString& value) {
+    return typeName.toLower() + ':' + value;
+}
+
+//-----------------------------------------------------------------------------
+// Each name is also indexed from each later word in it, starting after an
+// underscore or at a change from lowercase to uppercase, so that a prefix
+// lookup of "draw" finds vkCmdDrawIndexed.
+static QStringList index_tokens(const QString& text) {
+    QStringList tokens;
+    QStringList words = split_words(text);
+    for (int w = 0; w < words.count(); w++) {
+        const QString& word = words[w];
+        QString token = normalize_token(word);
+        tokens.append(token);
+        if (is_numeric_token(token)) {
+            continue;
+        }
+        for (int i = 1; i < word.length(); i++) {
+            if ((word[i - 1] == '_' && word[i] != '_') || (word[i - 1].isLower() && word[i].isUpper())) {
+                tokens.append(word.mid(i).toLower());
+            }
+        }
+    }
+    return tokens;
+}
+
+//-----------------------------------------------------------------------------
+// A handle type followed by a value becomes a single typed token, so that
+// "VkImage 0x1234" only matches packets where 0x1234 is a VkImage.
+static QStringList query_tokens(const QString& text) {
+    QStringList tokens;
+    QStringList words = split_words(text);
+    for (int w = 0; w < words.count(); w++) {
+        QString token = normalize_token(words[w]);
+        if (words[w].startsWith("Vk") && w + 1 < words.count()) {
+            QString value = normalize_token(words[w + 1]);
+            if (is_numeric_token(value)) {
+                tokens.append(typed_handle_token(words[w], value));
+                w++;
+                continue;
+            }
+        }
+        tokens.append(token);
+    }
+    return tokens;
+}
+
+//-----------------------------------------------------------------------------
+static bool token_matches(const QString& queryToken, const QString& indexedToken) {
+    if (is_exact_token(queryToken)) {
+        return indexedToken == queryToken;
+    }
+    return indexedToken.startsWith(queryToken);
+}
+
+//=============================================================================
+vktraceviewer_QSearchIndex::vktraceviewer_QSearchIndex(vktraceviewer_trace_file_info* pTraceFileInfo,
+                                                       const vktraceviewer_QTraceFileModel* pTraceFileModel)
+    : QObject(NULL),
+      m_pTraceFileInfo(pTraceFileInfo),
+      m_pTraceFileModel(pTraceFileModel),
+      m_indexingScheduled(0),
+      m_indexedPacketCount(0),
+      m_bQueryActive(false),
+      m_queryId(0) {
+    qRegisterMetaType<QVector<uint32_t> >("QVector<uint32_t>");
+}
+
+vktraceviewer_QSearchIndex::~vktraceviewer_QSearchIndex() {}
+
+//-----------------------------------------------------------------------------
+void vktraceviewer_QSearchIndex::scheduleIndexing() {
+    // only keep one request in the queue, indexPackets() reschedules itself until it catches up
+    if (m_indexingScheduled.testAndSetOrdered(0, 1)) {
+        QMetaObject::invokeMethod(this, "indexPackets", Qt::QueuedConnection);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void vktraceviewer_QSearchIndex::indexPackets() {
+    m_indexingScheduled.storeRelease(0);
+
+    QThread* pThread = QThread::currentThread();
+    uint64_t packetCount = vktraceviewer_get_packet_count(m_pTraceFileInfo);
+    uint64_t firstPacket = m_indexedPacketCount;
+    uint64_t endPacket = qMin(packetCount, firstPacket + VKTRACEVIEWER_SEARCH_INDEX_BATCH_SIZE);
+    if (firstPacket >= endPacket) {
+        return;
+    }
+
+    for (uint64_t i = firstPacket; i < endPacket; i++) {
+        if (pThread->isInterruptionRequested()) {
+            return;
+        }
+
+        const vktrace_trace_packet_header* pHeader = vktraceviewer_get_packet_header(m_pTraceFileInfo, i);
+        if (pHeader == NULL) {
+            continue;
+        }
+
+        // index the same text that the API Call Tree displays, plus the index and thread columns, and the handles
+        // of the call wherever they are in its parameters
+        QString text = QString("%1 %2").arg(pHeader->global_packet_index).arg(pHeader->thread_id);
+        QList<QPair<const char*, uint64_t> > handles;
+
+        void* pAllocation = NULL;
+        vktrace_trace_packet_header* pInterpreted = vktraceviewer_interpret_packet_copy(m_pTraceFileInfo, i, &pAllocation);
+        if (pInterpreted != NULL) {
+            text += " " + m_pTraceFileModel->get_packet_string(pInterpreted);
+            handles = m_pTraceFileModel->get_packet_handles(pInterpreted);
+            vktrace_free(pAllocation);
+        }
+
+        add_packet_tokens((uint32_t)i, text, handles);
+    }
+    m_indexedPacketCount = endPacket;
+
+    if (m_bQueryActive) {
+        emit SearchResultsFound(m_queryId, find_matches(firstPacket, endPacket), m_indexedPacketCount);
+    }
+
+    if (m_indexedPacketCount < vktraceviewer_get_packet_count(m_pTraceFileInfo)) {
+        scheduleIndexing();
+    }
+}
+
+//-----------------------------------------------------------------------------
+void vktraceviewer_QSearchIndex::add_packet_tokens(uint32_t packetIndex, const QString& text,
+                                                   const QList<QPair<const char*, uint64_t> >& handles) {
+    QStringList tokens = index_tokens(text);
+    for (int h = 0; h < handles.count(); h++) {
+        // handles are found by value, by type and value, and by the words of their type name
+        QString typeName = QString::fromLatin1(handles[h].first);
+        QString value = normalize_token(QString::number(handles[h].second, 16));
+        tokens.append(value);
+        tokens.append(typed_handle_token(typeName, value));
+        tokens.append(index_tokens(typeName));
+    }
+
+    for (int t = 0; t < tokens.count(); t++) {
+        add_packet_token(packetIndex, tokens[t]);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void vktraceviewer_QSearchIndex::add_packet_token(uint32_t packetIndex, const QString& token) {
+    QVector<uint32_t>& packets = m_postings[token];
+    if (packets.isEmpty() && m_bQueryActive) {
+        // a token seen for the first time may match the active query
+        for (int q = 0; q < m_queryTokens.count(); q++) {
+            if (token_matches(m_queryTokens[q], token)) {
+                m_queryMatchingKeys[q].append(token);
+            }
+        }
+    }
+
+    if (packets.isEmpty() || packets.last() != packetIndex) {
+        packets.append(packetIndex);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void vktraceviewer_QSearchIndex::search(const QString& searchText, uint64_t queryId) {
+    m_queryId = queryId;
+    m_queryTokens = query_tokens(searchText);
+    m_queryTokens.removeDuplicates();
+    m_queryMatchingKeys.clear();
+    m_bQueryActive = !m_queryTokens.isEmpty();
+    if (!m_bQueryActive) {
+        return;
+    }
+
+    m_queryMatchingKeys.resize(m_queryTokens.count());
+    for (int q = 0; q < m_queryTokens.count(); q++) {
+        if (is_exact_token(m_queryTokens[q])) {
+            if (m_postings.contains(m_queryTokens[q])) {
+                m_queryMatchingKeys[q].append(m_queryTokens[q]);
+            }
+        } else {
+            // the tokens that start with the query token sort right after it
+            QMap<QString, QVector<uint32_t> >::const_iterator it = m_postings.lowerBound(m_queryTokens[q]);
+            for (; it != m_postings.constEnd() && it.key().startsWith(m_queryTokens[q]); ++it) {
+                m_queryMatchingKeys[q].append(it.key());
+            }
+        }
+    }
+
+    emit SearchResultsFound(m_queryId, find_matches(0, m_indexedPacketCount), m_indexedPacketCount);
+}
+
+//-----------------------------------------------------------------------------
+QVector<uint32_t> vktraceviewer_QSearchIndex::find_matches(uint64_t firstPacket, uint64_t endPacket) const {
+    QVector<uint32_t> matches;
+    for (int q = 0; q < m_queryTokens.count(); q++) {
+        // gather the packets in range that contain any token matching this query token
+        QVector<uint32_t> tokenMatches;
+        const QStringList& keys = m_queryMatchingKeys[q];
+        for (int k = 0; k < keys.count(); k++) {
+            const QVector<uint32_t>& packets = m_postings[keys[k]];
+            const uint32_t* pFirst = std::lower_bound(packets.constBegin(), packets.constEnd(), (uint32_t)firstPacket);
+            for (; pFirst != packets.constEnd() && *pFirst < endPacket; pFirst++) {
+                tokenMatches.append(*pFirst);
+            }
+        }
+        std::sort(tokenMatches.begin(), tokenMatches.end());
+        tokenMatches.erase(std::unique(tokenMatches.begin(), tokenMatches.end()), tokenMatches.end());
+
+        // every query token has to match
+        if (q == 0) {
+            matches = tokenMatches;
+        } else {
+            QVector<uint32_t> intersection(qMin(matches.count(), tokenMatches.count()));
+            uint32_t* pEnd = std::set_intersection(matches.constBegin(), matches.constEnd(), tokenMatches.constBegin(),
+                                                   tokenMatches.constEnd(), intersection.begin());
+            intersection.resize((int)(pEnd - intersection.begin()));
+            matches = intersection;
+        }
+
+        if (matches.isEmpty()) {
+            break;
+        }
+    }
+
+    return matches;
+}
@@ -0,0 +1,87 @@
+/**************************************************************************
+ *
+ * Copyright 2014-2016 Valve Corporation
+ * Copyright (C) 2014-2016 LunarG, Inc.
+ * All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ **************************************************************************/
+#ifndef VKTRACEVIEWER_QSEARCHINDEX_H
+#define VKTRACEVIEWER_QSEARCHINDEX_H
+
+#include <QAtomicInt>
+#include <QList>
+#include <QMap>
+#include <QPair>
+#include <QObject>
+#include <QStringList>
+#include <QVector>
+#include "vktraceviewer_trace_file_utils.h"
+
+class vktraceviewer_QTraceFileModel;
+
+// Number of packets indexed before pending search requests get a chance to run.
+#define VKTRACEVIEWER_SEARCH_INDEX_BATCH_SIZE 4096
+
+// Inverted index from the tokens of each API call's display string (entrypoint name, parameter names and
+// values) and from the handles the call holds or points to, including those in structs and pNext chains,
+// to the packets that contain them. The index is built on the thread the object is moved to, and searches
+// run on that same thread in between batches of indexing.
+//
+// Hex values are indexed without their "0x" prefix and leading zeros so that handles match however
+// they were formatted. Names are also indexed from each word in them, so "draw" finds vkCmdDrawIndexed.
+// A query matches packets that contain every query token; numeric query tokens must match exactly, other
+// query tokens match the start of an indexed token. A handle type followed by a value, such as
+// "VkImage 0x1234", only matches handles of that type.
+class vktraceviewer_QSearchIndex : public QObject {
+    Q_OBJECT
+   public:
+    vktraceviewer_QSearchIndex(vktraceviewer_trace_file_info* pTraceFileInfo, const vktraceviewer_QTraceFileModel* pTraceFileModel);
+    virtual ~vktraceviewer_QSearchIndex();
+
+    // Queues indexing of any packets that were loaded since the last batch. Can be called from any thread.
+    void scheduleIndexing();
+
+   public slots:
+    void indexPackets();
+    void search(const QString& searchText, uint64_t queryId);
+
+   signals:
+    // Rows of the trace file model that match the query, in increasing order. Each emission covers packets
+    // that were not covered by earlier emissions for the same query; indexedPacketCount is the number of
+    // packets covered so far.
+    void SearchResultsFound(uint64_t queryId, const QVector<uint32_t>& rows, uint64_t indexedPacketCount);
+
+   private:
+    vktraceviewer_trace_file_info* m_pTraceFileInfo;
+    const vktraceviewer_QTraceFileModel* m_pTraceFileModel;
+    QAtomicInt m_indexingScheduled;
+    uint64_t m_indexedPacketCount;
+
+    // token -> packets that contain it, in increasing order. Tokens are sorted so that the tokens starting
+    // with a query token are a single range.
+    QMap<QString, QVector<uint32_t> > m_postings;
+
+    // the active query, and for each of its tokens the indexed tokens that it matches
+    bool m_bQueryActive;
+    uint64_t m_queryId;
+    QStringList m_queryTokens;
+    QVector<QStringList> m_queryMatchingKeys;
+
+    void add_packet_tokens(uint32_t packetIndex, const QString& text, const QList<QPair<const char*, uint64_t> >& handles);
+    void add_packet_token(uint32_t packetIndex, const QString& token);
+    QVector<uint32_t> find_matches(uint64_t firstPacket, uint64_t endPacket) const;
+};
+
+#endif  // VKTRACEVIEWER_QSEARCHINDEX_H
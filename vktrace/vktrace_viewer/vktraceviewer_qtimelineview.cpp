@@ -28,6 +28,7 @@
 #define _USE_MATH_DEFINES
 #endif
 #include <math.h>
+#include <algorithm>
 #include "vktraceviewer_qtimelineview.h"
 #include "vktraceviewer_QTraceFileModel.h"
 
@@ -141,7 +142,7 @@ vktraceviewer_QTimelineView::vktraceviewer_QTimelineView(QWidget *parent)
       m_maxItemDuration(0),
       m_maxZoom(0.001f),
       m_threadHeight(0),
-      m_hashIsDirty(true),
+      m_threadAreaIsDirty(true),
       m_margin(10),
       m_pPixmap(NULL),
       m_itemDelegate(this) {
@@ -169,11 +170,13 @@ vktraceviewer_QTimelineView::~vktraceviewer_QTimelineView() { m_threadIdList.cle
 //-----------------------------------------------------------------------------
 void vktraceviewer_QTimelineView::setModel(QAbstractItemModel *pModel) {
     QAbstractItemView::setModel(pModel);
-    m_hashIsDirty = true;
+    m_threadAreaIsDirty = true;
     setItemDelegate(&m_itemDelegate);
 
     m_threadIdList.clear();
+    m_threadTimelines.clear();
     m_threadMask.clear();
+    m_threadArea.clear();
     m_maxItemDuration = 0;
     m_rawStartTime = 0;
     m_rawEndTime = 0;
@@ -187,40 +190,14 @@ void vktraceviewer_QTimelineView::setModel(QAbstractItemModel *pModel) {
         return;
     }
 
-    int numRows = model()->rowCount();
-    for (int i = 0; i < numRows; i++) {
-        // Count number of unique thread Ids
-        QModelIndex item = model()->index(i, vktraceviewer_QTraceFileModel::Column_ThreadId);
-        if (item.isValid()) {
-            uint32_t threadId = item.data().toUInt();
-            if (!m_threadIdList.contains(threadId)) {
-                m_threadIdList.append(threadId);
-                m_threadMask.insert(threadId, QVector<int>());
-                m_threadArea.append(QRect());
-            }
-        }
-
-        // Find duration of longest item
-        item = model()->index(i, vktraceviewer_QTraceFileModel::Column_CpuDuration);
-        if (item.isValid()) {
-            float duration = item.data().toFloat();
-            if (m_maxItemDuration < duration) {
-                m_maxItemDuration = duration;
-            }
-        }
-    }
-
     // Get start time
     QModelIndex start = model()->index(0, vktraceviewer_QTraceFileModel::Column_BeginTime);
     if (start.isValid()) {
         m_rawStartTime = start.data().toULongLong();
     }
 
-    // Get end time
-    QModelIndex end = model()->index(numRows - 1, vktraceviewer_QTraceFileModel::Column_EndTime);
-    if (end.isValid()) {
-        m_rawEndTime = end.data().toULongLong();
-    }
+    int numRows = model()->rowCount();
+    gatherModelStats(0, numRows - 1);
 
     // the duration to viewport scale should allow us to map the entire timeline into the current window width.
     m_lineLength = m_rawEndTime - m_rawStartTime;
@@ -236,9 +213,130 @@ void vktraceviewer_QTimelineView::setModel(QAbstractItemModel *pModel) {
     verticalScrollBar()->setSingleStep(1);
 }
 
+//-----------------------------------------------------------------------------
+void vktraceviewer_QTimelineView::gatherModelStats(int firstRow, int lastRow) {
+    for (int i = firstRow; i <= lastRow; i++) {
+        QModelIndex item = model()->index(i, vktraceviewer_QTraceFileModel::Column_EntrypointName);
+        vktrace_trace_packet_header *pHeader = (vktrace_trace_packet_header *)item.internalPointer();
+        if (pHeader == NULL) {
+            continue;
+        }
+
+        // Count number of unique thread Ids
+        int threadIndex = m_threadIdList.indexOf(pHeader->thread_id);
+        if (threadIndex < 0) {
+            threadIndex = m_threadIdList.count();
+            m_threadIdList.append(pHeader->thread_id);
+            m_threadTimelines.append(vktraceviewer_timeline_thread());
+            m_threadMask.insert(pHeader->thread_id, QVector<int>());
+            m_threadArea.append(QRect());
+        }
+
+        // Items without a valid duration are not drawn
+        if (pHeader->entrypoint_end_time <= pHeader->entrypoint_begin_time || pHeader->entrypoint_begin_time < m_rawStartTime) {
+            continue;
+        }
+
+        // Find duration of longest item
+        float duration = u64ToFloat(pHeader->entrypoint_end_time - pHeader->entrypoint_begin_time);
+        if (m_maxItemDuration < duration) {
+            m_maxItemDuration = duration;
+        }
+
+        addTimelineItem(m_threadTimelines[threadIndex], i, pHeader->entrypoint_begin_time - m_rawStartTime,
+                        pHeader->entrypoint_end_time - m_rawStartTime);
+    }
+
+    // Get end time
+    QModelIndex end = model()->index(lastRow, vktraceviewer_QTraceFileModel::Column_EndTime);
+    if (end.isValid()) {
+        m_rawEndTime = end.data().toULongLong();
+    }
+}
+
+//-----------------------------------------------------------------------------
+void vktraceviewer_QTimelineView::addTimelineItem(vktraceviewer_timeline_thread &thread, int row, uint64_t beginTime,
+                                                  uint64_t endTime) {
+    thread.rows.append(row);
+    thread.beginTimes.append(beginTime);
+    thread.endTimes.append(endTime);
+
+    // Calls on a thread don't overlap and arrive in order, so each one either joins or follows the last bucket of every level.
+    uint64_t duration = endTime - beginTime;
+    for (int level = 0; level < VKTRACEVIEWER_TIMELINE_LOD_LEVELS; level++) {
+        QVector<vktraceviewer_timeline_bucket> &buckets = thread.levels[level];
+        uint64_t bucketIndex = beginTime >> (VKTRACEVIEWER_TIMELINE_LOD_BASE_SHIFT + level);
+        if (buckets.isEmpty() || buckets.last().bucketIndex < bucketIndex) {
+            vktraceviewer_timeline_bucket bucket;
+            bucket.bucketIndex = bucketIndex;
+            bucket.beginTime = beginTime;
+            bucket.endTime = endTime;
+            bucket.maxDuration = duration;
+            bucket.callCount = 1;
+            bucket.maxDurationRow = row;
+            buckets.append(bucket);
+        } else {
+            vktraceviewer_timeline_bucket &bucket = buckets.last();
+            bucket.beginTime = qMin(bucket.beginTime, beginTime);
+            bucket.endTime = qMax(bucket.endTime, endTime);
+            bucket.callCount++;
+            if (bucket.maxDuration < duration) {
+                bucket.maxDuration = duration;
+                bucket.maxDurationRow = row;
+            }
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+int vktraceviewer_QTimelineView::findTimelineItem(int threadIndex, double time, double tolerance) const {
+    const vktraceviewer_timeline_thread &thread = m_threadTimelines[threadIndex];
+
+    // Find the last call that begins at or before the given time (plus tolerance) and check that it reaches that time.
+    const uint64_t *pBegin = thread.beginTimes.constData();
+    const uint64_t *pEnd = pBegin + thread.beginTimes.count();
+    double latestBegin = qMax(0.0, time + tolerance);
+    const uint64_t *pFound = std::upper_bound(pBegin, pEnd, (uint64_t)latestBegin);
+    if (pFound == pBegin) {
+        return -1;
+    }
+
+    int i = (int)(pFound - pBegin) - 1;
+    if ((double)thread.endTimes[i] + tolerance < time) {
+        return -1;
+    }
+
+    return thread.rows[i];
+}
+
+//-----------------------------------------------------------------------------
+void vktraceviewer_QTimelineView::rowsInserted(const QModelIndex &parent, int start, int end) {
+    QAbstractItemView::rowsInserted(parent, start, end);
+
+    if (parent.isValid()) {
+        return;
+    }
+
+    // The trace file loader appends packets while the timeline is displayed, so extend the timeline to cover them.
+    bool bZoomedToFit = (m_zoomFactor == m_durationToViewportScale);
+    gatherModelStats(start, end);
+    m_lineLength = m_rawEndTime - m_rawStartTime;
+
+    int initialTimelineWidth = viewport()->width() - 2 * m_margin - m_scrollBarWidth;
+    m_durationToViewportScale = (float)initialTimelineWidth / u64ToFloat(m_lineLength);
+    if (bZoomedToFit) {
+        m_zoomFactor = m_durationToViewportScale;
+    }
+
+    m_threadAreaIsDirty = true;
+    deletePixmap();
+    updateGeometries();
+    viewport()->update();
+}
+
 //-----------------------------------------------------------------------------
 void vktraceviewer_QTimelineView::calculateRectsIfNecessary() {
-    if (!m_hashIsDirty) {
+    if (!m_threadAreaIsDirty) {
         return;
     }
 
@@ -253,43 +351,39 @@ void vktraceviewer_QTimelineView::calculateRectsIfNecessary() {
         this->m_threadArea[threadIndex] = QRect(0, top, viewport()->width(), itemHeight);
     }
 
-    int numRows = model()->rowCount();
-    for (int row = 0; row < numRows; row++) {
-        QRectF rect;
-        QModelIndex item = model()->index(row, vktraceviewer_QTraceFileModel::Column_EntrypointName);
+    m_threadAreaIsDirty = false;
+    viewport()->update();
+}
 
-        vktrace_trace_packet_header *pHeader = (vktrace_trace_packet_header *)item.internalPointer();
+//-----------------------------------------------------------------------------
+QRectF vktraceviewer_QTimelineView::itemRect(const QModelIndex &item) const {
+    QRectF rect;
+    if (!item.isValid() || model() == NULL) {
+        return rect;
+    }
 
-        // make sure item is valid size
-        if (pHeader->entrypoint_end_time > pHeader->entrypoint_begin_time) {
-            int threadIndex = m_threadIdList.indexOf(pHeader->thread_id);
-            int topOffset = (m_threadHeight * threadIndex) + (m_threadHeight * 0.5);
+    QModelIndex index = model()->index(item.row(), vktraceviewer_QTraceFileModel::Column_EntrypointName);
+    vktrace_trace_packet_header *pHeader = (vktrace_trace_packet_header *)index.internalPointer();
 
-            uint64_t duration = pHeader->entrypoint_end_time - pHeader->entrypoint_begin_time;
+    // make sure item is valid size
+    if (pHeader != NULL && pHeader->entrypoint_end_time > pHeader->entrypoint_begin_time &&
+        pHeader->entrypoint_begin_time >= m_rawStartTime) {
+        int itemHeight = m_threadHeight * 0.4;
+        int threadIndex = m_threadIdList.indexOf(pHeader->thread_id);
+        int topOffset = (m_threadHeight * threadIndex) + (m_threadHeight * 0.5);
 
-            float leftOffset = u64ToFloat(pHeader->entrypoint_begin_time - m_rawStartTime);
-            float Width = u64ToFloat(duration);
+        uint64_t duration = pHeader->entrypoint_end_time - pHeader->entrypoint_begin_time;
 
-            // create the rect that represents this item
-            rect.setLeft(leftOffset);
-            rect.setTop(topOffset - (itemHeight / 2));
-            rect.setWidth(Width);
-            rect.setHeight(itemHeight);
-        }
+        float leftOffset = u64ToFloat(pHeader->entrypoint_begin_time - m_rawStartTime);
+        float Width = u64ToFloat(duration);
 
-        m_rowToRectMap[row] = rect;
+        // create the rect that represents this item
+        rect.setLeft(leftOffset);
+        rect.setTop(topOffset - (itemHeight / 2));
+        rect.setWidth(Width);
+        rect.setHeight(itemHeight);
     }
 
-    m_hashIsDirty = false;
-    viewport()->update();
-}
-
-//-----------------------------------------------------------------------------
-QRectF vktraceviewer_QTimelineView::itemRect(const QModelIndex &item) const {
-    QRectF rect;
-    if (item.isValid()) {
-        rect = m_rowToRectMap.value(item.row());
-    }
     return rect;
 }
 
@@ -313,7 +407,7 @@ bool vktraceviewer_QTimelineView::event(QEvent *e) {
 
 //-----------------------------------------------------------------------------
 void vktraceviewer_QTimelineView::resizeEvent(QResizeEvent *event) {
-    m_hashIsDirty = true;
+    m_threadAreaIsDirty = true;
     deletePixmap();
 
     // The duration to viewport scale should allow us to map the entire timeline into the current window width.
@@ -455,33 +549,31 @@ QModelIndex vktraceviewer_QTimelineView::indexAt(const QPoint &point) const {
     float wy = (float)point.y();
 
     // Early out if the point is not in the areas covered by timeline items
-    bool inThreadArea = false;
+    int threadIndex = -1;
     for (int i = 0; i < m_threadArea.size(); i++) {
         if (wy >= m_threadArea[i].top() && wy <= m_threadArea[i].bottom()) {
-            inThreadArea = true;
+            threadIndex = i;
             break;
         }
     }
 
-    if (inThreadArea == false) {
+    if (threadIndex < 0 || threadIndex >= m_threadTimelines.size()) {
         // point is outside the areas that timeline items are drawn to.
         return QModelIndex();
     }
 
     // Transform the view coordinates into content widget coordinates.
+    // When zoomed out, anything within the pixel under the point is a hit.
     int x = point.x() - m_margin + horizontalScrollBar()->value();
-    float wx = (float)x / m_zoomFactor;
-
-    QHashIterator<int, QRectF> iter(m_rowToRectMap);
-    while (iter.hasNext()) {
-        iter.next();
-        QRectF value = iter.value();
-        if (value.contains(wx, wy)) {
-            return model()->index(iter.key(), vktraceviewer_QTraceFileModel::Column_EntrypointName);
-        }
+    double wx = (double)x / m_zoomFactor;
+    double pixelDuration = 1.0 / m_zoomFactor;
+
+    int row = findTimelineItem(threadIndex, wx, pixelDuration);
+    if (row < 0) {
+        return QModelIndex();
     }
 
-    return QModelIndex();
+    return model()->index(row, vktraceviewer_QTraceFileModel::Column_EntrypointName);
 }
 
 //-----------------------------------------------------------------------------
@@ -561,12 +653,8 @@ void vktraceviewer_QTimelineView::paint(QPainter *painter, QPaintEvent *event) {
         drawBaseTimelines(&pixmapPainter, event->rect(), threadList);
 
         if (model() != NULL) {
-            int numRows = model()->rowCount();
-
-            for (int r = 0; r < numRows; r++) {
-                QModelIndex index = model()->index(r, vktraceviewer_QTraceFileModel::Column_EntrypointName);
-
-                drawTimelineItem(&pixmapPainter, index);
+            for (int t = 0; t < m_threadTimelines.size(); t++) {
+                drawThreadTimeline(&pixmapPainter, t);
             }
         }
     }
@@ -625,6 +713,70 @@ float vktraceviewer_QTimelineView::scalePositionHorizontally(uint64_t value) con
     return offset;
 }
 
+//-----------------------------------------------------------------------------
+void vktraceviewer_QTimelineView::drawThreadTimeline(QPainter *painter, int threadIndex) {
+    const vktraceviewer_timeline_thread &thread = m_threadTimelines[threadIndex];
+    if (thread.rows.isEmpty()) {
+        return;
+    }
+
+    // Determine the range of time that is visible in the viewport
+    double pixelDuration = 1.0 / m_zoomFactor;
+    double viewStart = (double)(horizontalScrollBar()->value() - m_margin) * pixelDuration;
+    double viewEnd = (double)(horizontalScrollBar()->value() - m_margin + viewport()->width()) * pixelDuration;
+    uint64_t visibleBegin = (uint64_t)qMax(0.0, viewStart);
+    uint64_t visibleEnd = (uint64_t)qMax(0.0, viewEnd);
+
+    // Use the coarsest level whose buckets are still no wider than a pixel
+    int level = -1;
+    for (int l = VKTRACEVIEWER_TIMELINE_LOD_LEVELS - 1; l >= 0; l--) {
+        if ((double)(1ull << (VKTRACEVIEWER_TIMELINE_LOD_BASE_SHIFT + l)) <= pixelDuration) {
+            level = l;
+            break;
+        }
+    }
+
+    if (level < 0) {
+        // Zoomed in far enough that each call can be drawn individually.
+        // Calls on a thread don't overlap, so only the call before the first one that begins in view can reach into it.
+        const uint64_t *pBegin = thread.beginTimes.constData();
+        const uint64_t *pEnd = pBegin + thread.beginTimes.count();
+        int i = qMax(0, (int)(std::upper_bound(pBegin, pEnd, visibleBegin) - pBegin) - 1);
+        for (; i < thread.rows.count() && thread.beginTimes[i] <= visibleEnd; i++) {
+            drawTimelineItem(painter, model()->index(thread.rows[i], vktraceviewer_QTraceFileModel::Column_EntrypointName));
+        }
+    } else {
+        const QVector<vktraceviewer_timeline_bucket> &buckets = thread.levels[level];
+        const vktraceviewer_timeline_bucket *pFirst =
+            std::lower_bound(buckets.constBegin(), buckets.constEnd(), visibleBegin,
+                             [](const vktraceviewer_timeline_bucket &bucket, uint64_t time) { return bucket.endTime < time; });
+        for (; pFirst != buckets.constEnd() && pFirst->beginTime <= visibleEnd; pFirst++) {
+            drawTimelineBucket(painter, threadIndex, *pFirst);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+void vktraceviewer_QTimelineView::drawTimelineBucket(QPainter *painter, int threadIndex,
+                                                     const vktraceviewer_timeline_bucket &bucket) {
+    if (bucket.callCount == 1) {
+        drawTimelineItem(painter, model()->index(bucket.maxDurationRow, vktraceviewer_QTraceFileModel::Column_EntrypointName));
+        return;
+    }
+
+    // The bucket is at most a pixel wide, so draw it as a single column colored by its longest call
+    int itemHeight = m_threadHeight * 0.4;
+    int top = (m_threadHeight * threadIndex) + (m_threadHeight * 0.5) - itemHeight / 2;
+    int left = (int)((double)bucket.beginTime * m_zoomFactor) - horizontalScrollBar()->value() + m_margin;
+    int right = (int)((double)bucket.endTime * m_zoomFactor) - horizontalScrollBar()->value() + m_margin;
+
+    float durationRatio = u64ToFloat(bucket.maxDuration) / getMaxItemDuration();
+    int intensity = std::min(255, (int)(durationRatio * 255.0f));
+    QColor color(intensity, 255 - intensity, 0);
+
+    painter->fillRect(QRect(left, top, qMax(1, right - left), itemHeight), color);
+}
+
 //-----------------------------------------------------------------------------
 void vktraceviewer_QTimelineView::drawTimelineItem(QPainter *painter, const QModelIndex &index) {
     QRectF rect = viewportRect(index);
@@ -37,6 +37,31 @@ QT_END_NAMESPACE
 #include <QFont>
 #include <QPen>
 #include <QScrollBar>
+#include <QVector>
+
+// Level 0 of the timeline summary groups API calls into buckets of 2^16 ns (~65 us); each following level doubles that.
+#define VKTRACEVIEWER_TIMELINE_LOD_BASE_SHIFT 16
+#define VKTRACEVIEWER_TIMELINE_LOD_LEVELS 20
+
+// Summary of the API calls on one thread that begin within the same time bucket.
+// Times are relative to the start of the trace.
+struct vktraceviewer_timeline_bucket {
+    uint64_t bucketIndex;
+    uint64_t beginTime;  // earliest begin time of the calls in the bucket
+    uint64_t endTime;    // latest end time of the calls in the bucket
+    uint64_t maxDuration;
+    uint32_t callCount;
+    int maxDurationRow;  // model row of the longest call in the bucket
+};
+
+// The API calls of one thread in begin time order, along with a pyramid of bucket summaries used to
+// draw the timeline when more than one bucket falls within a pixel. Only non-empty buckets are stored.
+struct vktraceviewer_timeline_thread {
+    QVector<int> rows;
+    QVector<uint64_t> beginTimes;
+    QVector<uint64_t> endTimes;
+    QVector<vktraceviewer_timeline_bucket> levels[VKTRACEVIEWER_TIMELINE_LOD_LEVELS];
+};
 
 class vktraceviewer_QTimelineItemDelegate : public QAbstractItemDelegate {
     Q_OBJECT
@@ -83,6 +108,7 @@ class vktraceviewer_QTimelineView : public QAbstractItemView {
 
     // new members
     QList<uint32_t> m_threadIdList;
+    QVector<vktraceviewer_timeline_thread> m_threadTimelines;  // in the same order as m_threadIdList
     QHash<uint32_t, QVector<int> > m_threadMask;
     QList<QRect> m_threadArea;
     float m_maxItemDuration;
@@ -93,8 +119,7 @@ class vktraceviewer_QTimelineView : public QAbstractItemView {
     float m_zoomFactor;
     float m_maxZoom;
     int m_threadHeight;
-    QHash<int, QRectF> m_rowToRectMap;
-    bool m_hashIsDirty;
+    bool m_threadAreaIsDirty;
     int m_margin;
     int m_scrollBarWidth;
     QPoint m_mousePosition;
@@ -103,7 +128,12 @@ class vktraceviewer_QTimelineView : public QAbstractItemView {
     vktraceviewer_QTimelineItemDelegate m_itemDelegate;
 
     void calculateRectsIfNecessary();
+    void gatherModelStats(int firstRow, int lastRow);
+    void addTimelineItem(vktraceviewer_timeline_thread &thread, int row, uint64_t beginTime, uint64_t endTime);
+    int findTimelineItem(int threadIndex, double time, double tolerance) const;
     void drawBaseTimelines(QPainter *painter, const QRect &rect, const QList<uint32_t> &threadList);
+    void drawThreadTimeline(QPainter *painter, int threadIndex);
+    void drawTimelineBucket(QPainter *painter, int threadIndex, const vktraceviewer_timeline_bucket &bucket);
     void drawTimelineItem(QPainter *painter, const QModelIndex &index);
 
     QRectF viewportRect(const QModelIndex &index) const;
@@ -138,6 +168,7 @@ class vktraceviewer_QTimelineView : public QAbstractItemView {
 
    protected slots:
     virtual void updateGeometries();
+    virtual void rowsInserted(const QModelIndex &parent, int start, int end);
 
    signals:
 
@@ -22,12 +22,27 @@
 #include "vktraceviewer_qtracefileloader.h"
 #include "vktraceviewer_controller_factory.h"
 
+#include <vector>
+#include <QElapsedTimer>
+#include <QThread>
+
 extern "C" {
 #include "vktrace_trace_packet_utils.h"
+#include "vktrace_vk_packet_id.h"
 }
 
-vktraceviewer_QTraceFileLoader::vktraceviewer_QTraceFileLoader() : QObject(NULL) {
+vktraceviewer_QTraceFileLoader::vktraceviewer_QTraceFileLoader()
+    : QObject(NULL),
+      m_pController(NULL),
+      m_scanOffset(0),
+      m_scanEnd(0),
+      m_scannedPacketCount(0),
+      m_firstBeginTime(0),
+      m_lastEndTime(0) {
     qRegisterMetaType<vktraceviewer_trace_file_info>("vktraceviewer_trace_file_info");
+    qRegisterMetaType<vktraceviewer_trace_file_packet_offsets*>("vktraceviewer_trace_file_packet_offsets*");
+    qRegisterMetaType<uint64_t*>("uint64_t*");
+    qRegisterMetaType<vktraceviewer_trace_file_stats>("vktraceviewer_trace_file_stats");
 }
 
 vktraceviewer_QTraceFileLoader::~vktraceviewer_QTraceFileLoader() {}
@@ -58,83 +73,139 @@ void vktraceviewer_QTraceFileLoader::loadTraceFile(const QString& filename) {
                 bOpened = false;
             }
 
-#if defined(USE_STATIC_CONTROLLER_LIBRARY)
-            m_pController = vtvCreateQController();
-            if (bOpened)
-#else
-            if (!load_controllers(&m_traceFileInfo)) {
+#if !defined(USE_STATIC_CONTROLLER_LIBRARY)
+            // Packets are interpreted on demand by the viewer's own controller, so this one
+            // is only needed to find out which controller library to use.
+            if (bOpened && !load_controllers(&m_traceFileInfo)) {
                 emit OutputMessage(VKTRACE_LOG_ERROR, "Failed to load necessary debug controllers.");
                 bOpened = false;
-            } else if (bOpened)
-#endif
-            {
-                connect(m_pController, SIGNAL(OutputMessage(VktraceLogLevel, const QString&)), this,
-                        SIGNAL(OutputMessage(VktraceLogLevel, const QString&)));
-                connect(m_pController, SIGNAL(OutputMessage(VktraceLogLevel, uint64_t, const QString&)), this,
-                        SIGNAL(OutputMessage(VktraceLogLevel, uint64_t, const QString&)));
-
-                // interpret the trace file packets
-                for (uint64_t i = 0; i < m_traceFileInfo.packetCount; i++) {
-                    vktraceviewer_trace_file_packet_offsets* pOffsets = &m_traceFileInfo.pPacketOffsets[i];
-                    switch (pOffsets->pHeader->packet_id) {
-                        case VKTRACE_TPI_MESSAGE:
-                            m_traceFileInfo.pPacketOffsets[i].pHeader =
-                                vktrace_interpret_body_as_trace_packet_message(pOffsets->pHeader)->pHeader;
-                            break;
-                        case VKTRACE_TPI_MARKER_CHECKPOINT:
-                            break;
-                        case VKTRACE_TPI_MARKER_API_BOUNDARY:
-                            break;
-                        case VKTRACE_TPI_MARKER_API_GROUP_BEGIN:
-                            break;
-                        case VKTRACE_TPI_MARKER_API_GROUP_END:
-                            break;
-                        case VKTRACE_TPI_MARKER_TERMINATE_PROCESS:
-                            break;
-                        case VKTRACE_TPI_PORTABILITY_TABLE:
-                            break;
-                        // TODO processing code for all the above cases
-                        default: {
-                            vktrace_trace_packet_header* pHeader = m_pController->InterpretTracePacket(pOffsets->pHeader);
-                            if (pHeader == NULL) {
-                                bOpened = false;
-                                emit OutputMessage(VKTRACE_LOG_ERROR,
-                                                   QString("Unrecognized packet type: %1").arg(pOffsets->pHeader->packet_id));
-                                m_traceFileInfo.pPacketOffsets[i].pHeader = NULL;
-                                break;
-                            }
-                            m_traceFileInfo.pPacketOffsets[i].pHeader = pHeader;
-                        }
-                    }
-
-                    // break from loop if there is an error
-                    if (bOpened == false) {
-                        break;
-                    }
-                }
-
-#if defined(USE_STATIC_CONTROLLER_LIBRARY)
-                vtvDeleteQController(&m_pController);
-#else
-                m_controllerFactory.Unload(&m_pController);
-#endif
             }
+            m_controllerFactory.Unload(&m_pController);
+#endif
         }
 
-        // TODO: We don't really want to close the trace file yet.
-        // I think we want to keep it open so that we can dynamically read from it.
-        // BUT we definitely don't want it to get locked open, so we need a smart
-        // way to open / close from it when reading.
+        // The mapping stays valid after the file is closed.
         fclose(m_traceFileInfo.pFile);
         m_traceFileInfo.pFile = NULL;
+
+        if (!bOpened) {
+            vktraceviewer_unmap_trace_file(&m_traceFileInfo);
+        }
     }
 
-    // populate the UI based on trace file info
+    // populate the UI based on trace file info; at this point only the first frame has been scanned
     emit TraceFileLoaded(bOpened, m_traceFileInfo, m_controllerFilename);
 
+    if (bOpened) {
+        // The UI owns the trace file info now, so the remaining packets are handed over in batches.
+        QThread* pThread = QThread::currentThread();
+        while (!scan_complete() && !pThread->isInterruptionRequested()) {
+            vktraceviewer_trace_file_packet_offsets* pOffsets = NULL;
+            uint64_t* pFrameEndPackets = NULL;
+            uint64_t frameEndCount = 0;
+            uint64_t count = scan_packets(&pOffsets, &pFrameEndPackets, &frameEndCount, false);
+            if (count > 0) {
+                emit PacketsLoaded(pOffsets, count, pFrameEndPackets, frameEndCount);
+            }
+        }
+
+        if (!pThread->isInterruptionRequested()) {
+            m_stats.totalTraceTime = m_lastEndTime - m_firstBeginTime;
+            emit TraceFileStatsLoaded(m_stats);
+        }
+    }
+
     emit Finished();
 }
 
+//-----------------------------------------------------------------------------
+uint64_t vktraceviewer_QTraceFileLoader::scan_packets(vktraceviewer_trace_file_packet_offsets** ppOffsets,
+                                                      uint64_t** ppFrameEndPackets, uint64_t* pFrameEndCount,
+                                                      bool bStopAtFrameEnd) {
+    std::vector<vktraceviewer_trace_file_packet_offsets> batch;
+    std::vector<uint64_t> frameEnds;
+    QElapsedTimer timer;
+    timer.start();
+
+    // "Walk" through each packet based on the packet size (which is the first 64-bits of the packet header).
+    // Only the packet headers are touched here; packet bodies are read when they are first displayed.
+    const uint8_t* pFileData = m_traceFileInfo.pMappedFile;
+    while (!scan_complete()) {
+        const vktrace_trace_packet_header* pHeader = (const vktrace_trace_packet_header*)(pFileData + m_scanOffset);
+        if (pHeader->size < sizeof(vktrace_trace_packet_header) || pHeader->size > m_scanEnd - m_scanOffset) {
+            emit OutputMessage(VKTRACE_LOG_WARNING, QString("Trace file is truncated after %1 packets.").arg(m_scannedPacketCount));
+            m_scanEnd = m_scanOffset;
+            break;
+        }
+
+        uint64_t fileOffset = m_scanOffset;
+        m_scanOffset += pHeader->size;
+
+        // If the last packet is the portability table, leave it out
+        if (pHeader->packet_id == VKTRACE_TPI_PORTABILITY_TABLE && m_scanOffset == m_scanEnd) {
+            break;
+        }
+
+        vktraceviewer_trace_file_packet_offsets offsets;
+        offsets.fileOffset = fileOffset;
+        offsets.pHeader = pHeader;
+        batch.push_back(offsets);
+        accumulate_stats(pHeader);
+
+        // Frame boundaries are recorded here so that grouping by frame doesn't need to look at every packet again.
+        bool bFrameEnd = (pHeader->tracer_id == VKTRACE_TID_VULKAN && pHeader->packet_id == VKTRACE_TPI_VK_vkQueuePresentKHR);
+        if (bFrameEnd) {
+            frameEnds.push_back(m_scannedPacketCount);
+        }
+        m_scannedPacketCount++;
+
+        if (bStopAtFrameEnd && bFrameEnd) {
+            break;
+        }
+
+        // checking the timer on every packet is measurably slower than the scan itself
+        if ((batch.size() % 256) == 0 && timer.elapsed() >= VKTRACEVIEWER_LOAD_BATCH_INTERVAL_MS) {
+            break;
+        }
+    }
+
+    *ppOffsets = NULL;
+    if (!batch.empty()) {
+        *ppOffsets = VKTRACE_NEW_ARRAY(vktraceviewer_trace_file_packet_offsets, batch.size());
+        memcpy(*ppOffsets, batch.data(), batch.size() * sizeof(vktraceviewer_trace_file_packet_offsets));
+    }
+
+    *ppFrameEndPackets = NULL;
+    *pFrameEndCount = frameEnds.size();
+    if (!frameEnds.empty()) {
+        *ppFrameEndPackets = VKTRACE_NEW_ARRAY(uint64_t, frameEnds.size());
+        memcpy(*ppFrameEndPackets, frameEnds.data(), frameEnds.size() * sizeof(uint64_t));
+    }
+    return batch.size();
+}
+
+//-----------------------------------------------------------------------------
+void vktraceviewer_QTraceFileLoader::accumulate_stats(const vktrace_trace_packet_header* pHeader) {
+    if (m_scannedPacketCount == 0) {
+        m_firstBeginTime = pHeader->entrypoint_begin_time;
+    }
+    m_lastEndTime = pHeader->entrypoint_end_time;
+
+    if (pHeader->packet_id < VKTRACE_TPI_VK_vkApiVersion) {
+        return;
+    }
+
+    uint64_t cpuTime = pHeader->entrypoint_end_time - pHeader->entrypoint_begin_time;
+    uint64_t overhead = (pHeader->vktrace_end_time - pHeader->vktrace_begin_time) - cpuTime;
+    vtvApiUsageStats* statsList[] = {&m_stats.totalStats, &m_stats.entrypointStats[pHeader->packet_id],
+                                     &m_stats.threadStats[pHeader->thread_id]};
+    for (vtvApiUsageStats* pStats : statsList) {
+        pStats->totalCallCount++;
+        pStats->totalCpuExecutionTime += cpuTime;
+        pStats->totalTraceOverhead += overhead;
+    }
+}
+
 //-----------------------------------------------------------------------------
 bool vktraceviewer_QTraceFileLoader::load_controllers(vktraceviewer_trace_file_info* pTraceFileInfo) {
     if (pTraceFileInfo->pHeader->tracer_count == 0) {
@@ -209,98 +280,33 @@ bool vktraceviewer_QTraceFileLoader::populate_trace_file_info(vktraceviewer_trac
     // Set global version num
     vktrace_set_trace_version(pTraceFileInfo->pHeader->trace_file_version);
 
-    // Find out how many trace packets there are.
-
-    // Seek to first packet
-    long first_offset = pTraceFileInfo->pHeader->first_packet_offset;
-    int seekResult = Fseek(pTraceFileInfo->pFile, first_offset, SEEK_SET);
-    if (seekResult != 0) {
-        emit OutputMessage(VKTRACE_LOG_WARNING, "Failed to seek to the first packet offset in the trace file.");
+    if (!vktraceviewer_map_trace_file(pTraceFileInfo)) {
+        vktrace_free(pTraceFileInfo->pHeader);
+        pTraceFileInfo->pHeader = NULL;
+        emit OutputMessage(VKTRACE_LOG_ERROR, "Unable to map trace file into memory.");
+        return false;
     }
 
-    // "Walk" through each packet based on the packet size (which is the first 64-bits of the packet header)
-    uint64_t fileOffset = pTraceFileInfo->pHeader->first_packet_offset;
-    uint64_t packetSize = 0;
-    while (1 == fread(&packetSize, sizeof(uint64_t), 1, pTraceFileInfo->pFile)) {
-        // success!
-        pTraceFileInfo->packetCount++;
-        fileOffset += packetSize;
-
-        seekResult = Fseek(pTraceFileInfo->pFile, packetSize - sizeof(uint64_t), SEEK_CUR);
-        if (seekResult != 0) {
-            emit OutputMessage(VKTRACE_LOG_ERROR, "Error while seeking through trace file.");
-            break;
-        }
-
-        if (ferror(pTraceFileInfo->pFile) != 0) {
-            emit OutputMessage(VKTRACE_LOG_ERROR, "Error while reading trace file.");
-            break;
+    // If the portability table was written, it is the last packet in the file and the final word
+    // of the file holds its entry count. Stop the packet scan in front of it.
+    const uint8_t* pFileData = pTraceFileInfo->pMappedFile;
+    m_scanOffset = pTraceFileInfo->pHeader->first_packet_offset;
+    m_scanEnd = pTraceFileInfo->mappedFileSize;
+    if (pTraceFileInfo->pHeader->portability_table_valid && m_scanEnd > m_scanOffset + sizeof(uint64_t)) {
+        uint64_t tableCount = *(const uint64_t*)(pFileData + m_scanEnd - sizeof(uint64_t));
+        uint64_t tableSize = sizeof(vktrace_trace_packet_header) + (tableCount + 1) * sizeof(uint64_t);
+        if (tableCount < m_scanEnd / sizeof(uint64_t) && tableSize <= m_scanEnd - m_scanOffset) {
+            m_scanEnd -= tableSize;
         }
     }
 
+    // Scan just the first frame so that the UI can show it right away; the rest of the packets follow in batches.
+    pTraceFileInfo->packetCount =
+        scan_packets(&pTraceFileInfo->pPacketOffsets, &pTraceFileInfo->pFrameEndPackets, &pTraceFileInfo->frameEndCount, true);
+    pTraceFileInfo->packetCapacity = pTraceFileInfo->packetCount;
+    pTraceFileInfo->frameEndCapacity = pTraceFileInfo->frameEndCount;
     if (pTraceFileInfo->packetCount == 0) {
-        if (ferror(pTraceFileInfo->pFile) != 0) {
-            perror("File Read error:");
-            emit OutputMessage(VKTRACE_LOG_ERROR, "There was an error reading the trace file.");
-            return false;
-        } else if (feof(pTraceFileInfo->pFile) != 0) {
-            emit OutputMessage(VKTRACE_LOG_WARNING, "Reached the end of the file.");
-        }
         emit OutputMessage(VKTRACE_LOG_WARNING, "There are no trace packets in this trace file.");
-        pTraceFileInfo->pPacketOffsets = NULL;
-    } else {
-        pTraceFileInfo->pPacketOffsets = VKTRACE_NEW_ARRAY(vktraceviewer_trace_file_packet_offsets, pTraceFileInfo->packetCount);
-
-        // rewind to first packet and this time, populate the packet offsets
-        if (Fseek(pTraceFileInfo->pFile, first_offset, SEEK_SET) != 0) {
-            vktrace_free(pTraceFileInfo->pHeader);
-            emit OutputMessage(VKTRACE_LOG_ERROR, "Unable to rewind trace file to gather packet offsets.");
-            return false;
-        }
-
-        unsigned int packetIndex = 0;
-        fileOffset = first_offset;
-        while (1 == fread(&packetSize, sizeof(uint64_t), 1, pTraceFileInfo->pFile)) {
-            // the fread confirms that this packet exists
-            // NOTE: We do not actually read the entire packet into memory right now.
-            pTraceFileInfo->pPacketOffsets[packetIndex].fileOffset = fileOffset;
-
-            // rewind slightly
-            seekResult = Fseek(pTraceFileInfo->pFile, -1 * (long)sizeof(uint64_t), SEEK_CUR);
-
-            if (seekResult != 0) {
-                emit OutputMessage(VKTRACE_LOG_ERROR, "Error while seeking between packets.");
-                break;
-            }
-
-            // allocate space for the packet and read it in
-            pTraceFileInfo->pPacketOffsets[packetIndex].pHeader = (vktrace_trace_packet_header*)vktrace_malloc(packetSize);
-            if (1 != fread(pTraceFileInfo->pPacketOffsets[packetIndex].pHeader, packetSize, 1, pTraceFileInfo->pFile)) {
-                vktrace_free(pTraceFileInfo->pHeader);
-                emit OutputMessage(VKTRACE_LOG_ERROR, "Unable to read in a trace packet.");
-                return false;
-            }
-
-            // adjust pointer to body of the packet
-            pTraceFileInfo->pPacketOffsets[packetIndex].pHeader->pBody =
-                (uintptr_t)pTraceFileInfo->pPacketOffsets[packetIndex].pHeader + sizeof(vktrace_trace_packet_header);
-
-            // now seek to what should be the next packet
-            fileOffset += packetSize;
-            packetIndex++;
-        }
-
-        // If the last packet is the portability table, remove it
-        if (pTraceFileInfo->pPacketOffsets[pTraceFileInfo->packetCount - 1].pHeader->packet_id == VKTRACE_TPI_PORTABILITY_TABLE) {
-            vktrace_free(pTraceFileInfo->pPacketOffsets[pTraceFileInfo->packetCount - 1].pHeader);
-            pTraceFileInfo->packetCount--;
-        }
-
-        if (Fseek(pTraceFileInfo->pFile, first_offset, SEEK_SET) != 0) {
-            vktrace_free(pTraceFileInfo->pHeader);
-            emit OutputMessage(VKTRACE_LOG_ERROR, "Unable to rewind trace file to restore position.");
-            return false;
-        }
     }
 
     return true;
@@ -26,6 +26,10 @@
 #include "vktraceviewer_controller.h"
 
 #define USE_STATIC_CONTROLLER_LIBRARY 1
+
+// How long the loader scans before handing a batch of packets to the UI.
+#define VKTRACEVIEWER_LOAD_BATCH_INTERVAL_MS 100
+
 class vktraceviewer_QTraceFileLoader : public QObject {
     Q_OBJECT
    public:
@@ -39,8 +43,17 @@ class vktraceviewer_QTraceFileLoader : public QObject {
     void OutputMessage(VktraceLogLevel level, uint64_t packetIndex, const QString& message);
     void OutputMessage(VktraceLogLevel level, const QString& message);
 
+    // Emitted once the header and the first frame of packets have been read.
     void TraceFileLoaded(bool bSuccess, const vktraceviewer_trace_file_info& fileInfo, const QString& controllerFilename);
 
+    // Emitted for each following batch of packets, along with the packet index of each frame that ends in the batch.
+    // The receiver takes ownership of pOffsets and pFrameEndPackets.
+    void PacketsLoaded(vktraceviewer_trace_file_packet_offsets* pOffsets, uint64_t count, uint64_t* pFrameEndPackets,
+                       uint64_t frameEndCount);
+
+    // Emitted after the last batch of packets.
+    void TraceFileStatsLoaded(const vktraceviewer_trace_file_stats& stats);
+
     void Finished();
 
    private:
@@ -49,9 +62,23 @@ class vktraceviewer_QTraceFileLoader : public QObject {
     vktraceviewer_QController* m_pController;
     QString m_controllerFilename;
 
+    // file offset of the next packet to scan, and of the end of the packets
+    uint64_t m_scanOffset;
+    uint64_t m_scanEnd;
+    uint64_t m_scannedPacketCount;
+
+    vktraceviewer_trace_file_stats m_stats;
+    uint64_t m_firstBeginTime;
+    uint64_t m_lastEndTime;
+
     bool load_controllers(vktraceviewer_trace_file_info* pTraceFileInfo);
 
     bool populate_trace_file_info(vktraceviewer_trace_file_info* pTraceFileInfo);
+
+    bool scan_complete() const { return m_scanOffset + sizeof(vktrace_trace_packet_header) > m_scanEnd; }
+    uint64_t scan_packets(vktraceviewer_trace_file_packet_offsets** ppOffsets, uint64_t** ppFrameEndPackets,
+                          uint64_t* pFrameEndCount, bool bStopAtFrameEnd);
+    void accumulate_stats(const vktrace_trace_packet_header* pHeader);
 };
 
 #endif  // VKTRACEVIEWER_QTRACEFILELOADER_H
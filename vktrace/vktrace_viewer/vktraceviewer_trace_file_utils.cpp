@@ -19,119 +19,322 @@
  * Author: Peter Lohrmann <peterl@valvesoftware.com> <plohrmann@gmail.com>
  **************************************************************************/
 #include "vktraceviewer_trace_file_utils.h"
+#include "vktraceviewer_controller.h"
 #include "vktrace_memory.h"
 
-BOOL vktraceviewer_populate_trace_file_info(vktraceviewer_trace_file_info* pTraceFileInfo) {
-    vktrace_trace_file_header header;
+extern "C" {
+#include "vktrace_trace_packet_utils.h"
+}
+
+#include <list>
+#include <unordered_map>
+#include <QMutex>
+#include <QMutexLocker>
+
+#if defined(WIN32)
+#include <io.h>
+#else
+#include <sys/stat.h>
+#endif
+
+struct vktraceviewer_packet_cache {
+    struct entry {
+        // allocation holding the interpreted packet
+        vktrace_trace_packet_header* pAllocation;
+
+        // the packet as returned by the interpreter
+        vktrace_trace_packet_header* pInterpreted;
+
+        // position in the lru list
+        std::list<uint64_t>::iterator lruPosition;
+    };
+
+    QMutex mutex;
+    vktraceviewer_QController* pController;
+
+    // packet indices, most recently used first
+    std::list<uint64_t> lru;
+    std::unordered_map<uint64_t, entry> entries;
+};
+
+// Copies the packet out of the read-only mapping and interprets the copy in place.
+// On success, *ppAllocation receives the copy, which the caller frees with vktrace_free().
+static vktrace_trace_packet_header* interpret_packet_copy(vktraceviewer_QController* pController,
+                                                          const vktrace_trace_packet_header* pFileHeader,
+                                                          vktrace_trace_packet_header** ppAllocation) {
+    vktrace_trace_packet_header* pPacket = (vktrace_trace_packet_header*)vktrace_malloc((size_t)pFileHeader->size);
+    if (pPacket == NULL) {
+        return NULL;
+    }
+    memcpy(pPacket, pFileHeader, (size_t)pFileHeader->size);
+    pPacket->pBody = (uintptr_t)pPacket + sizeof(vktrace_trace_packet_header);
 
+    vktrace_trace_packet_header* pInterpreted = NULL;
+    switch (pPacket->packet_id) {
+        case VKTRACE_TPI_MESSAGE:
+            pInterpreted = vktrace_interpret_body_as_trace_packet_message(pPacket)->pHeader;
+            break;
+        case VKTRACE_TPI_MARKER_CHECKPOINT:
+        case VKTRACE_TPI_MARKER_API_BOUNDARY:
+        case VKTRACE_TPI_MARKER_API_GROUP_BEGIN:
+        case VKTRACE_TPI_MARKER_API_GROUP_END:
+        case VKTRACE_TPI_MARKER_TERMINATE_PROCESS:
+        case VKTRACE_TPI_PORTABILITY_TABLE:
+            pInterpreted = pPacket;
+            break;
+        default:
+            if (pController != NULL) {
+                pInterpreted = pController->InterpretTracePacket(pPacket);
+            }
+            break;
+    }
+
+    if (pInterpreted == NULL) {
+        vktrace_free(pPacket);
+        return NULL;
+    }
+
+    *ppAllocation = pPacket;
+    return pInterpreted;
+}
+
+BOOL vktraceviewer_map_trace_file(vktraceviewer_trace_file_info* pTraceFileInfo) {
     assert(pTraceFileInfo != NULL);
     assert(pTraceFileInfo->pFile != NULL);
+    assert(pTraceFileInfo->pMappedFile == NULL);
 
-    // read trace file header
-    if (1 != fread(&header, sizeof(vktrace_trace_file_header), 1, pTraceFileInfo->pFile)) {
-        vktraceviewer_output_error("Unable to read header from file.");
+    void* pMapping = NULL;
+    uint64_t fileSize = 0;
+#if defined(WIN32)
+    HANDLE hFile = (HANDLE)_get_osfhandle(_fileno(pTraceFileInfo->pFile));
+    LARGE_INTEGER size;
+    if (hFile == INVALID_HANDLE_VALUE || !GetFileSizeEx(hFile, &size) || size.QuadPart == 0) {
         return FALSE;
     }
+    fileSize = (uint64_t)size.QuadPart;
 
-    // Make sure there is at least one gpuinfo struct in header
-    if (header.n_gpuinfo < 1) {
-        vktraceviewer_output_error("Trace file head may be corrupt - gpu info missing.");
+    // the view keeps the file mapping object alive, so the handle can be closed right away
+    HANDLE hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (hMapping == NULL) {
         return FALSE;
     }
-
-    // allocate trace file header that includes space for gpuinfo array
-    pTraceFileInfo->pHeader =
-        (vktrace_trace_file_header*)vktrace_malloc(sizeof(vktrace_trace_file_header) + header.n_gpuinfo * sizeof(struct_gpuinfo));
-    if (!pTraceFileInfo->pHeader) {
-        vktraceviewer_output_error("Unable to allocate memory for file read header.");
+    pMapping = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(hMapping);
+    if (pMapping == NULL) {
         return FALSE;
     }
-    *pTraceFileInfo->pHeader = header;
-    pTraceFileInfo->pGpuinfo = (struct_gpuinfo*)(pTraceFileInfo->pHeader + 1);
+#else
+    int fd = fileno(pTraceFileInfo->pFile);
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+        return FALSE;
+    }
+    fileSize = (uint64_t)fileStat.st_size;
 
-    // read the gpuinfo array
-    if (1 != fread(pTraceFileInfo->pGpuinfo, header.n_gpuinfo * sizeof(struct_gpuinfo), 1, pTraceFileInfo->pFile)) {
-        vktrace_free(pTraceFileInfo->pHeader);
-        vktraceviewer_output_error("Unable to read header from file.");
+    pMapping = mmap(NULL, (size_t)fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (pMapping == MAP_FAILED) {
         return FALSE;
     }
+#endif
 
-    // Set global version num
-    vktrace_set_trace_version(pTraceFileInfo->pHeader->trace_file_version);
+    pTraceFileInfo->pMappedFile = (const uint8_t*)pMapping;
+    pTraceFileInfo->mappedFileSize = fileSize;
+    pTraceFileInfo->pPacketCache = new vktraceviewer_packet_cache;
+    pTraceFileInfo->pPacketCache->pController = NULL;
+    return TRUE;
+}
+
+void vktraceviewer_unmap_trace_file(vktraceviewer_trace_file_info* pTraceFileInfo) {
+    assert(pTraceFileInfo != NULL);
 
-    // Find out how many trace packets there are.
+    if (pTraceFileInfo->pPacketCache != NULL) {
+        vktraceviewer_packet_cache* pCache = pTraceFileInfo->pPacketCache;
+        for (auto& it : pCache->entries) {
+            vktrace_free(it.second.pAllocation);
+        }
+        delete pCache;
+        pTraceFileInfo->pPacketCache = NULL;
+    }
+
+    if (pTraceFileInfo->pPacketOffsets != NULL) {
+        VKTRACE_DELETE(pTraceFileInfo->pPacketOffsets);
+        pTraceFileInfo->pPacketOffsets = NULL;
+    }
+    pTraceFileInfo->packetCount = 0;
+    pTraceFileInfo->packetCapacity = 0;
 
-    // Seek to first packet
-    long first_offset = pTraceFileInfo->pHeader->first_packet_offset;
-    int seekResult = Fseek(pTraceFileInfo->pFile, first_offset, SEEK_SET);
-    if (seekResult != 0) {
-        vktraceviewer_output_warning("Failed to seek to the first packet offset in the trace file.");
+    if (pTraceFileInfo->pFrameEndPackets != NULL) {
+        VKTRACE_DELETE(pTraceFileInfo->pFrameEndPackets);
+        pTraceFileInfo->pFrameEndPackets = NULL;
     }
+    pTraceFileInfo->frameEndCount = 0;
+    pTraceFileInfo->frameEndCapacity = 0;
 
-    uint64_t fileOffset = pTraceFileInfo->pHeader->first_packet_offset;
-    uint64_t packetSize = 0;
-    while (1 == fread(&packetSize, sizeof(uint64_t), 1, pTraceFileInfo->pFile)) {
-        // success!
-        pTraceFileInfo->packetCount++;
-        fileOffset += packetSize;
+    if (pTraceFileInfo->pMappedFile != NULL) {
+#if defined(WIN32)
+        UnmapViewOfFile(pTraceFileInfo->pMappedFile);
+#else
+        munmap((void*)pTraceFileInfo->pMappedFile, (size_t)pTraceFileInfo->mappedFileSize);
+#endif
+        pTraceFileInfo->pMappedFile = NULL;
+        pTraceFileInfo->mappedFileSize = 0;
+    }
+}
 
-        Fseek(pTraceFileInfo->pFile, fileOffset, SEEK_SET);
+void vktraceviewer_append_packet_offsets(vktraceviewer_trace_file_info* pTraceFileInfo,
+                                         const vktraceviewer_trace_file_packet_offsets* pOffsets, uint64_t count,
+                                         const uint64_t* pFrameEndPackets, uint64_t frameEndCount) {
+    assert(pTraceFileInfo != NULL);
+    vktraceviewer_packet_cache* pCache = pTraceFileInfo->pPacketCache;
+    if (pCache == NULL || count == 0) {
+        return;
     }
 
-    if (pTraceFileInfo->packetCount == 0) {
-        if (ferror(pTraceFileInfo->pFile) != 0) {
-            perror("File Read error:");
-            vktraceviewer_output_warning("There was an error reading the trace file.");
-            vktrace_free(pTraceFileInfo->pHeader);
-            return FALSE;
-        } else if (feof(pTraceFileInfo->pFile) != 0) {
-            vktraceviewer_output_warning("Reached the end of the file.");
+    QMutexLocker locker(&pCache->mutex);
+    uint64_t newFrameEndCount = pTraceFileInfo->frameEndCount + frameEndCount;
+    if (newFrameEndCount > pTraceFileInfo->frameEndCapacity) {
+        uint64_t newCapacity = qMax(newFrameEndCount, 2 * pTraceFileInfo->frameEndCapacity);
+        uint64_t* pNewFrameEnds =
+            (uint64_t*)vktrace_realloc(pTraceFileInfo->pFrameEndPackets, (size_t)newCapacity * sizeof(uint64_t));
+        if (pNewFrameEnds == NULL) {
+            return;
         }
-        vktraceviewer_output_warning("There are no trace packets in this trace file.");
-        pTraceFileInfo->pPacketOffsets = NULL;
-    } else {
-        pTraceFileInfo->pPacketOffsets = VKTRACE_NEW_ARRAY(vktraceviewer_trace_file_packet_offsets, pTraceFileInfo->packetCount);
-
-        // rewind to first packet and this time, populate the packet offsets
-        if (Fseek(pTraceFileInfo->pFile, first_offset, SEEK_SET) != 0) {
-            vktraceviewer_output_error("Unable to rewind trace file to gather packet offsets.");
-            vktrace_free(pTraceFileInfo->pHeader);
-            return FALSE;
+        pTraceFileInfo->pFrameEndPackets = pNewFrameEnds;
+        pTraceFileInfo->frameEndCapacity = newCapacity;
+    }
+
+    uint64_t newCount = pTraceFileInfo->packetCount + count;
+    if (newCount > pTraceFileInfo->packetCapacity) {
+        uint64_t newCapacity = qMax(newCount, 2 * pTraceFileInfo->packetCapacity);
+        vktraceviewer_trace_file_packet_offsets* pNewOffsets = (vktraceviewer_trace_file_packet_offsets*)vktrace_realloc(
+            pTraceFileInfo->pPacketOffsets, (size_t)newCapacity * sizeof(vktraceviewer_trace_file_packet_offsets));
+        if (pNewOffsets == NULL) {
+            return;
         }
+        pTraceFileInfo->pPacketOffsets = pNewOffsets;
+        pTraceFileInfo->packetCapacity = newCapacity;
+    }
 
-        unsigned int packetIndex = 0;
-        fileOffset = first_offset;
-        while (1 == fread(&packetSize, sizeof(uint64_t), 1, pTraceFileInfo->pFile)) {
-            // the fread confirms that this packet exists
-            // NOTE: We do not actually read the entire packet into memory right now.
-            pTraceFileInfo->pPacketOffsets[packetIndex].fileOffset = fileOffset;
-
-            // rewind slightly
-            Fseek(pTraceFileInfo->pFile, -1 * (long)sizeof(uint64_t), SEEK_CUR);
-
-            // allocate space for the packet and read it in
-            pTraceFileInfo->pPacketOffsets[packetIndex].pHeader = (vktrace_trace_packet_header*)vktrace_malloc(packetSize);
-            if (1 != fread(pTraceFileInfo->pPacketOffsets[packetIndex].pHeader, packetSize, 1, pTraceFileInfo->pFile)) {
-                vktraceviewer_output_error("Unable to read in a trace packet.");
-                vktrace_free(pTraceFileInfo->pHeader);
-                return FALSE;
-            }
+    memcpy(&pTraceFileInfo->pPacketOffsets[pTraceFileInfo->packetCount], pOffsets,
+           (size_t)count * sizeof(vktraceviewer_trace_file_packet_offsets));
+    pTraceFileInfo->packetCount = newCount;
 
-            // adjust pointer to body of the packet
-            pTraceFileInfo->pPacketOffsets[packetIndex].pHeader->pBody =
-                (uintptr_t)pTraceFileInfo->pPacketOffsets[packetIndex].pHeader + sizeof(vktrace_trace_packet_header);
+    if (frameEndCount > 0) {
+        memcpy(&pTraceFileInfo->pFrameEndPackets[pTraceFileInfo->frameEndCount], pFrameEndPackets,
+               (size_t)frameEndCount * sizeof(uint64_t));
+        pTraceFileInfo->frameEndCount = newFrameEndCount;
+    }
+}
 
-            // now seek to what should be the next packet
-            fileOffset += packetSize;
-            packetIndex++;
-        }
+uint64_t vktraceviewer_get_packet_count(vktraceviewer_trace_file_info* pTraceFileInfo) {
+    assert(pTraceFileInfo != NULL);
+    vktraceviewer_packet_cache* pCache = pTraceFileInfo->pPacketCache;
+    if (pCache == NULL) {
+        return 0;
+    }
+
+    QMutexLocker locker(&pCache->mutex);
+    return pTraceFileInfo->packetCount;
+}
+
+const vktrace_trace_packet_header* vktraceviewer_get_packet_header(vktraceviewer_trace_file_info* pTraceFileInfo,
+                                                                   uint64_t packetIndex) {
+    assert(pTraceFileInfo != NULL);
+    vktraceviewer_packet_cache* pCache = pTraceFileInfo->pPacketCache;
+    if (pCache == NULL) {
+        return NULL;
+    }
 
-        if (Fseek(pTraceFileInfo->pFile, first_offset, SEEK_SET) != 0) {
-            vktraceviewer_output_error("Unable to rewind trace file to restore position.");
-            vktrace_free(pTraceFileInfo->pHeader);
-            return FALSE;
+    QMutexLocker locker(&pCache->mutex);
+    if (packetIndex >= pTraceFileInfo->packetCount) {
+        return NULL;
+    }
+    return pTraceFileInfo->pPacketOffsets[packetIndex].pHeader;
+}
+
+void vktraceviewer_set_packet_interpreter(vktraceviewer_trace_file_info* pTraceFileInfo, vktraceviewer_QController* pController) {
+    assert(pTraceFileInfo != NULL);
+    vktraceviewer_packet_cache* pCache = pTraceFileInfo->pPacketCache;
+    if (pCache == NULL) {
+        return;
+    }
+
+    QMutexLocker locker(&pCache->mutex);
+    pCache->pController = pController;
+
+    // packets interpreted by a previous controller may not be valid anymore
+    for (auto& it : pCache->entries) {
+        vktrace_free(it.second.pAllocation);
+    }
+    pCache->entries.clear();
+    pCache->lru.clear();
+}
+
+vktrace_trace_packet_header* vktraceviewer_get_interpreted_packet(vktraceviewer_trace_file_info* pTraceFileInfo,
+                                                                  uint64_t packetIndex) {
+    assert(pTraceFileInfo != NULL);
+    vktraceviewer_packet_cache* pCache = pTraceFileInfo->pPacketCache;
+    if (pCache == NULL) {
+        return NULL;
+    }
+
+    QMutexLocker locker(&pCache->mutex);
+    if (packetIndex >= pTraceFileInfo->packetCount) {
+        return NULL;
+    }
+
+    auto found = pCache->entries.find(packetIndex);
+    if (found != pCache->entries.end()) {
+        pCache->lru.splice(pCache->lru.begin(), pCache->lru, found->second.lruPosition);
+        return found->second.pInterpreted;
+    }
+
+    vktrace_trace_packet_header* pPacket = NULL;
+    vktrace_trace_packet_header* pInterpreted =
+        interpret_packet_copy(pCache->pController, pTraceFileInfo->pPacketOffsets[packetIndex].pHeader, &pPacket);
+    if (pInterpreted == NULL) {
+        return NULL;
+    }
+
+    // evict the least recently used packets
+    while (pCache->entries.size() >= VKTRACEVIEWER_PACKET_CACHE_SIZE) {
+        auto evicted = pCache->entries.find(pCache->lru.back());
+        vktrace_free(evicted->second.pAllocation);
+        pCache->entries.erase(evicted);
+        pCache->lru.pop_back();
+    }
+
+    pCache->lru.push_front(packetIndex);
+    vktraceviewer_packet_cache::entry& newEntry = pCache->entries[packetIndex];
+    newEntry.pAllocation = pPacket;
+    newEntry.pInterpreted = pInterpreted;
+    newEntry.lruPosition = pCache->lru.begin();
+    return pInterpreted;
+}
+
+vktrace_trace_packet_header* vktraceviewer_interpret_packet_copy(vktraceviewer_trace_file_info* pTraceFileInfo,
+                                                                 uint64_t packetIndex, void** ppAllocation) {
+    assert(pTraceFileInfo != NULL);
+    assert(ppAllocation != NULL);
+    vktraceviewer_packet_cache* pCache = pTraceFileInfo->pPacketCache;
+    if (pCache == NULL) {
+        return NULL;
+    }
+
+    vktraceviewer_QController* pController = NULL;
+    const vktrace_trace_packet_header* pFileHeader = NULL;
+    {
+        QMutexLocker locker(&pCache->mutex);
+        if (packetIndex >= pTraceFileInfo->packetCount) {
+            return NULL;
         }
+        pController = pCache->pController;
+        pFileHeader = pTraceFileInfo->pPacketOffsets[packetIndex].pHeader;
     }
 
-    return TRUE;
+    // The mapping outlives the packet offsets array, so the copy can be made without holding the lock.
+    vktrace_trace_packet_header* pPacket = NULL;
+    vktrace_trace_packet_header* pInterpreted = interpret_packet_copy(pController, pFileHeader, &pPacket);
+    *ppAllocation = pPacket;
+    return pInterpreted;
 }
@@ -22,6 +22,7 @@
 #define VKTRACEVIEWER_TRACE_FILE_UTILS_H_
 
 //#include <string>
+#include <QMap>
 #include <QString>
 
 extern "C" {
@@ -29,12 +30,19 @@ extern "C" {
 }
 #include "vktraceviewer_output.h"
 
+// Maximum number of interpreted packets kept in memory at a time.
+#define VKTRACEVIEWER_PACKET_CACHE_SIZE 4096
+
+class vktraceviewer_QController;
+struct vktraceviewer_packet_cache;
+
 struct vktraceviewer_trace_file_packet_offsets {
     // the file offset to this particular packet
-    unsigned int fileOffset;
+    uint64_t fileOffset;
 
-    // Pointer to the packet header if it's been read from disk
-    vktrace_trace_packet_header* pHeader;
+    // Pointer to the packet header within the mapped trace file. The header fields are valid,
+    // but the body is not interpreted; use vktraceviewer_get_interpreted_packet() for that.
+    const vktrace_trace_packet_header* pHeader;
 };
 
 struct vktraceviewer_trace_file_info {
@@ -44,6 +52,10 @@ struct vktraceviewer_trace_file_info {
     // the trace file
     FILE* pFile;
 
+    // read-only mapping of the entire trace file
+    const uint8_t* pMappedFile;
+    uint64_t mappedFileSize;
+
     // trace file header
     vktrace_trace_file_header* pHeader;
     struct_gpuinfo* pGpuinfo;
@@ -51,10 +63,66 @@ struct vktraceviewer_trace_file_info {
     // number of packets in file which should also be number of elements in pPacketOffsets array
     uint64_t packetCount;
 
-    // array of packet offsets
+    // array of packet offsets, and the number of elements allocated for it
     vktraceviewer_trace_file_packet_offsets* pPacketOffsets;
+    uint64_t packetCapacity;
+
+    // Index of the last packet (the vkQueuePresentKHR) of each frame, in increasing order. Like the packet
+    // offsets, these are found while the loader scans the file.
+    uint64_t* pFrameEndPackets;
+    uint64_t frameEndCount;
+    uint64_t frameEndCapacity;
+
+    // most recently used interpreted packets
+    vktraceviewer_packet_cache* pPacketCache;
 };
 
-BOOL vktraceviewer_populate_trace_file_info(vktraceviewer_trace_file_info* pTraceFileInfo);
+typedef struct {
+    uint64_t totalCpuExecutionTime;
+    uint64_t totalTraceOverhead;
+    uint32_t totalCallCount;
+} vtvApiUsageStats;
+
+// API usage stats gathered while scanning the trace file
+struct vktraceviewer_trace_file_stats {
+    vktraceviewer_trace_file_stats() : totalTraceTime(0) { memset(&totalStats, 0, sizeof(totalStats)); }
+
+    uint64_t totalTraceTime;
+    vtvApiUsageStats totalStats;
+    QMap<uint16_t, vtvApiUsageStats> entrypointStats;
+    QMap<uint32_t, vtvApiUsageStats> threadStats;
+};
+
+// Maps pTraceFileInfo->pFile into memory and creates the packet cache.
+BOOL vktraceviewer_map_trace_file(vktraceviewer_trace_file_info* pTraceFileInfo);
+
+// Releases the packet cache, the packet offsets, the frame boundaries and the file mapping.
+void vktraceviewer_unmap_trace_file(vktraceviewer_trace_file_info* pTraceFileInfo);
+
+// Appends a batch of packet offsets and the frames that end within it; safe to call while the replay worker reads packets.
+void vktraceviewer_append_packet_offsets(vktraceviewer_trace_file_info* pTraceFileInfo,
+                                         const vktraceviewer_trace_file_packet_offsets* pOffsets, uint64_t count,
+                                         const uint64_t* pFrameEndPackets, uint64_t frameEndCount);
+
+// Thread-safe accessors for readers outside of the UI thread.
+uint64_t vktraceviewer_get_packet_count(vktraceviewer_trace_file_info* pTraceFileInfo);
+const vktrace_trace_packet_header* vktraceviewer_get_packet_header(vktraceviewer_trace_file_info* pTraceFileInfo,
+                                                                   uint64_t packetIndex);
+
+// Sets the controller used to interpret API packets as they are pulled into the packet cache.
+void vktraceviewer_set_packet_interpreter(vktraceviewer_trace_file_info* pTraceFileInfo, vktraceviewer_QController* pController);
+
+// Returns the interpreted packet at packetIndex, reading and interpreting it on first use.
+// The packet is owned by the cache and remains valid for at least the next
+// VKTRACEVIEWER_PACKET_CACHE_SIZE - 1 lookups. Returns NULL if the packet can't be interpreted.
+// Only the UI thread looks packets up in the cache; other threads use vktraceviewer_interpret_packet_copy(),
+// as a lookup from another thread could free a packet the UI thread is still using.
+vktrace_trace_packet_header* vktraceviewer_get_interpreted_packet(vktraceviewer_trace_file_info* pTraceFileInfo,
+                                                                  uint64_t packetIndex);
+
+// Interprets a private copy of the packet at packetIndex without going through the packet cache, for
+// background work and for replay, which changes the packets it replays. Free *ppAllocation with vktrace_free() when done with the packet.
+vktrace_trace_packet_header* vktraceviewer_interpret_packet_copy(vktraceviewer_trace_file_info* pTraceFileInfo,
+                                                                 uint64_t packetIndex, void** ppAllocation);
 
 #endif  // VKTRACEVIEWER_TRACE_FILE_UTILS_H_
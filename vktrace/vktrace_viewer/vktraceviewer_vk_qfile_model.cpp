@@ -25,6 +25,127 @@ extern "C" {
 #include "vktrace_vk_packet_id.h"
 }
 
+// Structs and pNext chains of a well-formed packet are much shorter, this only stops a malformed one.
+#define VKTRACEVIEWER_MAX_STRUCT_DEPTH 16
+
+struct packet_handles_context {
+    const char* pBegin;
+    const char* pEnd;
+    QList<QPair<const char*, uint64_t> >* pHandles;
+};
+
+//-----------------------------------------------------------------------------
+// Pointers that were not interpreted still hold offsets into the packet, so
+// anything outside of the packet is skipped rather than read.
+static bool is_in_packet(const packet_handles_context& context, const void* pData, uint64_t size) {
+    const char* pBytes = (const char*)pData;
+    return pBytes >= context.pBegin && pBytes <= context.pEnd && size <= (uint64_t)(context.pEnd - pBytes);
+}
+
+//-----------------------------------------------------------------------------
+static uint64_t read_count(const char* pCount, uint32_t countSize) {
+    switch (countSize) {
+        case sizeof(uint64_t):
+            return *(const uint64_t*)pCount;
+        case sizeof(uint16_t):
+            return *(const uint16_t*)pCount;
+        case sizeof(uint8_t):
+            return *(const uint8_t*)pCount;
+        default:
+            return *(const uint32_t*)pCount;
+    }
+}
+
+//-----------------------------------------------------------------------------
+static void add_handles(const packet_handles_context& context, const char* pTypeName, const char* pHandles, uint64_t count,
+                        uint32_t handleSize) {
+    if (!is_in_packet(context, pHandles, count * handleSize)) {
+        return;
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t handle = (handleSize == sizeof(uint64_t)) ? *(const uint64_t*)(pHandles + i * handleSize)
+                                                           : *(const uint32_t*)(pHandles + i * handleSize);
+        if (handle != 0) {
+            context.pHandles->append(qMakePair(pTypeName, handle));
+        }
+    }
+}
+
+static void add_struct_handles(const packet_handles_context& context, const char* pStruct, const struct_info* pInfo,
+                               uint32_t depth);
+
+//-----------------------------------------------------------------------------
+// Adds the handles of the structs in the pNext chain of pStruct, which are described by their sType.
+static void add_pnext_handles(const packet_handles_context& context, const char* pStruct, uint32_t depth) {
+    const char* pNext = (const char*)((const VkApplicationInfo*)pStruct)->pNext;
+    for (uint32_t i = 0; i < VKTRACEVIEWER_MAX_STRUCT_DEPTH && is_in_packet(context, pNext, sizeof(VkApplicationInfo)); i++) {
+        const struct_info* pInfo = get_struct_info(((const VkApplicationInfo*)pNext)->sType);
+        if (pInfo == NULL || !is_in_packet(context, pNext, pInfo->size)) {
+            return;
+        }
+        struct_info memberInfo = *pInfo;
+        memberInfo.has_pnext = 0;  // the chain is followed here
+        add_struct_handles(context, pNext, &memberInfo, depth + 1);
+        pNext = (const char*)((const VkApplicationInfo*)pNext)->pNext;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Adds the handles that the struct at pStruct holds or points to, following the members and pNext chains that the
+// generated struct_info describes.
+static void add_struct_handles(const packet_handles_context& context, const char* pStruct, const struct_info* pInfo,
+                               uint32_t depth) {
+    if (depth >= VKTRACEVIEWER_MAX_STRUCT_DEPTH) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < pInfo->handle_count; i++) {
+        const struct_handle_info& handle = pInfo->pHandles[i];
+        const char* pMember = pStruct + handle.offset;
+        switch (handle.kind) {
+            case STRUCT_MEMBER_INLINE:
+                add_handles(context, handle.type_name, pMember, handle.inline_count, handle.handle_size);
+                break;
+            case STRUCT_MEMBER_SINGLE:
+                add_handles(context, handle.type_name, *(const char* const*)pMember, 1, handle.handle_size);
+                break;
+            case STRUCT_MEMBER_ARRAY:
+                add_handles(context, handle.type_name, *(const char* const*)pMember,
+                            read_count(pStruct + handle.count_offset, handle.count_size), handle.handle_size);
+                break;
+        }
+    }
+
+    for (uint32_t i = 0; i < pInfo->member_count; i++) {
+        const struct_member_info& member = pInfo->pMembers[i];
+        const char* pMember = pStruct + member.offset;
+        if (member.pElementInfo == NULL) {
+            continue;
+        }
+        if (member.kind == STRUCT_MEMBER_INLINE) {
+            add_struct_handles(context, pMember, member.pElementInfo, depth + 1);
+            continue;
+        }
+
+        const char* pElements = *(const char* const*)pMember;
+        uint64_t count = 1;
+        if (member.kind == STRUCT_MEMBER_ARRAY) {
+            count = read_count(pStruct + member.count_offset, member.count_size);
+            count = (count + member.count_divisor - 1) / member.count_divisor;
+        }
+        if (!is_in_packet(context, pElements, count * member.element_size)) {
+            continue;
+        }
+        for (uint64_t j = 0; j < count; j++) {
+            add_struct_handles(context, pElements + j * member.element_size, member.pElementInfo, depth + 1);
+        }
+    }
+
+    if (pInfo->has_pnext) {
+        add_pnext_handles(context, pStruct, depth);
+    }
+}
+
 vktraceviewer_vk_QFileModel::vktraceviewer_vk_QFileModel(QObject* parent, vktraceviewer_trace_file_info* pTraceFileInfo)
     : vktraceviewer_QTraceFileModel(parent, pTraceFileInfo) {}
 
@@ -48,6 +169,61 @@ QString vktraceviewer_vk_QFileModel::get_packet_string_multiline(const vktrace_t
     }
 }
 
+QList<QPair<const char*, uint64_t> > vktraceviewer_vk_QFileModel::get_packet_handles(
+    const vktrace_trace_packet_header* pHeader) const {
+    QList<QPair<const char*, uint64_t> > handles;
+    if (pHeader->packet_id < VKTRACE_TPI_VK_vkApiVersion) {
+        return handles;
+    }
+
+    uint32_t paramCount = 0;
+    const vktrace_vk_packet_param_info* pParams =
+        vktrace_vk_packet_param_infos((const VKTRACE_TRACE_PACKET_ID_VK)pHeader->packet_id, &paramCount);
+    packet_handles_context context = {(const char*)pHeader, (const char*)pHeader + pHeader->size, &handles};
+    const char* pPacket = (const char*)pHeader->pBody;
+    for (uint32_t i = 0; i < paramCount; i++) {
+        const vktrace_vk_packet_param_info& param = pParams[i];
+        const char* pParam = pPacket + param.offset;
+        if (!is_in_packet(context, pParam, (param.kind == STRUCT_MEMBER_INLINE) ? param.element_size : sizeof(void*))) {
+            continue;
+        }
+        if (param.kind == STRUCT_MEMBER_INLINE) {
+            add_handles(context, param.handle_type, pParam, 1, param.element_size);
+            continue;
+        }
+
+        uint64_t count = 1;
+        if (param.kind == STRUCT_MEMBER_ARRAY) {
+            const char* pCount = pPacket + param.count_offset;
+            if (param.count_indirect) {
+                pCount = *(const char* const*)pCount;
+                if (!is_in_packet(context, pCount, param.count_member_offset + sizeof(uint32_t))) {
+                    continue;
+                }
+                pCount += param.count_member_offset;
+            }
+            count = *(const uint32_t*)pCount;
+        }
+
+        const char* pElements = *(const char* const*)pParam;
+        if (param.handle_type != NULL) {
+            add_handles(context, param.handle_type, pElements, count, param.element_size);
+            continue;
+        }
+        if (!is_in_packet(context, pElements, count * param.element_size)) {
+            continue;
+        }
+        for (uint64_t j = 0; j < count; j++) {
+            const char* pStruct = pElements + j * param.element_size;
+            const struct_info* pInfo = get_struct_info(((const VkApplicationInfo*)pStruct)->sType);
+            if (pInfo != NULL && pInfo->size <= param.element_size) {
+                add_struct_handles(context, pStruct, pInfo, 0);
+            }
+        }
+    }
+    return handles;
+}
+
 bool vktraceviewer_vk_QFileModel::isDrawCall(const VKTRACE_TRACE_PACKET_ID_VK packetId) const {
     // TODO : Update this based on latest API updates
     bool isDraw = false;
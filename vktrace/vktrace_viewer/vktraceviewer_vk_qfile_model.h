@@ -31,6 +31,7 @@ class vktraceviewer_vk_QFileModel : public vktraceviewer_QTraceFileModel {
 
     virtual QString get_packet_string(const vktrace_trace_packet_header* pHeader) const;
     virtual QString get_packet_string_multiline(const vktrace_trace_packet_header* pHeader) const;
+    virtual QList<QPair<const char*, uint64_t> > get_packet_handles(const vktrace_trace_packet_header* pHeader) const;
 
     virtual bool isDrawCall(const VKTRACE_TRACE_PACKET_ID_VK packetId) const;
 };
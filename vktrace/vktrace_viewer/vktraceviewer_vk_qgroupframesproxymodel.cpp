@@ -19,36 +19,64 @@
  **************************************************************************/
 #include "vktraceviewer_vk_qgroupframesproxymodel.h"
 
-extern "C" {
-#include "vktrace_vk_packet_id.h"
-}
-
 void vktraceviewer_vk_QGroupFramesProxyModel::buildGroups() {
-    m_mapSourceRowToProxyGroupRow.clear();
     m_frameList.clear();
     m_curFrameCount = 0;
+    m_nextFrameEnd = 0;
 
     if (sourceModel() != NULL) {
-        FrameInfo* pCurFrame = addNewFrame();
-        m_mapSourceRowToProxyGroupRow.reserve(sourceModel()->rowCount());
-        for (int srcRow = 0; srcRow < sourceModel()->rowCount(); srcRow++) {
-            int proxyRow = pCurFrame->mapChildRowToSourceRow.count();
-
-            // map source row to it's corresponding row in the proxy group.
-            m_mapSourceRowToProxyGroupRow.append(proxyRow);
-
-            // add this src row to the current proxy group.
-            pCurFrame->mapChildRowToSourceRow.append(srcRow);
-
-            // Should a new frame be started based on the API call in the previous row?
-            // If source data is a frame boundary make a new frame
-            QModelIndex tmpIndex = sourceModel()->index(srcRow, 0);
-            assert(tmpIndex.isValid());
-            vktrace_trace_packet_header* pHeader = (vktrace_trace_packet_header*)tmpIndex.internalPointer();
-            if (pHeader != NULL && pHeader->tracer_id == VKTRACE_TID_VULKAN &&
-                pHeader->packet_id == VKTRACE_TPI_VK_vkQueuePresentKHR) {
-                pCurFrame = addNewFrame();
+        addNewFrame(0);
+        appendSourceRows(0, sourceModel()->rowCount() - 1, false);
+    }
+}
+
+// Groups the source rows [first, last] into frames, continuing the last frame. When bNotify is set, the rows are
+// announced to attached views as one insertion per frame rather than one per API call.
+void vktraceviewer_vk_QGroupFramesProxyModel::appendSourceRows(int first, int last, bool bNotify) {
+    if (m_frameList.isEmpty() || last < first) {
+        return;
+    }
+
+    // The trace file loader records the last packet of every frame, so the rows don't need to be looked at here.
+    const vktraceviewer_trace_file_info* pTraceFileInfo =
+        static_cast<const vktraceviewer_QTraceFileModel*>(sourceModel())->get_trace_file_info();
+
+    int srcRow = first;
+    while (srcRow <= last) {
+        FrameInfo* pCurFrame = &m_frameList[m_curFrameCount - 1];
+
+        // Find the run of source rows that belong to the current frame.
+        bool bFrameBoundary = false;
+        int runEnd = last;
+        if (pTraceFileInfo != NULL && m_nextFrameEnd < pTraceFileInfo->frameEndCount &&
+            pTraceFileInfo->pFrameEndPackets[m_nextFrameEnd] <= (uint64_t)last) {
+            runEnd = (int)pTraceFileInfo->pFrameEndPackets[m_nextFrameEnd];
+            m_nextFrameEnd++;
+            bFrameBoundary = true;
+        }
+        assert(runEnd >= srcRow);
+
+        int firstChildRow = pCurFrame->sourceRowCount;
+        if (bNotify) {
+            beginInsertRows(pCurFrame->modelIndex, firstChildRow, firstChildRow + (runEnd - srcRow));
+        }
+
+        // add this run of src rows to the current proxy group.
+        pCurFrame->sourceRowCount += runEnd - srcRow + 1;
+        srcRow = runEnd + 1;
+
+        if (bNotify) {
+            endInsertRows();
+        }
+
+        if (bFrameBoundary) {
+            if (bNotify) {
+                beginInsertRows(QModelIndex(), m_curFrameCount, m_curFrameCount);
+            }
+            addNewFrame(srcRow);
+            if (bNotify) {
+                endInsertRows();
             }
-        }  // end for each source row
+        }
     }
 }
@@ -27,16 +27,19 @@
 
 #include <QDebug>
 
+// The API calls of a frame are a contiguous range of source rows.
 struct FrameInfo {
     int frameIndex;
     QPersistentModelIndex modelIndex;
-    QList<int> mapChildRowToSourceRow;
+    int firstSourceRow;
+    int sourceRowCount;
 };
 
 class vktraceviewer_vk_QGroupFramesProxyModel : public QAbstractProxyModel {
     Q_OBJECT
    public:
-    vktraceviewer_vk_QGroupFramesProxyModel(QObject *parent = 0) : QAbstractProxyModel(parent), m_curFrameCount(0) {
+    vktraceviewer_vk_QGroupFramesProxyModel(QObject *parent = 0)
+        : QAbstractProxyModel(parent), m_curFrameCount(0), m_nextFrameEnd(0) {
         buildGroups();
     }
 
@@ -49,8 +52,19 @@ class vktraceviewer_vk_QGroupFramesProxyModel : public QAbstractProxyModel {
             sourceModel = NULL;
         }
 
+        if (this->sourceModel() != NULL) {
+            disconnect(this->sourceModel(), SIGNAL(rowsInserted(const QModelIndex &, int, int)), this,
+                       SLOT(onSourceRowsInserted(const QModelIndex &, int, int)));
+        }
+
         QAbstractProxyModel::setSourceModel(sourceModel);
         buildGroups();
+
+        if (sourceModel != NULL) {
+            // The trace file loader keeps appending packets to the source model after it is first displayed.
+            connect(sourceModel, SIGNAL(rowsInserted(const QModelIndex &, int, int)), this,
+                    SLOT(onSourceRowsInserted(const QModelIndex &, int, int)));
+        }
     }
 
     //---------------------------------------------------------------------------------------------
@@ -60,7 +74,7 @@ class vktraceviewer_vk_QGroupFramesProxyModel : public QAbstractProxyModel {
         } else if (isFrame(parent)) {
             // this is a frame.
             // A frame knows how many children it has!
-            return m_frameList[parent.row()].mapChildRowToSourceRow.count();
+            return m_frameList[parent.row()].sourceRowCount;
         } else {
             // ask the source
             return sourceModel()->rowCount(mapToSource(parent));
@@ -74,7 +88,7 @@ class vktraceviewer_vk_QGroupFramesProxyModel : public QAbstractProxyModel {
         if (!parent.isValid()) {
             return true;
         } else if (isFrame(parent)) {
-            return m_frameList[parent.row()].mapChildRowToSourceRow.count() > 0;
+            return m_frameList[parent.row()].sourceRowCount > 0;
         }
         return false;
     }
@@ -163,8 +177,8 @@ class vktraceviewer_vk_QGroupFramesProxyModel : public QAbstractProxyModel {
             quintptr frameIndex = proxyIndex.internalId();
             const FrameInfo *pFrame = (const FrameInfo *)&m_frameList[frameIndex];
             assert(pFrame->frameIndex == (int)frameIndex);
-            if (proxyIndex.row() < pFrame->mapChildRowToSourceRow.count()) {
-                int srcRow = pFrame->mapChildRowToSourceRow[proxyIndex.row()];
+            if (proxyIndex.row() < pFrame->sourceRowCount) {
+                int srcRow = pFrame->firstSourceRow + proxyIndex.row();
                 int srcCol = proxyIndex.column();
 
                 // by using a default srcParent, we'll only get top-level indices.
@@ -182,20 +196,25 @@ class vktraceviewer_vk_QGroupFramesProxyModel : public QAbstractProxyModel {
     QModelIndex mapFromSource(const QModelIndex &sourceIndex) const {
         if (!sourceIndex.isValid()) return QModelIndex();
 
+        // binary search for the frame that has the srcRow as a child
         int srcRow = sourceIndex.row();
-        int proxyRow = m_mapSourceRowToProxyGroupRow[srcRow];
-
-        // figure out which frame has the srcRow as a child
-        const FrameInfo *pProxyGroup = NULL;
-        QListIterator<FrameInfo> frameIter(m_frameList);
-        while (frameIter.hasNext()) {
-            const FrameInfo *pFrame = &frameIter.next();
-            if (pFrame->mapChildRowToSourceRow.contains(srcRow)) {
-                pProxyGroup = pFrame;
-                break;
+        int low = 0;
+        int high = m_frameList.count();
+        while (low < high) {
+            int mid = low + (high - low) / 2;
+            if (m_frameList[mid].firstSourceRow <= srcRow) {
+                low = mid + 1;
+            } else {
+                high = mid;
             }
         }
 
+        if (low == 0) {
+            return QModelIndex();
+        }
+
+        const FrameInfo *pProxyGroup = &m_frameList[low - 1];
+        int proxyRow = srcRow - pProxyGroup->firstSourceRow;
         return createIndex(proxyRow, sourceIndex.column(), pProxyGroup->frameIndex);
     }
 
@@ -210,12 +229,22 @@ class vktraceviewer_vk_QGroupFramesProxyModel : public QAbstractProxyModel {
         return results;
     }
 
+    //---------------------------------------------------------------------------------------------
+   private slots:
+    void onSourceRowsInserted(const QModelIndex &parent, int first, int last) {
+        if (!parent.isValid()) {
+            appendSourceRows(first, last, true);
+        }
+    }
+
     //---------------------------------------------------------------------------------------------
    private:
     QList<FrameInfo> m_frameList;
-    QList<int> m_mapSourceRowToProxyGroupRow;
     int m_curFrameCount;
 
+    // index into the trace file's frame end packets of the next frame boundary to group
+    uint64_t m_nextFrameEnd;
+
     //---------------------------------------------------------------------------------------------
     bool isFrame(const QModelIndex &proxyIndex) const {
         // API Calls use the frame number as the index's internalId
@@ -235,13 +264,15 @@ class vktraceviewer_vk_QGroupFramesProxyModel : public QAbstractProxyModel {
     }
 
     //---------------------------------------------------------------------------------------------
-    FrameInfo *addNewFrame() {
+    FrameInfo *addNewFrame(int firstSourceRow) {
         // create frame info
         FrameInfo info;
         m_frameList.append(info);
         FrameInfo *pFrame = &m_frameList[m_curFrameCount];
 
         pFrame->frameIndex = m_curFrameCount;
+        pFrame->firstSourceRow = firstSourceRow;
+        pFrame->sourceRowCount = 0;
 
         // create proxy model index for frame node
         pFrame->modelIndex = createIndex(m_curFrameCount, 0, pFrame);
@@ -254,6 +285,7 @@ class vktraceviewer_vk_QGroupFramesProxyModel : public QAbstractProxyModel {
 
     //---------------------------------------------------------------------------------------------
     void buildGroups();
+    void appendSourceRows(int first, int last, bool bNotify);
 };
 
 #endif  // VKTRACEVIEWER_VK_QGROUPFRAMESPROXYMODEL_H